@@ -13,6 +13,9 @@
 /// This comes at the cost of increased runtime overhead because
 /// now there is some interpretation overhead within the hash
 /// table lookup functions.
+///
+/// The key-aware benchmarks are labeled with the tag probing layout of the build.
+/// Configure with -DSCALAR_HT_PROBING=ON to compare single-tag probing against SSE2 group probing.
 namespace inkfuse {
 
 namespace {
@@ -105,6 +108,7 @@ void ht_insert_key_aware(benchmark::State& state) {
    }
    state.SetItemsProcessed(state.iterations() * num_elems);
    state.SetBytesProcessed(state.iterations() * num_elems * (key_size + payload_size));
+   state.SetLabel(SharedHashTableState::probing_layout);
 }
 
 void ht_lookup_key_aware_match(benchmark::State& state) {
@@ -118,6 +122,7 @@ void ht_lookup_key_aware_match(benchmark::State& state) {
       probeKeyAwareHT(data, ht, num_elems, key_size);
    }
    state.SetItemsProcessed(state.iterations() * probe_count);
+   state.SetLabel(SharedHashTableState::probing_layout);
 }
 
 void ht_lookup_key_aware_nomatch(benchmark::State& state) {
@@ -132,6 +137,27 @@ void ht_lookup_key_aware_nomatch(benchmark::State& state) {
       probeKeyAwareHT(data_nomatch, ht, num_elems, key_size);
    }
    state.SetItemsProcessed(state.iterations() * probe_count);
+   state.SetLabel(SharedHashTableState::probing_layout);
+}
+
+/// Probe a table with a fixed number of slots filled to the given percentage.
+/// Higher loads lead to longer collision chains, which is where group probing pays off.
+void ht_lookup_key_aware_load(benchmark::State& state) {
+   const size_t slots = 1ull << 22;
+   const auto load_percent = state.range(0);
+   const bool match = state.range(1);
+   const size_t key_size = 8;
+   const size_t payload_size = 8;
+   const size_t num_elems = slots * load_percent / 100;
+   auto data = buildData(num_elems, key_size, payload_size);
+   auto data_nomatch = buildData(num_elems, key_size, payload_size, 420);
+   HashTableSimpleKey ht(key_size, payload_size, slots);
+   addToKeyAwareHT(data, ht, num_elems, key_size, payload_size);
+   for (auto _ : state) {
+      probeKeyAwareHT(match ? data : data_nomatch, ht, num_elems, key_size);
+   }
+   state.SetItemsProcessed(state.iterations() * probe_count);
+   state.SetLabel(SharedHashTableState::probing_layout);
 }
 
 template <class KV_pair>
@@ -211,6 +237,11 @@ BENCHMARK(ht_insert_unordered_map<std::pair<TB64, TB64>>)->ArgsProduct({{1'000,
 BENCHMARK(ht_lookup_key_aware_match)->ArgsProduct({{1'000, 100'000, 10'000'000, 50'000'000}, {8, 32, 64}, {8, 64}});
 BENCHMARK(ht_lookup_key_aware_nomatch)->ArgsProduct({{1'000, 100'000, 10'000'000, 50'000'000}, {8, 32, 64}, {8, 64}});
 
+// InkFuse Simple Key Map Lookup Benchmarks at different loads.
+// Load: 25%, 50%, 75% of 4M slots.
+// Matching and non-matching probes.
+BENCHMARK(ht_lookup_key_aware_load)->ArgsProduct({{25, 50, 75}, {0, 1}});
+
 // std::unordered_map Lookup Benchmarks.
 // Insert 1k, 100k, 10M, 50M keys.
 // Key sizes: 8, 32, 64 bytes.
@@ -15,23 +15,53 @@
 
 namespace inkfuse {
 
-Aggregation::Aggregation(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_)
+namespace {
+/// Number of radix partitions of the thread-local pre-aggregation tables.
+const size_t PRE_AGG_PARTITIONS = 64;
+}
+
+Aggregation::Aggregation(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_, std::optional<size_t> memory_budget_)
    : RelAlgOp(std::move(children_), std::move(op_name_)), group_by(std::move(group_by_)),
-     agg_pointer_result(IR::Pointer::build(IR::Char::build())), ht_scan_result(IR::Pointer::build(IR::Char::build())) {
+     agg_pointer_result(IR::Pointer::build(IR::Char::build())), ht_scan_result(IR::Pointer::build(IR::Char::build())), memory_budget(memory_budget_) {
    plan(std::move(aggregates_));
+   if (memory_budget) {
+      if (requires_complex_ht) {
+         // The complex keys point to memory outside of the hash table.
+         throw std::runtime_error("Out-of-core aggregation only supports keys that are stored within the hash table.");
+      }
+      for (const auto& [iu, granule] : granules) {
+         if (granule->needsStateInit()) {
+            // Groups get spilled right after they were inserted, before their state was initialized.
+            throw std::runtime_error("Out-of-core aggregation only supports zero-initialized aggregate state.");
+         }
+      }
+   }
 }
 
-std::unique_ptr<Aggregation> Aggregation::build(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_) {
-   return std::make_unique<Aggregation>(std::move(children_), std::move(op_name_), std::move(group_by_), std::move(aggregates_));
+std::unique_ptr<Aggregation> Aggregation::build(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_, std::optional<size_t> memory_budget_) {
+   return std::make_unique<Aggregation>(std::move(children_), std::move(op_name_), std::move(group_by_), std::move(aggregates_), memory_budget_);
 }
 
 void Aggregation::plan(std::vector<AggregateFunctions::Description> description) {
-   // Compute the hash table required by this aggregation?
-   if (group_by.size() == 1 && dynamic_cast<IR::String*>(group_by[0]->type.get())) {
-      requires_complex_ht = true;
+   // Compute the hash table required by this aggregation? Any string key needs
+   // a complex hash table, which expects the strings at the start of the packed key.
+   for (const IU* key : group_by) {
+      if (dynamic_cast<IR::String*>(key->type.get())) {
+         num_string_keys++;
+      }
    }
-   // We pack the aggregation keys first.
+   requires_complex_ht = num_string_keys > 0;
+   // We pack the aggregation keys first. Strings come first, followed by all other keys.
+   size_t string_offset = 0;
+   size_t simple_offset = 8 * num_string_keys;
    for (const IU* key : group_by) {
+      if (dynamic_cast<IR::String*>(key->type.get())) {
+         key_offsets.push_back(string_offset);
+         string_offset += key->type->numBytes();
+      } else {
+         key_offsets.push_back(simple_offset);
+         simple_offset += key->type->numBytes();
+      }
       key_size += key->type->numBytes();
       const auto& out = out_key_ius.emplace_back(key->type);
       output_ius.push_back(&out);
@@ -41,6 +71,10 @@ void Aggregation::plan(std::vector<AggregateFunctions::Description> description)
          pseudo_ius.emplace_back(IR::Void::build());
       }
    }
+   // Keys of at most two bytes, as well as single date keys, have a small enough value range to
+   // be aggregated in a dense array. The table falls back to hashing for keys outside of the range.
+   const bool single_date = group_by.size() == 1 && dynamic_cast<IR::Date*>(group_by[0]->type.get());
+   dense_keys = !requires_complex_ht && key_size != 0 && (key_size <= 2 || single_date);
    // We know the key size - so we can now create the properly sized byte array.
    packed_ht_key.emplace(IR::ByteArray::build(key_size));
 
@@ -130,15 +164,59 @@ void Aggregation::decay(PipelineDAG& dag) const {
    // New Pipeline:
    // 4. Attach readers on a new pipeline.
 
-   // Set up the backing aggregation hash table. We can drop it after the
+   // Compute where the aggregate granules live within a hash table slot.
+   // The aggregate state starts after the serialized key.
+   std::vector<std::pair<size_t, const AggState*>> granule_offsets;
+   size_t granule_offset = key_size + payload_offset;
+   for (const auto& [agg_iu, agg_state] : granules) {
+      granule_offsets.emplace_back(granule_offset, agg_state.get());
+      granule_offset += agg_state->getStateSize();
+   }
+   // Merge the thread-local aggregate states of a group granule by granule.
+   auto merge = [granule_offsets](char* dst, const char* src) {
+      for (const auto& [offset, agg_state] : granule_offsets) {
+         agg_state->mergeState(dst + offset, src + offset);
+      }
+   };
+
+   // Set up the backing aggregation hash tables. We can drop them after the
    // pipeline which reads from the aggregation is done.
+   // Every worker thread pre-aggregates into its own hash table, radix-partitioned by the
+   // key hash. The read pipeline then merges the partitions of the different workers.
+   // Direct lookup tables and the single group of a key-less aggregation are not partitioned.
+   // Their size is bounded, so they also ignore the memory budget.
    void* hash_table;
+   RuntimeFunctionSubop::ThreadLocalObjectResolver thread_table;
    if (requires_complex_ht) {
-      hash_table = &dag.attachHashTableComplexKey(dag.getPipelines().size(), 1, payload_size);
-   } else if (key_size == 2) {
-      hash_table = &dag.attachHashTableDirectLookup(dag.getPipelines().size(), payload_size);
+      const auto simple_key_size = static_cast<uint16_t>(key_size - 8 * num_string_keys);
+      auto factory = [simple_key_size, num_string_keys = num_string_keys, payload_size = payload_size]() { return std::make_unique<HashTableComplexKey>(simple_key_size, num_string_keys, payload_size, 8); };
+      auto& tables = dag.attachAggregationHashTables<HashTableComplexKey>(dag.getPipelines().size(), factory, merge, PRE_AGG_PARTITIONS, key_size, payload_size);
+      thread_table = [&tables](size_t thread_id) -> void* { return &tables.getThreadTable(thread_id); };
+      hash_table = &tables;
+   } else if (dense_keys) {
+      // The dense window of a single key covers exactly its value range, if it is known.
+      const auto range = group_by.size() == 1 ? group_by[0]->range : std::nullopt;
+      auto factory = [key_size = key_size, payload_size = payload_size, range]() {
+         if (range) {
+            return std::make_unique<HashTableDirectLookup>(key_size, payload_size, range->min, range->max);
+         }
+         return std::make_unique<HashTableDirectLookup>(key_size, payload_size);
+      };
+      auto& tables = dag.attachAggregationHashTables<HashTableDirectLookup>(dag.getPipelines().size(), factory, merge, 1, key_size, payload_size);
+      thread_table = [&tables](size_t thread_id) -> void* { return &tables.getThreadTable(thread_id).getPartition(0); };
+      hash_table = &tables;
    } else {
-      hash_table = &dag.attachHashTableSimpleKey(dag.getPipelines().size(), key_size, payload_size);
+      auto factory = [key_size = key_size, payload_size = payload_size]() { return std::make_unique<HashTableSimpleKey>(key_size, payload_size, 8); };
+      const size_t num_partitions = key_size == 0 ? 1 : PRE_AGG_PARTITIONS;
+      // The single group of a key-less aggregation never needs to spill.
+      const auto budget = key_size == 0 ? std::nullopt : memory_budget;
+      auto& tables = dag.attachAggregationHashTables<HashTableSimpleKey>(dag.getPipelines().size(), factory, merge, num_partitions, key_size, payload_size, budget);
+      if (key_size == 0) {
+         thread_table = [&tables](size_t thread_id) -> void* { return &tables.getThreadTable(thread_id).getPartition(0); };
+      } else {
+         thread_table = [&tables](size_t thread_id) -> void* { return &tables.getThreadTable(thread_id); };
+      }
+      hash_table = &tables;
    }
 
    auto& curr_pipe = dag.getCurrentPipeline();
@@ -152,16 +230,15 @@ void Aggregation::decay(PipelineDAG& dag) const {
       curr_pipe.attachSuboperator(ScratchPadIUProvider::build(this, *packed_ht_key));
 
       // Now pack the key into the provided scratch pad IU.
-      size_t key_offset = 0;
       auto pseudo = pseudo_ius.begin();
+      auto key_offset = key_offsets.begin();
       for (const auto& key : group_by) {
          auto& packer = curr_pipe.attachSuboperator(KeyPackerSubop::build(this, *key, *packed_ht_key, {&(*pseudo)}));
          // Attach the runtime parameter that represents the state offset.
          KeyPackingRuntimeParams param;
-         param.offsetSet(IR::UI<2>::build(key_offset));
+         param.offsetSet(IR::UI<2>::build(*key_offset));
          reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
-         // Update the key offset by the size of the IU.
-         key_offset += key->type->numBytes();
+         key_offset++;
          pseudo++;
       }
       packed_key_iu = &packed_ht_key.value();
@@ -174,18 +251,25 @@ void Aggregation::decay(PipelineDAG& dag) const {
    }
 
    // Dispatch the correct lookup function.
+   std::unique_ptr<RuntimeFunctionSubop> lookup;
    if (key_size && requires_complex_ht) {
-      curr_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<HashTableComplexKey>(this, &agg_pointer_result, *packed_key_iu, std::move(pseudo), hash_table));
-   } else if (key_size == 2) {
-      curr_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<HashTableDirectLookup>(this, &agg_pointer_result, *packed_key_iu, std::move(pseudo), hash_table));
+      lookup = RuntimeFunctionSubop::htLookupOrInsert<PartitionedHashTable<HashTableComplexKey>>(this, &agg_pointer_result, *packed_key_iu, std::move(pseudo), hash_table);
+   } else if (dense_keys) {
+      lookup = RuntimeFunctionSubop::htLookupOrInsert<HashTableDirectLookup>(this, &agg_pointer_result, *packed_key_iu, std::move(pseudo), hash_table);
    } else if (key_size != 0) {
-      curr_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<HashTableSimpleKey>(this, &agg_pointer_result, *packed_key_iu, std::move(pseudo), hash_table));
+      // Use the runtime functions specialized on the key width if there are any.
+      lookup = dispatchKeyWidth(key_size, [&](auto key_width) {
+         return RuntimeFunctionSubop::htLookupOrInsert<KeyWidthSpecialized<PartitionedHashTable<HashTableSimpleKey>, key_width>>(this, &agg_pointer_result, *packed_key_iu, std::move(pseudo), hash_table);
+      });
    } else {
       // The key size is zero - so we just aggregate a single group.
       // We use an optimized code path for this. We need to htNoKeyLookup to reference an
       // input IU as a dependency. This is
-      curr_pipe.attachSuboperator(RuntimeFunctionSubop::htNoKeyLookup(this, agg_pointer_result, *granules[0].first, hash_table));
+      lookup = RuntimeFunctionSubop::htNoKeyLookup(this, agg_pointer_result, *granules[0].first, hash_table);
    }
+   // Every worker thread inserts into its own pre-aggregation table.
+   lookup->setThreadLocalObjects(std::move(thread_table));
+   curr_pipe.attachSuboperator(std::move(lookup));
 
    // Step 3: Update the aggregation state.
    // The current offset into the serialized aggregate state. The aggregate state starts after the serialized key.
@@ -205,24 +289,24 @@ void Aggregation::decay(PipelineDAG& dag) const {
    auto& read_pipe = dag.buildNewPipeline();
    // First, build a reader on the aggregate hash table returning pointers to the elements.
    // Dispatch the correct reader depending on the layout.
+   // The reader merges the thread-local partitions of the different workers.
    if (requires_complex_ht) {
-      read_pipe.attachSuboperator(ComplexHashTableSource::build(this, ht_scan_result, static_cast<HashTableComplexKey*>(hash_table)));
-   } else if (key_size == 2) {
-      read_pipe.attachSuboperator(DirectLookupHashTableSource::build(this, ht_scan_result, static_cast<HashTableDirectLookup*>(hash_table)));
+      read_pipe.attachSuboperator(ComplexPartitionedHashTableSource::build(this, ht_scan_result, static_cast<AggregationHashTables<HashTableComplexKey>*>(hash_table)));
+   } else if (dense_keys) {
+      read_pipe.attachSuboperator(DirectLookupPartitionedHashTableSource::build(this, ht_scan_result, static_cast<AggregationHashTables<HashTableDirectLookup>*>(hash_table)));
    } else {
-      read_pipe.attachSuboperator(SimpleHashTableSource::build(this, ht_scan_result, static_cast<HashTableSimpleKey*>(hash_table)));
+      read_pipe.attachSuboperator(SimplePartitionedHashTableSource::build(this, ht_scan_result, static_cast<AggregationHashTables<HashTableSimpleKey>*>(hash_table)));
    }
 
    // Produce the readers for the materialized keys.
-   size_t key_offset = 0;
+   auto key_offset = key_offsets.begin();
    for (const auto& out_key_iu : out_key_ius) {
       auto& unpacker = read_pipe.attachSuboperator(KeyUnpackerSubop::build(this, ht_scan_result, out_key_iu));
       // Attach the runtime parameter that represents the state offset.
       KeyPackingRuntimeParams param;
-      param.offsetSet(IR::UI<2>::build(key_offset));
+      param.offsetSet(IR::UI<2>::build(*key_offset));
       reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
-      // Update the key offset by the size of the IU.
-      key_offset += out_key_iu.type->numBytes();
+      key_offset++;
    }
 
    // Produce the actual operators that computes the aggregate functions.
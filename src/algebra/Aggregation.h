@@ -9,9 +9,11 @@
 namespace inkfuse {
 
 /// Relational algebra operator for aggregations.
+/// If a memory budget is given, the aggregation spills its pre-aggregated groups to disk once the
+/// hash tables of the workers exceed the budget.
 struct Aggregation : public RelAlgOp {
-   Aggregation(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_);
-   static std::unique_ptr<Aggregation> build(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_);
+   Aggregation(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_, std::optional<size_t> memory_budget_ = std::nullopt);
+   static std::unique_ptr<Aggregation> build(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> group_by_, std::vector<AggregateFunctions::Description> aggregates_, std::optional<size_t> memory_budget_ = std::nullopt);
 
    void decay(PipelineDAG& dag) const override;
 
@@ -48,12 +50,20 @@ struct Aggregation : public RelAlgOp {
    IU ht_scan_result;
    /// Size of the aggregation key.
    size_t key_size = 0;
+   /// Offset of every group-by key within the packed key. String keys are packed first.
+   std::vector<size_t> key_offsets;
+   /// Number of string keys within the packed key.
+   uint16_t num_string_keys = 0;
    /// Offset of the payload - i.e. after how many bytes does the first granule start.
    size_t payload_offset = 0;
    /// Size of the aggregation payload.
    size_t payload_size = 0;
    /// Does this aggregation require a complex hash table?
    bool requires_complex_ht = false;
+   /// Are the keys aggregated in a dense array (HashTableDirectLookup)?
+   bool dense_keys = false;
+   /// Memory budget of the pre-aggregation hash tables in bytes, if the aggregation may spill.
+   std::optional<size_t> memory_budget;
 };
 
 }
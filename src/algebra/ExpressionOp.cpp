@@ -78,6 +78,26 @@ void ExpressionOp::decay(PipelineDAG& dag) const {
    }
 }
 
+void ExpressionOp::rewriteDictionaryEquals(ComputeNode::Type& code, std::optional<IR::ValuePtr>& runtime_param, const std::vector<const IU*>& source_ius) {
+   const auto dictionary = [](const IU* iu) {
+      return dynamic_cast<const IR::DictionaryCode*>(iu->type.get());
+   };
+   if (runtime_param) {
+      if (const auto* codes = dictionary(source_ius[0])) {
+         // Encode the constant once, the rows then only need an integer compare.
+         const auto& constant = dynamic_cast<IR::StringVal&>(**runtime_param);
+         runtime_param = IR::UI<1>::build(codes->encode(constant.value));
+         code = ComputeNode::Type::Eq;
+      }
+   } else if (dictionary(source_ius[0]) || dictionary(source_ius[1])) {
+      // Codes of the same dictionary can be compared directly.
+      if (!dictionary(source_ius[0]) || !dictionary(source_ius[1]) || dictionary(source_ius[0])->dictionary != dictionary(source_ius[1])->dictionary) {
+         throw std::runtime_error("StrEquals needs both sides encoded with the same dictionary");
+      }
+      code = ComputeNode::Type::Eq;
+   }
+}
+
 void ExpressionOp::decayNode(Node* node, std::unordered_map<Node*, const IU*>& built, PipelineDAG& dag) const {
    if (built.count(node)) {
       // Stop early if this node was processed already.
@@ -95,16 +115,24 @@ void ExpressionOp::decayNode(Node* node, std::unordered_map<Node*, const IU*>& b
          source_ius.push_back(built[child]);
       }
       std::vector<const IU*> out_ius{&compute_node->out};
+      auto code = compute_node->code;
+      std::optional<IR::ValuePtr> runtime_param;
+      if (compute_node->opt_runtime_param) {
+         runtime_param = (*compute_node->opt_runtime_param)->copy();
+      }
+      if (code == ComputeNode::Type::StrEquals) {
+         rewriteDictionaryEquals(code, runtime_param, source_ius);
+      }
       SuboperatorArc subop;
-      if (!compute_node->opt_runtime_param) {
+      if (!runtime_param) {
          // Add a regular ExpressionSubop for this node.
-         subop = std::make_shared<ExpressionSubop>(this, std::move(out_ius), std::move(source_ius), compute_node->code);
+         subop = std::make_shared<ExpressionSubop>(this, std::move(out_ius), std::move(source_ius), code);
       } else {
          // Add a RuntimeExpressionSubop for this node.
-         subop = std::make_shared<RuntimeExpressionSubop>(this, std::move(out_ius), std::move(source_ius), compute_node->code, (*compute_node->opt_runtime_param)->getType());
+         subop = std::make_shared<RuntimeExpressionSubop>(this, std::move(out_ius), std::move(source_ius), code, (*runtime_param)->getType());
          // Add the runtime parameters needed for the runtime expression.
          RuntimeExpressionParams params;
-         params.dataSet((*compute_node->opt_runtime_param)->copy());
+         params.dataSet(std::move(*runtime_param));
          static_cast<RuntimeExpressionSubop&>(*subop).attachRuntimeParams(std::move(params));
       }
       dag.getCurrentPipeline().attachSuboperator(std::move(subop));
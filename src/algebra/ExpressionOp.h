@@ -91,6 +91,9 @@ struct ExpressionOp : public RelAlgOp {
    static IR::TypeArc derive(ComputeNode::Type code, const std::vector<IR::TypeArc>& types);
 
    protected:
+   /// Turn a StrEquals on dictionary-encoded strings into an Eq on their codes.
+   static void rewriteDictionaryEquals(ComputeNode::Type& code, std::optional<IR::ValuePtr>& runtime_param, const std::vector<const IU*>& source_ius);
+
    /// Helper for decaying the expression DAG without duplicate subops.
    void decayNode(
       Node* node,
@@ -16,7 +16,8 @@ Filter::Filter(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string nam
       // Define the output IUs which we will use.
       for (const IU* iu : to_redefine) {
          assert(iu);
-         redefined.emplace_back(iu->type);
+         // Filtering keeps the values within their range.
+         redefined.emplace_back(iu->type).range = iu->range;
       }
       // Set up output structure.
       for (const IU& iu : redefined) {
@@ -2,6 +2,8 @@
 #define INKFUSE_IU_H
 
 #include "codegen/Type.h"
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <sstream>
 
@@ -19,10 +21,18 @@ struct IU {
 
    explicit IU(IR::TypeArc type_) : type(std::move(type_)) { assert(type); };
 
+   /// Smallest and largest value of an IU. Both are the raw bytes of the value read as little-endian integer.
+   struct ValueRange {
+      uint64_t min;
+      uint64_t max;
+   };
+
    /// Type of this IU.
    IR::TypeArc type;
    /// The name for this IU.
    std::string name;
+   /// The range of the values of this IU, if it is known when planning the query.
+   std::optional<ValueRange> range;
 };
 
 }
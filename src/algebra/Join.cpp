@@ -3,14 +3,19 @@
 #include "algebra/suboperators/RuntimeFunctionSubop.h"
 #include "algebra/suboperators/row_layout/KeyPackerSubop.h"
 #include "algebra/suboperators/row_layout/KeyUnpackerSubop.h"
+#include "algebra/Pipeline.h"
+#include "algebra/suboperators/sources/JoinRowsSource.h"
 #include "algebra/suboperators/sources/ScratchPadIUProvider.h"
 
 namespace inkfuse {
 
-Join::Join(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> keys_left_, std::vector<const IU*> payload_left_, std::vector<const IU*> keys_right_, std::vector<const IU*> payload_right_, JoinType type_, bool is_pk_join_)
+Join::Join(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> keys_left_, std::vector<const IU*> payload_left_, std::vector<const IU*> keys_right_, std::vector<const IU*> payload_right_, JoinType type_, bool is_pk_join_, bool bloom_filter_, std::optional<size_t> memory_budget_, std::optional<size_t> build_rows_)
    : RelAlgOp(std::move(children_), std::move(op_name_)),
      type(type_),
      is_pk_join(is_pk_join_),
+     bloom_filter(bloom_filter_),
+     memory_budget(memory_budget_),
+     build_rows(build_rows_),
      keys_left(std::move(keys_left_)),
      payload_left(std::move(payload_left_)),
      keys_right(std::move(keys_right_)),
@@ -18,17 +23,28 @@ Join::Join(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name
    if (children.size() != 2) {
       throw std::runtime_error("Join needs to have two children");
    }
+   if (memory_budget && !is_pk_join) {
+      throw std::runtime_error("Joins with a memory budget need to be primary key joins");
+   }
+   for (const IU* key : keys_left) {
+      if (dynamic_cast<IR::String*>(key->type.get())) {
+         // The join hash tables compare packed keys bytewise, a string key would only compare its pointer.
+         throw std::runtime_error("Joins on string keys are not supported");
+      }
+   }
    plan();
 }
 
-std::unique_ptr<Join> Join::build(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> keys_left_, std::vector<const IU*> payload_left_, std::vector<const IU*> keys_right_, std::vector<const IU*> payload_right_, JoinType type_, bool is_pk_join_) {
-   return std::make_unique<Join>(std::move(children_), std::move(op_name_), std::move(keys_left_), std::move(payload_left_), std::move(keys_right_), std::move(payload_right_), type_, is_pk_join_);
+std::unique_ptr<Join> Join::build(std::vector<std::unique_ptr<RelAlgOp>> children_, std::string op_name_, std::vector<const IU*> keys_left_, std::vector<const IU*> payload_left_, std::vector<const IU*> keys_right_, std::vector<const IU*> payload_right_, JoinType type_, bool is_pk_join_, bool bloom_filter_, std::optional<size_t> memory_budget_, std::optional<size_t> build_rows_) {
+   return std::make_unique<Join>(std::move(children_), std::move(op_name_), std::move(keys_left_), std::move(payload_left_), std::move(keys_right_), std::move(payload_right_), type_, is_pk_join_, bloom_filter_, memory_budget_, build_rows_);
 }
 
 void Join::plan() {
    // Set up the left side output IUs.
    for (const IU* key : keys_left) {
       auto& iu = keys_left_out.emplace_back(key->type);
+      // Joining keeps the values within their range.
+      iu.range = key->range;
       if (keys_left.size() > 1) {
          left_pseudo_ius.emplace_back(IR::Void::build());
       }
@@ -37,6 +53,7 @@ void Join::plan() {
    }
    for (const IU* payload : payload_left) {
       auto& iu = payload_left_out.emplace_back(payload->type);
+      iu.range = payload->range;
       output_ius.push_back(&iu);
       payload_size_left += iu.type->numBytes();
    }
@@ -50,6 +67,7 @@ void Join::plan() {
    for (const IU* key : keys_right) {
       if (type != JoinType::LeftSemi) {
          auto& iu = keys_right_out.emplace_back(key->type);
+         iu.range = key->range;
          output_ius.push_back(&iu);
       }
       right_pseudo_ius.emplace_back(IR::Void::build());
@@ -57,6 +75,7 @@ void Join::plan() {
    }
    for (const IU* payload : payload_right) {
       auto& iu = payload_right_out.emplace_back(payload->type);
+      iu.range = payload->range;
       // We need pseudo IUs for the payload of the probe side. The return IU of the probe
       // gets used for re-unpacking the joined row later. When we touch that return IU we
       // need to make sure the entire key is present already.
@@ -67,22 +86,53 @@ void Join::plan() {
 
    assert(key_size_left == key_size_right);
 
+   // Large builds of PK joins get radix-partitioned. A memory budget takes precedence, the hybrid hash join partitions as well.
+   radix_join = is_pk_join && !memory_budget && build_rows && *build_rows * (key_size_left + payload_size_left) > radix_join_threshold;
+   if (is_pk_join && !memory_budget && !radix_join && keys_left.size() == 1) {
+      // Single integer keys can index into an array. Whether the keys are dense enough is only known once the build is done.
+      const auto* type = keys_left[0]->type.get();
+      array_key_signed = dynamic_cast<const IR::SignedInt*>(type) || dynamic_cast<const IR::Date*>(type);
+      array_join = array_key_signed || dynamic_cast<const IR::UnsignedInt*>(type);
+   }
+
    scratch_pad_left.emplace(IR::ByteArray::build(key_size_left));
    scratch_pad_right.emplace(IR::ByteArray::build(key_size_right + payload_size_right));
    filtered_build.emplace(IR::Pointer::build(IR::Char::build()));
    // The filtered probe column consists of Char* into the contiguous ByteArray column `filtered_build`.
    filtered_probe.emplace(IR::Pointer::build(IR::Char::build()));
+   if (bloom_filter && keys_right.size() == 1 && !memory_budget && !radix_join) {
+      // The Bloom filter hashes the single probe key directly, before it gets packed.
+      bloom_match.emplace(IR::Bool::build());
+      bloom_pseudo_iu.emplace(IR::Void::build());
+      for (const IU* iu : keys_right) {
+         bloom_filtered_right.emplace_back(iu->type);
+      }
+      for (const IU* iu : payload_right) {
+         bloom_filtered_right.emplace_back(iu->type);
+      }
+   } else {
+      bloom_filter = false;
+   }
    lookup_left.emplace(IR::Pointer::build(IR::Char::build()));
    lookup_right.emplace(IR::Pointer::build(IR::Char::build()));
+   hash_left.emplace(IR::UnsignedInt::build(8));
+   hash_right.emplace(IR::UnsignedInt::build(8));
    filter_pseudo_iu.emplace(IR::Void::build());
+   if (!is_pk_join || memory_budget || radix_join) {
+      expanded_build.emplace(IR::Pointer::build(IR::Char::build()));
+      expanded_probe.emplace(IR::Pointer::build(IR::Char::build()));
+   }
 }
 
 void Join::decay(inkfuse::PipelineDAG& dag) const {
-   if (is_pk_join) {
+   if (is_pk_join && memory_budget) {
+      decayHybridJoin(dag);
+   } else if (radix_join) {
+      decayRadixJoin(dag);
+   } else if (is_pk_join) {
       decayPkJoin(dag);
    } else {
-      // TODO(benjamin) implement
-      throw std::runtime_error("Only supporting PK joins so far");
+      decayNMJoin(dag);
    }
 }
 
@@ -93,15 +143,21 @@ void Join::decayPkJoin(inkfuse::PipelineDAG& dag) const {
    // 1. Pack the join key into a scratch pad IU
    // 2. Insert the scratch pad IU into a hash table
    // 3. Pack the remaining columns of the build payload
+   // Once the build pipeline is done, single integer keys get an array index if they are dense.
    //
    // Probe pipeline:
+   // 0. Optionally drop probe rows that fail the Bloom filter on the build keys
    // 1. Pack both the probe key and the probe payload into a scratch pad IU
-   // 2. Lookup the scratch pad IU
+   // 2. Lookup the scratch pad IU, either in the hash table or in the array index
    // 3. Filter the rows whether the lookup returned a non-null pointer
    // 4. Unpack all the rows again into individual IUs
 
    // TODO fix discard
    HashTableSimpleKey& ht = dag.attachHashTableSimpleKey(0, key_size_left, payload_size_left);
+   // Bloom filter on the build keys, filled when the build pipeline is finalized.
+   BloomFilter* bloom = nullptr;
+   // Array index on dense build keys, set up when the build pipeline is finalized.
+   ArrayJoinIndex* array = nullptr;
    {
       // Step 1: Construct the build pipeline.
 
@@ -110,51 +166,53 @@ void Join::decayPkJoin(inkfuse::PipelineDAG& dag) const {
       auto& build_pipe = dag.getCurrentPipeline();
 
       // 1.1 Pack the join key into a scratch pad IU.
-      const IU* key_iu = keys_left.front();
-      if (keys_left.size() > 1) {
-         key_iu = &(*scratch_pad_left);
-         // We only need to pack if we can't use the single key directly.
-         build_pipe.attachSuboperator(ScratchPadIUProvider::build(this, *scratch_pad_left));
-         size_t build_key_offset = 0;
-         auto build_pseudo = left_pseudo_ius.begin();
-         for (const IU* key_left : keys_left) {
-            auto& packer = build_pipe.attachSuboperator(KeyPackerSubop::build(this, *key_left, *scratch_pad_left, {&(*build_pseudo)}));
-            // Attach the runtime parameter that represents the state offset.
-            KeyPackingRuntimeParams param;
-            param.offsetSet(IR::UI<2>::build(build_key_offset));
-            reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
-            // Update the key offset by the size of the IU.
-            build_key_offset += key_left->type->numBytes();
-            build_pseudo++;
-         }
-      }
+      const IU& key_iu = packBuildKey(build_pipe);
 
       // 1.2 Insert into the hash table.
       std::vector<const IU*> pseudo;
       for (const auto& pseudo_iu : left_pseudo_ius) {
          pseudo.push_back(&pseudo_iu);
       }
-      // We know there are no duplicate keys. We might think we can insert directly, without duplicate checking.
-      // However, this is not possible since there might be morsel restarts. We need `htLookupOrInsert`.
-      if (payload_left.empty()) {
-         // We do not care about the result pointer as we don't need to do packing.
-         build_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<HashTableSimpleKey>(this, nullptr, *key_iu, std::move(pseudo), &ht));
-      } else {
-         // We need the result pointer for payload packing.
-         build_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<HashTableSimpleKey>(this, &(*lookup_left), *key_iu, std::move(pseudo), &ht));
+      // Every worker builds its own table. Once the build pipeline is done, the workers move their
+      // rows into the probed hash table `ht` in parallel.
+      auto& build_tables = dag.attachParallelBuildHashTable(0, ht, key_size_left, payload_size_left);
+      if (bloom_filter) {
+         bloom = &build_tables.enableBloomFilter();
+      }
+      if (array_join) {
+         array = &build_tables.enableArrayIndex(array_key_signed);
       }
+      std::unique_ptr<RuntimeFunctionSubop> hash;
+      std::unique_ptr<RuntimeFunctionSubop> insert;
+      // Use the runtime functions specialized on the key width if there are any.
+      dispatchKeyWidth(key_size_left, [&](auto key_width) {
+         using Table = KeyWidthSpecialized<HashTableSimpleKey, key_width>;
+         // Hash the keys first. During vectorized interpretation this prefetches the slots of the whole chunk.
+         hash = RuntimeFunctionSubop::htHashPrefetch<Table>(this, *hash_left, key_iu, pseudo, &ht);
+         // We know there are no duplicate keys. We might think we can insert directly, without duplicate checking.
+         // However, this is not possible since there might be morsel restarts. We need `htLookupOrInsert`.
+         if (payload_left.empty()) {
+            // We do not care about the result pointer as we don't need to do packing.
+            insert = RuntimeFunctionSubop::htLookupOrInsertWithHash<Table>(this, nullptr, key_iu, *hash_left, std::move(pseudo), &ht);
+         } else {
+            // We need the result pointer for payload packing.
+            insert = RuntimeFunctionSubop::htLookupOrInsertWithHash<Table>(this, &(*lookup_left), key_iu, *hash_left, std::move(pseudo), &ht);
+         }
+      });
+      auto thread_table = [&build_tables](size_t thread_id) { return &build_tables.getThreadTable(thread_id); };
+      hash->setThreadLocalObjects(thread_table);
+      insert->setThreadLocalObjects(
+         thread_table,
+         [&build_tables](size_t thread_id) { build_tables.finalize(thread_id); });
+      if (array) {
+         // Finalizing the build fills the array index the probe pipeline reads from.
+         insert->addSharedObjectAccess(array, true);
+      }
+      build_pipe.attachSuboperator(std::move(hash));
+      build_pipe.attachSuboperator(std::move(insert));
 
       // 1.3 Pack the payload.
-      size_t build_payload_offset = key_size_left;
-      for (const IU* payload : payload_left) {
-         auto& packer = build_pipe.attachSuboperator(KeyPackerSubop::build(this, *payload, *lookup_left, {}));
-         // Attach the runtime parameter that represents the state offset.
-         KeyPackingRuntimeParams param;
-         param.offsetSet(IR::UI<2>::build(build_payload_offset));
-         reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
-         // Update the key offset by the size of the IU.
-         build_payload_offset += payload->type->numBytes();
-      }
+      packBuildPayload(build_pipe);
    }
 
    {
@@ -164,92 +222,414 @@ void Join::decayPkJoin(inkfuse::PipelineDAG& dag) const {
       children[1]->decay(dag);
       auto& probe_pipe = dag.getCurrentPipeline();
 
-      // 2.1 Pack the probe key and the probe payload.
-      probe_pipe.attachSuboperator(ScratchPadIUProvider::build(this, *scratch_pad_right));
-      size_t probe_offset = 0;
-      auto probe_pseudo = right_pseudo_ius.begin();
-      // Pack keys.
-      for (const IU* key_right : keys_right) {
-         auto& packer = probe_pipe.attachSuboperator(KeyPackerSubop::build(this, *key_right, *scratch_pad_right, {&(*probe_pseudo)}));
-         // Attach the runtime parameter that represents the state offset.
-         KeyPackingRuntimeParams param;
-         param.offsetSet(IR::UI<2>::build(probe_offset));
-         reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
-         // Update the key offset by the size of the IU.
-         probe_offset += key_right->type->numBytes();
-         probe_pseudo++;
+      // 2.1 - 2.3 Pack, probe and filter on probe matches.
+      probe(probe_pipe, ht, bloom, nullptr, nullptr, array);
+
+      // 2.4 Unpack everything.
+      unpack(probe_pipe, *filtered_build, *filtered_probe);
+   }
+}
+
+void Join::decayNMJoin(PipelineDAG& dag) const {
+   // Decay a join where the build keys are not unique. A probe row can have more than one
+   // join partner, so the probe pipeline would have to produce more rows than it consumes.
+   // Instead, the probe pipeline remembers its matches and a third pipeline expands them
+   // into the joined rows. This proceeds as-follows:
+   //
+   // Build pipeline:
+   // 1. Pack the join key into a scratch pad IU
+   // 2. Append the key to the build rows
+   // 3. Pack the remaining columns of the build payload
+   // Once the build pipeline is done, the build rows get grouped by key.
+   //
+   // Probe pipeline:
+   // 0. Optionally drop probe rows that fail the Bloom filter on the build keys
+   // 1. Pack both the probe key and the probe payload into a scratch pad IU
+   // 2. Lookup the scratch pad IU in the key index
+   // 3. Filter the rows whether the lookup returned a non-null pointer
+   // 4. Remember the probe rows together with their index slot
+   //
+   // Expansion pipeline:
+   // 1. Expand the matches into pairs of probe and build rows, at most DEFAULT_CHUNK_SIZE at a time
+   // 2. Unpack all the rows again into individual IUs
+
+   HashTableSimpleKey& ht = dag.attachHashTableSimpleKey(0, key_size_left, NMJoinHashTable::index_payload_size);
+   NMJoinHashTable& table = dag.attachNMJoinHashTable(0, ht, key_size_left, payload_size_left);
+   BloomFilter* bloom = bloom_filter ? &table.enableBloomFilter() : nullptr;
+   {
+      // Step 1: Construct the build pipeline.
+
+      // 1.0: Decay build pipeline.
+      children[0]->decay(dag);
+      auto& build_pipe = dag.getCurrentPipeline();
+
+      // 1.1 Pack the join key into a scratch pad IU.
+      const IU& key_iu = packBuildKey(build_pipe);
+
+      // 1.2 Append the build row. Every worker appends to its own rows, which never move once
+      // they were appended. As a result, the append never has to restart a morsel.
+      std::vector<const IU*> pseudo;
+      for (const auto& pseudo_iu : left_pseudo_ius) {
+         pseudo.push_back(&pseudo_iu);
       }
-      // Pack payload.
-      for (const IU* payload_r : payload_right) {
-         auto& packer = probe_pipe.attachSuboperator(KeyPackerSubop::build(this, *payload_r, *scratch_pad_right, {&(*probe_pseudo)}));
-         // Attach the runtime parameter that represents the state offset.
-         KeyPackingRuntimeParams param;
-         param.offsetSet(IR::UI<2>::build(probe_offset));
-         reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
-         // Update the key offset by the size of the IU.
-         probe_offset += payload_r->type->numBytes();
-         probe_pseudo++;
+      const IU* rows = payload_left.empty() ? nullptr : &(*lookup_left);
+      auto append = RuntimeFunctionSubop::nmJoinAppend(this, rows, key_iu, std::move(pseudo), &ht);
+      append->setThreadLocalObjects(
+         [&table](size_t thread_id) { return &table.getThreadRows(thread_id); },
+         [&table](size_t thread_id) { table.finalize(thread_id); });
+      build_pipe.attachSuboperator(std::move(append));
+
+      // 1.3 Pack the payload.
+      packBuildPayload(build_pipe);
+   }
+
+   NMJoinMatches* matches;
+   {
+      // Step 2: Construct the probe pipeline.
+
+      // 2.0 : Decay probe pipeline.
+      children[1]->decay(dag);
+      auto& probe_pipe = dag.getCurrentPipeline();
+
+      // 2.1 - 2.3 Pack, probe and filter on probe matches.
+      probe(probe_pipe, ht, bloom);
+
+      // 2.4 Remember the matches. Semi joins don't produce columns of the probe side and only keep the
+      // index slot.
+      const uint16_t probe_size = type == JoinType::LeftSemi ? 0 : key_size_right + payload_size_right;
+      matches = &dag.attachNMJoinMatches(0, table, probe_size, DEFAULT_CHUNK_SIZE);
+      const IU* probe_rows = type == JoinType::LeftSemi ? nullptr : &(*filtered_probe);
+      auto add_match = RuntimeFunctionSubop::nmJoinAddMatch(this, probe_rows, *filtered_build, static_cast<JoinRows*>(matches));
+      add_match->setThreadLocalObjects([matches](size_t thread_id) { return &matches->getThreadMatches(thread_id); });
+      probe_pipe.attachSuboperator(std::move(add_match));
+   }
+
+   // Step 3: Construct the expansion pipeline.
+   produceJoinedRows(dag, *matches);
+}
+
+void Join::decayHybridJoin(PipelineDAG& dag) const {
+   // Decay a primary key join whose build side may exceed the memory budget. This proceeds as-follows:
+   //
+   // Build pipeline:
+   // 1. Pack the join key into a scratch pad IU
+   // 2. Append the key to the build rows
+   // 3. Pack the remaining columns of the build payload
+   // Once the build pipeline is done, the rows of the partitions which fit into memory are inserted
+   // into the hash table. The other partitions are spilled to disk.
+   //
+   // Probe pipeline:
+   // 1. Pack both the probe key and the probe payload into a scratch pad IU
+   // 2. Probe the resident partitions and remember the matches, spill the probe rows of evicted partitions
+   //
+   // Output pipeline:
+   // 1. Produce the remembered matches, then join the evicted partitions pair-wise
+   // 2. Unpack all the rows again into individual IUs
+
+   HashTableSimpleKey& ht = dag.attachHashTableSimpleKey(0, key_size_left, payload_size_left);
+   HybridHashJoin& hybrid = dag.attachHybridHashJoin(0, ht, key_size_left, payload_size_left, key_size_right + payload_size_right, *memory_budget, type == JoinType::LeftSemi, DEFAULT_CHUNK_SIZE);
+   {
+      // Step 1: Construct the build pipeline.
+
+      // 1.0: Decay build pipeline.
+      children[0]->decay(dag);
+      auto& build_pipe = dag.getCurrentPipeline();
+
+      // 1.1 Pack the join key into a scratch pad IU.
+      const IU& key_iu = packBuildKey(build_pipe);
+
+      // 1.2 Append the build row. The appended rows never move while the morsel writing them runs,
+      // so the append never has to restart a morsel.
+      std::vector<const IU*> pseudo;
+      for (const auto& pseudo_iu : left_pseudo_ius) {
+         pseudo.push_back(&pseudo_iu);
       }
+      const IU* rows = payload_left.empty() ? nullptr : &(*lookup_left);
+      auto append = RuntimeFunctionSubop::hybridJoinAppend(this, rows, key_iu, std::move(pseudo), &ht);
+      append->setThreadLocalObjects(
+         [&hybrid](size_t thread_id) { return &hybrid.getThreadBuild(thread_id); },
+         [&hybrid](size_t thread_id) { hybrid.finalizeBuild(thread_id); });
+      build_pipe.attachSuboperator(std::move(append));
+
+      // 1.3 Pack the payload.
+      packBuildPayload(build_pipe);
+   }
+
+   {
+      // Step 2: Construct the probe pipeline.
+
+      // 2.0 : Decay probe pipeline.
+      children[1]->decay(dag);
+      auto& probe_pipe = dag.getCurrentPipeline();
 
-      // 2.2 Probe.
+      // 2.1 - 2.2 Pack and probe.
+      probe(probe_pipe, ht, nullptr, &hybrid);
+   }
+
+   // Step 3: Construct the output pipeline.
+   produceJoinedRows(dag, hybrid);
+}
+
+void Join::decayRadixJoin(PipelineDAG& dag) const {
+   // Decay a primary key join with a build side that is much larger than the CPU caches. This proceeds as-follows:
+   //
+   // Build pipeline:
+   // 1. Pack the join key into a scratch pad IU
+   // 2. Append the key to the build rows
+   // 3. Pack the remaining columns of the build payload
+   // Once the build pipeline is done, the build rows get radix-partitioned.
+   //
+   // Probe pipeline:
+   // 1. Pack both the probe key and the probe payload into a scratch pad IU
+   // 2. Scatter the probe row into its partition
+   //
+   // Output pipeline:
+   // 1. Join the partitions pair-wise with cache-resident hash tables
+   // 2. Unpack all the rows again into individual IUs
+
+   // The hash table is only used to hash the probe keys, it never contains any rows.
+   HashTableSimpleKey& ht = dag.attachHashTableSimpleKey(0, key_size_left, 0);
+   RadixHashJoin& radix = dag.attachRadixHashJoin(0, key_size_left, payload_size_left, key_size_right + payload_size_right, type == JoinType::LeftSemi, DEFAULT_CHUNK_SIZE);
+   {
+      // Step 1: Construct the build pipeline.
+
+      // 1.0: Decay build pipeline.
+      children[0]->decay(dag);
+      auto& build_pipe = dag.getCurrentPipeline();
+
+      // 1.1 Pack the join key into a scratch pad IU.
+      const IU& key_iu = packBuildKey(build_pipe);
+
+      // 1.2 Append the build row. The appended rows never move, so the append never has to restart a morsel.
       std::vector<const IU*> pseudo;
-      for (const auto& pseudo_iu : right_pseudo_ius) {
+      for (const auto& pseudo_iu : left_pseudo_ius) {
          pseudo.push_back(&pseudo_iu);
       }
+      const IU* rows = payload_left.empty() ? nullptr : &(*lookup_left);
+      auto append = RuntimeFunctionSubop::radixJoinAppend(this, rows, key_iu, std::move(pseudo), &ht);
+      append->setThreadLocalObjects(
+         [&radix](size_t thread_id) { return &radix.getThreadBuild(thread_id); },
+         [&radix](size_t thread_id) { radix.finalizeBuild(thread_id); });
+      build_pipe.attachSuboperator(std::move(append));
+
+      // 1.3 Pack the payload.
+      packBuildPayload(build_pipe);
+   }
+
+   {
+      // Step 2: Construct the probe pipeline.
+
+      // 2.0 : Decay probe pipeline.
+      children[1]->decay(dag);
+      auto& probe_pipe = dag.getCurrentPipeline();
+
+      // 2.1 - 2.2 Pack and partition.
+      probe(probe_pipe, ht, nullptr, nullptr, &radix);
+   }
+
+   // Step 3: Construct the output pipeline.
+   produceJoinedRows(dag, radix);
+}
+
+void Join::produceJoinedRows(PipelineDAG& dag, JoinRows& rows) const {
+   auto& pipe = dag.buildNewPipeline();
+
+   // Produce the joined rows.
+   auto& driver = pipe.attachSuboperator(JoinRowsDriver::build(this, &rows));
+   const IU& driver_iu = **driver.getIUs().begin();
+   pipe.attachSuboperator(JoinRowsIUProvider::build(this, driver_iu, *expanded_build, &rows, /* build_side_= */ true));
+   if (type != JoinType::LeftSemi) {
+      pipe.attachSuboperator(JoinRowsIUProvider::build(this, driver_iu, *expanded_probe, &rows, /* build_side_= */ false));
+   }
+
+   // Unpack everything.
+   unpack(pipe, *expanded_build, *expanded_probe);
+}
+
+const IU& Join::packBuildKey(Pipeline& build_pipe) const {
+   if (keys_left.size() == 1) {
+      // We only need to pack if we can't use the single key directly.
+      return *keys_left.front();
+   }
+   build_pipe.attachSuboperator(ScratchPadIUProvider::build(this, *scratch_pad_left));
+   size_t build_key_offset = 0;
+   auto build_pseudo = left_pseudo_ius.begin();
+   for (const IU* key_left : keys_left) {
+      auto& packer = build_pipe.attachSuboperator(KeyPackerSubop::build(this, *key_left, *scratch_pad_left, {&(*build_pseudo)}));
+      // Attach the runtime parameter that represents the state offset.
+      KeyPackingRuntimeParams param;
+      param.offsetSet(IR::UI<2>::build(build_key_offset));
+      reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
+      // Update the key offset by the size of the IU.
+      build_key_offset += key_left->type->numBytes();
+      build_pseudo++;
+   }
+   return *scratch_pad_left;
+}
+
+void Join::packBuildPayload(Pipeline& build_pipe) const {
+   // The payload is packed right behind the key.
+   size_t build_payload_offset = key_size_left;
+   for (const IU* payload : payload_left) {
+      auto& packer = build_pipe.attachSuboperator(KeyPackerSubop::build(this, *payload, *lookup_left, {}));
+      // Attach the runtime parameter that represents the state offset.
+      KeyPackingRuntimeParams param;
+      param.offsetSet(IR::UI<2>::build(build_payload_offset));
+      reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
+      // Update the key offset by the size of the IU.
+      build_payload_offset += payload->type->numBytes();
+   }
+}
+
+void Join::probe(Pipeline& probe_pipe, HashTableSimpleKey& ht, BloomFilter* bloom, HybridHashJoin* hybrid, RadixHashJoin* radix, ArrayJoinIndex* array) const {
+   std::vector<const IU*> probe_keys{keys_right.begin(), keys_right.end()};
+   std::vector<const IU*> probe_payload{payload_right.begin(), payload_right.end()};
+   if (bloom) {
+      // Check the probe key against the Bloom filter. Rows that cannot find a join partner
+      // are dropped before they get packed and looked up in the hash table.
+      probe_pipe.attachSuboperator(RuntimeFunctionSubop::bloomFilterContains(this, *bloom_match, *keys_right[0], bloom));
+      probe_pipe.attachSuboperator(ColumnFilterScope::build(this, *bloom_match, *bloom_pseudo_iu));
+      auto filtered = bloom_filtered_right.begin();
+      for (const IU*& iu : probe_keys) {
+         probe_pipe.attachSuboperator(ColumnFilterLogic::build(this, *bloom_pseudo_iu, *iu, *filtered));
+         iu = &(*filtered++);
+      }
+      for (const IU*& iu : probe_payload) {
+         probe_pipe.attachSuboperator(ColumnFilterLogic::build(this, *bloom_pseudo_iu, *iu, *filtered));
+         iu = &(*filtered++);
+      }
+   }
 
+   // Pack the probe key and the probe payload.
+   probe_pipe.attachSuboperator(ScratchPadIUProvider::build(this, *scratch_pad_right));
+   size_t probe_offset = 0;
+   auto probe_pseudo = right_pseudo_ius.begin();
+   // Pack keys.
+   for (const IU* key_right : probe_keys) {
+      auto& packer = probe_pipe.attachSuboperator(KeyPackerSubop::build(this, *key_right, *scratch_pad_right, {&(*probe_pseudo)}));
+      // Attach the runtime parameter that represents the state offset.
+      KeyPackingRuntimeParams param;
+      param.offsetSet(IR::UI<2>::build(probe_offset));
+      reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
+      // Update the key offset by the size of the IU.
+      probe_offset += key_right->type->numBytes();
+      probe_pseudo++;
+   }
+   // Pack payload.
+   for (const IU* payload_r : probe_payload) {
+      auto& packer = probe_pipe.attachSuboperator(KeyPackerSubop::build(this, *payload_r, *scratch_pad_right, {&(*probe_pseudo)}));
+      // Attach the runtime parameter that represents the state offset.
+      KeyPackingRuntimeParams param;
+      param.offsetSet(IR::UI<2>::build(probe_offset));
+      reinterpret_cast<KeyPackerSubop&>(packer).attachRuntimeParams(std::move(param));
+      // Update the key offset by the size of the IU.
+      probe_offset += payload_r->type->numBytes();
+      probe_pseudo++;
+   }
+
+   // Probe.
+   std::vector<const IU*> pseudo;
+   for (const auto& pseudo_iu : right_pseudo_ius) {
+      pseudo.push_back(&pseudo_iu);
+   }
+
+   if (array) {
+      // Whether the keys are dense is only known once the build is done. Dense keys map straight to an offset
+      // within the array index, the hash step only prefetches their array slot. Keys that are too sparse for
+      // the array get hashed, prefetched and looked up in the hash table by the index itself.
+      dispatchKeyWidth(key_size_left, [&](auto key_width) {
+         // The array index only specializes on the key widths of single integer keys.
+         constexpr uint16_t index_width = (key_width == 4 || key_width == 8) ? key_width : 0;
+         using Index = KeyWidthSpecialized<ArrayJoinIndex, index_width>;
+         probe_pipe.attachSuboperator(RuntimeFunctionSubop::htHashPrefetch<Index>(this, *hash_right, *scratch_pad_right, pseudo, array));
+         if (type == JoinType::LeftSemi) {
+            probe_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupDisableWithHash<ArrayJoinIndex>(this, *lookup_right, *scratch_pad_right, *hash_right, std::move(pseudo), array));
+         } else {
+            probe_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupWithHash<Index>(this, *lookup_right, *scratch_pad_right, *hash_right, std::move(pseudo), array));
+         }
+      });
+   } else {
+      // Hash the keys first. During vectorized interpretation this prefetches the slots of the whole chunk.
+      // The probe rows start with the key, so the runtime functions specialized on the key width apply.
+      probe_pipe.attachSuboperator(dispatchKeyWidth(key_size_left, [&](auto key_width) {
+         return RuntimeFunctionSubop::htHashPrefetch<KeyWidthSpecialized<HashTableSimpleKey, key_width>>(this, *hash_right, *scratch_pad_right, pseudo, &ht);
+      }));
+      if (hybrid) {
+         // The hybrid hash join remembers the matches of the resident partitions and spills the probe rows of evicted ones.
+         // The joined rows are produced by a separate pipeline.
+         auto hybrid_probe = RuntimeFunctionSubop::hybridJoinProbe(this, *scratch_pad_right, *hash_right, std::move(pseudo), static_cast<JoinRows*>(hybrid));
+         hybrid_probe->setThreadLocalObjects(
+            [hybrid](size_t thread_id) { return &hybrid->getThreadProbe(thread_id); },
+            [hybrid](size_t thread_id) { hybrid->finalizeProbe(thread_id); });
+         probe_pipe.attachSuboperator(std::move(hybrid_probe));
+         return;
+      }
+      if (radix) {
+         // The radix-partitioned join only scatters the probe rows into their partitions.
+         // The joined rows are produced by a separate pipeline.
+         auto radix_probe = RuntimeFunctionSubop::radixJoinProbe(this, *scratch_pad_right, *hash_right, std::move(pseudo), static_cast<JoinRows*>(radix));
+         radix_probe->setThreadLocalObjects(
+            [radix](size_t thread_id) { return &radix->getThreadProbe(thread_id); },
+            [radix](size_t thread_id) { radix->finalizeProbe(thread_id); });
+         probe_pipe.attachSuboperator(std::move(radix_probe));
+         return;
+      }
       if (type == JoinType::LeftSemi) {
          // Lookup on a slot disables the slot, giving semi-join behaviour.
-         probe_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupDisable(this, *lookup_right, *scratch_pad_right, std::move(pseudo), &ht));
+         probe_pipe.attachSuboperator(RuntimeFunctionSubop::htLookupDisableWithHash(this, *lookup_right, *scratch_pad_right, *hash_right, std::move(pseudo), &ht));
       } else {
          // Regular lookup that does not disable slots.
-         probe_pipe.attachSuboperator(RuntimeFunctionSubop::htLookup<HashTableSimpleKey>(this, *lookup_right, *scratch_pad_right, std::move(pseudo), &ht));
+         probe_pipe.attachSuboperator(dispatchKeyWidth(key_size_left, [&](auto key_width) {
+            return RuntimeFunctionSubop::htLookupWithHash<KeyWidthSpecialized<HashTableSimpleKey, key_width>>(this, *lookup_right, *scratch_pad_right, *hash_right, std::move(pseudo), &ht);
+         }));
       }
+   }
 
-      // 2.3 Filter on probe matches.
-      probe_pipe.attachSuboperator(ColumnFilterScope::build(this, *lookup_right, *filter_pseudo_iu));
-      // The filter on the build site filters "itself". This has some repercussions on the repiping
-      // behaviour of the suboperator and needs to be passed explicitly.
-      probe_pipe.attachSuboperator(ColumnFilterLogic::build(this, *filter_pseudo_iu, *lookup_right, *filtered_build, /* filter_type= */ lookup_right->type, /* filters_itself= */ true));
-      if (type != JoinType::LeftSemi) {
-         // If we need to produce columns on the probe side, we also have to filter the probe result.
-         // Note: the filtered ByteArray from the probe side becomes a Char* after filtering.
-         probe_pipe.attachSuboperator(ColumnFilterLogic::build(this, *filter_pseudo_iu, *scratch_pad_right, *filtered_probe, /* filter_type_= */ lookup_right->type));
-      }
+   // Filter on probe matches.
+   probe_pipe.attachSuboperator(ColumnFilterScope::build(this, *lookup_right, *filter_pseudo_iu));
+   // The filter on the build site filters "itself". This has some repercussions on the repiping
+   // behaviour of the suboperator and needs to be passed explicitly.
+   probe_pipe.attachSuboperator(ColumnFilterLogic::build(this, *filter_pseudo_iu, *lookup_right, *filtered_build, /* filter_type= */ lookup_right->type, /* filters_itself= */ true));
+   if (type != JoinType::LeftSemi) {
+      // If we need to produce columns on the probe side, we also have to filter the probe result.
+      // Note: the filtered ByteArray from the probe side becomes a Char* after filtering.
+      probe_pipe.attachSuboperator(ColumnFilterLogic::build(this, *filter_pseudo_iu, *scratch_pad_right, *filtered_probe, /* filter_type_= */ lookup_right->type));
+   }
+}
 
-      // 2.4 Unpack everything.
-      // 2.4.1 Unpack Build Side IUs
-      size_t build_unpack_offset = 0;
-      for (const auto& iu : keys_left_out) {
-         auto& unpacker = probe_pipe.attachSuboperator(KeyUnpackerSubop::build(this, *filtered_build, iu));
+void Join::unpack(Pipeline& pipe, const IU& build_rows, const IU& probe_rows) const {
+   // Unpack Build Side IUs.
+   size_t build_unpack_offset = 0;
+   for (const auto& iu : keys_left_out) {
+      auto& unpacker = pipe.attachSuboperator(KeyUnpackerSubop::build(this, build_rows, iu));
+      KeyPackingRuntimeParams param;
+      param.offsetSet(IR::UI<2>::build(build_unpack_offset));
+      reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
+      build_unpack_offset += iu.type->numBytes();
+   }
+   for (const auto& iu : payload_left_out) {
+      auto& unpacker = pipe.attachSuboperator(KeyUnpackerSubop::build(this, build_rows, iu));
+      KeyPackingRuntimeParams param;
+      param.offsetSet(IR::UI<2>::build(build_unpack_offset));
+      reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
+      build_unpack_offset += iu.type->numBytes();
+   }
+   // Unpack Probe Side IUs. Not needed for semi joins.
+   if (type != JoinType::LeftSemi) {
+      size_t probe_unpack_offset = 0;
+      for (const auto& iu : keys_right_out) {
+         auto& unpacker = pipe.attachSuboperator(KeyUnpackerSubop::build(this, probe_rows, iu));
          KeyPackingRuntimeParams param;
-         param.offsetSet(IR::UI<2>::build(build_unpack_offset));
+         param.offsetSet(IR::UI<2>::build(probe_unpack_offset));
          reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
-         build_unpack_offset += iu.type->numBytes();
+         probe_unpack_offset += iu.type->numBytes();
       }
-      for (const auto& iu : payload_left_out) {
-         auto& unpacker = probe_pipe.attachSuboperator(KeyUnpackerSubop::build(this, *filtered_build, iu));
+      for (const auto& iu : payload_right_out) {
+         auto& unpacker = pipe.attachSuboperator(KeyUnpackerSubop::build(this, probe_rows, iu));
          KeyPackingRuntimeParams param;
-         param.offsetSet(IR::UI<2>::build(build_unpack_offset));
+         param.offsetSet(IR::UI<2>::build(probe_unpack_offset));
          reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
-         build_unpack_offset += iu.type->numBytes();
-      }
-      // 2.4.1 Unpack Probe Side IUs. Not needed for semi joins.
-      if (type != JoinType::LeftSemi) {
-         size_t probe_unpack_offset = 0;
-         for (const auto& iu : keys_right_out) {
-            auto& unpacker = probe_pipe.attachSuboperator(KeyUnpackerSubop::build(this, *filtered_probe, iu));
-            KeyPackingRuntimeParams param;
-            param.offsetSet(IR::UI<2>::build(probe_unpack_offset));
-            reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
-            probe_unpack_offset += iu.type->numBytes();
-         }
-         for (const auto& iu : payload_right_out) {
-            auto& unpacker = probe_pipe.attachSuboperator(KeyUnpackerSubop::build(this, *filtered_probe, iu));
-            KeyPackingRuntimeParams param;
-            param.offsetSet(IR::UI<2>::build(probe_unpack_offset));
-            reinterpret_cast<KeyUnpackerSubop&>(unpacker).attachRuntimeParams(std::move(param));
-            probe_unpack_offset += iu.type->numBytes();
-         }
+         probe_unpack_offset += iu.type->numBytes();
       }
    }
 }
@@ -7,6 +7,14 @@
 
 namespace inkfuse {
 
+struct ArrayJoinIndex;
+struct BloomFilter;
+struct HashTableSimpleKey;
+struct HybridHashJoin;
+struct JoinRows;
+struct Pipeline;
+struct RadixHashJoin;
+
 enum class JoinType {
    Inner,
    LeftSemi,
@@ -18,9 +26,22 @@ enum class JoinType {
 /// - No growing chunks - the output chunk will always be either the same size or smaller.
 /// This means that we can create an optimzied suboperator layout for this type of join.
 /// For non-PK joins we need to pack a much more complex join state and take care of potentially
-/// growing chunks.
+/// growing chunks. The probe pipeline only remembers the matches, a separate pipeline then
+/// expands them into chunks of joined rows.
+/// PK joins with a memory budget run as hybrid hash join: partitions of the build side that exceed
+/// the budget are spilled to disk and joined in a separate pipeline once the probe side is done.
+/// PK joins with a build side that is much larger than the CPU caches run as radix-partitioned hash join:
+/// both sides get partitioned until every partition fits into the cache and are joined in a separate pipeline.
+/// Other PK joins on a single integer key probe through an array index if the build keys turn out to be dense.
 struct Join : public RelAlgOp {
 
+   /// Build a new join. If `bloom_filter_` is set, a Bloom filter on the build keys drops
+   /// probe rows without a match before they get packed and looked up. This pays off for selective
+   /// joins. The Bloom filter is only supported for joins on a single key.
+   /// If `memory_budget_` is set, the build rows and the remembered matches of a PK join use at most
+   /// that many bytes of memory, the rest is spilled to disk. The Bloom filter is not supported together with a budget.
+   /// `build_rows_` is the expected number of build rows. If the packed build rows of a PK join without a memory budget
+   /// exceed `radix_join_threshold`, the join is radix-partitioned. The Bloom filter is not supported for those either.
    static std::unique_ptr<Join> build(
       std::vector<std::unique_ptr<RelAlgOp>> children_,
       std::string op_name_,
@@ -29,7 +50,10 @@ struct Join : public RelAlgOp {
       std::vector<const IU*> keys_right_,
       std::vector<const IU*> payload_right_,
       JoinType type_,
-      bool is_pk_join_);
+      bool is_pk_join_,
+      bool bloom_filter_ = false,
+      std::optional<size_t> memory_budget_ = std::nullopt,
+      std::optional<size_t> build_rows_ = std::nullopt);
 
    Join(
       std::vector<std::unique_ptr<RelAlgOp>> children_,
@@ -39,18 +63,52 @@ struct Join : public RelAlgOp {
       std::vector<const IU*> keys_right_,
       std::vector<const IU*> payload_right_,
       JoinType type_,
-      bool is_pk_join_);
+      bool is_pk_join_,
+      bool bloom_filter_ = false,
+      std::optional<size_t> memory_budget_ = std::nullopt,
+      std::optional<size_t> build_rows_ = std::nullopt);
 
    void decay(PipelineDAG& dag) const override;
 
+   /// Size of the packed build rows from which on PK joins get radix-partitioned. Beyond the size of the last level cache,
+   /// probing a single large hash table turns into random DRAM accesses.
+   static constexpr size_t radix_join_threshold = size_t{16} << 20;
+
    private:
    void plan();
    void decayPkJoin(PipelineDAG& dag) const;
+   void decayNMJoin(PipelineDAG& dag) const;
+   void decayHybridJoin(PipelineDAG& dag) const;
+   void decayRadixJoin(PipelineDAG& dag) const;
+   /// Pack the build keys if there is more than one. Returns the IU of the (packed) key.
+   const IU& packBuildKey(Pipeline& build_pipe) const;
+   /// Pack the build payload behind the key of the build row.
+   void packBuildPayload(Pipeline& build_pipe) const;
+   /// Pack the probe rows, look them up in the hash table and filter on the rows that have a match.
+   /// A hybrid hash join instead remembers the matches within the join itself, a radix-partitioned join only partitions the probe rows.
+   /// With an array index, the probe keys are looked up in the index without getting hashed.
+   void probe(Pipeline& probe_pipe, HashTableSimpleKey& ht, BloomFilter* bloom, HybridHashJoin* hybrid = nullptr, RadixHashJoin* radix = nullptr, ArrayJoinIndex* array = nullptr) const;
+   /// Build a new pipeline producing the joined rows that were computed outside of the probe pipeline.
+   void produceJoinedRows(PipelineDAG& dag, JoinRows& rows) const;
+   /// Unpack the output IUs from the packed build and probe rows.
+   void unpack(Pipeline& pipe, const IU& build_rows, const IU& probe_rows) const;
 
    /// What join type is this?
    JoinType type;
    /// Is the left (build) side of the hash join a PK?
    bool is_pk_join;
+   /// Is the probe side filtered through a Bloom filter on the build keys?
+   bool bloom_filter;
+   /// Memory budget of a hybrid hash join.
+   std::optional<size_t> memory_budget;
+   /// Expected number of build rows.
+   std::optional<size_t> build_rows;
+   /// Is this a radix-partitioned hash join?
+   bool radix_join = false;
+   /// Does the PK join probe through an array index on its single integer key?
+   bool array_join = false;
+   /// Is the key of the array index a signed integer?
+   bool array_key_signed = false;
 
    size_t key_size_left = 0;
    size_t payload_size_left = 0;
@@ -66,6 +124,10 @@ struct Join : public RelAlgOp {
    std::optional<IU> lookup_left;
    /// Lookup result right.
    std::optional<IU> lookup_right;
+   /// Hashed join key left.
+   std::optional<IU> hash_left;
+   /// Hashed join key right.
+   std::optional<IU> hash_right;
 
    /// Void-typed pseudo-IUs that connect the key packing operators on
    /// the build side with the hash table insert.
@@ -76,10 +138,21 @@ struct Join : public RelAlgOp {
    /// Void-types pseudo-IU for the filter on rows that have no match.
    std::optional<IU> filter_pseudo_iu;
 
+   /// Result of the Bloom filter check on the probe key.
+   std::optional<IU> bloom_match;
+   /// Void-typed pseudo-IU for the Bloom filter on the probe side.
+   std::optional<IU> bloom_pseudo_iu;
+   /// Probe keys followed by the probe payload after the Bloom filter.
+   std::list<IU> bloom_filtered_right;
+
    /// Filtered build side in the probe phase. Char* typed.
    std::optional<IU> filtered_build;
    /// Filtered probe side in the probe phase. Byte[] typed.
    std::optional<IU> filtered_probe;
+   /// Build rows produced outside of the probe pipeline. Char* typed.
+   std::optional<IU> expanded_build;
+   /// Probe rows produced outside of the probe pipeline. Char* typed.
+   std::optional<IU> expanded_probe;
 
    /// The input IUs.
    std::vector<const IU*> keys_left;
@@ -220,18 +220,49 @@ PrettyPrinter* Pipeline::getPrettyPrinter()
 
 HashTableSimpleKey& PipelineDAG::attachHashTableSimpleKey(size_t discard_after, size_t key_size, size_t payload_size) {
    auto& inserted = hash_tables_simple.emplace_back(discard_after, std::make_unique<HashTableSimpleKey>(key_size, payload_size, 8));
+   trackStats(inserted.second.get(), *inserted.second);
+   return *inserted.second;
+}
+
+ParallelBuildHashTable& PipelineDAG::attachParallelBuildHashTable(size_t discard_after, HashTableSimpleKey& target, uint16_t key_size, uint16_t payload_size) {
+   auto& inserted = join_build_tables.emplace_back(discard_after, std::make_unique<ParallelBuildHashTable>(target, key_size, payload_size));
+   trackStats(inserted.second.get(), target);
+   return *inserted.second;
+}
+
+NMJoinHashTable& PipelineDAG::attachNMJoinHashTable(size_t discard_after, HashTableSimpleKey& index, uint16_t key_size, uint16_t payload_size) {
+   auto& inserted = nm_join_tables.emplace_back(discard_after, std::make_unique<NMJoinHashTable>(index, key_size, payload_size));
+   trackStats(inserted.second.get(), index);
+   return *inserted.second;
+}
+
+NMJoinMatches& PipelineDAG::attachNMJoinMatches(size_t discard_after, const NMJoinHashTable& table, uint16_t probe_size, size_t max_rows) {
+   auto& inserted = nm_join_matches.emplace_back(discard_after, std::make_unique<NMJoinMatches>(table, probe_size, max_rows));
+   return *inserted.second;
+}
+
+HybridHashJoin& PipelineDAG::attachHybridHashJoin(size_t discard_after, HashTableSimpleKey& resident, uint16_t key_size, uint16_t payload_size, uint16_t probe_size, size_t memory_budget, bool semi_join, size_t max_rows) {
+   auto& inserted = hybrid_joins.emplace_back(discard_after, std::make_unique<HybridHashJoin>(resident, key_size, payload_size, probe_size, memory_budget, semi_join, max_rows));
+   trackStats(inserted.second.get(), resident);
+   return *inserted.second;
+}
+
+RadixHashJoin& PipelineDAG::attachRadixHashJoin(size_t discard_after, uint16_t key_size, uint16_t payload_size, uint16_t probe_size, bool semi_join, size_t max_rows) {
+   auto& inserted = radix_joins.emplace_back(discard_after, std::make_unique<RadixHashJoin>(key_size, payload_size, probe_size, semi_join, max_rows));
    return *inserted.second;
 }
 
 HashTableComplexKey& PipelineDAG::attachHashTableComplexKey(size_t discard_after, uint16_t slots, size_t payload_size)
 {
    auto& inserted = hash_tables_complex.emplace_back(discard_after, std::make_unique<HashTableComplexKey>(0, slots, payload_size, 8));
+   trackStats(inserted.second.get(), *inserted.second);
    return *inserted.second;
 }
 
-HashTableDirectLookup& PipelineDAG::attachHashTableDirectLookup(size_t discard_after, size_t payload_size)
+HashTableDirectLookup& PipelineDAG::attachHashTableDirectLookup(size_t discard_after, uint16_t key_size, size_t payload_size)
 {
-   auto& inserted = hash_tables_dl.emplace_back(discard_after, std::make_unique<HashTableDirectLookup>(payload_size));
+   auto& inserted = hash_tables_dl.emplace_back(discard_after, std::make_unique<HashTableDirectLookup>(key_size, payload_size));
+   trackStats(inserted.second.get(), *inserted.second);
    return *inserted.second;
 }
 
@@ -249,4 +280,58 @@ const std::vector<PipelinePtr>& PipelineDAG::getPipelines() const {
    return pipelines;
 }
 
+std::vector<HashTableStats> PipelineDAG::getHashTableStats(const Pipeline& pipe) const {
+   std::vector<HashTableStats> result;
+   std::unordered_set<const void*> reported;
+   collectHashTableStats(pipe, reported, result);
+   return result;
+}
+
+std::vector<HashTableStats> PipelineDAG::getHashTableStats() const {
+   std::vector<HashTableStats> result;
+   std::unordered_set<const void*> reported;
+   for (const auto& pipe : pipelines) {
+      collectHashTableStats(*pipe, reported, result);
+   }
+   return result;
+}
+
+void PipelineDAG::collectHashTableStats(const Pipeline& pipe, std::unordered_set<const void*>& reported, std::vector<HashTableStats>& result) const {
+   for (const auto& subop : pipe.getSubops()) {
+      for (const auto& access : subop->getSharedObjectAccesses()) {
+         auto it = table_stats.find(access.object);
+         if (it != table_stats.end() && reported.insert(it->second.first).second) {
+            result.push_back(it->second.second());
+         }
+      }
+   }
+}
+
+std::vector<std::vector<size_t>> PipelineDAG::getPipelineDependencies() const {
+   // Which shared objects does every pipeline read and modify?
+   std::vector<std::unordered_set<const void*>> reads(pipelines.size());
+   std::vector<std::unordered_set<const void*>> writes(pipelines.size());
+   for (size_t idx = 0; idx < pipelines.size(); ++idx) {
+      for (const auto& subop : pipelines[idx]->getSubops()) {
+         for (const auto& access : subop->getSharedObjectAccesses()) {
+            (access.mutates ? writes : reads)[idx].insert(access.object);
+         }
+      }
+   }
+   auto intersects = [](const std::unordered_set<const void*>& lhs, const std::unordered_set<const void*>& rhs) {
+      return std::any_of(lhs.begin(), lhs.end(), [&](const void* object) { return rhs.contains(object); });
+   };
+   // Pipelines are in topological order. A later pipeline depends on an earlier one if one of them
+   // modifies an object the other one accesses.
+   std::vector<std::vector<size_t>> dependencies(pipelines.size());
+   for (size_t later = 0; later < pipelines.size(); ++later) {
+      for (size_t earlier = 0; earlier < later; ++earlier) {
+         if (intersects(writes[earlier], reads[later]) || intersects(writes[earlier], writes[later]) || intersects(reads[earlier], writes[later])) {
+            dependencies[later].push_back(earlier);
+         }
+      }
+   }
+   return dependencies;
+}
+
 }
\ No newline at end of file
@@ -4,9 +4,15 @@
 #include "algebra/suboperators/Suboperator.h"
 #include "exec/FuseChunk.h"
 #include "runtime/HashTables.h"
+#include "runtime/HybridHashJoin.h"
+#include "runtime/RadixHashJoin.h"
+#include "runtime/JoinHashTables.h"
+#include "runtime/PartitionedHashTables.h"
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -91,6 +97,12 @@ struct PipelineDAG {
 
    const std::vector<PipelinePtr>& getPipelines() const;
 
+   /// Get the dependencies between the pipelines. Entry `k` contains the indexes of all pipelines
+   /// which have to be finished before pipeline `k` can start. Dependencies are derived from the
+   /// runtime objects (e.g. hash tables) that are shared between pipelines. Pipelines which
+   /// don't share any state can run concurrently.
+   std::vector<std::vector<size_t>> getPipelineDependencies() const;
+
    /// Mark a pipeline as done. Allows for the release of runtime state.
    void markPipelineDone(size_t idx);
 
@@ -99,9 +111,40 @@ struct PipelineDAG {
    /// Attach a complex hash table to the runtime state of the PipelineDAG.
    HashTableComplexKey& attachHashTableComplexKey(size_t discard_after, uint16_t slots, size_t payload_size);
    /// Attach a direct lookup hash table to the runtime state of the PipelineDAG.
-   HashTableDirectLookup& attachHashTableDirectLookup(size_t discard_after, size_t payload_size);
+   HashTableDirectLookup& attachHashTableDirectLookup(size_t discard_after, uint16_t key_size, size_t payload_size);
+   /// Attach the thread-local build tables of a parallel join build into `target` to the runtime state of the PipelineDAG.
+   ParallelBuildHashTable& attachParallelBuildHashTable(size_t discard_after, HashTableSimpleKey& target, uint16_t key_size, uint16_t payload_size);
+   /// Attach the build side of an n:m join with the key index `index` to the runtime state of the PipelineDAG.
+   NMJoinHashTable& attachNMJoinHashTable(size_t discard_after, HashTableSimpleKey& index, uint16_t key_size, uint16_t payload_size);
+   /// Attach the probe matches of an n:m join to the runtime state of the PipelineDAG.
+   NMJoinMatches& attachNMJoinMatches(size_t discard_after, const NMJoinHashTable& table, uint16_t probe_size, size_t max_rows);
+   /// Attach a hybrid hash join spilling to disk with the hash table `resident` to the runtime state of the PipelineDAG.
+   HybridHashJoin& attachHybridHashJoin(size_t discard_after, HashTableSimpleKey& resident, uint16_t key_size, uint16_t payload_size, uint16_t probe_size, size_t memory_budget, bool semi_join, size_t max_rows);
+   /// Attach a radix-partitioned hash join to the runtime state of the PipelineDAG.
+   RadixHashJoin& attachRadixHashJoin(size_t discard_after, uint16_t key_size, uint16_t payload_size, uint16_t probe_size, bool semi_join, size_t max_rows);
+   /// Attach the hash tables of a parallel aggregation to the runtime state of the PipelineDAG.
+   template <class HashTable, class... Args>
+   AggregationHashTables<HashTable>& attachAggregationHashTables(size_t discard_after, Args&&... args) {
+      auto tables = std::make_shared<AggregationHashTables<HashTable>>(std::forward<Args>(args)...);
+      aggregation_tables.emplace_back(discard_after, tables);
+      trackStats(tables.get(), *tables);
+      return *tables;
+   }
+
+   /// Get the statistics of all hash tables which are accessed by the pipeline.
+   std::vector<HashTableStats> getHashTableStats(const Pipeline& pipe) const;
+   /// Get the statistics of all hash tables which are accessed by any pipeline, every table is reported once.
+   std::vector<HashTableStats> getHashTableStats() const;
 
    private:
+   /// Report the statistics of `table` for every pipeline accessing the runtime object `object`.
+   template <class Table>
+   void trackStats(const void* object, Table& table) {
+      table_stats[object] = {&table, [&table]() { return table.getStats(); }};
+   }
+   /// Append the statistics of the tables accessed by the pipeline which were not `reported` yet.
+   void collectHashTableStats(const Pipeline& pipe, std::unordered_set<const void*>& reported, std::vector<HashTableStats>& result) const;
+
    /// Internally the PipelineDAG is represented as a vector of pipelines within a topological order.
    std::vector<PipelinePtr> pipelines;
    /// Hash tables, ordered by pipeline after which they can be discarded.
@@ -110,6 +153,22 @@ struct PipelineDAG {
    std::deque<std::pair<size_t, std::unique_ptr<HashTableComplexKey>>> hash_tables_complex;
    /// Hash tables, ordered by pipeline after which they can be discarded.
    std::deque<std::pair<size_t, std::unique_ptr<HashTableDirectLookup>>> hash_tables_dl;
+   /// Parallel join builds, ordered by pipeline after which they can be discarded.
+   std::deque<std::pair<size_t, std::unique_ptr<ParallelBuildHashTable>>> join_build_tables;
+   /// Build sides of n:m joins, ordered by pipeline after which they can be discarded.
+   std::deque<std::pair<size_t, std::unique_ptr<NMJoinHashTable>>> nm_join_tables;
+   /// Probe matches of n:m joins, ordered by pipeline after which they can be discarded.
+   std::deque<std::pair<size_t, std::unique_ptr<NMJoinMatches>>> nm_join_matches;
+   /// Hybrid hash joins, ordered by pipeline after which they can be discarded.
+   std::deque<std::pair<size_t, std::unique_ptr<HybridHashJoin>>> hybrid_joins;
+   /// Radix-partitioned hash joins, ordered by pipeline after which they can be discarded.
+   std::deque<std::pair<size_t, std::unique_ptr<RadixHashJoin>>> radix_joins;
+   /// Aggregation hash tables of different types, ordered by pipeline after which they can be discarded.
+   std::deque<std::pair<size_t, std::shared_ptr<void>>> aggregation_tables;
+   /// Statistics of the hash tables, keyed by the runtime object through which pipelines access them.
+   /// Different objects can share the same hash table (e.g. a join build and its target), the first
+   /// element identifies the table.
+   std::unordered_map<const void*, std::pair<const void*, std::function<HashTableStats()>>> table_stats;
 };
 
 using PipelineDAGPtr = std::unique_ptr<PipelineDAG>;
@@ -2,6 +2,7 @@
 #define INKFUSE_PRINT_H
 
 #include "algebra/RelAlgOp.h"
+#include <mutex>
 #include <optional>
 #include <ostream>
 
@@ -14,9 +15,10 @@ struct PrettyPrinter {
    PrettyPrinter(std::vector<const IU*> ius, std::vector<std::string> colnames, std::optional<size_t> limit);
 
    /// Tell the pretty printer that a morsel is materialized in the sinks
-   /// and can be written out.
+   /// of the given worker thread and can be written out.
+   /// Can be called concurrently from multiple worker threads.
    /// @return true if the output is closed.
-   bool markMorselDone(ExecutionContext& ctx);
+   bool markMorselDone(ExecutionContext& ctx, size_t thread_id = 0);
 
    /// Set the output stream for this PrettyPrinter.
    void setOstream(std::ostream& ostream);
@@ -35,6 +37,8 @@ struct PrettyPrinter {
    std::optional<size_t> limit;
    /// How many morsels did we print so far?
    size_t morsel_count = 0;
+   /// Lock serializing morsels from different worker threads.
+   std::mutex print_lock;
    /// The output stream into which to write the pretty-printed result.
    std::ostream* out = nullptr;
 };
@@ -2,11 +2,35 @@
 #include "algebra/Pipeline.h"
 #include "algebra/suboperators/sources/TableScanSource.h"
 #include "exec/FuseChunk.h"
+#include <algorithm>
 
 namespace inkfuse {
 
-TableScan::TableScan(StoredRelation& rel_, std::vector<std::string> cols_, std::string name)
+namespace {
+
+/// Get the column if it is a dictionary-encoded string column. The scan then reads the codes instead of the strings.
+StringColumn* dictionaryEncoded(BaseColumn& col) {
+   auto strings = dynamic_cast<StringColumn*>(&col);
+   return strings && strings->getCodeType() ? strings : nullptr;
+}
+
+}
+
+TableScan::TableScan(StoredRelation& rel_, std::vector<std::string> cols_, std::string name, std::vector<RangePredicate> predicates_)
    : RelAlgOp({}, std::move(name)), rel(rel_) {
+   for (const auto& predicate : predicates_) {
+      auto column = dynamic_cast<const PODColumn*>(&rel.getColumn(predicate.column));
+      if (!column) {
+         throw std::runtime_error("Range predicates are only supported on PODColumns");
+      }
+      auto& parsed = predicates.emplace_back(ParsedPredicate{.column = column, .lower = std::nullopt, .upper = std::nullopt});
+      if (predicate.lower) {
+         parsed.lower = column->parseValue(*predicate.lower);
+      }
+      if (predicate.upper) {
+         parsed.upper = column->parseValue(*predicate.upper);
+      }
+   }
    for (auto& col : cols_) {
       // Set up the IUs.
       std::string iu_name;
@@ -15,15 +39,23 @@ TableScan::TableScan(StoredRelation& rel_, std::vector<std::string> cols_, std::
       } else {
          iu_name = col;
       }
-      IU iu(rel.getColumn(col).getType(), std::move(iu_name));
+      auto& column = rel.getColumn(col);
+      auto encoded = dictionaryEncoded(column);
+      IU iu(encoded ? encoded->getCodeType() : column.getType(), std::move(iu_name));
+      if (auto pod = dynamic_cast<const PODColumn*>(&column)) {
+         // The zone map knows the value range of the column, e.g. to size dense aggregation tables.
+         if (auto range = pod->getValueRange()) {
+            iu.range = IU::ValueRange{.min = range->first, .max = range->second};
+         }
+      }
       auto& elem = cols.emplace_back(std::make_pair(std::move(col), std::move(iu)));
       output_ius.push_back(&elem.second);
    }
 }
 
-std::unique_ptr<TableScan> TableScan::build(inkfuse::StoredRelation& rel_, std::vector<std::string> cols, std::string name)
+std::unique_ptr<TableScan> TableScan::build(inkfuse::StoredRelation& rel_, std::vector<std::string> cols, std::string name, std::vector<RangePredicate> predicates)
 {
-   return std::make_unique<TableScan>(rel_, std::move(cols), std::move(name));
+   return std::make_unique<TableScan>(rel_, std::move(cols), std::move(name), std::move(predicates));
 }
 
 void TableScan::decay(PipelineDAG& dag) const {
@@ -31,12 +63,32 @@ void TableScan::decay(PipelineDAG& dag) const {
    auto& pipe = dag.buildNewPipeline();
    // Set up the loop driver.
    auto rel_size = rel.getColumn(0).second.length();
-   auto& driver = reinterpret_cast<TScanDriver&>(pipe.attachSuboperator(TScanDriver::build(this, rel_size)));
+   TScanDriver::MorselFilter filter;
+   if (!predicates.empty()) {
+      // A morsel has to be scanned if it could contain rows satisfying all predicates.
+      filter = [predicates = predicates](uint64_t begin, uint64_t end) {
+         return std::all_of(predicates.begin(), predicates.end(), [&](const ParsedPredicate& predicate) {
+            return predicate.column->mayContain(
+               begin,
+               end,
+               predicate.lower ? predicate.lower->data() : nullptr,
+               predicate.upper ? predicate.upper->data() : nullptr);
+         });
+      };
+   }
+   auto& driver = reinterpret_cast<TScanDriver&>(pipe.attachSuboperator(TScanDriver::build(this, rel_size, std::move(filter))));
    auto driver_iu = *driver.getIUs().begin();
    // Set up the actual column scans.
    for (auto& col : cols) {
       // Attach the operator.
-      auto col_data = rel.getColumn(col.first).getRawData();
+      auto& column = rel.getColumn(col.first);
+      if (auto compressed = dynamic_cast<PODColumn*>(&column); compressed && compressed->getDeltaType()) {
+         // Compressed columns get decoded inline.
+         pipe.attachSuboperator(TScanDecodeIUProvider::build(this, *driver_iu, col.second, compressed->getDeltaType(), compressed->getReferences(), compressed->getDeltas()));
+         continue;
+      }
+      auto encoded = dictionaryEncoded(column);
+      auto col_data = encoded ? encoded->getCodes() : column.getRawData();
       auto& provider = reinterpret_cast<TScanIUProvider&>(pipe.attachSuboperator(TScanIUProvider::build(this, *driver_iu, col.second, col_data)));
    }
 }
@@ -4,22 +4,46 @@
 #include "algebra/RelAlgOp.h"
 #include "storage/Relation.h"
 #include <list>
+#include <optional>
 
 namespace inkfuse {
 
 /// A table scan relational operator. Reads a set of columns from an underlying relation
-/// and makes them available as IUs.
+/// and makes them available as IUs. Dictionary-encoded string columns are read as their
+/// codes, the IUs then have an IR::DictionaryCode type. Compressed integer columns are decoded
+/// within the scan and provide their original type.
+///
+/// A scan can get range predicates on PODColumns. Morsels where the zone maps of the columns show
+/// that no row satisfies all of them are skipped. Predicates never filter single rows: the query still
+/// has to evaluate the exact predicates on the rows of the scanned morsels.
 struct TableScan : public RelAlgOp {
-   TableScan(StoredRelation& rel_, std::vector<std::string> cols, std::string name);
-   static std::unique_ptr<TableScan> build(StoredRelation& rel_, std::vector<std::string> cols, std::string name);
+   /// Range predicate `lower <= column <= upper`. The bounds are given in the .tbl representation
+   /// of the column, a missing bound leaves the range open on that side.
+   struct RangePredicate {
+      std::string column;
+      std::optional<std::string> lower;
+      std::optional<std::string> upper;
+   };
+
+   TableScan(StoredRelation& rel_, std::vector<std::string> cols, std::string name, std::vector<RangePredicate> predicates = {});
+   static std::unique_ptr<TableScan> build(StoredRelation& rel_, std::vector<std::string> cols, std::string name, std::vector<RangePredicate> predicates = {});
 
    void decay(PipelineDAG& dag) const override;
 
    private:
+   /// Range predicate with its bounds parsed into the representation of the column type.
+   struct ParsedPredicate {
+      const PODColumn* column;
+      std::optional<std::vector<char>> lower;
+      std::optional<std::vector<char>> upper;
+   };
+
    // The relation which to read from.
    StoredRelation& rel;
    // Columns to be read.
    std::list<std::pair<std::string, IU>> cols;
+   // Range predicates for skipping morsels.
+   std::vector<ParsedPredicate> predicates;
 };
 
 }
@@ -1,6 +1,7 @@
 #include "algebra/suboperators/RuntimeFunctionSubop.h"
 #include "algebra/CompilationContext.h"
 #include "codegen/IRBuilder.h"
+#include "runtime/HashTables.h"
 #include "runtime/Runtime.h"
 #include <memory>
 #include <sstream>
@@ -28,7 +29,7 @@ std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::htInsert(const inkfu
       out_ius_.push_back(pointers_);
    }
    std::vector<const IU*> args{&key_};
-   return std::unique_ptr<RuntimeFunctionSubop>(
+   auto op = std::unique_ptr<RuntimeFunctionSubop>(
       new RuntimeFunctionSubop(
          source,
          std::move(fct_name),
@@ -38,6 +39,8 @@ std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::htInsert(const inkfu
          std::move(ref),
          pointers_,
          hash_table_));
+   op->reserveKeysOn<HashTableSimpleKey>();
+   return op;
 }
 
 std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::htLookupDisable(const RelAlgOp* source, const IU& pointers_, const IU& keys_, std::vector<const IU*> pseudo_ius_, void* hash_table_)
@@ -64,6 +67,131 @@ std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::htLookupDisable(cons
          hash_table_));
 }
 
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::htLookupDisableWithHash(const RelAlgOp* source, const IU& pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_)
+{
+   return withHash("ht_sk_lookup_disable_with_hash", source, &pointers_, key_, hash_, std::move(pseudo_ius_), hash_table_);
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::withHash(std::string fct_name, const RelAlgOp* source, const IU* pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_)
+{
+   std::vector<const IU*> in_ius{&key_, &hash_};
+   for (auto pseudo : pseudo_ius_) {
+      // Pseudo IUs are used as input IUs in the backing graph, but do not influence arguments.
+      in_ius.push_back(pseudo);
+   }
+   // The hash is passed by value.
+   std::vector<bool> ref{key_.type->id() != "ByteArray" && key_.type->id() != "Ptr_Char", false};
+   std::vector<const IU*> out_ius_;
+   if (pointers_) {
+      out_ius_.push_back(pointers_);
+   }
+   std::vector<const IU*> args{&key_, &hash_};
+   return std::unique_ptr<RuntimeFunctionSubop>(
+      new RuntimeFunctionSubop(
+         source,
+         std::move(fct_name),
+         std::move(in_ius),
+         std::move(out_ius_),
+         std::move(args),
+         std::move(ref),
+         pointers_,
+         hash_table_));
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::bloomFilterContains(const RelAlgOp* source, const IU& result_, const IU& key_, void* filter_)
+{
+   std::string fct_name = "bf_contains";
+   std::vector<const IU*> in_ius{&key_};
+   std::vector<bool> ref{key_.type->id() != "ByteArray" && key_.type->id() != "Ptr_Char"};
+   std::vector<const IU*> out_ius_{&result_};
+   std::vector<const IU*> args{&key_};
+   const IU* out = &result_;
+   return std::unique_ptr<RuntimeFunctionSubop>(
+      new RuntimeFunctionSubop(
+         source,
+         std::move(fct_name),
+         std::move(in_ius),
+         std::move(out_ius_),
+         std::move(args),
+         std::move(ref),
+         out,
+         filter_));
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::nmJoinAppend(const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* rows_object_)
+{
+   return appendRow("nm_join_append", source, rows_, key_, std::move(pseudo_ius_), rows_object_);
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::hybridJoinAppend(const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* join_)
+{
+   return appendRow("hj_append", source, rows_, key_, std::move(pseudo_ius_), join_);
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::hybridJoinProbe(const RelAlgOp* source, const IU& row_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* join_)
+{
+   return withHash("hj_probe", source, nullptr, row_, hash_, std::move(pseudo_ius_), join_);
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::radixJoinAppend(const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* join_)
+{
+   return appendRow("rj_append", source, rows_, key_, std::move(pseudo_ius_), join_);
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::radixJoinProbe(const RelAlgOp* source, const IU& row_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* join_)
+{
+   return withHash("rj_probe", source, nullptr, row_, hash_, std::move(pseudo_ius_), join_);
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::appendRow(std::string fct_name, const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* rows_object_)
+{
+   std::vector<const IU*> in_ius{&key_};
+   for (auto pseudo : pseudo_ius_) {
+      // Pseudo IUs are used as input IUs in the backing graph, but do not influence arguments.
+      in_ius.push_back(pseudo);
+   }
+   std::vector<bool> ref{key_.type->id() != "ByteArray" && key_.type->id() != "Ptr_Char"};
+   std::vector<const IU*> out_ius_;
+   if (rows_) {
+      out_ius_.push_back(rows_);
+   }
+   std::vector<const IU*> args{&key_};
+   return std::unique_ptr<RuntimeFunctionSubop>(
+      new RuntimeFunctionSubop(
+         source,
+         std::move(fct_name),
+         std::move(in_ius),
+         std::move(out_ius_),
+         std::move(args),
+         std::move(ref),
+         rows_,
+         rows_object_));
+}
+
+std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::nmJoinAddMatch(const RelAlgOp* source, const IU* probe_row_, const IU& slot_, void* matches_)
+{
+   std::string fct_name = probe_row_ ? "nm_join_add_match" : "nm_join_add_slot";
+   std::vector<const IU*> in_ius{&slot_};
+   // All arguments are pointers into packed rows.
+   std::vector<bool> ref{false};
+   std::vector<const IU*> args{&slot_};
+   if (probe_row_) {
+      in_ius.insert(in_ius.begin(), probe_row_);
+      ref.push_back(false);
+      args.insert(args.begin(), probe_row_);
+   }
+   return std::unique_ptr<RuntimeFunctionSubop>(
+      new RuntimeFunctionSubop(
+         source,
+         std::move(fct_name),
+         std::move(in_ius),
+         {},
+         std::move(args),
+         std::move(ref),
+         nullptr,
+         matches_));
+}
+
 std::unique_ptr<RuntimeFunctionSubop> RuntimeFunctionSubop::htNoKeyLookup(const RelAlgOp* source, const IU& pointers_, const IU& input_dependency, void* hash_table_)
 {
    std::string fct_name = "ht_nk_lookup";
@@ -167,8 +295,57 @@ void RuntimeFunctionSubop::consumeAllChildren(CompilationContext& context) {
    }
 }
 
-void RuntimeFunctionSubop::setUpStateImpl(const ExecutionContext& context) {
-   state->this_object = static_cast<void*>(this_object);
+void RuntimeFunctionSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
+   if (thread_local_objects) {
+      state->this_object = thread_local_objects(thread_id);
+   } else {
+      state->this_object = static_cast<void*>(this_object);
+   }
+}
+
+void RuntimeFunctionSubop::setThreadLocalObjects(ThreadLocalObjectResolver resolver, ThreadLocalObjectFinisher finisher) {
+   thread_local_objects = std::move(resolver);
+   thread_local_finisher = std::move(finisher);
+}
+
+void RuntimeFunctionSubop::finishPipeline(size_t thread_id) {
+   if (thread_local_finisher) {
+      thread_local_finisher(thread_id);
+   }
+}
+
+void RuntimeFunctionSubop::addSharedObjectAccess(const void* object, bool mutates) {
+   extra_accesses.push_back(SharedObjectAccess{.object = object, .mutates = mutates});
+}
+
+void RuntimeFunctionSubop::prepareMorsel(size_t thread_id, size_t morsel_size) {
+   if (reserve_keys && thread_id < states.size() && states[thread_id]->this_object) {
+      // Every row of the morsel can insert at most one new key.
+      reserve_keys(states[thread_id]->this_object, states[thread_id]->morsel_start_keys, morsel_size);
+   }
+}
+
+bool RuntimeFunctionSubop::isParallelizable() const {
+   // Disabling lookups flip the state of their slot atomically, only one thread gets the row of a key.
+   return thread_local_objects || !mutatesObject() || fct_name.find("_lookup_disable") != std::string::npos;
+}
+
+std::vector<Suboperator::SharedObjectAccess> RuntimeFunctionSubop::getSharedObjectAccesses() const {
+   std::vector<SharedObjectAccess> accesses = extra_accesses;
+   if (this_object) {
+      accesses.push_back(SharedObjectAccess{.object = this_object, .mutates = mutatesObject()});
+   }
+   return accesses;
+}
+
+bool RuntimeFunctionSubop::mutatesObject() const {
+   // Inserts, disabling lookups and the no-key lookup (which inserts the single group) mutate the hash table.
+   if (fct_name == "ht_nk_lookup") {
+      return true;
+   }
+   // Pure lookups, hashing and filter checks only read.
+   return !(fct_name.ends_with("_lookup") || fct_name.ends_with("_lookup_with_hash") || fct_name.ends_with("_hash_prefetch") || fct_name.ends_with("_contains"));
 }
 
 std::string RuntimeFunctionSubop::id() const {
@@ -2,6 +2,8 @@
 #define INKFUSE_RUNTIMEFUNCTIONSUBOP_H
 
 #include "algebra/suboperators/Suboperator.h"
+#include <functional>
+#include <limits>
 
 namespace inkfuse {
 
@@ -11,6 +13,8 @@ struct RuntimeFunctionSubopState {
 
    /// Backing object used as the first argument in the call.
    void* this_object;
+   /// Number of keys within the backing hash table when the current morsel started. Not accessed by generated code.
+   size_t morsel_start_keys = std::numeric_limits<size_t>::max();
 };
 
 /// RuntimeFunctionSubop calls a runtime function on a given object.
@@ -29,6 +33,14 @@ struct RuntimeFunctionSubop : public TemplatedSuboperator<RuntimeFunctionSubopSt
    /// Build a hash table lookup function that disables every found slot.
    static std::unique_ptr<RuntimeFunctionSubop> htLookupDisable(const RelAlgOp* source, const IU& pointers_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr);
 
+   /// Build a lookup function that disables every found slot on a table other than the HashTableSimpleKey.
+   template <class HashTable>
+   static std::unique_ptr<RuntimeFunctionSubop> htLookupDisable(const RelAlgOp* source, const IU& pointers_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr) {
+      auto op = htLookup<HashTable>(source, pointers_, key_, std::move(pseudo_ius_), hash_table_);
+      op->fct_name += "_disable";
+      return op;
+   }
+
    /// Build a hash table lookup function.
    template <class HashTable>
    static std::unique_ptr<RuntimeFunctionSubop> htLookup(const RelAlgOp* source, const IU& pointers_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr) {
@@ -70,7 +82,7 @@ struct RuntimeFunctionSubop : public TemplatedSuboperator<RuntimeFunctionSubopSt
          out_ius_.push_back(pointers_);
       }
       std::vector<const IU*> args{&key_};
-      return std::unique_ptr<RuntimeFunctionSubop>(
+      auto op = std::unique_ptr<RuntimeFunctionSubop>(
          new RuntimeFunctionSubop(
             source,
             std::move(fct_name),
@@ -80,8 +92,81 @@ struct RuntimeFunctionSubop : public TemplatedSuboperator<RuntimeFunctionSubopSt
             std::move(ref),
             pointers_,
             hash_table_));
+      op->template reserveKeysOn<HashTable>();
+      return op;
+   }
+
+   /// Build a function that hashes a key and prefetches the hash table slot of the hash.
+   /// Splitting hashing from resolving the key lets a vectorized primitive issue the prefetches
+   /// for a whole chunk before the first lookup has to wait on its cache miss.
+   template <class HashTable>
+   static std::unique_ptr<RuntimeFunctionSubop> htHashPrefetch(const RelAlgOp* source, const IU& hashes_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr) {
+      std::string fct_name = "ht_" + HashTable::ID + "_hash_prefetch";
+      std::vector<const IU*> in_ius{&key_};
+      for (auto pseudo : pseudo_ius_) {
+         // Pseudo IUs are used as input IUs in the backing graph, but do not influence arguments.
+         in_ius.push_back(pseudo);
+      }
+      std::vector<bool> ref{key_.type->id() != "ByteArray" && key_.type->id() != "Ptr_Char"};
+      std::vector<const IU*> out_ius_{&hashes_};
+      std::vector<const IU*> args{&key_};
+      const IU* out = &hashes_;
+      return std::unique_ptr<RuntimeFunctionSubop>(
+         new RuntimeFunctionSubop(
+            source,
+            std::move(fct_name),
+            std::move(in_ius),
+            std::move(out_ius_),
+            std::move(args),
+            std::move(ref),
+            out,
+            hash_table_));
    }
 
+   /// Build a hash table lookup function on a key whose hash was computed by `htHashPrefetch`.
+   template <class HashTable>
+   static std::unique_ptr<RuntimeFunctionSubop> htLookupWithHash(const RelAlgOp* source, const IU& pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr) {
+      return withHash("ht_" + HashTable::ID + "_lookup_with_hash", source, &pointers_, key_, hash_, std::move(pseudo_ius_), hash_table_);
+   }
+
+   /// Build a hash table lookup function that disables every found slot on a key whose hash was computed by `htHashPrefetch`.
+   static std::unique_ptr<RuntimeFunctionSubop> htLookupDisableWithHash(const RelAlgOp* source, const IU& pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr);
+
+   /// Build a lookup function that disables every found slot on a table other than the HashTableSimpleKey,
+   /// on a key whose hash was computed by `htHashPrefetch`.
+   template <class HashTable>
+   static std::unique_ptr<RuntimeFunctionSubop> htLookupDisableWithHash(const RelAlgOp* source, const IU& pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr) {
+      return withHash("ht_" + HashTable::ID + "_lookup_disable_with_hash", source, &pointers_, key_, hash_, std::move(pseudo_ius_), hash_table_);
+   }
+
+   /// Build a hash table lookup or insert function on a key whose hash was computed by `htHashPrefetch`.
+   template <class HashTable>
+   static std::unique_ptr<RuntimeFunctionSubop> htLookupOrInsertWithHash(const RelAlgOp* source, const IU* pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_ = nullptr) {
+      auto op = withHash("ht_" + HashTable::ID + "_lookup_or_insert_with_hash", source, pointers_, key_, hash_, std::move(pseudo_ius_), hash_table_);
+      op->template reserveKeysOn<HashTable>();
+      return op;
+   }
+
+   /// Build a Bloom filter check producing whether the key might be contained in the filter.
+   static std::unique_ptr<RuntimeFunctionSubop> bloomFilterContains(const RelAlgOp* source, const IU& result_, const IU& key_, void* filter_ = nullptr);
+
+   /// Build a function appending a build row of an n:m join. Produces a pointer to the row with the key copied into it.
+   static std::unique_ptr<RuntimeFunctionSubop> nmJoinAppend(const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* rows_object_ = nullptr);
+
+   /// Build a function remembering a match of an n:m join probe: the probe row together with the matching index slot.
+   /// Without a probe row, only the index slot gets remembered.
+   static std::unique_ptr<RuntimeFunctionSubop> nmJoinAddMatch(const RelAlgOp* source, const IU* probe_row_, const IU& slot_, void* matches_ = nullptr);
+
+   /// Build a function appending a build row of a hybrid hash join. Produces a pointer to the row with the key copied into it.
+   static std::unique_ptr<RuntimeFunctionSubop> hybridJoinAppend(const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* join_ = nullptr);
+
+   /// Build a function probing a hybrid hash join with a packed probe row whose key hash was computed by `htHashPrefetch`.
+   static std::unique_ptr<RuntimeFunctionSubop> hybridJoinProbe(const RelAlgOp* source, const IU& row_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* join_ = nullptr);
+   /// Build a function appending a build row of a radix-partitioned hash join. Produces a pointer to the row with the key copied into it.
+   static std::unique_ptr<RuntimeFunctionSubop> radixJoinAppend(const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* join_ = nullptr);
+   /// Build a function partitioning a packed probe row of a radix-partitioned hash join on the key hash computed by `htHashPrefetch`.
+   static std::unique_ptr<RuntimeFunctionSubop> radixJoinProbe(const RelAlgOp* source, const IU& row_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* join_ = nullptr);
+
    /// Build a lookup function for a hash table with a 0-byte key.
    static std::unique_ptr<RuntimeFunctionSubop> htNoKeyLookup(const RelAlgOp* source, const IU& pointers_, const IU& input_dependency, void* hash_table_ = nullptr);
 
@@ -89,7 +174,32 @@ struct RuntimeFunctionSubop : public TemplatedSuboperator<RuntimeFunctionSubopSt
 
    void consumeAllChildren(CompilationContext& context) override;
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
+
+   /// Resolves the object passed to the runtime function for a given worker thread.
+   using ThreadLocalObjectResolver = std::function<void*(size_t thread_id)>;
+   /// Combines the thread-local objects once the pipeline is done. Called by every worker thread.
+   using ThreadLocalObjectFinisher = std::function<void(size_t thread_id)>;
+   /// Call the runtime function on a separate object for every worker thread, e.g. on thread-local
+   /// pre-aggregation tables. The backing object stays the one reported to the PipelineDAG.
+   void setThreadLocalObjects(ThreadLocalObjectResolver resolver, ThreadLocalObjectFinisher finisher = {});
+
+   /// Runs the finisher of the thread-local objects.
+   void finishPipeline(size_t thread_id) override;
+
+   /// Report an access to a shared object which is not passed to the runtime function,
+   /// e.g. a structure filled by the finisher of the thread-local objects.
+   void addSharedObjectAccess(const void* object, bool mutates);
+
+   /// Reserves room for the keys of the morsel if the runtime function inserts into a hash table.
+   /// The first morsel of a worker expects a new key for every row, later ones as many new keys as the previous one inserted.
+   void prepareMorsel(size_t thread_id, size_t morsel_size) override;
+
+   /// Only pure lookups, disabling lookups or functions on thread-local objects can run on multiple threads.
+   bool isParallelizable() const override;
+
+   /// The runtime function accesses the backing object and the additionally reported objects.
+   std::vector<SharedObjectAccess> getSharedObjectAccesses() const override;
 
    std::string id() const override;
 
@@ -108,12 +218,55 @@ struct RuntimeFunctionSubop : public TemplatedSuboperator<RuntimeFunctionSubopSt
    std::string fct_name;
    /// The object passed as first argument to the runtime function.
    void* this_object;
+   /// Optional resolver for thread-local objects replacing `this_object` within the runtime state.
+   ThreadLocalObjectResolver thread_local_objects;
+   /// Optional finisher for the thread-local objects.
+   ThreadLocalObjectFinisher thread_local_finisher;
+   /// Accesses to shared objects other than `this_object`.
+   std::vector<SharedObjectAccess> extra_accesses;
+   /// Makes room for the new keys of the next morsel within the object of a worker thread. Gets the number of keys
+   /// at the start of the previous morsel, which it updates, and the maximum number of new keys.
+   using KeyReservation = std::function<void(void* object, size_t& morsel_start_keys, size_t max_keys)>;
+   /// Optional key reservation, set for runtime functions inserting into a hash table.
+   KeyReservation reserve_keys;
    /// The IUs used as arguments.
    std::vector<const IU*> args;
    /// Reference annotations - which of the arguments need to be referenced before being passed to the function.
    std::vector<bool> ref;
    /// Optional output IU.
    const IU* out;
+
+   private:
+   /// Build a function appending a row that starts with the given key.
+   static std::unique_ptr<RuntimeFunctionSubop> appendRow(std::string fct_name, const RelAlgOp* source, const IU* rows_, const IU& key_, std::vector<const IU*> pseudo_ius_, void* rows_object_);
+
+   /// Build a hash table function taking a key and its precomputed hash.
+   static std::unique_ptr<RuntimeFunctionSubop> withHash(std::string fct_name, const RelAlgOp* source, const IU* pointers_, const IU& key_, const IU& hash_, std::vector<const IU*> pseudo_ius_, void* hash_table_);
+
+   /// Does the runtime function modify the backing object?
+   bool mutatesObject() const;
+
+   /// Reserve room for the keys of every morsel within the backing hash table.
+   template <class HashTable>
+   void reserveKeysOn() {
+      reserve_keys = [](void* object, size_t& morsel_start_keys, size_t max_keys) {
+         auto reserve = [&](auto& table) {
+            const size_t keys = table.size();
+            // Before the first morsel every row could insert a new key. Afterwards, expect as many new keys as the
+            // previous morsel inserted, tables which stopped growing don't reserve anything.
+            const bool first_morsel = morsel_start_keys == std::numeric_limits<size_t>::max();
+            const size_t growth = first_morsel ? max_keys : (keys > morsel_start_keys ? keys - morsel_start_keys : 0);
+            table.reserve(std::min(growth, max_keys));
+            morsel_start_keys = keys;
+         };
+         if constexpr (requires { typename HashTable::Table; }) {
+            // Specialized runtime functions operate on the underlying table.
+            reserve(*static_cast<typename HashTable::Table*>(object));
+         } else {
+            reserve(*static_cast<HashTable*>(object));
+         }
+      };
+   }
 };
 
 
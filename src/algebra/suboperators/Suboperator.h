@@ -2,6 +2,7 @@
 #define INKFUSE_SUBOPERATOR_H
 
 #include "algebra/IU.h"
+#include "exec/ExecutionContext.h"
 #include <memory>
 #include <optional>
 #include <set>
@@ -13,7 +14,6 @@
 namespace inkfuse {
 
 struct CompilationContext;
-struct ExecutionContext;
 struct FuseChunk;
 struct RelAlgOp;
 struct Pipeline;
@@ -79,15 +79,38 @@ struct Suboperator {
    /// to generate more efficient code.
    virtual bool outgoingStrongLinks() const { return false; }
 
+   /// Can multiple worker threads run this suboperator on different morsels at the same time?
+   /// Suboperators mutating shared runtime structures without synchronization have to return false.
+   /// A pipeline containing such a suboperator is always executed by a single thread.
+   virtual bool isParallelizable() const { return true; }
+
+   /// Access of a suboperator to a runtime object that is shared between pipelines, e.g. a hash table.
+   struct SharedObjectAccess {
+      /// The accessed object.
+      const void* object;
+      /// Does the suboperator modify the object?
+      bool mutates;
+   };
+   /// Get the runtime objects shared between pipelines which this suboperator accesses.
+   /// Used to derive the dependencies between the pipelines of a query.
+   virtual std::vector<SharedObjectAccess> getSharedObjectAccesses() const { return {}; }
+
    /// Set up the state needed by this operator. In an IncrementalFusion engine it's easiest to actually
    /// make this interpreted.
+   /// Creates one state for each of the worker threads of the execution context.
    /// This function has to be idempotent, i.e. multiple setUpStates should leave the operator
    /// in the same state as a single invocation.
    virtual void setUpState(const ExecutionContext& context){};
    /// Tear down the state needed by this operator.
    virtual void tearDownState(){};
-   /// Get a raw pointer to the state of this operator.
-   virtual void* accessState() const { return nullptr; };
+   /// Called by a worker thread once it picked a morsel of `morsel_size` rows, before the interpreted primitives
+   /// run on it. Allows growing runtime state up front for a whole chunk instead of once every few rows.
+   virtual void prepareMorsel(size_t thread_id, size_t morsel_size){};
+   /// Called by every worker thread once all workers are done processing the morsels of the pipeline.
+   /// Allows combining thread-local runtime state before dependent pipelines start.
+   virtual void finishPipeline(size_t thread_id){};
+   /// Get a raw pointer to the state of this operator for the given worker thread.
+   virtual void* accessState(size_t thread_id = 0) const { return nullptr; };
 
    struct NoMoreMorsels {};
    struct PickedMorsel {
@@ -100,7 +123,9 @@ struct Suboperator {
    /// Either returns that there are no more morsels, or progress [0, 1]
    /// Pick a morsel of work. Only relevant for source operators.
    /// Returns the size of the picked morsel - or 0 if picking was unsuccessful.
-   virtual PickMorselResult pickMorsel() { throw std::runtime_error("Operator does not support picking morsels"); }
+   /// Can be called concurrently by different worker threads, the picked morsel is
+   /// written into the state of the calling thread.
+   virtual PickMorselResult pickMorsel(size_t thread_id = 0) { throw std::runtime_error("Operator does not support picking morsels"); }
 
    /// Build a unique identifier for this suboperator (unique given the parameter set).
    /// This is neded to effectively use the fragment cache during vectorized interpretation.
@@ -134,35 +159,40 @@ struct EmptyState {};
 template <class GlobalState>
 struct TemplatedSuboperator : public Suboperator {
    void setUpState(const ExecutionContext& context) override {
-      if (state) {
+      if (!states.empty()) {
          return;
       }
-      state = std::make_unique<GlobalState>();
-      setUpStateImpl(context);
+      states.reserve(context.getNumThreads());
+      for (size_t thread_id = 0; thread_id < context.getNumThreads(); ++thread_id) {
+         states.push_back(std::make_unique<GlobalState>());
+         setUpStateImpl(context, thread_id);
+      }
    };
 
    void tearDownState() override {
-      tearDownStateImpl();
-      state.reset();
+      if (!states.empty()) {
+         tearDownStateImpl();
+      }
+      states.clear();
    };
 
-   void* accessState() const override {
-      return state.get();
+   void* accessState(size_t thread_id = 0) const override {
+      return thread_id < states.size() ? states[thread_id].get() : nullptr;
    };
 
    protected:
    TemplatedSuboperator(const RelAlgOp* source_, std::vector<const IU*> provided_ius_, std::vector<const IU*> source_ius_)
       : Suboperator(source_, std::move(provided_ius_), std::move(source_ius_)){};
 
-   /// Set up the state given that the precondition that both params and state
-   /// are non-empty is satisfied.
-   virtual void setUpStateImpl(const ExecutionContext& context){};
+   /// Set up the state of a single worker thread given that the precondition that both params
+   /// and state are non-empty is satisfied.
+   virtual void setUpStateImpl(const ExecutionContext& context, size_t thread_id){};
 
    /// Tear down the state - allows to run custom cleanup logic when a query is done.
    virtual void tearDownStateImpl(){};
 
-   /// Global state of the respective operator.
-   std::unique_ptr<GlobalState> state;
+   /// Global state of the respective operator, one for every worker thread.
+   std::vector<std::unique_ptr<GlobalState>> states;
 };
 
 using SuboperatorArc = std::shared_ptr<Suboperator>;
@@ -11,7 +11,8 @@ AggReaderSubop::AggReaderSubop(const RelAlgOp* source_, const IU& packed_ptr_iu,
    assert(agg_compute.requiredGranules() == 1 || agg_compute.requiredGranules() == 2);
 }
 
-void AggReaderSubop::setUpStateImpl(const ExecutionContext& context) {
+void AggReaderSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Runtime params have to be set up during execution and have the right type.
    if (!runtime_params.offset_1 || runtime_params.offset_1->getType()->id() != "UI2") {
       throw std::runtime_error("RuntimeParam offset_1 of AggregatorSubop must be set up and of type u16 during execution.");
@@ -13,7 +13,7 @@ namespace inkfuse {
 struct AggReaderSubop : public TemplatedSuboperator<KeyPackingRuntimeStateTwo>, public WithRuntimeParams<KeyPackingRuntimeParamsTwo> {
    static SuboperatorArc build(const RelAlgOp* source_, const IU& packed_ptr_iu, const IU& agg_iu, const AggCompute& agg_compute_);
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    void consumeAllChildren(CompilationContext& context) override;
 
@@ -32,6 +32,10 @@ struct AggState {
    /// Update the aggregate state.
    virtual void updateState(IR::FunctionBuilder& builder, const IR::Stmt& ptr, const IR::Stmt& val) const = 0;
 
+   /// Merge the aggregate state at `src` into the aggregate state at `dst`. Used to combine
+   /// the thread-local pre-aggregation results of a parallel aggregation.
+   virtual void mergeState(char* dst, const char* src) const = 0;
+
    /// Get the size of the backing aggregate state.
    virtual size_t getStateSize() const = 0;
 
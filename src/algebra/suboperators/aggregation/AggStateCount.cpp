@@ -19,6 +19,10 @@ void AggStateCount::updateState(IR::FunctionBuilder& builder, const IR::Stmt& pt
    builder.appendStmt(IR::AssignmentStmt::build(IR::DerefExpr::build(std::move(casted_ptr_expr_assign)), std::move(new_val)));
 }
 
+void AggStateCount::mergeState(char* dst, const char* src) const {
+   *reinterpret_cast<int64_t*>(dst) += *reinterpret_cast<const int64_t*>(src);
+}
+
 size_t AggStateCount::getStateSize() const {
    return 8;
 }
@@ -12,6 +12,8 @@ struct AggStateCount : public ZeroInitializedAggState {
 
    void updateState(IR::FunctionBuilder& builder, const IR::Stmt& ptr, const IR::Stmt& val) const override;
 
+   void mergeState(char* dst, const char* src) const override;
+
    size_t getStateSize() const override;
 
    std::string id() const override;
@@ -1,11 +1,48 @@
 #include "algebra/suboperators/aggregation/AggStateSum.h"
 #include "algebra/CompilationContext.h"
 #include "codegen/Statement.h"
+#include <unordered_map>
 
 namespace inkfuse {
 
+namespace {
+
+template <class T>
+void mergeSum(char* dst, const char* src) {
+   *reinterpret_cast<T*>(dst) += *reinterpret_cast<const T*>(src);
+}
+
+using MergeFct = void (*)(char*, const char*);
+
+/// Get the merge function for a sum on the given type. Returns nullptr if the type can't be merged.
+MergeFct resolveMerge(const IR::Type& type) {
+   static const std::unordered_map<std::string, MergeFct> merge_fcts{
+      {"I1", &mergeSum<int8_t>},
+      {"I2", &mergeSum<int16_t>},
+      {"I4", &mergeSum<int32_t>},
+      {"I8", &mergeSum<int64_t>},
+      {"UI1", &mergeSum<uint8_t>},
+      {"UI2", &mergeSum<uint16_t>},
+      {"UI4", &mergeSum<uint32_t>},
+      {"UI8", &mergeSum<uint64_t>},
+      {"F4", &mergeSum<float>},
+      {"F8", &mergeSum<double>},
+   };
+   const auto it = merge_fcts.find(type.id());
+   return it == merge_fcts.end() ? nullptr : it->second;
+}
+
+}
+
 AggStateSum::AggStateSum(IR::TypeArc type_)
-   : ZeroInitializedAggState(std::move(type_)) {
+   : ZeroInitializedAggState(std::move(type_)), merge_fct(resolveMerge(*type)) {
+}
+
+void AggStateSum::mergeState(char* dst, const char* src) const {
+   if (!merge_fct) {
+      throw std::runtime_error("Cannot merge sum state of type " + type->id());
+   }
+   merge_fct(dst, src);
 }
 
 void AggStateSum::updateState(IR::FunctionBuilder& builder, const IR::Stmt& ptr, const IR::Stmt& val) const {
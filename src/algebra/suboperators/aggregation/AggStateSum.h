@@ -13,9 +13,15 @@ struct AggStateSum : public ZeroInitializedAggState {
 
    void updateState(IR::FunctionBuilder& builder, const IR::Stmt& ptr, const IR::Stmt& val) const override;
 
+   void mergeState(char* dst, const char* src) const override;
+
    size_t getStateSize() const override;
 
    std::string id() const override;
+
+   private:
+   /// Adds up two sums of the aggregated type.
+   void (*merge_fct)(char* dst, const char* src);
 };
 
 }
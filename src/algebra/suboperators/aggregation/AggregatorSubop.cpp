@@ -15,7 +15,8 @@ std::string AggregatorSubop::id() const {
    return agg_state.id();
 }
 
-void AggregatorSubop::setUpStateImpl(const ExecutionContext& context) {
+void AggregatorSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Runtime params have to be set up during execution and have the right type.
    if (!runtime_params.offset || runtime_params.offset->getType()->id() != "UI2") {
       throw std::runtime_error("RuntimeParam of AggregatorSubop must be set up and of type u16 during execution.");
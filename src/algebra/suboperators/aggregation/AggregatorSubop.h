@@ -17,7 +17,7 @@ namespace inkfuse {
 struct AggregatorSubop : public TemplatedSuboperator<KeyPackingRuntimeState>, public WithRuntimeParams<KeyPackingRuntimeParams> {
    static SuboperatorArc build(const RelAlgOp* source_, const AggState& agg_state, const IU& ptr_iu, const IU& agg_iu);
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    void consumeAllChildren(CompilationContext& context) override;
 
@@ -83,12 +83,13 @@ void ExpressionSubop::buildHashingExpression(CompilationContext& context, IR::Fu
    args.push_back(IR::RefExpr::build(IR::VarRefExpr::build(context.getIUDeclaration(*source_ius[0]))));
    const IU& iu = *source_ius[0];
    // Very simple hashing logic for now - this needs to be updated once we have string support.
+   // The width-specialized hashes get inlined into the generated code.
    if (iu.type->numBytes() == 4) {
-      // Call into specialized 4 byte runtime.
       hash_fct = context.getRuntimeFunction("hash4").get();
    } else if (iu.type->numBytes() == 8) {
-      // Call into specialized 8 byte runtime.
       hash_fct = context.getRuntimeFunction("hash8").get();
+   } else if (iu.type->numBytes() == 16) {
+      hash_fct = context.getRuntimeFunction("hash16").get();
    } else {
       // Call into general purpose runtime.
       hash_fct = context.getRuntimeFunction("hash").get();
@@ -25,7 +25,8 @@ RuntimeExpressionSubop::RuntimeExpressionSubop(const RelAlgOp* source_, std::vec
    }
 }
 
-void RuntimeExpressionSubop::setUpStateImpl(const ExecutionContext& context) {
+void RuntimeExpressionSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Runtime params have to be set up during execution and have the right type.
    if (!runtime_params.data || runtime_param_type->id() != runtime_params.data->getType()->id()) {
       throw std::runtime_error("RuntimeParam of RuntimeExpressionSubop must be set up and of the right type during execution.");
@@ -35,7 +35,7 @@ struct RuntimeExpressionSubop : public TemplatedSuboperator<RuntimeExpressionSta
    static void registerRuntime();
 
    /// Set up the global state of this suboperator.
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    /// Consume once all IUs are ready.
    void consumeAllChildren(CompilationContext& context) override;
@@ -18,7 +18,8 @@ SuboperatorArc RuntimeKeyExpressionSubop::build(const RelAlgOp* source_, const I
    return std::shared_ptr<RuntimeKeyExpressionSubop>(new RuntimeKeyExpressionSubop(source_, provided_iu_, source_iu_elem, source_iu_ptr));
 }
 
-void RuntimeKeyExpressionSubop::setUpStateImpl(const ExecutionContext& context) {
+void RuntimeKeyExpressionSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Runtime params have to be set up during execution and have the right type.
    if (!runtime_params.offset || runtime_params.offset->getType()->id() != "UI2") {
       throw std::runtime_error("RuntimeParam of RuntimeKeyExpressionsubop must be set up and of type u16 during execution.");
@@ -17,7 +17,7 @@ struct RuntimeKeyExpressionSubop : public TemplatedSuboperator<KeyPackingRuntime
    static SuboperatorArc build(const RelAlgOp* source_, const IU& provided_iu_, const IU& source_iu_elem, const IU& source_iu_ptr);
 
    /// Set up the global state of this suboperator.
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    /// Consume once all IUs are ready.
    void consumeAllChildren(CompilationContext& context) override;
@@ -29,7 +29,8 @@ KeyPackerSubop::KeyPackerSubop(const RelAlgOp* source_, const IU& to_pack_, cons
    }
 }
 
-void KeyPackerSubop::setUpStateImpl(const ExecutionContext& context) {
+void KeyPackerSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Runtime params have to be set up during execution and have the right type.
    if (!runtime_params.offset || runtime_params.offset->getType()->id() != "UI2") {
       throw std::runtime_error("RuntimeParam of RuntimeKeyExpressionsubop must be set up and of type u16 during execution.");
@@ -20,7 +20,7 @@ IR::StmtPtr packInto(IR::ExprPtr ptr, IR::ExprPtr to_pack, IR::ExprPtr offset);
 struct KeyPackerSubop : public TemplatedSuboperator<KeyPackingRuntimeState>, public WithRuntimeParams<KeyPackingRuntimeParams> {
    static SuboperatorArc build(const RelAlgOp* source_, const IU& to_pack_, const IU& compound_key_, std::vector<const IU*> pseudo_ius = {});
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    void consumeAllChildren(CompilationContext& context) override;
 
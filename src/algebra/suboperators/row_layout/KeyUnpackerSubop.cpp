@@ -28,7 +28,8 @@ KeyUnpackerSubop::KeyUnpackerSubop(const RelAlgOp* source_, const IU& compound_k
    }
 }
 
-void KeyUnpackerSubop::setUpStateImpl(const ExecutionContext& context) {
+void KeyUnpackerSubop::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Runtime params have to be set up during execution and have the right type.
    if (!runtime_params.offset || runtime_params.offset->getType()->id() != "UI2") {
       throw std::runtime_error("RuntimeParam of RuntimeKeyExpressionsubop must be set up and of type u16 during execution.");
@@ -16,7 +16,7 @@ IR::StmtPtr unpackFrom(IR::ExprPtr ptr, IR::ExprPtr unpack_into, IR::ExprPtr off
 struct KeyUnpackerSubop: public TemplatedSuboperator<KeyPackingRuntimeState>, public WithRuntimeParams<KeyPackingRuntimeParams> {
    static SuboperatorArc build(const RelAlgOp* source_, const IU& compound_key_, const IU& target_iu_);
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    void consumeAllChildren(CompilationContext& context) override;
 
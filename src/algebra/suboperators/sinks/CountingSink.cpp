@@ -43,8 +43,9 @@ void CountingSink::consume(const IU& iu, CompilationContext& context)
    builder.appendStmt(std::move(increment_start));
 }
 
-void CountingSink::setUpStateImpl(const ExecutionContext& context)
+void CountingSink::setUpStateImpl(const ExecutionContext& context, size_t thread_id)
 {
+   auto& state = states[thread_id];
    state->count = 0;
 }
 
@@ -54,7 +55,11 @@ std::string CountingSink::id() const
 }
 
 size_t CountingSink::getCount() const {
-   return state->count;
+   size_t count = 0;
+   for (const auto& state : states) {
+      count += state->count;
+   }
+   return count;
 }
 
 void CountingSink::registerRuntime()
@@ -65,7 +70,7 @@ void CountingSink::registerRuntime()
 
 void CountingSink::tearDownStateImpl() {
    if (callback) {
-      callback(state->count);
+      callback(getCount());
    }
 }
 
@@ -19,11 +19,11 @@ struct CountingSink : public TemplatedSuboperator<CountingState> {
 
    void consume(const IU& iu, CompilationContext& context) override;
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    std::string id() const override;
 
-   /// Get the current count stored within the runtime state.
+   /// Get the current count stored within the runtime state, summed up over all threads.
    size_t getCount() const;
 
    /// Register runtime structs and functions.
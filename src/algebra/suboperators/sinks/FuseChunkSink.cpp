@@ -91,18 +91,23 @@ void FuseChunkSink::consume(const IU& iu, CompilationContext& context) {
 }
 
 void FuseChunkSink::setUpState(const ExecutionContext& context) {
-   state = std::make_unique<FuseChunkSinkState>();
-   auto& col = context.getColumn(**source_ius.begin());
-   state->raw_data = col.raw_data;
-   state->size = reinterpret_cast<uint64_t*>(&col.size);
+   states.clear();
+   states.reserve(context.getNumThreads());
+   for (size_t thread_id = 0; thread_id < context.getNumThreads(); ++thread_id) {
+      // Every worker thread writes into the column of its own fuse chunk.
+      auto& state = states.emplace_back(std::make_unique<FuseChunkSinkState>());
+      auto& col = context.getColumn(**source_ius.begin(), thread_id);
+      state->raw_data = col.raw_data;
+      state->size = reinterpret_cast<uint64_t*>(&col.size);
+   }
 }
 
 void FuseChunkSink::tearDownState() {
-   state.reset();
+   states.clear();
 }
 
-void* FuseChunkSink::accessState() const {
-   return state.get();
+void* FuseChunkSink::accessState(size_t thread_id) const {
+   return thread_id < states.size() ? states[thread_id].get() : nullptr;
 }
 
 std::string FuseChunkSink::id() const {
@@ -29,7 +29,7 @@ struct FuseChunkSink : public Suboperator {
 
    void setUpState(const ExecutionContext& context) override;
    void tearDownState() override;
-   void* accessState() const override;
+   void* accessState(size_t thread_id) const override;
 
    std::string id() const override;
 
@@ -38,8 +38,8 @@ struct FuseChunkSink : public Suboperator {
 
    private:
    FuseChunkSink(const RelAlgOp* source, const IU& iu_to_write);
-   /// Runtime state.
-   std::unique_ptr<FuseChunkSinkState> state;
+   /// Runtime state, one for every worker thread.
+   std::vector<std::unique_ptr<FuseChunkSinkState>> states;
 };
 
 }
@@ -10,8 +10,10 @@ std::unique_ptr<FuseChunkSourceDriver> FuseChunkSourceDriver::build() {
 FuseChunkSourceDriver::FuseChunkSourceDriver() : LoopDriver(nullptr) {
 }
 
-Suboperator::PickMorselResult FuseChunkSourceDriver::pickMorsel() {
-   assert(col);
+Suboperator::PickMorselResult FuseChunkSourceDriver::pickMorsel(size_t thread_id) {
+   assert(thread_id < cols.size());
+   auto& state = states[thread_id];
+   const Column* col = cols[thread_id];
    state->start = 0;
    state->end = col->size;
    // We can always pick a morsel for a fuse chunk. The actual execution is responsible for making
@@ -26,14 +28,15 @@ std::string FuseChunkSourceDriver::id() const {
    return "FuseChunkSourceDriver";
 }
 
-void FuseChunkSourceDriver::setUpStateImpl(const ExecutionContext& context_) {
+void FuseChunkSourceDriver::setUpStateImpl(const ExecutionContext& context_, size_t thread_id) {
    assert(!context_.getPipe().getConsumers(*this).empty());
    // Figure out which columns we are actually driving.
    const auto& consumer = context_.getPipe().getConsumers(*this)[0];
    const auto& driving = **consumer->getIUs().begin();
    // Get the column in the backing fuse chunk for that. The morsels
-   // we will pick will go over the size of that given column in the chunk.
-   col = &context_.getColumn(driving);
+   // we will pick will go over the size of that given column in the chunk of the worker thread.
+   cols.resize(context_.getNumThreads());
+   cols[thread_id] = &context_.getColumn(driving, thread_id);
 }
 
 std::unique_ptr<FuseChunkSourceIUProvider> FuseChunkSourceIUProvider::build(const IU& driver_iu, const IU& produced_iu) {
@@ -44,9 +47,10 @@ FuseChunkSourceIUProvider::FuseChunkSourceIUProvider(const IU& driver_iu, const
    : IndexedIUProvider(nullptr, driver_iu, produced_iu) {
 }
 
-void FuseChunkSourceIUProvider::setUpStateImpl(const ExecutionContext& context) {
+void FuseChunkSourceIUProvider::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    // Extract the raw data from which to read within the backing chunk.
-   auto& col = context.getColumn(**provided_ius.begin());
+   auto& col = context.getColumn(**provided_ius.begin(), thread_id);
    state->start = col.raw_data;
    if (runtime_params.type_param) {
       // Fetch the underlying raw data from the associated runtime parameters.
@@ -12,25 +12,26 @@ struct FuseChunkSourceDriver final : public LoopDriver {
    static std::unique_ptr<FuseChunkSourceDriver> build();
 
    /// Pick then next set of tuples from the table scan up to the maximum chunk size.
-   PickMorselResult pickMorsel() override;
+   PickMorselResult pickMorsel(size_t thread_id) override;
 
    std::string id() const override;
 
    /// Set up the state given that the precondition that both params and state
    /// are non-empty is satisfied.
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    private:
    /// Set up the table scan driver in the respective base pipeline.
    FuseChunkSourceDriver();
-   Column* col = nullptr;
+   /// The driving column in the fuse chunk of every worker thread.
+   std::vector<Column*> cols;
 };
 
 struct FuseChunkSourceIUProvider final : public IndexedIUProvider {
    static std::unique_ptr<FuseChunkSourceIUProvider> build(const IU& driver_iu, const IU& produced_iu);
 
    protected:
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    std::string providerName() const override;
 
@@ -1,6 +1,7 @@
 #include "algebra/suboperators/sources/HashTableSource.h"
 #include "exec/FuseChunk.h"
 #include "runtime/Runtime.h"
+#include <algorithm>
 
 namespace inkfuse {
 
@@ -26,26 +27,36 @@ std::string HashTableSource<HashTable>::id() const {
    return id + HashTable::ID;
 }
 
+template <class HashTable>
+std::vector<Suboperator::SharedObjectAccess> HashTableSource<HashTable>::getSharedObjectAccesses() const {
+   return {SharedObjectAccess{.object = hash_table, .mutates = false}};
+}
+
 template <class HashTable>
 SuboperatorArc HashTableSource<HashTable>::build(const RelAlgOp* source, const IU& produced_iu, HashTable* hash_table_) {
    return std::unique_ptr<HashTableSource>{new HashTableSource(source, produced_iu, hash_table_)};
 }
 
 template <class HashTable>
-Suboperator::PickMorselResult HashTableSource<HashTable>::pickMorsel() {
-   if (state->it_ptr_end == nullptr) {
+Suboperator::PickMorselResult HashTableSource<HashTable>::pickMorsel(size_t thread_id) {
+   assert(thread_id < states.size());
+   auto& state = states[thread_id];
+   std::unique_lock lock(it_lock);
+   if (it_ptr_next == nullptr) {
       // The last morsel went until the hash table end. We are done.
       return Suboperator::NoMoreMorsels{};
    }
-   // The current end becomes the new start.
-   state->it_ptr_start = state->it_ptr_end;
-   state->it_idx_start = state->it_idx_end;
-   // Advance the end iterator by one morsel.
+   // The shared iterator becomes the new start.
+   state->it_ptr_start = it_ptr_next;
+   state->it_idx_start = it_idx_next;
+   // Advance the shared iterator by one morsel.
    size_t entries_found = 0;
-   while (entries_found < DEFAULT_CHUNK_SIZE && (state->it_ptr_end != nullptr)) {
-      hash_table->iteratorAdvance(&state->it_ptr_end, &state->it_idx_end);
+   while (entries_found < DEFAULT_CHUNK_SIZE && (it_ptr_next != nullptr)) {
+      hash_table->iteratorAdvance(&it_ptr_next, &it_idx_next);
       entries_found++;
    }
+   state->it_ptr_end = it_ptr_next;
+   state->it_idx_end = it_idx_next;
    return PickedMorsel {
       .morsel_size = entries_found,
       .pipeline_progress = static_cast<double>(state->it_idx_end) / hash_table->capacity(),
@@ -126,7 +137,8 @@ void HashTableSource<HashTable>::close(CompilationContext& context) {
 }
 
 template <class HashTable>
-void HashTableSource<HashTable>::setUpStateImpl(const ExecutionContext& context) {
+void HashTableSource<HashTable>::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    assert(hash_table);
    state->hash_table = hash_table;
    // Initialize start to point to the first slot of the hash table.
@@ -134,11 +146,82 @@ void HashTableSource<HashTable>::setUpStateImpl(const ExecutionContext& context)
    // Set the end iterator to the same value. This way the first pickMorsel will work.
    state->it_ptr_end = state->it_ptr_start;
    state->it_idx_end = state->it_idx_start;
+   // The shared iterator also starts at the first slot.
+   it_ptr_next = state->it_ptr_start;
+   it_idx_next = state->it_idx_start;
+}
+
+template <class HashTable>
+PartitionedHashTableSource<HashTable>::PartitionedHashTableSource(const RelAlgOp* source, const IU& produced_iu, AggregationHashTables<HashTable>* tables_)
+   : HashTableSource<HashTable>(source, produced_iu, nullptr), tables(tables_) {
+}
+
+template <class HashTable>
+SuboperatorArc PartitionedHashTableSource<HashTable>::build(const RelAlgOp* source, const IU& produced_iu, AggregationHashTables<HashTable>* tables_) {
+   return std::unique_ptr<PartitionedHashTableSource>{new PartitionedHashTableSource(source, produced_iu, tables_)};
+}
+
+template <class HashTable>
+std::vector<Suboperator::SharedObjectAccess> PartitionedHashTableSource<HashTable>::getSharedObjectAccesses() const {
+   return {Suboperator::SharedObjectAccess{.object = tables, .mutates = false}};
+}
+
+template <class HashTable>
+Suboperator::PickMorselResult PartitionedHashTableSource<HashTable>::pickMorsel(size_t thread_id) {
+   assert(thread_id < this->states.size());
+   auto& state = this->states[thread_id];
+   // The end of the last morsel is the start of the next one. Claim a new partition once
+   // the current one is exhausted.
+   while (state->it_ptr_end == nullptr) {
+      if (claimed_partitions[thread_id]) {
+         // All morsels of the previous partition are done.
+         tables->dropPartition(*claimed_partitions[thread_id]);
+         claimed_partitions[thread_id].reset();
+      }
+      const size_t partition = next_partition.fetch_add(1);
+      if (partition >= tables->getNumPartitions()) {
+         return Suboperator::NoMoreMorsels{};
+      }
+      claimed_partitions[thread_id] = partition;
+      auto& merged = tables->mergePartition(partition);
+      state->hash_table = &merged;
+      merged.iteratorStart(&(state->it_ptr_end), &(state->it_idx_end));
+   }
+   auto& table = *static_cast<HashTable*>(state->hash_table);
+   state->it_ptr_start = state->it_ptr_end;
+   state->it_idx_start = state->it_idx_end;
+   // Advance the iterator by one morsel.
+   size_t entries_found = 0;
+   while (entries_found < DEFAULT_CHUNK_SIZE && (state->it_ptr_end != nullptr)) {
+      table.iteratorAdvance(&(state->it_ptr_end), &(state->it_idx_end));
+      entries_found++;
+   }
+   const double claimed = std::min(next_partition.load(), tables->getNumPartitions());
+   return Suboperator::PickedMorsel{
+      .morsel_size = entries_found,
+      .pipeline_progress = claimed / tables->getNumPartitions(),
+   };
+}
+
+template <class HashTable>
+void PartitionedHashTableSource<HashTable>::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = this->states[thread_id];
+   assert(tables);
+   // No partition claimed yet, the first pickMorsel claims one.
+   claimed_partitions.resize(this->states.size());
+   state->hash_table = nullptr;
+   state->it_ptr_start = nullptr;
+   state->it_idx_start = 0;
+   state->it_ptr_end = nullptr;
+   state->it_idx_end = 0;
 }
 
 // Explicitly instantiate templates.
 template class HashTableSource<HashTableSimpleKey>;
 template class HashTableSource<HashTableComplexKey>;
 template class HashTableSource<HashTableDirectLookup>;
+template class PartitionedHashTableSource<HashTableSimpleKey>;
+template class PartitionedHashTableSource<HashTableComplexKey>;
+template class PartitionedHashTableSource<HashTableDirectLookup>;
 
 }
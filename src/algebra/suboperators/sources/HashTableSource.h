@@ -5,6 +5,10 @@
 #include "algebra/RelAlgOp.h"
 #include "algebra/suboperators/Suboperator.h"
 #include "codegen/IRBuilder.h"
+#include "runtime/PartitionedHashTables.h"
+#include <atomic>
+#include <mutex>
+#include <optional>
 
 namespace inkfuse {
 
@@ -36,7 +40,8 @@ struct HashTableSource : public TemplatedSuboperator<HashTableSourceState> {
    static SuboperatorArc build(const RelAlgOp* source, const IU& produced_iu, HashTable* hash_table_);
 
    /// Keep running as long as we have cells to read from in the backing hash table.
-   PickMorselResult pickMorsel() override;
+   /// Multiple threads can pick morsels, they advance a shared iterator.
+   PickMorselResult pickMorsel(size_t thread_id) override;
 
    void open(CompilationContext& context) override;
 
@@ -44,10 +49,13 @@ struct HashTableSource : public TemplatedSuboperator<HashTableSourceState> {
 
    std::string id() const override;
 
+   /// The source reads from the backing hash table.
+   std::vector<SharedObjectAccess> getSharedObjectAccesses() const override;
+
    protected:
    HashTableSource(const RelAlgOp* source, const IU& produced_iu, HashTable* hash_table_);
 
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    private:
    /// In-flight while loop being generated between calls to open() and close().
@@ -58,12 +66,54 @@ struct HashTableSource : public TemplatedSuboperator<HashTableSourceState> {
    /// The hash table we are reading from.
    // TODO(benjamin) it's not clean to have the actual object as a suboperator member.
    HashTable* hash_table;
+   /// Lock protecting the shared iterator when picking morsels.
+   std::mutex it_lock;
+   /// Shared iterator pointing to the first entry which was not picked by any thread yet.
+   char* it_ptr_next = nullptr;
+   /// Shared iterator index.
+   uint64_t it_idx_next = 0;
 };
 
 using SimpleHashTableSource = HashTableSource<HashTableSimpleKey>;
 using ComplexHashTableSource = HashTableSource<HashTableComplexKey>;
 using DirectLookupHashTableSource = HashTableSource<HashTableDirectLookup>;
 
+/// The PartitionedHashTableSource reads the result of a parallel two-phase aggregation.
+/// Every worker claims whole partitions. The claiming worker merges the pre-aggregated
+/// partitions of all threads and then produces the merged partition in morsels of at most
+/// DEFAULT_CHUNK_SIZE elements. As a result, the merge itself runs in parallel.
+/// Once a worker claims the next partition, the previous one was read completely and gets freed.
+///
+/// Generates the same code as the regular HashTableSource, only the morsel picking differs.
+template <class HashTable>
+struct PartitionedHashTableSource : public HashTableSource<HashTable> {
+   static SuboperatorArc build(const RelAlgOp* source, const IU& produced_iu, AggregationHashTables<HashTable>* tables_);
+
+   /// Keep running as long as there are partitions left. Multiple threads can pick morsels,
+   /// every thread works on the partition it claimed last.
+   Suboperator::PickMorselResult pickMorsel(size_t thread_id) override;
+
+   /// The source reads from the aggregation hash tables.
+   std::vector<Suboperator::SharedObjectAccess> getSharedObjectAccesses() const override;
+
+   protected:
+   PartitionedHashTableSource(const RelAlgOp* source, const IU& produced_iu, AggregationHashTables<HashTable>* tables_);
+
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
+
+   private:
+   /// The aggregation hash tables we are reading from.
+   AggregationHashTables<HashTable>* tables;
+   /// The first partition which was not claimed by any thread yet.
+   std::atomic<size_t> next_partition = 0;
+   /// The partition every thread claimed last.
+   std::vector<std::optional<size_t>> claimed_partitions;
+};
+
+using SimplePartitionedHashTableSource = PartitionedHashTableSource<HashTableSimpleKey>;
+using ComplexPartitionedHashTableSource = PartitionedHashTableSource<HashTableComplexKey>;
+using DirectLookupPartitionedHashTableSource = PartitionedHashTableSource<HashTableDirectLookup>;
+
 }
 
 #endif //INKFUSE_HASHTABLESOURCE_H
@@ -0,0 +1,59 @@
+#include "algebra/suboperators/sources/JoinRowsSource.h"
+#include "algebra/RelAlgOp.h"
+
+namespace inkfuse {
+
+std::unique_ptr<JoinRowsDriver> JoinRowsDriver::build(const RelAlgOp* source, JoinRows* rows_) {
+   return std::unique_ptr<JoinRowsDriver>(new JoinRowsDriver(source, rows_));
+}
+
+JoinRowsDriver::JoinRowsDriver(const RelAlgOp* source, JoinRows* rows_)
+   : LoopDriver(source), rows(rows_) {
+}
+
+Suboperator::PickMorselResult JoinRowsDriver::pickMorsel(size_t thread_id) {
+   assert(thread_id < states.size());
+   auto& state = states[thread_id];
+
+   // The joined rows of this thread are always written to the start of its output arrays.
+   const size_t produced = rows->produce(thread_id);
+   if (produced == 0) {
+      return NoMoreMorsels{};
+   }
+   state->start = 0;
+   state->end = produced;
+   return PickedMorsel{
+      .morsel_size = produced,
+      .pipeline_progress = rows->progress(),
+   };
+}
+
+std::vector<Suboperator::SharedObjectAccess> JoinRowsDriver::getSharedObjectAccesses() const {
+   if (!rows) {
+      return {};
+   }
+   return {SharedObjectAccess{.object = rows, .mutates = false}};
+}
+
+std::string JoinRowsDriver::id() const {
+   return "JoinRowsDriver";
+}
+
+std::unique_ptr<JoinRowsIUProvider> JoinRowsIUProvider::build(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, JoinRows* rows_, bool build_side_) {
+   return std::unique_ptr<JoinRowsIUProvider>(new JoinRowsIUProvider(source, driver_iu, produced_iu, rows_, build_side_));
+}
+
+JoinRowsIUProvider::JoinRowsIUProvider(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, JoinRows* rows_, bool build_side_)
+   : IndexedIUProvider(source, driver_iu, produced_iu), rows(rows_), build_side(build_side_) {
+}
+
+void JoinRowsIUProvider::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
+   state->start = reinterpret_cast<char*>(rows->getOutput(thread_id, build_side));
+}
+
+std::string JoinRowsIUProvider::providerName() const {
+   return "JoinRowsIUProvider";
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef INKFUSE_JOINROWSSOURCE_H
+#define INKFUSE_JOINROWSSOURCE_H
+
+#include "algebra/suboperators/IndexedIUProvider.h"
+#include "algebra/suboperators/LoopDriver.h"
+#include "algebra/suboperators/Suboperator.h"
+#include "runtime/JoinHashTables.h"
+
+/// This file contains the sub-operators reading joined rows which are produced outside of the probe pipeline.
+namespace inkfuse {
+
+/// Loop driver producing the joined rows of a join, e.g. by expanding the probe matches of an n:m join.
+/// A single probe row can have an arbitrary number of join partners. The driver splits
+/// the joined rows into morsels of at most DEFAULT_CHUNK_SIZE rows.
+struct JoinRowsDriver final : public LoopDriver {
+   static std::unique_ptr<JoinRowsDriver> build(const RelAlgOp* source, JoinRows* rows_ = nullptr);
+
+   /// Produce the next set of joined rows. Multiple threads can produce concurrently.
+   PickMorselResult pickMorsel(size_t thread_id) override;
+
+   /// The driver reads the state of the probe pipeline.
+   std::vector<SharedObjectAccess> getSharedObjectAccesses() const override;
+
+   std::string id() const override;
+
+   private:
+   JoinRowsDriver(const RelAlgOp* source, JoinRows* rows_);
+
+   /// The joined rows.
+   JoinRows* rows;
+};
+
+/// IU provider for the joined rows of a join. Produces pointers either to the packed
+/// probe rows, or to the packed build rows.
+struct JoinRowsIUProvider final : public IndexedIUProvider {
+   static std::unique_ptr<JoinRowsIUProvider> build(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, JoinRows* rows_ = nullptr, bool build_side_ = true);
+
+   protected:
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
+
+   std::string providerName() const override;
+
+   private:
+   JoinRowsIUProvider(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, JoinRows* rows_, bool build_side_);
+
+   /// The joined rows.
+   JoinRows* rows;
+   /// Are the build rows produced? Otherwise, the probe rows are.
+   bool build_side;
+};
+
+}
+
+#endif //INKFUSE_JOINROWSSOURCE_H
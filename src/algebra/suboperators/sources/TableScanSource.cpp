@@ -3,36 +3,42 @@
 #include "algebra/RelAlgOp.h"
 #include "codegen/Type.h"
 #include "exec/FuseChunk.h"
+#include "runtime/Runtime.h"
+#include "storage/Relation.h"
 #include <algorithm>
 #include <functional>
 
 namespace inkfuse {
 
-std::unique_ptr<TScanDriver> TScanDriver::build(const RelAlgOp* source, size_t rel_size_) {
-   return std::unique_ptr<TScanDriver>(new TScanDriver(source, rel_size_));
+std::unique_ptr<TScanDriver> TScanDriver::build(const RelAlgOp* source, size_t rel_size_, MorselFilter filter_) {
+   return std::unique_ptr<TScanDriver>(new TScanDriver(source, rel_size_, std::move(filter_)));
 }
 
-TScanDriver::TScanDriver(const RelAlgOp* source, size_t rel_size_)
-   : LoopDriver(source), rel_size(rel_size_) {
+TScanDriver::TScanDriver(const RelAlgOp* source, size_t rel_size_, MorselFilter filter_)
+   : LoopDriver(source), rel_size(rel_size_), filter(std::move(filter_)) {
 }
 
-Suboperator::PickMorselResult TScanDriver::pickMorsel() {
-   assert(state);
+Suboperator::PickMorselResult TScanDriver::pickMorsel(size_t thread_id) {
+   assert(thread_id < states.size());
+   auto& state = states[thread_id];
 
-   if (!first_picked) {
-      state->start = 0;
-      first_picked = true;
-   } else {
-      state->start = state->end;
-   }
+   // Claim morsels until one of them could contain relevant rows. Skipped morsels are never touched.
+   uint64_t start;
+   uint64_t end;
+   do {
+      // Claim the next morsel. Relaxed ordering is enough, the counter does not publish any data.
+      start = next_start.fetch_add(DEFAULT_CHUNK_SIZE, std::memory_order_relaxed);
 
-   // Go up to the maximum chunk size of the intermediate results or the total relation size.
-   state->end = std::min(state->start + DEFAULT_CHUNK_SIZE, static_cast<uint64_t>(rel_size));
+      // If the starting point advanced to the end, then we know there are no more morsels to pick.
+      if (start >= rel_size) {
+         return NoMoreMorsels{};
+      }
 
-   // If the starting point advanced to the end, then we know there are no more morsels to pick.
-   if (state->end == state->start) {
-      return NoMoreMorsels{};
-   }
+      // Go up to the maximum chunk size of the intermediate results or the total relation size.
+      end = std::min(start + DEFAULT_CHUNK_SIZE, static_cast<uint64_t>(rel_size));
+   } while (filter && !filter(start, end));
+   state->start = start;
+   state->end = end;
    return PickedMorsel {
       .morsel_size = state->end - state->start,
       .pipeline_progress = static_cast<double>(state->end) / rel_size,
@@ -43,7 +49,8 @@ std::string TScanDriver::id() const {
    return "TScanDriver";
 }
 
-void TScanIUProvider::setUpStateImpl(const ExecutionContext& context) {
+void TScanIUProvider::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
    state->start = raw_data;
 }
 
@@ -59,4 +66,84 @@ TScanIUProvider::TScanIUProvider(const RelAlgOp* source, const IU& driver_iu, co
    : IndexedIUProvider(source, driver_iu, produced_iu), raw_data(raw_data_) {
 }
 
+const char* TScanDecodeState::name = "TScanDecodeState";
+
+std::unique_ptr<TScanDecodeIUProvider> TScanDecodeIUProvider::build(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, IR::TypeArc delta_type_, char* references_, char* deltas_) {
+   return std::unique_ptr<TScanDecodeIUProvider>(new TScanDecodeIUProvider{source, driver_iu, produced_iu, std::move(delta_type_), references_, deltas_});
+}
+
+TScanDecodeIUProvider::TScanDecodeIUProvider(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, IR::TypeArc delta_type_, char* references_, char* deltas_)
+   : TemplatedSuboperator<TScanDecodeState>(source, {&produced_iu}, {&driver_iu}), delta_type(std::move(delta_type_)), references(references_), deltas(deltas_) {
+}
+
+void TScanDecodeIUProvider::consume(const IU& iu, CompilationContext& context) {
+   assert(&iu == *this->source_ius.begin());
+   auto& builder = context.getFctBuilder();
+   const auto& program = context.getProgram();
+   const IU& out_iu = *provided_ius.front();
+   const auto& loop_idx = context.getIUDeclaration(*source_ius.front());
+
+   // Extract the typed references and deltas pointers into the function preamble.
+   std::deque<IR::StmtPtr> preamble_stmts;
+   const auto extract_pointer = [&](const std::string& member, IR::TypeArc type) -> const IR::Stmt& {
+      auto state_expr = context.accessGlobalState(*this);
+      auto cast_expr = IR::CastExpr::build(std::move(state_expr), IR::Pointer::build(program.getStruct(TScanDecodeState::name)));
+      auto var_name = getVarIdentifier();
+      var_name << "_" << member;
+      auto decl = IR::DeclareStmt::build(var_name.str(), IR::Pointer::build(type));
+      const auto& decl_ref = *decl;
+      preamble_stmts.push_back(std::move(decl));
+      preamble_stmts.push_back(IR::AssignmentStmt::build(
+         decl_ref,
+         IR::CastExpr::build(IR::StructAccessExpr::build(std::move(cast_expr), member), IR::Pointer::build(type))));
+      return decl_ref;
+   };
+   const auto& decl_references = extract_pointer("references", out_iu.type);
+   const auto& decl_deltas = extract_pointer("deltas", delta_type);
+   builder.getRootBlock().appendStmts(std::move(preamble_stmts));
+
+   // Declare IU.
+   const auto& declare_stmt = builder.appendStmt(IR::DeclareStmt::build(context.buildIUIdentifier(out_iu), out_iu.type));
+   context.declareIU(out_iu, declare_stmt);
+
+   // Decode: references[idx / block_rows] + deltas[idx]. The block size is a power of two, the division becomes a shift.
+   auto reference = IR::DerefExpr::build(
+      IR::ArithmeticExpr::build(
+         IR::VarRefExpr::build(decl_references),
+         IR::ArithmeticExpr::build(
+            IR::VarRefExpr::build(loop_idx),
+            IR::ConstExpr::build(IR::UI<8>::build(PODColumn::block_rows)),
+            IR::ArithmeticExpr::Opcode::Divide),
+         IR::ArithmeticExpr::Opcode::Add));
+   auto delta = IR::CastExpr::build(
+      IR::DerefExpr::build(
+         IR::ArithmeticExpr::build(
+            IR::VarRefExpr::build(decl_deltas),
+            IR::VarRefExpr::build(loop_idx),
+            IR::ArithmeticExpr::Opcode::Add)),
+      out_iu.type);
+   builder.appendStmt(IR::AssignmentStmt::build(
+      declare_stmt,
+      IR::ArithmeticExpr::build(std::move(reference), std::move(delta), IR::ArithmeticExpr::Opcode::Add)));
+
+   // And notify consumer that the IU is ready.
+   context.notifyIUsReady(*this);
+}
+
+std::string TScanDecodeIUProvider::id() const {
+   return "TScanDecodeIUProvider_" + provided_ius.front()->type->id() + "_" + delta_type->id();
+}
+
+void TScanDecodeIUProvider::registerRuntime() {
+   RuntimeStructBuilder{TScanDecodeState::name}
+      .addMember("references", IR::Pointer::build(IR::Char::build()))
+      .addMember("deltas", IR::Pointer::build(IR::Char::build()));
+}
+
+void TScanDecodeIUProvider::setUpStateImpl(const ExecutionContext& context, size_t thread_id) {
+   auto& state = states[thread_id];
+   state->references = references;
+   state->deltas = deltas;
+}
+
 }
\ No newline at end of file
@@ -4,27 +4,35 @@
 #include "algebra/suboperators/Suboperator.h"
 #include "algebra/suboperators/IndexedIUProvider.h"
 #include "algebra/suboperators/LoopDriver.h"
+#include <atomic>
+#include <functional>
 
 /// This file contains the necessary sub-operators for reading from a base table.
 namespace inkfuse {
 
 /// Loop driver for reading a morsel from an underlying table.
 struct TScanDriver final : public LoopDriver {
-   static std::unique_ptr<TScanDriver> build(const RelAlgOp* source, size_t rel_size_ = 0);
+   /// Could any row within [begin, end) be relevant to the scan? Morsels without relevant rows get skipped.
+   using MorselFilter = std::function<bool(uint64_t begin, uint64_t end)>;
+
+   static std::unique_ptr<TScanDriver> build(const RelAlgOp* source, size_t rel_size_ = 0, MorselFilter filter_ = {});
 
    /// Pick then next set of tuples from the table scan up to the maximum chunk size.
-   PickMorselResult pickMorsel() override;
+   /// Morsels are handed out through an atomic counter, allowing multiple threads to scan concurrently.
+   PickMorselResult pickMorsel(size_t thread_id) override;
 
    std::string id() const override;
 
    private:
    /// Set up the table scan driver in the respective base pipeline.
-   TScanDriver(const RelAlgOp* source, size_t rel_size_);
+   TScanDriver(const RelAlgOp* source, size_t rel_size_, MorselFilter filter_);
 
-   /// Was the first morsel picked already?
-   bool first_picked = false;
+   /// Start of the next morsel which has not been picked by any thread yet.
+   std::atomic<uint64_t> next_start = 0;
    /// What is the size of the backing relation?
    size_t rel_size;
+   /// Optional filter deciding which morsels have to be scanned.
+   MorselFilter filter;
 };
 
 /// IU provider when reading from a table scan.
@@ -32,7 +40,7 @@ struct TScanIUProvider final : public IndexedIUProvider {
    static std::unique_ptr<TScanIUProvider> build(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, char* raw_data_ = nullptr);
 
    protected:
-   void setUpStateImpl(const ExecutionContext& context) override;
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
 
    std::string providerName() const override;
 
@@ -43,6 +51,46 @@ struct TScanIUProvider final : public IndexedIUProvider {
    char* raw_data;
 };
 
+/// Runtime state of a TScanDecodeIUProvider.
+struct TScanDecodeState {
+   static const char* name;
+
+   /// Pointer to the reference value of every block.
+   char* references;
+   /// Pointer to the delta of every row.
+   char* deltas;
+};
+
+/// IU provider when reading from a compressed column (see `PODColumn::compress`). Decodes the values
+/// inline while scanning: the value of a row is the reference of its block plus the widened delta of the row.
+/// This way the scan only streams the narrow deltas through the memory bus.
+struct TScanDecodeIUProvider final : public TemplatedSuboperator<TScanDecodeState> {
+   static std::unique_ptr<TScanDecodeIUProvider> build(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, IR::TypeArc delta_type_, char* references_ = nullptr, char* deltas_ = nullptr);
+
+   /// The provider has to be understood in the context of its preceding TScanDriver.
+   bool incomingStrongLinks() const override { return true; }
+
+   void consume(const IU& iu, CompilationContext& context) override;
+
+   std::string id() const override;
+
+   /// Register runtime structs and functions.
+   static void registerRuntime();
+
+   protected:
+   void setUpStateImpl(const ExecutionContext& context, size_t thread_id) override;
+
+   private:
+   TScanDecodeIUProvider(const RelAlgOp* source, const IU& driver_iu, const IU& produced_iu, IR::TypeArc delta_type_, char* references_, char* deltas_);
+
+   /// Type of the deltas.
+   IR::TypeArc delta_type;
+   /// Pointer to the references of the backing stored column.
+   char* references;
+   /// Pointer to the deltas of the backing stored column.
+   char* deltas;
+};
+
 }
 
 #endif //INKFUSE_TABLESCANSOURCE_H
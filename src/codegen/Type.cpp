@@ -65,6 +65,24 @@ void String::print(std::ostream& stream, char* data) const
    stream << *indirection;
 }
 
+DictionaryCode::DictionaryCode(std::shared_ptr<const std::vector<std::string>> dictionary_)
+   : UnsignedInt(1), dictionary(std::move(dictionary_)) {
+   assert(dictionary->size() <= max_entries);
+}
+
+uint8_t DictionaryCode::encode(std::string_view str) const {
+   const auto it = std::lower_bound(dictionary->begin(), dictionary->end(), str);
+   if (it == dictionary->end() || *it != str) {
+      return max_entries;
+   }
+   return std::distance(dictionary->begin(), it);
+}
+
+void DictionaryCode::print(std::ostream& stream, char* data) const
+{
+   stream << decode(*reinterpret_cast<uint8_t*>(data));
+}
+
 void Date::print(std::ostream& stream, char* data) const
 {
    stream << helpers::dateIntToStr(*reinterpret_cast<int32_t*>(data));
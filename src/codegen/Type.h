@@ -6,6 +6,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /// This file contains the central building blocks for the backing types within the InkFuse IR.
@@ -168,6 +169,35 @@ struct String : public SQLType {
    void print(std::ostream& stream, char* data) const override;
 };
 
+/// Code of a dictionary-encoded string. Codes are one byte unsigned integers and the engine processes them
+/// as such: filters compare codes and aggregations group on them. Only the type knows the dictionary,
+/// which turns the codes back into strings once the results get printed.
+struct DictionaryCode : public UnsignedInt {
+   /// Set up a code type for the sorted distinct strings within `dictionary_`. The code of a string is its index.
+   explicit DictionaryCode(std::shared_ptr<const std::vector<std::string>> dictionary_);
+
+   static TypeArc build(std::shared_ptr<const std::vector<std::string>> dictionary) {
+      return std::make_shared<DictionaryCode>(std::move(dictionary));
+   }
+
+   /// Maximum number of strings within a dictionary. The largest code is never assigned, so that
+   /// every string outside of the dictionary maps to a code that does not match any row.
+   static constexpr size_t max_entries = 255;
+
+   /// Get the code of a string, `max_entries` if the string is not part of the dictionary.
+   uint8_t encode(std::string_view str) const;
+   /// Get the string of a code.
+   const std::string& decode(uint8_t code) const {
+      return (*dictionary)[code];
+   }
+
+   /// Writes the decoded string.
+   void print(std::ostream& stream, char* data) const override;
+
+   /// The sorted distinct strings.
+   const std::shared_ptr<const std::vector<std::string>> dictionary;
+};
+
 /// Date type.
 struct Date : public SQLType {
    static TypeArc build() {
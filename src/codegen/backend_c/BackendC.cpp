@@ -144,6 +144,37 @@ void BackendC::createPreamble(ScopedWriter& writer) {
    // We need to access strcmp.
    writer.stmt(false).stream() << "#include <string.h>";
    writer.stmt(false).stream() << "#include <stdbool.h>\n";
+   // Width-specialized hash functions, these have to agree with the ones in HashRuntime.h.
+   // Defining them as static inline before the runtime declares them as extern functions
+   // gives them internal linkage, so calls to them get inlined into the generated code.
+   // The guard is needed as the included runtime program has the same preamble.
+   writer.stmt(false).stream() << R"(#ifndef INKFUSE_INLINE_HASH
+#define INKFUSE_INLINE_HASH
+static inline uint64_t inkfuse_fmix(uint64_t k) {
+   k ^= k >> 33;
+   k *= 0xff51afd7ed558ccdull;
+   k ^= k >> 33;
+   k *= 0xc4ceb9fe1a85ec53ull;
+   k ^= k >> 33;
+   return k;
+}
+static inline uint64_t hash4(const void* in) {
+   uint32_t v;
+   memcpy(&v, in, 4);
+   return inkfuse_fmix(v);
+}
+static inline uint64_t hash8(const void* in) {
+   uint64_t v;
+   memcpy(&v, in, 8);
+   return inkfuse_fmix(v);
+}
+static inline uint64_t hash16(const void* in) {
+   uint64_t v[2];
+   memcpy(v, in, 16);
+   return inkfuse_fmix(v[0] ^ (inkfuse_fmix(v[1]) + 0x9e3779b97f4a7c15ull));
+}
+#endif
+)";
 }
 
 void BackendC::compileInclude(const IR::Program& include, ScopedWriter& writer) {
@@ -1,16 +1,47 @@
 #include "common/Helpers.h"
 #include "date.h"
+#include "storage/ColumnarFile.h"
 #include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 
 namespace inkfuse::helpers {
 
 int32_t dateStrToInt(const char* str) {
-   std::istringstream stream(str);
-   date::sys_time<std::chrono::days> time;
-   date::from_stream(stream, "%Y-%m-%d", time);
-   return time.time_since_epoch().count();
+   return dateStrToInt(str, std::strlen(str));
+}
+
+int32_t dateStrToInt(const char* str, size_t len) {
+   // Parse the three components by hand, going through a stream for every value is far too slow for ingest.
+   const char* pos = str;
+   const char* end = str + len;
+   const auto component = [&](char terminator) {
+      int32_t value = 0;
+      const char* start = pos;
+      for (; pos < end && *pos >= '0' && *pos <= '9'; ++pos) {
+         value = 10 * value + (*pos - '0');
+      }
+      if (pos == start || pos - start > 4 || (terminator && (pos == end || *pos++ != terminator))) {
+         throw std::runtime_error("Invalid date literal " + std::string(str, len));
+      }
+      return value;
+   };
+   int32_t year = component('-');
+   const int32_t month = component('-');
+   const int32_t day = component(0);
+   if (pos != end || month < 1 || month > 12 || day < 1 || day > 31) {
+      throw std::runtime_error("Invalid date literal " + std::string(str, len));
+   }
+   // Days since the epoch of the proleptic Gregorian calendar, counting years from March
+   // so that the leap day is the last day of a year.
+   year -= month <= 2;
+   const int32_t era = (year >= 0 ? year : year - 399) / 400;
+   const int32_t year_of_era = year - era * 400;
+   const int32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+   const int32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+   return era * 146097 + day_of_era - 719468;
 }
 
 std::string dateIntToStr(int32_t date) {
@@ -22,13 +53,27 @@ std::string dateIntToStr(int32_t date) {
 
 void loadDataInto(Schema& schema, const std::string& path, bool force) {
    for (auto& [tbl_name, tbl]: schema) {
-      std::ifstream input;
-      if (force) {
-         input.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+      const std::string columnar_dir = path + "/" + tbl_name + ".columnar";
+      if (ColumnarFile::exists(columnar_dir)) {
+         ColumnarFile::read(*tbl, columnar_dir);
+      } else {
+         const std::string tbl_file = path + "/" + tbl_name + ".tbl";
+         if (!force && !std::filesystem::exists(tbl_file)) {
+            continue;
+         }
+         tbl->loadFile(tbl_file);
+         // Columnar files already contain the derived data.
+         tbl->buildDictionaries();
+         // Zone maps are computed on the values, which compression releases.
+         tbl->buildZoneMaps();
+         tbl->compressColumns();
       }
-      input.open(path + "/" + tbl_name + ".tbl");
-      tbl->loadRows(input);
-      input.close();
+   }
+}
+
+void storeDataInto(const Schema& schema, const std::string& path) {
+   for (const auto& [tbl_name, tbl]: schema) {
+      ColumnarFile::write(*tbl, path + "/" + tbl_name + ".columnar");
    }
 }
 
@@ -12,14 +12,25 @@ namespace inkfuse::helpers {
 /// The date is stored as offset to the epoch 1-1-1970.
 int32_t dateStrToInt(const char* str);
 
+/// Transform a date literal of the format `YYYY-MM-DD` with `len` characters into an integer represented in the runtime.
+/// Month and day may also consist of a single digit. Does not need a null terminator.
+int32_t dateStrToInt(const char* str, size_t len);
+
 /// Transform an integer represented in the runtime to a date literal.
 /// The date is stored as offset to the epoch 1-1-1970.
 std::string dateIntToStr(int32_t date);
 
 /// Load data into the backing columns of a schema.
-/// Looks for '|' separated .tbl files within the directory of `path`.
+/// Tables stored in the columnar format within `<path>/<table>.columnar` get mapped into memory, together with
+/// the derived data that was stored with them. Otherwise, looks for '|' separated .tbl files within the directory
+/// of `path` and parses them in parallel. Parsed string columns with few distinct values then get
+/// dictionary-encoded, integer columns compressed, and all PODColumns get zone maps.
 void loadDataInto(Schema& schema, const std::string& path, bool force = false);
 
+/// Store the tables of a schema in the columnar format within the directory of `path`,
+/// so that the next `loadDataInto` can map them instead of parsing the .tbl files.
+void storeDataInto(const Schema& schema, const std::string& path);
+
 } // namespace inkfuse
 
 #endif
\ No newline at end of file
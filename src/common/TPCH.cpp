@@ -568,6 +568,8 @@ std::unique_ptr<Print> q4(const Schema& schema) {
       // No right payload - semi join.
       {},
       JoinType::LeftSemi,
+      true,
+      // Only a small fraction of orders survives the date filter - drop most lineitems through a Bloom filter.
       true);
    auto& o_l_join_ref = *o_l_join;
    assert(o_l_join_ref.getOutput().size() == 2);
@@ -608,7 +610,9 @@ std::unique_ptr<Print> q6(const Schema& schema) {
       "l_shipdate",
       "l_discount",
       "l_quantity"};
-   auto scan = TableScan::build(*rel, cols, "scan");
+   // Skip the morsels which cannot contain shipdates from 1994.
+   std::vector<TableScan::RangePredicate> ranges{{"l_shipdate", "1994-01-01", "1994-12-31"}};
+   auto scan = TableScan::build(*rel, cols, "scan", std::move(ranges));
    auto& scan_ref = *scan;
 
    // 2. Evaluate the filter predicate.
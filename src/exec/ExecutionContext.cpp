@@ -5,58 +5,79 @@ namespace inkfuse {
 
 namespace {
 thread_local ExecutionContext* installed_context = nullptr;
+thread_local size_t installed_thread_id = 0;
 }
 
-ExecutionContext::ExecutionContext(const Pipeline& pipe_)
-   : pipe(pipe_), chunk(std::make_shared<FuseChunk>()) {
-   for (const auto& [iu, _] : pipe.iu_providers) {
-      // Do not add void-typed pseudo-IUs to the fuse chunks.
-      if (!dynamic_cast<IR::Void*>(iu->type.get())) {
-         chunk->attachColumn(*iu);
+ExecutionContext::ExecutionContext(const Pipeline& pipe_, size_t num_threads_)
+   : pipe(pipe_) {
+   assert(num_threads_ > 0);
+   chunks.reserve(num_threads_);
+   thread_states.reserve(num_threads_);
+   for (size_t thread_id = 0; thread_id < num_threads_; ++thread_id) {
+      auto& chunk = chunks.emplace_back(std::make_shared<FuseChunk>());
+      for (const auto& [iu, _] : pipe.iu_providers) {
+         // Do not add void-typed pseudo-IUs to the fuse chunks.
+         if (!dynamic_cast<IR::Void*>(iu->type.get())) {
+            chunk->attachColumn(*iu);
+         }
       }
+      thread_states.push_back(std::make_unique<ThreadState>());
    }
 }
 
 ExecutionContext ExecutionContext::recontextualize(const Pipeline& new_pipe_) const {
-   return ExecutionContext(chunk, new_pipe_);
+   return ExecutionContext(chunks, new_pipe_);
 }
 
-Column& ExecutionContext::getColumn(const IU& iu) const {
-   return chunk->getColumn(iu);
+Column& ExecutionContext::getColumn(const IU& iu, size_t thread_id) const {
+   assert(thread_id < chunks.size());
+   return chunks[thread_id]->getColumn(iu);
 }
 
-void ExecutionContext::clear() const {
-   chunk->clearColumns();
+void ExecutionContext::clear(size_t thread_id) const {
+   assert(thread_id < chunks.size());
+   chunks[thread_id]->clearColumns();
 }
 
 const Pipeline& ExecutionContext::getPipe() const {
    return pipe;
 }
 
-ExecutionContext::ExecutionContext(FuseChunkArc chunk_, const Pipeline& pipe_)
-   : chunk(std::move(chunk_)), pipe(pipe_) {
+size_t ExecutionContext::getNumThreads() const {
+   return chunks.size();
 }
 
-ExecutionContext::RuntimeGuard::RuntimeGuard(ExecutionContext& ctx) {
+ExecutionContext::ExecutionContext(std::vector<FuseChunkArc> chunks_, const Pipeline& pipe_)
+   : chunks(std::move(chunks_)), pipe(pipe_) {
+   thread_states.reserve(chunks.size());
+   for (size_t thread_id = 0; thread_id < chunks.size(); ++thread_id) {
+      thread_states.push_back(std::make_unique<ThreadState>());
+   }
+}
+
+ExecutionContext::RuntimeGuard::RuntimeGuard(ExecutionContext& ctx, size_t thread_id) {
+   assert(thread_id < ctx.getNumThreads());
    installed_context = &ctx;
+   installed_thread_id = thread_id;
 }
 
 ExecutionContext::RuntimeGuard::~RuntimeGuard() {
    installed_context = nullptr;
+   installed_thread_id = 0;
 }
 
 MemoryRuntime::MemoryRegion& ExecutionContext::getInstalledMemoryContext() {
    assert(installed_context);
-   return installed_context->memory_context;
+   return installed_context->thread_states[installed_thread_id]->memory_context;
 }
 
 bool& ExecutionContext::getInstalledRestartFlag() {
    assert(installed_context);
-   return installed_context->restart_flag;
+   return installed_context->thread_states[installed_thread_id]->restart_flag;
 }
 
 bool* ExecutionContext::tryGetInstalledRestartFlag() {
-   return installed_context ? &installed_context->restart_flag : nullptr;
+   return installed_context ? &installed_context->thread_states[installed_thread_id]->restart_flag : nullptr;
 }
 
 }
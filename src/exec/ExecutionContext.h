@@ -6,6 +6,7 @@
 #include "runtime/MemoryRuntime.h"
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace inkfuse {
 
@@ -15,26 +16,33 @@ struct Suboperator;
 /// The execution context for a single pipeline.
 /// Takes the compile-time context of a pipeline and creates the runtime
 /// fuse chunks.
+/// A pipeline can be executed by multiple worker threads at the same time. Every worker
+/// thread gets its own fuse chunk, memory context and restart flag.
 struct ExecutionContext {
    /// Create the execution context for a given base pipeline.
-   ExecutionContext(const Pipeline& pipe_);
+   /// @param pipe_ the pipeline to create the context for
+   /// @param num_threads_ how many worker threads execute the pipeline in parallel
+   ExecutionContext(const Pipeline& pipe_, size_t num_threads_ = 1);
 
    /// Recontextualize based on another pipeline with the same underlying fuse chunks.
    ExecutionContext recontextualize(const Pipeline& new_pipe_) const;
 
-   /// Get the raw data column for the given IU.
-   Column& getColumn(const IU& iu) const;
+   /// Get the raw data column for the given IU of a worker thread.
+   Column& getColumn(const IU& iu, size_t thread_id = 0) const;
 
-   /// Clear the execution context.
-   void clear() const;
+   /// Clear the execution context of a worker thread.
+   void clear(size_t thread_id = 0) const;
 
    const Pipeline& getPipe() const;
 
+   /// How many worker threads is this execution context set up for?
+   size_t getNumThreads() const;
+
    /// Scope guard which installs the necessary thread-local context for this ExecutionContext.
    /// Needs to be installed when running morsels to e.g. enable proper memory allocation from
-   /// within the generated code.
+   /// within the generated code. Every worker thread installs the guard with its own id.
    struct RuntimeGuard {
-      RuntimeGuard(ExecutionContext& ctx);
+      RuntimeGuard(ExecutionContext& ctx, size_t thread_id = 0);
       ~RuntimeGuard();
    };
 
@@ -43,20 +51,27 @@ struct ExecutionContext {
    static bool* tryGetInstalledRestartFlag();
 
    private:
-   ExecutionContext(FuseChunkArc chunk_, const Pipeline& pipe_);
+   ExecutionContext(std::vector<FuseChunkArc> chunks_, const Pipeline& pipe_);
+
+   /// Runtime state which is private to a single worker thread.
+   /// Aligned to a cache line to prevent false sharing on the restart flag.
+   struct alignas(64) ThreadState {
+      /// The memory context of this worker.
+      MemoryRuntime::MemoryRegion memory_context;
+      /// The restart flag indicates whether the last vectorized primitive needs to be restarted
+      /// during interpretation. Primitives that can set this flag need to be idempotent.
+      /// This flag is used by aggregation hash tables when they spill in the middle of a morsel. As this invalidates
+      /// previously accessed pointers, we need to restart the previous lookups in order to ensure that
+      /// we don't access the groups of the cleared hash table.
+      bool restart_flag = false;
+   };
 
-   /// The backing fuse chunk for the pipeline.
-   FuseChunkArc chunk;
+   /// The backing fuse chunks for the pipeline, one per worker thread.
+   std::vector<FuseChunkArc> chunks;
    /// The pipeline.
    const Pipeline& pipe;
-   /// The memory context of this pipeline.
-   MemoryRuntime::MemoryRegion memory_context;
-   /// The restart flag indicates whether the last vectorized primitive needs to be restarted
-   /// during interpretation. Primitives that can set this flag need to be idempotent.
-   /// This flag is used by hash tables when they grow in the middle of a morsel. As this invalidates
-   /// previously accessed pointers, we need to restart the previous lookups in order to ensure that
-   /// we don't access deallocated memory of the older (smaller) hash table.
-   bool restart_flag = false;
+   /// The thread-local runtime state, one per worker thread.
+   std::vector<std::unique_ptr<ThreadState>> thread_states;
 };
 
 }
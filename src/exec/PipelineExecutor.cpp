@@ -8,16 +8,37 @@
 
 #include <chrono>
 #include <iostream>
+#include <optional>
 
 namespace inkfuse {
 
-PipelineExecutor::PipelineExecutor(Pipeline& pipe_, ExecutionMode mode, std::string full_name_, PipelineExecutor::QueryControlBlockArc control_block_)
-   : compile_state(std::make_shared<AsyncCompileState>(std::move(control_block_), pipe_)), pipe(pipe_), mode(mode), full_name(std::move(full_name_)) {
+namespace {
+
+/// How many worker threads can we use for the given pipeline?
+size_t effectiveThreads(const Pipeline& pipe, size_t requested) {
+   for (const auto& op : pipe.getSubops()) {
+      if (!op->isParallelizable()) {
+         // Some suboperator mutates shared state without synchronization.
+         return 1;
+      }
+   }
+   return std::max(requested, size_t{1});
+}
+
+}
+
+PipelineExecutor::PipelineExecutor(Pipeline& pipe_, ExecutionMode mode, std::string full_name_, PipelineExecutor::QueryControlBlockArc control_block_, size_t num_threads_)
+   : compile_state(std::make_shared<AsyncCompileState>(std::move(control_block_), pipe_, effectiveThreads(pipe_, num_threads_))), pipe(pipe_), mode(mode), num_threads(compile_state->context.getNumThreads()), full_name(std::move(full_name_)) {
    assert(pipe.getSubops()[0]->isSource());
    assert(pipe.getSubops().back()->isSink());
 }
 
 PipelineExecutor::~PipelineExecutor() noexcept {
+   if (compiler_setup_started) {
+      // The hybrid mode detaches the compilation, wait until it no longer needs the pipeline.
+      std::unique_lock lock(compile_state->compiled_lock);
+      compile_state->codegen_cv.wait(lock, [&] { return compile_state->codegen_done; });
+   }
    for (auto& op : pipe.getSubops()) {
       op->tearDownState();
    }
@@ -46,9 +67,8 @@ void PipelineExecutor::preparePipeline(ExecutionMode prep_mode) {
 
 PipelineExecutor::PipelineStats PipelineExecutor::runPipeline() {
    PipelineStats result;
+   restarts = 0;
    const auto start_execution_ts = std::chrono::steady_clock::now();
-   // Scope guard for memory compile_state->context and flags.
-   ExecutionContext::RuntimeGuard guard{compile_state->context};
    if (mode == ExecutionMode::Fused) {
       preparePipeline(ExecutionMode::Fused);
       if (compilation_job.joinable()) {
@@ -60,70 +80,30 @@ PipelineExecutor::PipelineStats PipelineExecutor::runPipeline() {
       // Store how long we were stalled waiting for compilation to finish.
       result.codegen_microseconds = std::chrono::duration_cast<std::chrono::microseconds>(compilation_done_ts - start_execution_ts).count();
       compile_state->compiled->setUpState();
-      while (std::holds_alternative<Suboperator::PickedMorsel>(runFusedMorsel())) {}
+      runWorkers([&](size_t thread_id) {
+         // Scope guard for memory context and flags of this worker.
+         ExecutionContext::RuntimeGuard guard{compile_state->context, thread_id};
+         while (std::holds_alternative<Suboperator::PickedMorsel>(runFusedMorsel(thread_id))) {}
+      });
    } else if (mode == ExecutionMode::Interpreted) {
       preparePipeline(ExecutionMode::Interpreted);
       for (auto& interpreter : interpreters) {
          interpreter->setUpState();
       }
-      while (std::holds_alternative<Suboperator::PickedMorsel>(runInterpretedMorsel())) {}
+      runWorkers([&](size_t thread_id) {
+         // Scope guard for memory context and flags of this worker.
+         ExecutionContext::RuntimeGuard guard{compile_state->context, thread_id};
+         while (std::holds_alternative<Suboperator::PickedMorsel>(runInterpretedMorsel(thread_id))) {}
+      });
    } else {
       preparePipeline(ExecutionMode::Interpreted);
       preparePipeline(ExecutionMode::Fused);
-
-      // Last measured pipeline throughput.
-      // TODO(benjamin): More robust as exponential decaying average.
-      double compiled_throughput = 0.0;
-      double interpreted_throughput = 0.0;
-
-      auto timeAndRunInterpreted = [&] {
-         const auto start = std::chrono::steady_clock::now();
-         const auto morsel = runInterpretedMorsel();
-         const auto stop = std::chrono::steady_clock::now();
-         const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
-         if (auto picked = std::get_if<Suboperator::PickedMorsel>(&morsel)) {
-            interpreted_throughput = static_cast<double>(picked->morsel_size) / nanos;
-         }
-         return std::holds_alternative<Suboperator::NoMoreMorsels>(morsel);
-      };
-
-      auto timeAndRunCompiled = [&] {
-         const auto start = std::chrono::steady_clock::now();
-         const auto morsel = runFusedMorsel();
-         const auto stop = std::chrono::steady_clock::now();
-         const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
-         if (auto picked = std::get_if<Suboperator::PickedMorsel>(&morsel)) {
-            compiled_throughput = static_cast<double>(picked->morsel_size) / nanos;
-         }
-         return std::holds_alternative<Suboperator::NoMoreMorsels>(morsel);
-      };
-
       for (auto& interpreter : interpreters) {
          interpreter->setUpState();
       }
-      bool fused_ready = false;
-      bool terminate = false;
-      while (!fused_ready && !terminate) {
-         terminate = timeAndRunInterpreted();
-         std::unique_lock lock(compile_state->compiled_lock);
-         fused_ready = compile_state->fused_set_up;
-      }
-      // Code is ready - set up for compiled execution.
-      if (!terminate && fused_ready) {
-         compile_state->compiled->setUpState();
-      }
-      size_t it_counter = 0;
-      while (!terminate) {
-         // We run 2 out of 25 morsels with the interpreter just to repeatedly check on performance.
-         if ((it_counter % 50 < 2) || compiled_throughput == 0.0 || (compiled_throughput > (0.95 * interpreted_throughput))) {
-            // If the compiled throughput approaches the interpreted one, use the generated code.
-            terminate = timeAndRunCompiled();
-         } else {
-            // But in some cases the vectorized interpreter is better - stick with it.
-            terminate = timeAndRunInterpreted();
-         }
-         it_counter++;
-      }
+      runWorkers([&](size_t thread_id) {
+         runHybridWorker(thread_id);
+      });
       // Async interrupt trigger - saves us some wall clock time.
       std::thread([compilation_job = std::move(compilation_job), compile_state = compile_state]() mutable {
          // Stop the backing compilation job (if not finished) and clean up.
@@ -132,14 +112,125 @@ PipelineExecutor::PipelineStats PipelineExecutor::runPipeline() {
          compilation_job.detach();
       }).detach();
    }
+   // All morsels are done. Suboperators can now combine their thread-local state in parallel.
+   runWorkers([&](size_t thread_id) {
+      for (auto& op : pipe.getSubops()) {
+         op->finishPipeline(thread_id);
+      }
+   });
+   result.restarts = restarts.load();
+   if (compile_state->control_block) {
+      result.hash_tables = compile_state->control_block->dag.getHashTableStats(pipe);
+   }
    return result;
 }
 
+void PipelineExecutor::runHybridWorker(size_t thread_id) {
+   // Scope guard for memory context and flags of this worker.
+   ExecutionContext::RuntimeGuard guard{compile_state->context, thread_id};
+
+   // Last measured pipeline throughput. Every worker measures its own throughput.
+   // TODO(benjamin): More robust as exponential decaying average.
+   double compiled_throughput = 0.0;
+   double interpreted_throughput = 0.0;
+
+   auto timeAndRunInterpreted = [&] {
+      const auto start = std::chrono::steady_clock::now();
+      const auto morsel = runInterpretedMorsel(thread_id);
+      const auto stop = std::chrono::steady_clock::now();
+      const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+      if (auto picked = std::get_if<Suboperator::PickedMorsel>(&morsel)) {
+         interpreted_throughput = static_cast<double>(picked->morsel_size) / nanos;
+      }
+      return std::holds_alternative<Suboperator::NoMoreMorsels>(morsel);
+   };
+
+   auto timeAndRunCompiled = [&] {
+      const auto start = std::chrono::steady_clock::now();
+      const auto morsel = runFusedMorsel(thread_id);
+      const auto stop = std::chrono::steady_clock::now();
+      const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+      if (auto picked = std::get_if<Suboperator::PickedMorsel>(&morsel)) {
+         compiled_throughput = static_cast<double>(picked->morsel_size) / nanos;
+      }
+      return std::holds_alternative<Suboperator::NoMoreMorsels>(morsel);
+   };
+
+   bool fused_ready = false;
+   bool terminate = false;
+   while (!fused_ready && !terminate) {
+      terminate = timeAndRunInterpreted();
+      std::unique_lock lock(compile_state->compiled_lock);
+      fused_ready = compile_state->fused_set_up;
+   }
+   // Code is ready - set up for compiled execution. The first worker to get here
+   // sets up the state, setting up the compiled runner is idempotent.
+   if (!terminate && fused_ready) {
+      std::unique_lock lock(compile_state->compiled_lock);
+      compile_state->compiled->setUpState();
+   }
+   size_t it_counter = 0;
+   while (!terminate) {
+      // We run 2 out of 25 morsels with the interpreter just to repeatedly check on performance.
+      if ((it_counter % 50 < 2) || compiled_throughput == 0.0 || (compiled_throughput > (0.95 * interpreted_throughput))) {
+         // If the compiled throughput approaches the interpreted one, use the generated code.
+         terminate = timeAndRunCompiled();
+      } else {
+         // But in some cases the vectorized interpreter is better - stick with it.
+         terminate = timeAndRunInterpreted();
+      }
+      it_counter++;
+   }
+}
+
+void PipelineExecutor::runWorkers(const std::function<void(size_t)>& work) {
+   if (num_threads == 1) {
+      // Single-threaded execution stays on the calling thread.
+      work(0);
+      return;
+   }
+   // Only borrow the workers of the budget which are free right now.
+   const size_t extra_workers = budget ? budget->acquire(0, num_threads - 1) : num_threads - 1;
+   std::optional<WorkerBudget::Guard> borrowed;
+   if (budget) {
+      borrowed.emplace(*budget, extra_workers);
+   }
+   const size_t num_workers = extra_workers + 1;
+   std::mutex error_lock;
+   std::exception_ptr error;
+   auto guardedWork = [&](size_t worker_id) {
+      try {
+         // Morsels are picked dynamically, so the work of an id without its own thread finishes right away.
+         for (size_t thread_id = worker_id; thread_id < num_threads; thread_id += num_workers) {
+            work(thread_id);
+         }
+      } catch (...) {
+         std::unique_lock lock(error_lock);
+         if (!error) {
+            error = std::current_exception();
+         }
+      }
+   };
+   std::vector<std::thread> workers;
+   workers.reserve(extra_workers);
+   for (size_t worker_id = 1; worker_id < num_workers; ++worker_id) {
+      workers.emplace_back(guardedWork, worker_id);
+   }
+   // The calling thread participates as worker 0.
+   guardedWork(0);
+   for (auto& worker : workers) {
+      worker.join();
+   }
+   if (error) {
+      std::rethrow_exception(error);
+   }
+}
+
 Suboperator::PickMorselResult PipelineExecutor::runMorsel() {
    if (compilation_job.joinable()) {
       compilation_job.join();
    }
-   // Scope guard for memory compile_state->context and flags.
+   // Scope guard for memory compile_state->context and flags. Single morsels always run on worker 0.
    ExecutionContext::RuntimeGuard guard{compile_state->context};
    if (mode == ExecutionMode::Fused || (mode == ExecutionMode::Hybrid)) {
       preparePipeline(ExecutionMode::Fused);
@@ -147,16 +238,24 @@ Suboperator::PickMorselResult PipelineExecutor::runMorsel() {
          compilation_job.join();
       }
       compile_state->compiled->setUpState();
-      return runFusedMorsel();
+      return runFusedMorsel(0);
    } else {
       preparePipeline(ExecutionMode::Interpreted);
       for (auto& interpreter : interpreters) {
          interpreter->setUpState();
       }
-      return runInterpretedMorsel();
+      return runInterpretedMorsel(0);
    }
 }
 
+size_t PipelineExecutor::getNumThreads() const {
+   return num_threads;
+}
+
+void PipelineExecutor::setWorkerBudget(WorkerBudget* budget_) {
+   budget = budget_;
+}
+
 void PipelineExecutor::setUpInterpreted() {
    auto count = pipe.getSubops().size();
    interpreters.reserve(count);
@@ -189,6 +288,11 @@ std::thread PipelineExecutor::setUpFusedAsync() {
    auto ret = std::thread([runner = std::move(runner), state = compile_state]() mutable {
       // Generate C code in the backend.
       runner->generateC();
+      {
+         std::unique_lock lock(state->compiled_lock);
+         state->codegen_done = true;
+      }
+      state->codegen_cv.notify_all();
       // Turn the generated C into machine code.
       bool done = runner->generateMachineCode(state->interrupt);
       if (done) {
@@ -201,65 +305,75 @@ std::thread PipelineExecutor::setUpFusedAsync() {
    return ret;
 }
 
-void PipelineExecutor::cleanUp() {
-   compile_state->context.clear();
+void PipelineExecutor::cleanUp(size_t thread_id) {
+   compile_state->context.clear(thread_id);
    // Reset the restart flag to have a clean slate for the next morsel.
    ExecutionContext::getInstalledRestartFlag() = false;
 }
 
-Suboperator::PickMorselResult PipelineExecutor::runFusedMorsel() {
+Suboperator::PickMorselResult PipelineExecutor::runFusedMorsel(size_t thread_id) {
    assert(compile_state->fused_set_up);
    // Run the whole compiled executor.
-   auto morsel = compile_state->compiled->runMorsel(true);
+   auto morsel = compile_state->compiled->runMorsel(true, thread_id);
    if (std::holds_alternative<Suboperator::PickedMorsel>(morsel)) {
       if (auto printer = pipe.getPrettyPrinter()) {
          // Tell the printer that a morsel is done.
-         if (printer->markMorselDone(compile_state->context)) {
+         if (printer->markMorselDone(compile_state->context, thread_id)) {
             // Output is closed - no more work to be done.
             return Suboperator::NoMoreMorsels{};
          }
       }
-      cleanUp();
+      cleanUp(thread_id);
    }
    return morsel;
 }
 
-Suboperator::PickMorselResult PipelineExecutor::runInterpretedMorsel() {
+Suboperator::PickMorselResult PipelineExecutor::runInterpretedMorsel(size_t thread_id) {
    // Run a morsel and retry it if the `restart_flag` gets set to true.
    // This is needed to defend against e.g. hash table resizes without
    // massively complicating the generated code.
-   auto runMorselWithRetry = [&](PipelineRunner& runner, bool force_pick) {
-      // The restart flag was installed by the current compile_state->context in `runPipeline` or `runMorsel`.
+   auto runMorselWithRetry = [&](PipelineRunner& runner, bool force_pick, const std::function<void(const Suboperator::PickedMorsel&)>& on_pick = {}) {
+      // The restart flag of this worker was installed by the current compile_state->context in `runPipeline` or `runMorsel`.
       bool& restart_flag = ExecutionContext::getInstalledRestartFlag();
       assert(!restart_flag);
 
       // Run the morsel until the flag is not set. The flag can be set multiple times if e.g.
       // multiple hash table resizes happen for the same chunk.
-      auto pick_result = runner.runMorsel(force_pick);
+      auto pick_result = runner.runMorsel(force_pick, thread_id, on_pick);
       while (restart_flag) {
          restart_flag = false;
-         runner.prepareForRerun();
-         runner.runMorsel(false);
+         restarts.fetch_add(1, std::memory_order_relaxed);
+         runner.prepareForRerun(thread_id);
+         runner.runMorsel(false, thread_id);
       }
 
       return pick_result;
    };
 
+   // Let the suboperators make room for the morsel before the first primitive runs, e.g. hash tables
+   // reserve slots for the keys they expect so that they don't rebuild their index multiple times
+   // in the middle of the chunk.
+   auto prepare = [&](const Suboperator::PickedMorsel& picked) {
+      for (auto& op : pipe.getSubops()) {
+         op->prepareMorsel(thread_id, picked.morsel_size);
+      }
+   };
+
    // Only the first interpreter is allowed to pick a morsel - the morsel of that source is then
    // fixed for all remaining interpreters in the pipeline.
-   auto morsel = runMorselWithRetry(*interpreters[0], true);
+   auto morsel = runMorselWithRetry(*interpreters[0], true, prepare);
    if (std::holds_alternative<Suboperator::PickedMorsel>(morsel)) {
       for (auto interpreter = interpreters.begin() + 1; interpreter < interpreters.end(); ++interpreter) {
          runMorselWithRetry(**interpreter, false);
       }
       if (auto printer = pipe.getPrettyPrinter()) {
          // Tell the printer that a morsel is done.
-         if (printer->markMorselDone(compile_state->context)) {
+         if (printer->markMorselDone(compile_state->context, thread_id)) {
             // Output is closed - no more work to be done.
             return Suboperator::NoMoreMorsels{};
          }
       }
-      cleanUp();
+      cleanUp(thread_id);
    }
    return morsel;
 }
@@ -4,8 +4,12 @@
 #include "algebra/Pipeline.h"
 #include "algebra/RelAlgOp.h"
 #include "exec/InterruptableJob.h"
+#include "exec/TaskScheduler.h"
 #include "exec/runners/CompiledRunner.h"
 #include "exec/runners/PipelineRunner.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <future>
 #include <map>
 #include <utility>
@@ -45,7 +49,9 @@ struct PipelineExecutor {
    /// @param pipe_ the backing pipe to be executed
    /// @param mode_ the execution mode to execute the pipeline in
    /// @param full_name_ the name of the full compiled binary
-   PipelineExecutor(Pipeline& pipe_, ExecutionMode mode_ = ExecutionMode::Hybrid, std::string full_name_ = "", QueryControlBlockArc control_block_ = nullptr);
+   /// @param num_threads_ how many worker threads should run morsels of the pipeline in parallel.
+   ///                     Pipelines which cannot be parallelized are always run by a single thread.
+   PipelineExecutor(Pipeline& pipe_, ExecutionMode mode_ = ExecutionMode::Hybrid, std::string full_name_ = "", QueryControlBlockArc control_block_ = nullptr, size_t num_threads_ = 1);
 
    ~PipelineExecutor() noexcept;
 
@@ -61,6 +67,12 @@ struct PipelineExecutor {
    struct PipelineStats {
       /// How many microseconds was execution stalled on waiting for code generation?
       size_t codegen_microseconds = 0;
+      /// How often did an interpreted primitive have to be rerun because it set the restart flag?
+      /// Hash tables grow in place, only spilling the tables of an out-of-core aggregation restarts primitives.
+      size_t restarts = 0;
+      /// Statistics of the hash tables accessed by the pipeline. Only available if the
+      /// pipeline belongs to a query control block.
+      std::vector<HashTableStats> hash_tables;
    };
    /// Run the full pipeline to completion.
    PipelineStats runPipeline();
@@ -69,24 +81,37 @@ struct PipelineExecutor {
    /// @return true if there are more morsels.
    Suboperator::PickMorselResult runMorsel();
 
+   /// How many worker threads execute the pipeline?
+   size_t getNumThreads() const;
+
+   /// Share the workers with other pipelines. The thread calling `runPipeline` has to hold a worker
+   /// of the budget already, the other workers are only used while they are free.
+   void setWorkerBudget(WorkerBudget* budget_);
+
    private:
-   /// Run a full morsel through the compiled path.
-   Suboperator::PickMorselResult runFusedMorsel();
-   /// Run a full morsel through the interpreted path.
-   Suboperator::PickMorselResult runInterpretedMorsel();
+   /// Run a full morsel through the compiled path on the given worker thread.
+   Suboperator::PickMorselResult runFusedMorsel(size_t thread_id);
+   /// Run a full morsel through the interpreted path on the given worker thread.
+   Suboperator::PickMorselResult runInterpretedMorsel(size_t thread_id);
+   /// Run the hybrid execution loop of a single worker thread until the pipeline is done.
+   void runHybridWorker(size_t thread_id);
+   /// Run the work function for all worker thread ids. The calling thread becomes worker 0.
+   /// If the worker budget hands out fewer threads, every thread runs the work of multiple ids after another.
+   /// Exceptions of the workers are propagated to the caller.
+   void runWorkers(const std::function<void(size_t)>& work);
 
    /// Set up interpreted state in a synchronous way.
    void setUpInterpreted();
    /// Set up fused state in an asynchronous way.
    /// Returns a handle to a thread performing asynchronous compilation.
    std::thread setUpFusedAsync();
-   /// Clean up the fuse chunks for a new morsel.
-   void cleanUp();
+   /// Clean up the fuse chunks of a worker thread for a new morsel.
+   void cleanUp(size_t thread_id);
 
    /// Asynchronous state used for background compilation that may outlive this PipelineExecutor.
    struct AsyncCompileState {
-      AsyncCompileState(QueryControlBlockArc control_block_, Pipeline& pipe)
-         : context(pipe), control_block(std::move(control_block_)){};
+      AsyncCompileState(QueryControlBlockArc control_block_, Pipeline& pipe, size_t num_threads)
+         : context(pipe, num_threads), control_block(std::move(control_block_)){};
 
       /// Lock protecting shared state with the background thread doing async compilation.
       std::mutex compiled_lock;
@@ -102,6 +127,11 @@ struct PipelineExecutor {
       InterruptableJob interrupt;
       /// Was fused mode set up successfully? Atomic since this is done asynchronously.
       bool fused_set_up = false;
+      /// Was the C code generated? Code generation reads the suboperators, so a detached
+      /// compilation must not outlive the PipelineExecutor before it is done.
+      bool codegen_done = false;
+      /// Signals `codegen_done`.
+      std::condition_variable codegen_cv;
    };
 
    /// Shared compilation state with the background thread doing code generation.
@@ -112,6 +142,12 @@ struct PipelineExecutor {
    std::vector<PipelineRunnerPtr> interpreters;
    /// Backing execution mode.
    ExecutionMode mode;
+   /// Number of restarted interpreted primitives within the current `runPipeline`.
+   std::atomic<size_t> restarts = 0;
+   /// Number of worker threads running the pipeline.
+   size_t num_threads;
+   /// Budget of workers shared with concurrently running pipelines, nullptr if all workers can be used.
+   WorkerBudget* budget = nullptr;
    /// Potential full name of the generated program.
    std::string full_name;
    /// Was the pipeline set-up started for the interpreted mode?
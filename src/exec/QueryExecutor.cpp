@@ -1,11 +1,13 @@
 #include "exec/QueryExecutor.h"
+#include "exec/TaskScheduler.h"
 
 #include <list>
+#include <mutex>
 
 namespace inkfuse::QueryExecutor {
 
-StepwiseExecutor::StepwiseExecutor(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname)
-: control_block(std::move(control_block_)), mode(mode), qname(qname)
+StepwiseExecutor::StepwiseExecutor(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname, size_t num_threads)
+: control_block(std::move(control_block_)), mode(mode), qname(qname), num_threads(num_threads)
 {
 }
 
@@ -15,7 +17,7 @@ void StepwiseExecutor::prepareQuery()
    for (size_t idx = 0; idx < pipes.size(); ++idx) {
       // Step 2: Set up the executors for the pipelines.
       const auto& pipe = pipes[idx];
-      auto& executor = executors.emplace_back(*pipe, mode, qname + "_pipe_" + std::to_string(idx), control_block);
+      auto& executor = executors.emplace_back(*pipe, mode, qname + "_pipe_" + std::to_string(idx), control_block, num_threads);
       if (mode != PipelineExecutor::ExecutionMode::Interpreted) {
          // If we have to generate code, already kick off asynchronous compilation.
          // This hides compilation latency much better than kicking it off at the beginning of each pipeline.
@@ -27,18 +29,35 @@ void StepwiseExecutor::prepareQuery()
 PipelineExecutor::PipelineStats StepwiseExecutor::runQuery()
 {
    PipelineExecutor::PipelineStats total_stats;
+   std::mutex stats_lock;
+   // Step 2: Run the pipelines. Pipelines that don't depend on each other can run concurrently.
+   const auto dependencies = control_block->dag.getPipelineDependencies();
+   assert(dependencies.size() == executors.size());
+   // Both the scheduler and the pipelines run multiple workers. They share a single budget of threads:
+   // a running pipeline holds one worker, and borrows more of them only while they are free.
+   WorkerBudget budget(num_threads);
+   TaskScheduler scheduler(num_threads);
+   size_t idx = 0;
    for (auto& executor : executors) {
-      // Step 2: Run the pipelines.
-      const auto pipe_stats = executor.runPipeline();
-      total_stats.codegen_microseconds += pipe_stats.codegen_microseconds;
+      executor.setWorkerBudget(&budget);
+      scheduler.addTask([&executor, &budget, &total_stats, &stats_lock]() {
+         WorkerBudget::Guard own_worker(budget, budget.acquire(1, 1));
+         const auto pipe_stats = executor.runPipeline();
+         std::unique_lock lock(stats_lock);
+         total_stats.codegen_microseconds += pipe_stats.codegen_microseconds;
+         total_stats.restarts += pipe_stats.restarts;
+      }, dependencies[idx++]);
    }
+   scheduler.run();
+   // Multiple pipelines access the same tables. Report every table once, after all pipelines are done.
+   total_stats.hash_tables = control_block->dag.getHashTableStats();
    return total_stats;
 }
 
 
 
-PipelineExecutor::PipelineStats runQuery(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname) {
-   StepwiseExecutor executor(std::move(control_block_), mode, qname);
+PipelineExecutor::PipelineStats runQuery(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname, size_t num_threads) {
+   StepwiseExecutor executor(std::move(control_block_), mode, qname, num_threads);
    // Kick off preparation.
    executor.prepareQuery();
    // And instantly start execution - backend will wait if compilation is not done yet.
@@ -12,22 +12,27 @@ namespace QueryExecutor {
 /// Executor that allows pre-compiling the query (crudely). Needed to get clean perf counters
 /// for the evaluation.
 struct StepwiseExecutor {
-   StepwiseExecutor(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname);
+   StepwiseExecutor(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname, size_t num_threads = 1);
 
    /// Prepare the query, kicking off compilation.
    void prepareQuery();
    /// Run the query, perfoming the actual execution. Returns aggregated (summed) pipeline statistics.
+   /// Pipelines are scheduled as soon as the pipelines they depend on are done, independent pipelines
+   /// run concurrently on up to `num_threads` workers.
    PipelineExecutor::PipelineStats runQuery();
 
    private:
    PipelineExecutor::QueryControlBlockArc control_block;
    PipelineExecutor::ExecutionMode mode;
    const std::string& qname;
+   /// How many worker threads are used, both across and within pipelines.
+   size_t num_threads;
    std::list<PipelineExecutor> executors;
 };
 
 /// Run a complete query to completion. Returns aggregated (summed) pipeline statistics.
-PipelineExecutor::PipelineStats runQuery(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname = "query");
+/// Every pipeline is executed by up to `num_threads` worker threads.
+PipelineExecutor::PipelineStats runQuery(PipelineExecutor::QueryControlBlockArc control_block_, PipelineExecutor::ExecutionMode mode, const std::string& qname = "query", size_t num_threads = 1);
 
 };
 
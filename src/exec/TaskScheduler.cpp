@@ -0,0 +1,158 @@
+#include "exec/TaskScheduler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace inkfuse {
+
+WorkerBudget::WorkerBudget(size_t workers) : free(workers) {
+}
+
+size_t WorkerBudget::acquire(size_t min, size_t max) {
+   std::unique_lock guard(lock);
+   cv.wait(guard, [&]() { return free >= min; });
+   const size_t taken = std::min(free, max);
+   free -= taken;
+   return taken;
+}
+
+void WorkerBudget::release(size_t count) {
+   if (count == 0) {
+      return;
+   }
+   {
+      std::unique_lock guard(lock);
+      free += count;
+   }
+   cv.notify_all();
+}
+
+TaskScheduler::TaskScheduler(size_t num_workers_) : num_workers(std::max(num_workers_, size_t{1})) {
+}
+
+size_t TaskScheduler::addTask(Task task, const std::vector<size_t>& dependencies) {
+   const size_t task_id = nodes.size();
+   auto& node = nodes.emplace_back(std::make_unique<TaskNode>());
+   node->task = std::move(task);
+   for (size_t dependency : dependencies) {
+      if (dependency >= task_id) {
+         throw std::runtime_error("TaskScheduler tasks can only depend on previously added tasks");
+      }
+      nodes[dependency]->dependents.push_back(task_id);
+   }
+   node->open_dependencies = dependencies.size();
+   return task_id;
+}
+
+void TaskScheduler::run() {
+   queues.clear();
+   for (size_t worker_id = 0; worker_id < num_workers; ++worker_id) {
+      queues.push_back(std::make_unique<WorkerQueue>());
+   }
+   // Distribute the initially ready tasks across the workers. Workers take from the back of their queue,
+   // so we push to the front to run tasks with a lower id first.
+   size_t next_worker = 0;
+   for (size_t task_id = 0; task_id < nodes.size(); ++task_id) {
+      if (nodes[task_id]->open_dependencies == 0) {
+         queues[next_worker]->tasks.push_front(task_id);
+         next_worker = (next_worker + 1) % num_workers;
+         queued++;
+      }
+   }
+   if (!nodes.empty() && queued == 0) {
+      throw std::runtime_error("TaskScheduler needs at least one task without dependencies");
+   }
+
+   std::vector<std::thread> workers;
+   workers.reserve(num_workers - 1);
+   for (size_t worker_id = 1; worker_id < num_workers; ++worker_id) {
+      workers.emplace_back([this, worker_id]() { workerLoop(worker_id); });
+   }
+   // The calling thread participates as worker 0.
+   workerLoop(0);
+   for (auto& worker : workers) {
+      worker.join();
+   }
+   if (error) {
+      std::rethrow_exception(error);
+   }
+}
+
+void TaskScheduler::workerLoop(size_t worker_id) {
+   while (true) {
+      size_t task_id;
+      if (tryGetTask(worker_id, task_id)) {
+         {
+            // Don't start new tasks once a task failed.
+            std::unique_lock lock(idle_lock);
+            if (aborted) {
+               return;
+            }
+         }
+         try {
+            nodes[task_id]->task();
+         } catch (...) {
+            std::unique_lock lock(idle_lock);
+            if (!error) {
+               error = std::current_exception();
+            }
+            aborted = true;
+         }
+         finishTask(worker_id, task_id);
+      }
+      std::unique_lock lock(idle_lock);
+      // Wait until there is either more work to be done, or all work is done.
+      idle_cv.wait(lock, [&]() { return queued > 0 || finished == nodes.size() || aborted; });
+      if (finished == nodes.size() || aborted) {
+         return;
+      }
+   }
+}
+
+bool TaskScheduler::tryGetTask(size_t worker_id, size_t& task_id) {
+   {
+      // Take the most recently readied task from the own queue.
+      auto& own = *queues[worker_id];
+      std::unique_lock lock(own.lock);
+      if (!own.tasks.empty()) {
+         task_id = own.tasks.back();
+         own.tasks.pop_back();
+         queued--;
+         return true;
+      }
+   }
+   // Steal the oldest task from another worker.
+   for (size_t offset = 1; offset < num_workers; ++offset) {
+      auto& victim = *queues[(worker_id + offset) % num_workers];
+      std::unique_lock lock(victim.lock);
+      if (!victim.tasks.empty()) {
+         task_id = victim.tasks.front();
+         victim.tasks.pop_front();
+         queued--;
+         return true;
+      }
+   }
+   return false;
+}
+
+void TaskScheduler::finishTask(size_t worker_id, size_t task_id) {
+   const auto& dependents = nodes[task_id]->dependents;
+   {
+      auto& own = *queues[worker_id];
+      std::unique_lock lock(own.lock);
+      // Dependents are sorted by id. Push in reverse so that the lowest id gets picked first.
+      for (auto dependent = dependents.rbegin(); dependent != dependents.rend(); ++dependent) {
+         if (--nodes[*dependent]->open_dependencies == 0) {
+            own.tasks.push_back(*dependent);
+            queued++;
+         }
+      }
+   }
+   {
+      std::unique_lock lock(idle_lock);
+      finished++;
+   }
+   idle_cv.notify_all();
+}
+
+}
@@ -0,0 +1,118 @@
+#ifndef INKFUSE_TASKSCHEDULER_H
+#define INKFUSE_TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace inkfuse {
+
+/// Budget of worker threads shared by concurrently running pipelines. Every running pipeline holds
+/// at least one worker, additional workers are only handed out while they are free.
+/// This keeps the total number of threads of a query at the budget, even though both the
+/// TaskScheduler and every pipeline run multiple workers.
+struct WorkerBudget {
+   explicit WorkerBudget(size_t workers);
+
+   /// Take between `min` and `max` workers. Blocks until at least `min` workers are free.
+   /// @return the number of taken workers
+   size_t acquire(size_t min, size_t max);
+
+   /// Return previously taken workers.
+   void release(size_t count);
+
+   /// Returns the taken workers when it goes out of scope.
+   struct Guard {
+      Guard(WorkerBudget& budget_, size_t count_) : budget(budget_), count(count_) {}
+      ~Guard() { budget.release(count); }
+
+      WorkerBudget& budget;
+      size_t count;
+   };
+
+   private:
+   std::mutex lock;
+   std::condition_variable cv;
+   /// Number of workers which are not taken.
+   size_t free;
+};
+
+/// The TaskScheduler runs a DAG of tasks on a pool of worker threads.
+/// A task becomes ready once all tasks it depends on are finished.
+///
+/// Scheduling is done through work stealing: every worker owns a deque of ready tasks.
+/// Tasks which become ready when a worker finishes a task are pushed onto the deque of that worker.
+/// A worker takes tasks from the back of its own deque, and steals from the front of the
+/// deques of other workers once it runs out of work.
+///
+/// This is used to run independent pipelines of a query (e.g. the build sides of different joins)
+/// concurrently.
+struct TaskScheduler {
+   using Task = std::function<void()>;
+
+   /// Create a new scheduler with the given number of workers. The thread calling `run` is one of the workers.
+   explicit TaskScheduler(size_t num_workers_);
+
+   /// Add a new task to the scheduler.
+   /// @param task the work to run
+   /// @param dependencies ids of previously added tasks which have to be finished before this task can start
+   /// @return the id of the task
+   size_t addTask(Task task, const std::vector<size_t>& dependencies = {});
+
+   /// Run all tasks to completion. If a task throws, no further tasks are started and
+   /// the first exception is re-thrown once all in-flight tasks are done.
+   void run();
+
+   private:
+   /// A task within the DAG.
+   struct TaskNode {
+      /// The work to run.
+      Task task;
+      /// Number of dependencies which are not finished yet.
+      std::atomic<size_t> open_dependencies = 0;
+      /// Tasks which depend on this task.
+      std::vector<size_t> dependents;
+   };
+
+   /// Deque of ready tasks owned by a single worker.
+   struct WorkerQueue {
+      std::mutex lock;
+      std::deque<size_t> tasks;
+   };
+
+   /// Main loop of a worker.
+   void workerLoop(size_t worker_id);
+   /// Try to get a ready task, first from the own queue, then by stealing from other workers.
+   bool tryGetTask(size_t worker_id, size_t& task_id);
+   /// Mark the task as finished and make its dependents ready.
+   void finishTask(size_t worker_id, size_t task_id);
+
+   /// The tasks, stable in memory as the atomics cannot be moved.
+   std::vector<std::unique_ptr<TaskNode>> nodes;
+   /// The ready queues of the workers.
+   std::vector<std::unique_ptr<WorkerQueue>> queues;
+   /// Number of workers.
+   size_t num_workers;
+
+   /// Lock protecting the idle state of the workers.
+   std::mutex idle_lock;
+   /// Condition variable on which idle workers wait for new tasks.
+   std::condition_variable idle_cv;
+   /// Number of finished tasks.
+   size_t finished = 0;
+   /// Was execution aborted because a task threw?
+   bool aborted = false;
+   /// Number of tasks that were pushed into the queues and not picked up yet.
+   std::atomic<size_t> queued = 0;
+   /// First exception raised by a task.
+   std::exception_ptr error;
+};
+
+}
+
+#endif //INKFUSE_TASKSCHEDULER_H
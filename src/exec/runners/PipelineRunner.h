@@ -3,6 +3,7 @@
 
 #include "algebra/Pipeline.h"
 #include "exec/ExecutionContext.h"
+#include <functional>
 #include <string>
 #include <vector>
 #include <memory>
@@ -26,13 +27,15 @@ struct PipelineRunner {
 
    /// Run a single morsel of the backing pipeline.
    /// @param force_pick should we always pick, even if we are not a fuse chunk source?
+   /// @param thread_id the worker thread running the morsel
+   /// @param on_pick optional callback invoked with the picked morsel before the primitive runs
    /// @return result of picking a morsel.
-   Suboperator::PickMorselResult runMorsel(bool force_pick);
+   Suboperator::PickMorselResult runMorsel(bool force_pick, size_t thread_id = 0, const std::function<void(const Suboperator::PickedMorsel&)>& on_pick = {});
 
    /// Clean up the intermediate morsel state from a previous failure.
    /// Purges the morsel size of the sinks to make sure we get a fresh
    /// column to write into.
-   void prepareForRerun();
+   void prepareForRerun(size_t thread_id = 0);
 
    /// Set up the state for the given pipeline.
    /// @param compiled_hybrid are we setting up state as the compiled backend in hybird mode?
@@ -42,8 +45,8 @@ struct PipelineRunner {
    /// The compiled function. Either a fragment received from the backing cache,
    /// or a new function.
    std::function<uint8_t(void**)> fct;
-   /// Operator states for this specific pipeline.
-   std::vector<void*> states;
+   /// Operator states for this specific pipeline, one set for every worker thread.
+   std::vector<std::vector<void*>> states;
    /// The backing pipeline.
    PipelinePtr pipe;
    /// The recontextualized execution context.
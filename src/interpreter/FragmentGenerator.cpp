@@ -6,6 +6,7 @@
 #include "interpreter/CountingSinkFragmentizer.h"
 #include "interpreter/ExpressionFragmentizer.h"
 #include "interpreter/HashTableSourceFragmentizer.h"
+#include "interpreter/JoinRowsSourceFragmentizer.h"
 #include "interpreter/RuntimeExpressionFragmentizer.h"
 #include "interpreter/RuntimeFunctionSubopFragmentizer.h"
 #include "interpreter/RuntimeKeyExpressionFragmentizer.h"
@@ -95,6 +96,7 @@ IR::ProgramArc FragmentGenerator::build() {
    fragmentizers.push_back(std::make_unique<CopyFragmentizer>());
    fragmentizers.push_back(std::make_unique<ExpressionFragmentizer>());
    fragmentizers.push_back(std::make_unique<HashTableSourceFragmentizer>());
+   fragmentizers.push_back(std::make_unique<JoinRowsSourceFragmentizer>());
    fragmentizers.push_back(std::make_unique<RuntimeExpressionFragmentizer>());
    fragmentizers.push_back(std::make_unique<RuntimeKeyExpressionFragmentizer>());
    fragmentizers.push_back(std::make_unique<KeyPackingFragmentizer>());
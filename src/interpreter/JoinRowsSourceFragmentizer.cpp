@@ -0,0 +1,17 @@
+#include "interpreter/JoinRowsSourceFragmentizer.h"
+#include "algebra/suboperators/sources/JoinRowsSource.h"
+
+namespace inkfuse {
+
+JoinRowsSourceFragmentizer::JoinRowsSourceFragmentizer() {
+   // Joined rows are always pointers to packed rows.
+   auto& [name, pipe] = pipes.emplace_back();
+   auto& op = pipe.attachSuboperator(JoinRowsDriver::build(nullptr));
+   const auto& driver_iu = **op.getIUs().begin();
+   auto& provider_iu = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()), "");
+   auto& iu_op = pipe.attachSuboperator(JoinRowsIUProvider::build(nullptr, driver_iu, provider_iu));
+   // The fragment is uniquely identified by the id of the provider.
+   name = iu_op.id();
+}
+
+}
@@ -0,0 +1,14 @@
+#ifndef INKFUSE_JOINROWSSOURCEFRAGMENTIZER_H
+#define INKFUSE_JOINROWSSOURCEFRAGMENTIZER_H
+
+#include "interpreter/FragmentGenerator.h"
+
+namespace inkfuse {
+
+struct JoinRowsSourceFragmentizer : public Fragmentizer {
+   JoinRowsSourceFragmentizer();
+};
+
+}
+
+#endif //INKFUSE_JOINROWSSOURCEFRAGMENTIZER_H
@@ -1,5 +1,7 @@
 #include "interpreter/RuntimeFunctionSubopFragmentizer.h"
 #include "algebra/suboperators/RuntimeFunctionSubop.h"
+#include "runtime/JoinHashTables.h"
+#include "runtime/PartitionedHashTables.h"
 
 namespace inkfuse {
 
@@ -77,7 +79,223 @@ RuntimeFunctionSubopFragmentizer::RuntimeFunctionSubopFragmentizer() {
             name = op.id();
          }
       }
+
+      // Fragmentize hashing with prefetching, followed by the operations on the precomputed hash.
+      // As separate primitives, all slots of a chunk are prefetched before the first one is resolved.
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htHashPrefetch<HashTableSimpleKey>(nullptr, hash, key, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupWithHash<HashTableSimpleKey>(nullptr, result_ptr, key, hash, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupDisableWithHash(nullptr, result_ptr, key, hash, {}));
+         name = op.id();
+      }
+      // The array index on dense join keys splits its lookups the same way.
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htHashPrefetch<ArrayJoinIndex>(nullptr, hash, key, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupWithHash<ArrayJoinIndex>(nullptr, result_ptr, key, hash, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupDisableWithHash<ArrayJoinIndex>(nullptr, result_ptr, key, hash, {}));
+         name = op.id();
+      }
+      for (const auto& out_type : out_types) {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const IU* out_iu = nullptr;
+         if (out_type) {
+            out_iu = &generated_ius.emplace_back(out_type);
+         }
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsertWithHash<HashTableSimpleKey>(nullptr, out_iu, key, hash, {}));
+         name = op.id();
+      }
+
+      // Fragmentize the Bloom filter check of join probes.
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& result = generated_ius.emplace_back(IR::Bool::build());
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::bloomFilterContains(nullptr, result, key));
+         name = op.id();
+      }
+
+      // Fragmentize the append of n:m join build rows.
+      for (const auto& out_type : out_types) {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const IU* out_iu = nullptr;
+         if (out_type) {
+            out_iu = &generated_ius.emplace_back(out_type);
+         }
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::nmJoinAppend(nullptr, out_iu, key, {}));
+         name = op.id();
+      }
+
+      // Fragmentize the build and probe side of hybrid hash joins.
+      for (const auto& out_type : out_types) {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const IU* out_iu = nullptr;
+         if (out_type) {
+            out_iu = &generated_ius.emplace_back(out_type);
+         }
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::hybridJoinAppend(nullptr, out_iu, key, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& row = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::hybridJoinProbe(nullptr, row, hash, {}));
+         name = op.id();
+      }
+
+      // Fragmentize the build and probe side of radix-partitioned hash joins.
+      for (const auto& out_type : out_types) {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const IU* out_iu = nullptr;
+         if (out_type) {
+            out_iu = &generated_ius.emplace_back(out_type);
+         }
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::radixJoinAppend(nullptr, out_iu, key, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& row = generated_ius.emplace_back(in_type);
+         const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::radixJoinProbe(nullptr, row, hash, {}));
+         name = op.id();
+      }
+
+      // Fragmentize lookup with insert on the thread-local tables of a parallel aggregation.
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(in_type);
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         // No pseudo-IU inputs, these only matter for more complex DAGs.
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<PartitionedHashTable<HashTableSimpleKey>>(nullptr, &result_ptr, key, {}));
+         name = op.id();
+      }
    }
+   // Fragmentize the hot hash table paths specialized on fixed key widths. Unpacked keys
+   // can only use them if their type has the right width.
+   for (const auto& in_type : in_types) {
+      const bool packed = in_type->id() == "ByteArray" || in_type->id() == "Ptr_Char";
+      for (const uint16_t width : fixed_key_widths) {
+         if (!packed && in_type->numBytes() != width) {
+            continue;
+         }
+         dispatchKeyWidth(width, [&](auto key_width) {
+            using SimpleTable = KeyWidthSpecialized<HashTableSimpleKey, key_width>;
+            using PartitionedTable = KeyWidthSpecialized<PartitionedHashTable<HashTableSimpleKey>, key_width>;
+            {
+               auto& [name, pipe] = pipes.emplace_back();
+               const auto& key = generated_ius.emplace_back(in_type);
+               const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+               const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookup<SimpleTable>(nullptr, result_ptr, key, {}));
+               name = op.id();
+            }
+            {
+               auto& [name, pipe] = pipes.emplace_back();
+               const auto& key = generated_ius.emplace_back(in_type);
+               const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+               const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htHashPrefetch<SimpleTable>(nullptr, hash, key, {}));
+               name = op.id();
+            }
+            {
+               auto& [name, pipe] = pipes.emplace_back();
+               const auto& key = generated_ius.emplace_back(in_type);
+               const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+               const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+               const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupWithHash<SimpleTable>(nullptr, result_ptr, key, hash, {}));
+               name = op.id();
+            }
+            for (const auto& out_type : out_types) {
+               {
+                  auto& [name, pipe] = pipes.emplace_back();
+                  const auto& key = generated_ius.emplace_back(in_type);
+                  const IU* out_iu = nullptr;
+                  if (out_type) {
+                     out_iu = &generated_ius.emplace_back(out_type);
+                  }
+                  const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<SimpleTable>(nullptr, out_iu, key, {}));
+                  name = op.id();
+               }
+               {
+                  auto& [name, pipe] = pipes.emplace_back();
+                  const auto& key = generated_ius.emplace_back(in_type);
+                  const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+                  const IU* out_iu = nullptr;
+                  if (out_type) {
+                     out_iu = &generated_ius.emplace_back(out_type);
+                  }
+                  const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsertWithHash<SimpleTable>(nullptr, out_iu, key, hash, {}));
+                  name = op.id();
+               }
+            }
+            {
+               auto& [name, pipe] = pipes.emplace_back();
+               const auto& key = generated_ius.emplace_back(in_type);
+               const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+               const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<PartitionedTable>(nullptr, &result_ptr, key, {}));
+               name = op.id();
+            }
+            if constexpr (key_width == 4 || key_width == 8) {
+               // Single integer keys of the array index.
+               using ArrayIndex = KeyWidthSpecialized<ArrayJoinIndex, key_width>;
+               {
+                  auto& [name, pipe] = pipes.emplace_back();
+                  const auto& key = generated_ius.emplace_back(in_type);
+                  const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+                  const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htHashPrefetch<ArrayIndex>(nullptr, hash, key, {}));
+                  name = op.id();
+               }
+               {
+                  auto& [name, pipe] = pipes.emplace_back();
+                  const auto& key = generated_ius.emplace_back(in_type);
+                  const auto& hash = generated_ius.emplace_back(IR::UnsignedInt::build(8));
+                  const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+                  const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupWithHash<ArrayIndex>(nullptr, result_ptr, key, hash, {}));
+                  name = op.id();
+               }
+            }
+         });
+      }
+   }
+
    // Fragmentize no-key hash table lookup/insert. Does not care about
    // input types at all. The input IU just makes connecting the DAG easier.
    // We still create a 1-byte input type as that's the only thing that really lets
@@ -90,6 +308,21 @@ RuntimeFunctionSubopFragmentizer::RuntimeFunctionSubopFragmentizer() {
       name = op.id();
    }
 
+   // Fragmentize remembering the matches of n:m join probes.
+   {
+      auto& [name, pipe] = pipes.emplace_back();
+      const auto& probe_row = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+      const auto& slot = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+      const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::nmJoinAddMatch(nullptr, &probe_row, slot));
+      name = op.id();
+   }
+   {
+      auto& [name, pipe] = pipes.emplace_back();
+      const auto& slot = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+      const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::nmJoinAddMatch(nullptr, nullptr, slot));
+      name = op.id();
+   }
+
    // Fragmentize string insert on the complex hash table.
    {
       auto& [name, pipe] = pipes.emplace_back();
@@ -109,6 +342,31 @@ RuntimeFunctionSubopFragmentizer::RuntimeFunctionSubopFragmentizer() {
       const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<HashTableComplexKey>(nullptr, &result_ptr, key, {}));
       name = op.id();
    }
+   {
+      auto& [name, pipe] = pipes.emplace_back();
+      const auto& key = generated_ius.emplace_back(IR::String::build());
+      const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+      // No pseudo-IU inputs, these only matter for more complex DAGs.
+      const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<PartitionedHashTable<HashTableComplexKey>>(nullptr, &result_ptr, key, {}));
+      name = op.id();
+   }
+   // Fragmentize packed keys mixing strings with other columns on the complex hash tables.
+   for (const auto& packed_type : TypeDecorator().attachPackedKeyTypes().produce()) {
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(packed_type);
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookup<HashTableComplexKey>(nullptr, result_ptr, key, {}));
+         name = op.id();
+      }
+      {
+         auto& [name, pipe] = pipes.emplace_back();
+         const auto& key = generated_ius.emplace_back(packed_type);
+         const auto& result_ptr = generated_ius.emplace_back(IR::Pointer::build(IR::Char::build()));
+         const auto& op = pipe.attachSuboperator(RuntimeFunctionSubop::htLookupOrInsert<PartitionedHashTable<HashTableComplexKey>>(nullptr, &result_ptr, key, {}));
+         name = op.id();
+      }
+   }
 }
 
 }
\ No newline at end of file
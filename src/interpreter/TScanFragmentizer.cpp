@@ -11,6 +11,15 @@ const std::vector<IR::TypeArc> types =
       .attachTypes()
       .attachStringType()
       .produce();
+
+// Compressed scans decode into integers and dates that are wider than their deltas.
+const std::vector<IR::TypeArc> decoded_types = []() {
+   auto result = TypeDecorator().attachIntegers().produce();
+   result.push_back(IR::Date::build());
+   return result;
+}();
+
+const std::vector<IR::TypeArc> delta_types = {IR::UnsignedInt::build(1), IR::UnsignedInt::build(2), IR::UnsignedInt::build(4)};
 }
 
 TScanFragmetizer::TScanFragmetizer() {
@@ -24,6 +33,20 @@ TScanFragmetizer::TScanFragmetizer() {
       // The table scan is uniquely identified by the id of the provider.
       name = iu_op.id();
    }
+   for (auto& type : decoded_types) {
+      for (auto& delta_type : delta_types) {
+         if (delta_type->numBytes() >= type->numBytes()) {
+            continue;
+         }
+         // Decoding scans replace the plain IU provider behind the loop driver.
+         auto& [name, pipe] = pipes.emplace_back();
+         auto& op = pipe.attachSuboperator(TScanDriver::build(nullptr));
+         const auto& driver_iu = **op.getIUs().begin();
+         auto& provider_iu = generated_ius.emplace_back(type, "");
+         auto& iu_op = pipe.attachSuboperator(TScanDecodeIUProvider::build(nullptr, driver_iu, provider_iu, delta_type));
+         name = iu_op.id();
+      }
+   }
 }
 
 }
\ No newline at end of file
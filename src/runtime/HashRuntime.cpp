@@ -1,19 +1,22 @@
 #include "runtime/HashRuntime.h"
 #include "runtime/Runtime.h"
-#include "xxhash.h"
 
 namespace inkfuse {
 
 extern "C" uint64_t hash(void* in, uint64_t len) {
-   return XXH3_64bits(in, len);
+   return HashRuntime::hashKey(in, len);
 }
 
 extern "C" uint64_t hash4(void* in) {
-   return XXH3_64bits(in, 4);
+   return HashRuntime::hashFixed4(in);
 }
 
 extern "C" uint64_t hash8(void* in) {
-   return XXH3_64bits(in, 8);
+   return HashRuntime::hashFixed8(in);
+}
+
+extern "C" uint64_t hash16(void* in) {
+   return HashRuntime::hashFixed16(in);
 }
 
 void HashRuntime::registerRuntime() {
@@ -26,5 +29,8 @@ void HashRuntime::registerRuntime() {
 
    RuntimeFunctionBuilder("hash8", IR::UnsignedInt::build(8))
       .addArg("in", IR::Pointer::build(IR::Void::build()), true);
+
+   RuntimeFunctionBuilder("hash16", IR::UnsignedInt::build(8))
+      .addArg("in", IR::Pointer::build(IR::Void::build()), true);
+}
 }
-}
\ No newline at end of file
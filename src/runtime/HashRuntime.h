@@ -3,28 +3,69 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include "xxhash.h"
 namespace inkfuse {
 
-/// Hash runtime allowing generated code to hash values. We currently
-/// use xxhash as hash function.
-/// There are two ways we could go for this, and it's not 100% clear what is better:
-/// 1. Include xxhash directly in the generated code. This way it can make use of inline hints etc.
-/// 2. Link xxhash statically into inkfuse and expose it through the inkfuse runtime.
-/// The second option makes it a lot easier to ship inkfuse binaries, and we are going with
-/// it for now until it becomes a performance bottleneck.
-/// (Also note that the include-style option (1) only works nicely in a world where we generate C).
-/// TODO Narrower types should use narrower hashes, but fine for now. No point to compute 64 bit hashes on 32 bit data.
+/// Hash runtime allowing generated code to hash values.
+/// Keys of 4, 8 and 16 bytes are hashed with width-specialized multiply-xorshift
+/// finalizers. They are cheap enough that a function call into the runtime would
+/// dominate their cost. The C backend therefore emits the same functions as static
+/// inline code into every generated program (see BackendC::createPreamble), which
+/// lets the compiler inline and vectorize them within the hashing loops over a chunk.
+/// All other widths use xxhash, linked statically into inkfuse and exposed through the runtime.
 namespace HashRuntime {
 
 extern "C" uint64_t hash(void* in, uint64_t len);
 extern "C" uint64_t hash4(void* in);
 extern "C" uint64_t hash8(void* in);
+extern "C" uint64_t hash16(void* in);
 
 void registerRuntime();
 
+/// Finalizer of MurmurHash3. Every input bit affects every output bit.
+inline uint64_t fmix(uint64_t k) {
+   k ^= k >> 33;
+   k *= 0xff51afd7ed558ccdull;
+   k ^= k >> 33;
+   k *= 0xc4ceb9fe1a85ec53ull;
+   k ^= k >> 33;
+   return k;
 }
 
+inline uint64_t hashFixed4(const void* in) {
+   uint32_t v;
+   std::memcpy(&v, in, 4);
+   return fmix(v);
+}
+
+inline uint64_t hashFixed8(const void* in) {
+   uint64_t v;
+   std::memcpy(&v, in, 8);
+   return fmix(v);
+}
+
+inline uint64_t hashFixed16(const void* in) {
+   uint64_t v[2];
+   std::memcpy(v, in, 16);
+   return fmix(v[0] ^ (fmix(v[1]) + 0x9e3779b97f4a7c15ull));
+}
+
+/// Hash a key of the given width. Has to agree with the hashes computed by generated code.
+inline uint64_t hashKey(const void* in, size_t len) {
+   switch (len) {
+      case 4:
+         return hashFixed4(in);
+      case 8:
+         return hashFixed8(in);
+      case 16:
+         return hashFixed16(in);
+      default:
+         return XXH3_64bits(in, len);
+   }
+}
+
+}
 
 }
 
@@ -1,5 +1,9 @@
 #include "runtime/HashTableRuntime.h"
 #include "runtime/HashTables.h"
+#include "runtime/HybridHashJoin.h"
+#include "runtime/JoinHashTables.h"
+#include "runtime/PartitionedHashTables.h"
+#include "runtime/RadixHashJoin.h"
 #include "runtime/Runtime.h"
 
 namespace inkfuse {
@@ -28,6 +32,144 @@ extern "C" void HashTableRuntime::ht_sk_it_advance(void* table, char** it_data,
    reinterpret_cast<HashTableSimpleKey*>(table)->iteratorAdvance(it_data, it_idx);
 }
 
+extern "C" uint64_t HashTableRuntime::ht_sk_hash_prefetch(void* table, char* key) {
+   const auto& ht = *reinterpret_cast<HashTableSimpleKey*>(table);
+   const uint64_t hash = ht.hash(key);
+   ht.prefetch(hash);
+   return hash;
+}
+
+extern "C" char* HashTableRuntime::ht_sk_lookup_with_hash(void* table, char* key, uint64_t hash) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookup(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_sk_lookup_disable_with_hash(void* table, char* key, uint64_t hash) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupDisable(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_sk_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash) {
+   char* result;
+   bool is_new_key;
+   reinterpret_cast<HashTableSimpleKey*>(table)->lookupOrInsert(&result, &is_new_key, key, hash);
+   return result;
+}
+
+namespace {
+
+template <uint16_t key_width>
+uint64_t hashPrefetchFixed(void* table, char* key) {
+   const auto& ht = *reinterpret_cast<HashTableSimpleKey*>(table);
+   const uint64_t hash = HashTableSimpleKey::hashFixed<key_width>(key);
+   ht.prefetch(hash);
+   return hash;
+}
+
+template <uint16_t key_width>
+char* lookupOrInsertFixed(void* table, char* key, uint64_t hash) {
+   char* result;
+   bool is_new_key;
+   reinterpret_cast<HashTableSimpleKey*>(table)->lookupOrInsertFixed<key_width>(&result, &is_new_key, key, hash);
+   return result;
+}
+
+}
+
+extern "C" uint64_t HashTableRuntime::ht_sk4_hash_prefetch(void* table, char* key) {
+   return hashPrefetchFixed<4>(table, key);
+}
+
+extern "C" char* HashTableRuntime::ht_sk4_lookup(void* table, char* key) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<4>(key, HashTableSimpleKey::hashFixed<4>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk4_lookup_with_hash(void* table, char* key, uint64_t hash) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<4>(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_sk4_lookup_or_insert(void* table, char* key) {
+   return lookupOrInsertFixed<4>(table, key, HashTableSimpleKey::hashFixed<4>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk4_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash) {
+   return lookupOrInsertFixed<4>(table, key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_psk4_lookup_or_insert(void* table, char* key) {
+   return reinterpret_cast<PartitionedHashTable<HashTableSimpleKey>*>(table)->lookupOrInsertFixed<4>(key);
+}
+
+extern "C" uint64_t HashTableRuntime::ht_sk8_hash_prefetch(void* table, char* key) {
+   return hashPrefetchFixed<8>(table, key);
+}
+
+extern "C" char* HashTableRuntime::ht_sk8_lookup(void* table, char* key) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<8>(key, HashTableSimpleKey::hashFixed<8>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk8_lookup_with_hash(void* table, char* key, uint64_t hash) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<8>(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_sk8_lookup_or_insert(void* table, char* key) {
+   return lookupOrInsertFixed<8>(table, key, HashTableSimpleKey::hashFixed<8>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk8_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash) {
+   return lookupOrInsertFixed<8>(table, key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_psk8_lookup_or_insert(void* table, char* key) {
+   return reinterpret_cast<PartitionedHashTable<HashTableSimpleKey>*>(table)->lookupOrInsertFixed<8>(key);
+}
+
+extern "C" uint64_t HashTableRuntime::ht_sk12_hash_prefetch(void* table, char* key) {
+   return hashPrefetchFixed<12>(table, key);
+}
+
+extern "C" char* HashTableRuntime::ht_sk12_lookup(void* table, char* key) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<12>(key, HashTableSimpleKey::hashFixed<12>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk12_lookup_with_hash(void* table, char* key, uint64_t hash) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<12>(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_sk12_lookup_or_insert(void* table, char* key) {
+   return lookupOrInsertFixed<12>(table, key, HashTableSimpleKey::hashFixed<12>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk12_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash) {
+   return lookupOrInsertFixed<12>(table, key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_psk12_lookup_or_insert(void* table, char* key) {
+   return reinterpret_cast<PartitionedHashTable<HashTableSimpleKey>*>(table)->lookupOrInsertFixed<12>(key);
+}
+
+extern "C" uint64_t HashTableRuntime::ht_sk16_hash_prefetch(void* table, char* key) {
+   return hashPrefetchFixed<16>(table, key);
+}
+
+extern "C" char* HashTableRuntime::ht_sk16_lookup(void* table, char* key) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<16>(key, HashTableSimpleKey::hashFixed<16>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk16_lookup_with_hash(void* table, char* key, uint64_t hash) {
+   return reinterpret_cast<HashTableSimpleKey*>(table)->lookupFixed<16>(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_sk16_lookup_or_insert(void* table, char* key) {
+   return lookupOrInsertFixed<16>(table, key, HashTableSimpleKey::hashFixed<16>(key));
+}
+
+extern "C" char* HashTableRuntime::ht_sk16_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash) {
+   return lookupOrInsertFixed<16>(table, key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_psk16_lookup_or_insert(void* table, char* key) {
+   return reinterpret_cast<PartitionedHashTable<HashTableSimpleKey>*>(table)->lookupOrInsertFixed<16>(key);
+}
+
 extern "C" char* HashTableRuntime::ht_nk_lookup(void* table) {
    return reinterpret_cast<HashTableSimpleKey*>(table)->lookupOrInsertSingleKey();
 }
@@ -56,6 +198,74 @@ extern "C" void HashTableRuntime::ht_dl_it_advance(void* table, char** it_data,
    reinterpret_cast<HashTableDirectLookup*>(table)->iteratorAdvance(it_data, it_idx);
 }
 
+extern "C" uint64_t HashTableRuntime::ht_aj_hash_prefetch(void* index, char* key) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->hashPrefetch(key);
+}
+
+extern "C" char* HashTableRuntime::ht_aj_lookup_with_hash(void* index, char* key, uint64_t hash) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->lookup(key, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_aj_lookup_disable_with_hash(void* index, char* key, uint64_t hash) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->lookupDisable(key, hash);
+}
+
+extern "C" uint64_t HashTableRuntime::ht_aj4_hash_prefetch(void* index, char* key) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->hashPrefetch<4>(key);
+}
+
+extern "C" char* HashTableRuntime::ht_aj4_lookup_with_hash(void* index, char* key, uint64_t hash) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->lookup<4>(key, hash);
+}
+
+extern "C" uint64_t HashTableRuntime::ht_aj8_hash_prefetch(void* index, char* key) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->hashPrefetch<8>(key);
+}
+
+extern "C" char* HashTableRuntime::ht_aj8_lookup_with_hash(void* index, char* key, uint64_t hash) {
+   return reinterpret_cast<ArrayJoinIndex*>(index)->lookup<8>(key, hash);
+}
+
+extern "C" bool HashTableRuntime::bf_contains(void* filter, char* key) {
+   return reinterpret_cast<BloomFilter*>(filter)->containsKey(key);
+}
+
+extern "C" char* HashTableRuntime::nm_join_append(void* rows, char* key) {
+   return reinterpret_cast<NMJoinHashTable::ThreadRows*>(rows)->append(key);
+}
+
+extern "C" void HashTableRuntime::nm_join_add_match(void* matches, char* probe_row, char* slot) {
+   NMJoinMatches::addMatch(*reinterpret_cast<RowBuffer*>(matches), probe_row, slot);
+}
+
+extern "C" void HashTableRuntime::nm_join_add_slot(void* matches, char* slot) {
+   NMJoinMatches::addMatch(*reinterpret_cast<RowBuffer*>(matches), nullptr, slot);
+}
+
+extern "C" char* HashTableRuntime::hj_append(void* build, char* key) {
+   return reinterpret_cast<HybridHashJoin::ThreadBuild*>(build)->append(key);
+}
+
+extern "C" void HashTableRuntime::hj_probe(void* probe, char* row, uint64_t hash) {
+   reinterpret_cast<HybridHashJoin::ThreadProbe*>(probe)->probe(row, hash);
+}
+
+extern "C" char* HashTableRuntime::rj_append(void* build, char* key) {
+   return reinterpret_cast<RadixHashJoin::ThreadBuild*>(build)->append(key);
+}
+
+extern "C" void HashTableRuntime::rj_probe(void* probe, char* row, uint64_t hash) {
+   reinterpret_cast<RadixHashJoin::ThreadProbe*>(probe)->probe(row, hash);
+}
+
+extern "C" char* HashTableRuntime::ht_psk_lookup_or_insert(void* table, char* key) {
+   return reinterpret_cast<PartitionedHashTable<HashTableSimpleKey>*>(table)->lookupOrInsert(key);
+}
+
+extern "C" char* HashTableRuntime::ht_pck_lookup_or_insert(void* table, char* key) {
+   return reinterpret_cast<PartitionedHashTable<HashTableComplexKey>*>(table)->lookupOrInsert(key);
+}
+
 void HashTableRuntime::registerRuntime() {
    RuntimeFunctionBuilder("ht_sk_insert", IR::Pointer::build(IR::Char::build()))
       .addArg("table", IR::Pointer::build(IR::Void::build()))
@@ -84,6 +294,54 @@ void HashTableRuntime::registerRuntime() {
       .addArg("it_data", IR::Pointer::build(IR::Pointer::build(IR::Char::build())))
       .addArg("it_idx", IR::Pointer::build(IR::UnsignedInt::build(8)));
 
+   RuntimeFunctionBuilder("ht_sk_hash_prefetch", IR::UnsignedInt::build(8))
+      .addArg("table", IR::Pointer::build(IR::Void::build()), true)
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("ht_sk_lookup_with_hash", IR::Pointer::build(IR::Char::build()))
+      .addArg("table", IR::Pointer::build(IR::Void::build()), true)
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("hash", IR::UnsignedInt::build(8));
+
+   RuntimeFunctionBuilder("ht_sk_lookup_disable_with_hash", IR::Pointer::build(IR::Char::build()))
+      .addArg("table", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("hash", IR::UnsignedInt::build(8));
+
+   RuntimeFunctionBuilder("ht_sk_lookup_or_insert_with_hash", IR::Pointer::build(IR::Char::build()))
+      .addArg("table", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("hash", IR::UnsignedInt::build(8));
+
+   for (const uint16_t width : fixed_key_widths) {
+      const std::string sk = "ht_sk" + std::to_string(width);
+      RuntimeFunctionBuilder(sk + "_hash_prefetch", IR::UnsignedInt::build(8))
+         .addArg("table", IR::Pointer::build(IR::Void::build()), true)
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+      RuntimeFunctionBuilder(sk + "_lookup", IR::Pointer::build(IR::Char::build()))
+         .addArg("table", IR::Pointer::build(IR::Void::build()), true)
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+      RuntimeFunctionBuilder(sk + "_lookup_with_hash", IR::Pointer::build(IR::Char::build()))
+         .addArg("table", IR::Pointer::build(IR::Void::build()), true)
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+         .addArg("hash", IR::UnsignedInt::build(8));
+
+      RuntimeFunctionBuilder(sk + "_lookup_or_insert", IR::Pointer::build(IR::Char::build()))
+         .addArg("table", IR::Pointer::build(IR::Void::build()))
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+      RuntimeFunctionBuilder(sk + "_lookup_or_insert_with_hash", IR::Pointer::build(IR::Char::build()))
+         .addArg("table", IR::Pointer::build(IR::Void::build()))
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+         .addArg("hash", IR::UnsignedInt::build(8));
+
+      RuntimeFunctionBuilder("ht_psk" + std::to_string(width) + "_lookup_or_insert", IR::Pointer::build(IR::Char::build()))
+         .addArg("table", IR::Pointer::build(IR::Void::build()))
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+   }
+
    RuntimeFunctionBuilder("ht_nk_lookup", IR::Pointer::build(IR::Char::build()))
       .addArg("table", IR::Pointer::build(IR::Void::build()), true);
 
@@ -112,6 +370,65 @@ void HashTableRuntime::registerRuntime() {
       .addArg("table", IR::Pointer::build(IR::Void::build()), true)
       .addArg("it_data", IR::Pointer::build(IR::Pointer::build(IR::Char::build())))
       .addArg("it_idx", IR::Pointer::build(IR::UnsignedInt::build(8)));
+
+   for (const std::string aj : {"ht_aj", "ht_aj4", "ht_aj8"}) {
+      RuntimeFunctionBuilder(aj + "_hash_prefetch", IR::UnsignedInt::build(8))
+         .addArg("index", IR::Pointer::build(IR::Void::build()), true)
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+      RuntimeFunctionBuilder(aj + "_lookup_with_hash", IR::Pointer::build(IR::Char::build()))
+         .addArg("index", IR::Pointer::build(IR::Void::build()), true)
+         .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+         .addArg("hash", IR::UnsignedInt::build(8));
+   }
+
+   RuntimeFunctionBuilder("ht_aj_lookup_disable_with_hash", IR::Pointer::build(IR::Char::build()))
+      .addArg("index", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("hash", IR::UnsignedInt::build(8));
+
+   RuntimeFunctionBuilder("bf_contains", IR::Bool::build())
+      .addArg("filter", IR::Pointer::build(IR::Void::build()), true)
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("nm_join_append", IR::Pointer::build(IR::Char::build()))
+      .addArg("rows", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("nm_join_add_match", IR::Void::build())
+      .addArg("matches", IR::Pointer::build(IR::Void::build()))
+      .addArg("probe_row", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("slot", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("nm_join_add_slot", IR::Void::build())
+      .addArg("matches", IR::Pointer::build(IR::Void::build()))
+      .addArg("slot", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("hj_append", IR::Pointer::build(IR::Char::build()))
+      .addArg("build", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("hj_probe", IR::Void::build())
+      .addArg("probe", IR::Pointer::build(IR::Void::build()))
+      .addArg("row", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("hash", IR::UnsignedInt::build(8));
+
+   RuntimeFunctionBuilder("rj_append", IR::Pointer::build(IR::Char::build()))
+      .addArg("build", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("rj_probe", IR::Void::build())
+      .addArg("probe", IR::Pointer::build(IR::Void::build()))
+      .addArg("row", IR::Pointer::build(IR::Char::build()), true)
+      .addArg("hash", IR::UnsignedInt::build(8));
+
+   RuntimeFunctionBuilder("ht_psk_lookup_or_insert", IR::Pointer::build(IR::Char::build()))
+      .addArg("table", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
+
+   RuntimeFunctionBuilder("ht_pck_lookup_or_insert", IR::Pointer::build(IR::Char::build()))
+      .addArg("table", IR::Pointer::build(IR::Void::build()))
+      .addArg("key", IR::Pointer::build(IR::Char::build()), true);
 }
 
 }
\ No newline at end of file
@@ -16,6 +16,39 @@ extern "C" char* ht_sk_lookup_or_insert(void* table, char* key);
 extern "C" void ht_sk_lookup_or_insert_with_init(void* table, char** result, bool* is_new_key, char* key);
 extern "C" void ht_sk_it_advance(void* table, char** it_data, uint64_t* it_idx);
 
+/// Split hashing from resolving the key. In a vectorized primitive, the hashes of a whole chunk
+/// get computed and their slots prefetched before the first slot is resolved.
+extern "C" uint64_t ht_sk_hash_prefetch(void* table, char* key);
+extern "C" char* ht_sk_lookup_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_sk_lookup_disable_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_sk_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash);
+
+/// Hot paths of simple key tables specialized on fixed key widths, see `FixedKeyWidth`.
+extern "C" uint64_t ht_sk4_hash_prefetch(void* table, char* key);
+extern "C" char* ht_sk4_lookup(void* table, char* key);
+extern "C" char* ht_sk4_lookup_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_sk4_lookup_or_insert(void* table, char* key);
+extern "C" char* ht_sk4_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_psk4_lookup_or_insert(void* table, char* key);
+extern "C" uint64_t ht_sk8_hash_prefetch(void* table, char* key);
+extern "C" char* ht_sk8_lookup(void* table, char* key);
+extern "C" char* ht_sk8_lookup_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_sk8_lookup_or_insert(void* table, char* key);
+extern "C" char* ht_sk8_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_psk8_lookup_or_insert(void* table, char* key);
+extern "C" uint64_t ht_sk12_hash_prefetch(void* table, char* key);
+extern "C" char* ht_sk12_lookup(void* table, char* key);
+extern "C" char* ht_sk12_lookup_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_sk12_lookup_or_insert(void* table, char* key);
+extern "C" char* ht_sk12_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_psk12_lookup_or_insert(void* table, char* key);
+extern "C" uint64_t ht_sk16_hash_prefetch(void* table, char* key);
+extern "C" char* ht_sk16_lookup(void* table, char* key);
+extern "C" char* ht_sk16_lookup_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_sk16_lookup_or_insert(void* table, char* key);
+extern "C" char* ht_sk16_lookup_or_insert_with_hash(void* table, char* key, uint64_t hash);
+extern "C" char* ht_psk16_lookup_or_insert(void* table, char* key);
+
 extern "C" char* ht_ck_lookup(void* table, char* key);
 extern "C" char* ht_ck_lookup_or_insert(void* table, char* key);
 extern "C" void ht_ck_it_advance(void* table, char** it_data, uint64_t* it_idx);
@@ -24,6 +57,36 @@ extern "C" char* ht_dl_lookup(void* table, char* key);
 extern "C" char* ht_dl_lookup_or_insert(void* table, char* key);
 extern "C" void ht_dl_it_advance(void* table, char** it_data, uint64_t* it_idx);
 
+/// Array index on the dense integer keys of a join build. Sparse keys are looked up in the hash table on their hash.
+extern "C" uint64_t ht_aj_hash_prefetch(void* index, char* key);
+extern "C" char* ht_aj_lookup_with_hash(void* index, char* key, uint64_t hash);
+extern "C" char* ht_aj_lookup_disable_with_hash(void* index, char* key, uint64_t hash);
+extern "C" uint64_t ht_aj4_hash_prefetch(void* index, char* key);
+extern "C" char* ht_aj4_lookup_with_hash(void* index, char* key, uint64_t hash);
+extern "C" uint64_t ht_aj8_hash_prefetch(void* index, char* key);
+extern "C" char* ht_aj8_lookup_with_hash(void* index, char* key, uint64_t hash);
+
+/// Bloom filter on the keys of a join build.
+extern "C" bool bf_contains(void* filter, char* key);
+
+/// Build and probe side of n:m joins.
+extern "C" char* nm_join_append(void* rows, char* key);
+extern "C" void nm_join_add_match(void* matches, char* probe_row, char* slot);
+/// Semi joins only remember the index slot of a match.
+extern "C" void nm_join_add_slot(void* matches, char* slot);
+
+/// Build and probe side of hybrid hash joins which can spill to disk.
+extern "C" char* hj_append(void* build, char* key);
+extern "C" void hj_probe(void* probe, char* row, uint64_t hash);
+
+/// Build and probe side of radix-partitioned hash joins.
+extern "C" char* rj_append(void* build, char* key);
+extern "C" void rj_probe(void* probe, char* row, uint64_t hash);
+
+/// Thread-local pre-aggregation tables of a parallel aggregation.
+extern "C" char* ht_psk_lookup_or_insert(void* table, char* key);
+extern "C" char* ht_pck_lookup_or_insert(void* table, char* key);
+
 /// Special lookup function if we know we have a 0-byte key.
 extern "C" char* ht_nk_lookup(void* table);
 
@@ -1,9 +1,18 @@
 #include "runtime/HashTables.h"
-#include "exec/ExecutionContext.h"
+#include "runtime/HashRuntime.h"
 #include "xxhash.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 
+#if defined(__SSE2__) && !defined(WITH_SCALAR_HT_PROBING)
+#define INKFUSE_HT_GROUP_PROBING
+#include <emmintrin.h>
+#endif
+
 namespace inkfuse {
 
 namespace {
@@ -11,53 +20,217 @@ namespace {
 const uint8_t tag_fill_mask = 1u << 7u;
 /// Mask that allows inverting hash fingerprint but doesn't touch the fill bit.
 const uint8_t fingerprint_inversion_mask = tag_fill_mask - 1;
-/// Lower order 7 bits in the hash slot store salt of the hash.
-const uint8_t tag_hash_mask = tag_fill_mask - 1;
+/// Tag of a slot that was claimed by a concurrent insert, but whose key is not written yet.
+/// The fill bit is not set, but the tag is not empty either.
+const uint8_t tag_busy = 1;
 }
 
 const std::string HashTableSimpleKey::ID = "sk";
 const std::string HashTableComplexKey::ID = "ck";
 const std::string HashTableDirectLookup::ID = "dl";
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 4>::ID = "sk4";
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 8>::ID = "sk8";
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 12>::ID = "sk12";
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 16>::ID = "sk16";
+
+#ifdef INKFUSE_HT_GROUP_PROBING
+const char* SharedHashTableState::probing_layout = "sse2_group";
+#else
+const char* SharedHashTableState::probing_layout = "scalar";
+#endif
+
+double HashTableStats::loadFactor() const {
+   return slots ? static_cast<double>(groups) / static_cast<double>(slots) : 0.0;
+}
+
+uint64_t HashTableStats::probes() const {
+   uint64_t total = 0;
+   for (uint64_t count : probe_lengths) {
+      total += count;
+   }
+   return total;
+}
+
+void HashTableStats::merge(const HashTableStats& other) {
+   for (size_t k = 0; k < probe_buckets; ++k) {
+      probe_lengths[k] += other.probe_lengths[k];
+   }
+   fingerprint_false_positives += other.fingerprint_false_positives;
+   resizes += other.resizes;
+   resize_nanos += other.resize_nanos;
+   peak_bytes_sum += other.peak_bytes_sum;
+   groups += other.groups;
+   slots += other.slots;
+}
+
+void HashTableStats::recordProbe(size_t length, uint64_t false_positives) {
+   const size_t bucket = std::min(static_cast<size_t>(std::bit_width(length)) - 1, probe_buckets - 1);
+   std::atomic_ref<uint64_t>(probe_lengths[bucket]).fetch_add(1, std::memory_order_relaxed);
+   if (false_positives) {
+      std::atomic_ref<uint64_t>(fingerprint_false_positives).fetch_add(false_positives, std::memory_order_relaxed);
+   }
+}
 
 SharedHashTableState::SharedHashTableState(uint16_t total_slot_size_, size_t start_slots_)
-   : mod_mask(start_slots_ - 1), total_slot_size(total_slot_size_), max_fill(start_slots_ / 2) {
+   : mod_mask(start_slots_ - 1), max_fill(start_slots_ - start_slots_ / 4), total_slot_size(total_slot_size_) {
    if (start_slots_ < 2 || ((start_slots_ & (start_slots_ - 1)) != 0)) {
       throw std::runtime_error("Hash table start size has to power of 2 of at size 2.");
    }
 
    // Set up initial hash table based on the provided start size.
-   // Allow half of the slots to be filled - this is needed to keep collision chains short.
-   tags = std::make_unique<uint8_t[]>(start_slots_);
-   data = std::make_unique<char[]>((start_slots_) *total_slot_size);
+   // Allow three quarters of the slots to be filled - this is needed to keep collision chains short.
+   tags = TableMemory::makeArray<uint8_t>(start_slots_);
+   rows = TableMemory::makeArray<char*>(start_slots_);
+   // The first heap chunk has room for all rows that fit before the first resize.
+   chunk_rows = std::bit_ceil(max_fill);
+   heap_rows = chunk_rows;
+   heap.push_back(TableMemory::makeArray<char>(chunk_rows * total_slot_size));
+   stats.peak_bytes_sum = memoryBytes();
+}
+
+size_t SharedHashTableState::memoryBytes() const {
+   return (mod_mask + 1) * (sizeof(uint8_t) + sizeof(char*)) + heap_rows * total_slot_size;
+}
+
+char* SharedHashTableState::heapRow(size_t pos) const {
+   if (pos < chunk_rows) [[likely]] {
+      return &heap[0][pos * total_slot_size];
+   }
+   // Chunk k > 0 starts at row `chunk_rows << (k - 1)`.
+   const size_t chunk = std::bit_width(pos / chunk_rows);
+   const size_t chunk_start = chunk_rows << (chunk - 1);
+   return &heap[chunk][(pos - chunk_start) * total_slot_size];
+}
+
+char* SharedHashTableState::emplace(size_t idx, uint8_t tag) {
+   if (inserted == heap_rows) [[unlikely]] {
+      // Double the heap. Existing rows stay where they are.
+      heap.push_back(TableMemory::makeArray<char>(heap_rows * total_slot_size));
+      heap_rows *= 2;
+      stats.peak_bytes_sum = std::max(stats.peak_bytes_sum, memoryBytes());
+   }
+   char* row = heapRow(inserted++);
+   rows[idx] = row;
+   tags[idx] = tag;
+   return row;
+}
+
+char* SharedHashTableState::appendConcurrent() {
+   const size_t pos = std::atomic_ref<size_t>(inserted).fetch_add(1, std::memory_order_relaxed);
+   assert(pos < heap_rows);
+   return heapRow(pos);
+}
+
+template <class HashOf>
+void SharedHashTableState::rebuildIndex(size_t slots, const HashOf& hash_of) {
+   const auto start = std::chrono::steady_clock::now();
+   // Both indexes are alive at the same time.
+   stats.peak_bytes_sum = std::max(stats.peak_bytes_sum, memoryBytes() + slots * (sizeof(uint8_t) + sizeof(char*)));
+   auto old_tags = std::move(tags);
+   auto old_rows = std::move(rows);
+   const size_t old_slots = mod_mask + 1;
+   tags = TableMemory::makeArray<uint8_t>(slots);
+   rows = TableMemory::makeArray<char*>(slots);
+   mod_mask = slots - 1;
+   max_fill = slots - slots / 4;
+   for (uint64_t idx = 0; idx < old_slots; ++idx) {
+      if (old_tags[idx] & tag_fill_mask) {
+         // Move over the tag and the row pointer. Disabled slots keep their tag.
+         // The rehash is not a probe of the table, keep it out of the probe statistics.
+         const size_t new_idx = findSlotOrEmpty<false>(hash_of(old_rows[idx]), [](const char*) { return false; });
+         tags[new_idx] = old_tags[idx];
+         rows[new_idx] = old_rows[idx];
+      }
+   }
+   stats.resizes++;
+   stats.resize_nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
 }
 
-void SharedHashTableState::advance(size_t& idx, char*& data_ptr, uint8_t*& tag_ptr) const {
-   assert(data_ptr != nullptr && tag_ptr != nullptr);
-   if (idx == mod_mask) [[unlikely]] {
-      // Wrap around.
-      idx = 0;
-      data_ptr = &data[0];
-      tag_ptr = &tags[0];
-   } else [[likely]] {
-      // Regular advance.
-      data_ptr += total_slot_size;
-      tag_ptr++;
-      idx++;
+void SharedHashTableState::iteratorStart(char** it_data, uint64_t* it_idx) const {
+   *it_idx = 0;
+   *it_data = inserted ? heapRow(0) : nullptr;
+}
+
+void SharedHashTableState::iteratorAdvance(char** it_data, uint64_t* it_idx) const {
+   assert(*it_data != nullptr);
+   const size_t next = ++(*it_idx);
+   if (next == inserted) {
+      // Reached the end of the heap.
+      *it_data = nullptr;
+   } else if (next >= chunk_rows && std::has_single_bit(next)) [[unlikely]] {
+      // Moved on to the next heap chunk.
+      *it_data = heapRow(next);
+   } else {
+      *it_data += total_slot_size;
    }
 }
 
-void SharedHashTableState::advanceNoWrap(size_t& idx, char*& data_ptr, uint8_t*& tag_ptr) const {
-   // Should not be called after it returned a nullptr.
-   assert(data_ptr != nullptr && tag_ptr != nullptr);
-   assert(idx <= mod_mask);
-   if (idx == mod_mask) [[unlikely]] {
-      // Reached end. Set the data to null.
-      data_ptr = nullptr;
-   } else [[likely]] {
-      // Regular advance.
-      data_ptr += total_slot_size;
-      tag_ptr++;
-      idx++;
+template <bool record, class KeyMatches>
+size_t SharedHashTableState::findSlotOrEmpty(uint64_t hash, const KeyMatches& matches) const {
+   uint64_t idx = hash & mod_mask;
+   // Get the tag from the hash, take the highest order bits as these
+   // have the lowest risk of collision (lowest order bits are used to compute the slot).
+   const auto target_tag = static_cast<uint8_t>(tag_fill_mask | static_cast<uint8_t>(hash >> 56ul));
+#ifdef INKFUSE_HT_GROUP_PROBING
+   const __m128i target_group = _mm_set1_epi8(static_cast<char>(target_tag));
+#endif
+   // Probe statistics, compiled out unless they are collected.
+   [[maybe_unused]] const uint64_t home = idx;
+   [[maybe_unused]] uint64_t false_positives = 0;
+   auto found = [&](size_t slot) {
+      if constexpr (HashTableStats::collect_probes && record) {
+         stats.recordProbe(((slot - home) & mod_mask) + 1, false_positives);
+      }
+      return slot;
+   };
+   for (;;) {
+#ifdef INKFUSE_HT_GROUP_PROBING
+      // Only load groups which don't wrap around the end of the table.
+      // Tables with less than 16 slots always take the scalar path.
+      if (idx + group_size <= mod_mask + 1) [[likely]] {
+         const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&tags[idx]));
+         uint32_t candidates = _mm_movemask_epi8(_mm_cmpeq_epi8(group, target_group));
+         // Slots without the fill bit end the collision chain.
+         const uint32_t empty = ~static_cast<uint32_t>(_mm_movemask_epi8(group)) & 0xFFFFu;
+         if (empty) {
+            // Only candidates in front of the first empty slot are part of the chain.
+            candidates &= (empty & (~empty + 1)) - 1;
+         }
+         while (candidates) {
+            const size_t slot = idx + std::countr_zero(candidates);
+            if (matches(rows[slot])) {
+               return found(slot);
+            }
+            if constexpr (HashTableStats::collect_probes) {
+               false_positives++;
+            }
+            candidates &= candidates - 1;
+         }
+         if (empty) {
+            return found(idx + std::countr_zero(empty));
+         }
+         idx = (idx + group_size) & mod_mask;
+         continue;
+      }
+#endif
+      const uint8_t tag = tags[idx];
+      if (!(tag & tag_fill_mask)) {
+         // We found an empty slot indicating the key does not exist.
+         return found(idx);
+      }
+      if (tag == target_tag) {
+         if (matches(rows[idx])) {
+            return found(idx);
+         }
+         if constexpr (HashTableStats::collect_probes) {
+            false_positives++;
+         }
+      }
+      idx = (idx + 1) & mod_mask;
    }
 }
 
@@ -71,8 +244,10 @@ HashTableSimpleKey::HashTableSimpleKey(uint16_t key_size_, uint16_t payload_size
 }
 
 char* HashTableSimpleKey::lookup(const char* key) {
-   // First step: hash the key.
-   const uint64_t hash = XXH3_64bits(key, simple_key_size);
+   return lookup(key, HashRuntime::hashKey(key, simple_key_size));
+}
+
+char* HashTableSimpleKey::lookup(const char* key, uint64_t hash) {
    // Find the slot which we belong to.
    const auto slot = findSlotOrEmpty(hash, key);
    // Only if the slot was tagged did we actually find the key.
@@ -80,20 +255,29 @@ char* HashTableSimpleKey::lookup(const char* key) {
 }
 
 char* HashTableSimpleKey::lookupDisable(const char* key) {
-   // First step: hash the key.
-   const uint64_t hash = XXH3_64bits(key, simple_key_size);
+   return lookupDisable(key, HashRuntime::hashKey(key, simple_key_size));
+}
+
+char* HashTableSimpleKey::lookupDisable(const char* key, uint64_t hash) {
    // Find the slot which we belong to.
    const auto slot = findSlotOrEmpty(hash, key);
-   // Store the current tag value.
-   const uint8_t tag_before = *slot.tag;
+   // Only if the slot was tagged did we actually find the key.
+   if (!(*slot.tag & tag_fill_mask)) {
+      return nullptr;
+   }
    // Disable the slot. It won't be found in the future anymore.
    // What actually happens here is a bit of bit fiddling: we keep the slot enabled but invert
    // the lower 7 bit (hash fingerprint).
    // This way, any future lookup on the key will not find this tag anymore.
    // As a result, the row won't be found. At the same time, the chain stays intact.
-   *slot.tag = tag_before ^ fingerprint_inversion_mask;
-   // Only if the slot was tagged did we actually find the key.
-   return (tag_before & tag_fill_mask) ? slot.elem : nullptr;
+   // Multiple threads can disable keys at the same time. The compare-and-swap makes sure only
+   // one of them gets the row, a second inversion would enable the slot again. The swap starts from
+   // the enabled tag of the key: re-reading the tag could already see the tag disabled by another thread.
+   auto tag_before = static_cast<uint8_t>(tag_fill_mask | static_cast<uint8_t>(hash >> 56ul));
+   if (!std::atomic_ref<uint8_t>(*slot.tag).compare_exchange_strong(tag_before, tag_before ^ fingerprint_inversion_mask, std::memory_order_relaxed)) {
+      return nullptr;
+   }
+   return slot.elem;
 }
 
 char* HashTableSimpleKey::lookupOrInsert(const char* key) {
@@ -104,72 +288,57 @@ char* HashTableSimpleKey::lookupOrInsert(const char* key) {
 }
 
 void HashTableSimpleKey::lookupOrInsert(char** result, bool* is_new_key, const char* key) {
+   lookupOrInsert(result, is_new_key, key, hash(key));
+}
+
+void HashTableSimpleKey::lookupOrInsert(char** result, bool* is_new_key, const char* key, uint64_t hash) {
    // Double the hash table if we don't have enough space.
    // Strictly speaking a bit too passive, as we might not need the
    // slot of the key already exists. But this is a border-case.
    reserveSlot();
-   // First step: hash the key.
-   const uint64_t hash = XXH3_64bits(key, simple_key_size);
    const auto slot = findSlotOrEmpty(hash, key);
    if (!(*slot.tag)) {
-      // Initialize the slot.
+      // Append a new row for the key.
       auto target_tag = static_cast<uint8_t>(hash >> 56ul);
-      *slot.tag = tag_fill_mask | target_tag;
+      char* row = state.emplace(slot.idx, tag_fill_mask | target_tag);
       // Copy over the key.
-      std::memcpy(slot.elem, key, simple_key_size);
-      state.inserted++;
+      std::memcpy(row, key, simple_key_size);
       *is_new_key = true;
+      *result = row;
    } else {
       *is_new_key = false;
+      *result = slot.elem;
    }
-   *result = slot.elem;
 }
 
-char* HashTableSimpleKey::insert(const char* key) {
-   reserveSlot();
-   const uint64_t hash = XXH3_64bits(key, simple_key_size);
+uint64_t HashTableSimpleKey::hash(const char* key) const {
+   return HashRuntime::hashKey(key, simple_key_size);
+}
 
-   // Access the base table at the right index.
-   uint64_t idx = hash & state.mod_mask;
-   char* elem_ptr = &state.data[idx * state.total_slot_size];
-   uint8_t* tag_ptr = &state.tags[idx];
+void HashTableSimpleKey::prefetch(uint64_t hash) const {
+   const uint64_t idx = hash & state.mod_mask;
+   __builtin_prefetch(&state.tags[idx]);
+   __builtin_prefetch(&state.rows[idx]);
+}
 
-   // Find the first free slot.
-   for (;;) {
-      const uint8_t tag_fill = *tag_ptr & tag_fill_mask;
-      const uint8_t tag_hash = *tag_ptr & tag_hash_mask;
-      if (!tag_fill) {
-         // We found the first free slot. Mark it as occupied.
-         auto target_tag = static_cast<uint8_t>(hash >> 56ul);
-         *tag_ptr = tag_fill_mask | target_tag;
-         // Copy over the key.
-         std::memcpy(elem_ptr, key, simple_key_size);
-         state.inserted++;
-         return elem_ptr;
-      }
-      state.advance(idx, elem_ptr, tag_ptr);
-   }
+char* HashTableSimpleKey::insert(const char* key) {
+   reserveSlot();
+   const uint64_t hash = HashRuntime::hashKey(key, simple_key_size);
+   // Find the first free slot and mark it as occupied.
+   const auto slot = findFirstEmptySlot(hash);
+   auto target_tag = static_cast<uint8_t>(hash >> 56ul);
+   char* row = state.emplace(slot.idx, tag_fill_mask | target_tag);
+   // Copy over the key.
+   std::memcpy(row, key, simple_key_size);
+   return row;
 }
 
 void HashTableSimpleKey::iteratorStart(char** it_data, size_t* it_idx) {
-   *it_idx = 0;
-   *it_data = &state.data[0];
-   uint8_t* tag_ptr = &state.tags[0];
-   while (((*tag_ptr & tag_fill_mask) == 0) && *it_data != nullptr) {
-      // Advance iterator to the first occupied slot.
-      state.advanceNoWrap(*it_idx, *it_data, tag_ptr);
-   }
+   state.iteratorStart(it_data, it_idx);
 }
 
 void HashTableSimpleKey::iteratorAdvance(char** it_data, size_t* it_idx) {
-   assert(*it_data != nullptr);
-   uint8_t* tag_ptr = &state.tags[*it_idx];
-   // Advance once to the next slot.
-   state.advanceNoWrap(*it_idx, *it_data, tag_ptr);
-   while (((*tag_ptr & tag_fill_mask) == 0) && *it_data != nullptr) {
-      // Advance until a free slot was found.
-      state.advanceNoWrap(*it_idx, *it_data, tag_ptr);
-   }
+   state.iteratorAdvance(it_data, it_idx);
 }
 
 size_t HashTableSimpleKey::size() const {
@@ -180,47 +349,140 @@ size_t HashTableSimpleKey::capacity() const {
    return state.mod_mask + 1;
 }
 
+HashTableStats HashTableSimpleKey::getStats() const {
+   HashTableStats stats = state.stats;
+   stats.table = ID;
+   stats.groups = size();
+   stats.slots = capacity();
+   return stats;
+}
+
 char* HashTableSimpleKey::lookupOrInsertSingleKey() {
-   // We always return the first slot.
+   // We always return the row of the first slot.
    // We don't need any key checking whatsoever.
-   char* elem_ptr = &state.data[0];
-   uint8_t* tag_ptr = &state.tags[0];
-   if (!*tag_ptr) {
+   if (!state.tags[0]) {
       // First insert - tag the slot.
-      *tag_ptr = tag_fill_mask;
-      state.inserted++;
+      return state.emplace(0, tag_fill_mask);
+   }
+   return state.rows[0];
+}
+
+void HashTableSimpleKey::mergeConcurrent(const HashTableSimpleKey& other) {
+   assert(state.total_slot_size == other.state.total_slot_size);
+   // The rows of the other table are dense, so this is a sequential scan.
+   char* it_data;
+   uint64_t it_idx;
+   other.state.iteratorStart(&it_data, &it_idx);
+   while (it_data != nullptr) {
+      insertConcurrent(it_data, HashRuntime::hashKey(it_data, simple_key_size));
+      other.state.iteratorAdvance(&it_data, &it_idx);
    }
-   return elem_ptr;
 }
 
-HashTableSimpleKey::LookupResult HashTableSimpleKey::findSlotOrEmpty(uint64_t hash, const char* key) {
-   // Access the base table at the right index.
+bool HashTableSimpleKey::insertConcurrent(const char* slot, uint64_t hash) {
    uint64_t idx = hash & state.mod_mask;
-   char* elem_ptr = &state.data[idx * state.total_slot_size];
-   uint8_t* tag_ptr = &state.tags[idx];
-   // Get the tag from the hash, take the highest order bits as these
-   // have the lowest risk of collision (lowest order bits are used to compute the slot).
-   auto target_tag = tag_hash_mask & static_cast<uint8_t>(hash >> 56ul);
+   const auto target_tag = static_cast<uint8_t>(tag_fill_mask | static_cast<uint8_t>(hash >> 56ul));
    for (;;) {
-      const uint8_t tag_fill = *tag_ptr & tag_fill_mask;
-      const uint8_t tag_hash = *tag_ptr & tag_hash_mask;
-      if (!tag_fill || (tag_hash == target_tag && (std::memcmp(elem_ptr, key, simple_key_size) == 0))) {
-         // We either found the key or an empty slot indicating the key does not exist.
-         return {.elem = elem_ptr, .tag = tag_ptr};
+      std::atomic_ref<uint8_t> tag(state.tags[idx]);
+      uint8_t current = tag.load(std::memory_order_acquire);
+      if (current == 0) {
+         if (tag.compare_exchange_strong(current, tag_busy, std::memory_order_acquire)) {
+            // We own the slot. Copy the full slot into a new row and publish it by setting the final tag.
+            char* row = state.appendConcurrent();
+            std::memcpy(row, slot, state.total_slot_size);
+            state.rows[idx] = row;
+            tag.store(target_tag, std::memory_order_release);
+            return true;
+         }
+         // Another thread claimed the slot first, `current` now contains its tag.
+      }
+      while (current == tag_busy) {
+         // The key of the other thread is not written yet. Wait for it to be published, this
+         // is only ever a memcpy away.
+         current = tag.load(std::memory_order_acquire);
+      }
+      if (current == target_tag && std::memcmp(state.rows[idx], slot, simple_key_size) == 0) {
+         // The key was already inserted.
+         return false;
+      }
+      idx = (idx + 1) & state.mod_mask;
+   }
+}
+
+HashTableSimpleKey::LookupResult HashTableSimpleKey::findSlotOrEmpty(uint64_t hash, const char* key) {
+   return findSlotOrEmptyFixed<0>(hash, key);
+}
+
+template <uint16_t key_width>
+HashTableSimpleKey::LookupResult HashTableSimpleKey::findSlotOrEmptyFixed(uint64_t hash, const char* key) {
+   const size_t idx = state.findSlotOrEmpty(hash, [&](const char* elem) {
+      if constexpr (key_width == 0) {
+         return std::memcmp(elem, key, simple_key_size) == 0;
+      } else {
+         // With a constant width, the compiler turns this into one or two integer comparisons.
+         return std::memcmp(elem, key, key_width) == 0;
       }
-      state.advance(idx, elem_ptr, tag_ptr);
+   });
+   return {.elem = state.rows[idx], .tag = &state.tags[idx], .idx = idx};
+}
+
+template <uint16_t key_width>
+uint64_t HashTableSimpleKey::hashFixed(const char* key) {
+   return HashRuntime::hashKey(key, key_width);
+}
+
+template <uint16_t key_width>
+char* HashTableSimpleKey::lookupFixed(const char* key, uint64_t hash) {
+   assert(simple_key_size == key_width);
+   const auto slot = findSlotOrEmptyFixed<key_width>(hash, key);
+   return (*slot.tag & tag_fill_mask) ? slot.elem : nullptr;
+}
+
+template <uint16_t key_width>
+void HashTableSimpleKey::lookupOrInsertFixed(char** result, bool* is_new_key, const char* key, uint64_t hash) {
+   assert(simple_key_size == key_width);
+   reserveSlot();
+   const auto slot = findSlotOrEmptyFixed<key_width>(hash, key);
+   if (!(*slot.tag)) {
+      auto target_tag = static_cast<uint8_t>(hash >> 56ul);
+      char* row = state.emplace(slot.idx, tag_fill_mask | target_tag);
+      std::memcpy(row, key, key_width);
+      *is_new_key = true;
+      *result = row;
+   } else {
+      *is_new_key = false;
+      *result = slot.elem;
    }
 }
 
+// Instantiate the specialized lookups for all supported key widths.
+template uint64_t HashTableSimpleKey::hashFixed<4>(const char* key);
+template uint64_t HashTableSimpleKey::hashFixed<8>(const char* key);
+template uint64_t HashTableSimpleKey::hashFixed<12>(const char* key);
+template uint64_t HashTableSimpleKey::hashFixed<16>(const char* key);
+template char* HashTableSimpleKey::lookupFixed<4>(const char* key, uint64_t hash);
+template char* HashTableSimpleKey::lookupFixed<8>(const char* key, uint64_t hash);
+template char* HashTableSimpleKey::lookupFixed<12>(const char* key, uint64_t hash);
+template char* HashTableSimpleKey::lookupFixed<16>(const char* key, uint64_t hash);
+template void HashTableSimpleKey::lookupOrInsertFixed<4>(char** result, bool* is_new_key, const char* key, uint64_t hash);
+template void HashTableSimpleKey::lookupOrInsertFixed<8>(char** result, bool* is_new_key, const char* key, uint64_t hash);
+template void HashTableSimpleKey::lookupOrInsertFixed<12>(char** result, bool* is_new_key, const char* key, uint64_t hash);
+template void HashTableSimpleKey::lookupOrInsertFixed<16>(char** result, bool* is_new_key, const char* key, uint64_t hash);
+
 HashTableSimpleKey::LookupResult HashTableSimpleKey::findFirstEmptySlot(uint64_t hash) {
-   uint64_t idx = hash & state.mod_mask;
-   char* elem_ptr = &state.data[idx * state.total_slot_size];
-   uint8_t* tag_ptr = &state.tags[idx];
+   const size_t idx = state.findSlotOrEmpty(hash, [](const char*) { return false; });
+   return {.elem = state.rows[idx], .tag = &state.tags[idx], .idx = idx};
+}
 
-   while (*tag_ptr != 0) {
-      state.advance(idx, elem_ptr, tag_ptr);
+void HashTableSimpleKey::reserve(size_t num_keys) {
+   if (state.inserted + num_keys <= state.max_fill) {
+      return;
    }
-   return {.elem = elem_ptr, .tag = tag_ptr};
+   size_t slots = state.mod_mask + 1;
+   while (slots - slots / 4 < state.inserted + num_keys) {
+      slots *= 2;
+   }
+   grow(slots);
 }
 
 void HashTableSimpleKey::reserveSlot() {
@@ -228,50 +490,59 @@ void HashTableSimpleKey::reserveSlot() {
       return;
    }
 
-   // We need to resize. Indicate that this happened to the currently installed execution context.
-   // This will force the driver of the query to rerun the primitive if this used the interpreted path.
-   bool* try_restart_flag = ExecutionContext::tryGetInstalledRestartFlag();
-   if (try_restart_flag) {
-      *try_restart_flag = true;
-   }
-
-   char* curr_slot = &state.data[0];
-   uint8_t* curr_tag = &state.tags[0];
-   size_t old_max_slot = state.mod_mask;
-   // Double the size.
-   SharedHashTableState new_state(state.total_slot_size, 2 * (state.mod_mask + 1));
-   std::swap(new_state, state);
-   for (uint64_t idx = 0; idx <= old_max_slot; ++idx) {
-      if (*curr_tag) {
-         // If it's set, insert hash value into new table. Upper bit does not matter, so don't have to zero it out.
-         const uint64_t hash = XXH3_64bits(curr_slot, simple_key_size);
-         const auto slot = findFirstEmptySlot(hash);
-         // Move over the tag.
-         *slot.tag = *curr_tag;
-         // Move over the full payload.
-         std::memcpy(slot.elem, curr_slot, state.total_slot_size);
-      }
-      curr_slot += state.total_slot_size;
-      curr_tag++;
-   }
-   state.inserted = new_state.inserted;
+   // Double the size. Rows never move, so the pointers handed out so far stay valid
+   // and vectorized primitives don't have to be restarted.
+   grow(2 * (state.mod_mask + 1));
+}
+
+void HashTableSimpleKey::grow(size_t slots) {
+   // Only the index gets rebuilt, the rows stay where they are.
+   state.rebuildIndex(slots, [&](const char* row) { return HashRuntime::hashKey(row, simple_key_size); });
 }
 
 HashTableComplexKey::HashTableComplexKey(uint16_t simple_key_size, uint16_t complex_key_slots, uint16_t payload_size, size_t start_slots)
-   : state(simple_key_size + 8 * complex_key_slots + payload_size, start_slots), simple_key_size(simple_key_size), complex_key_slots(complex_key_slots), payload_size(payload_size) {
-   if (simple_key_size != 0 || complex_key_slots != 1) {
-      throw std::runtime_error("InkFuse currently only supports complex hash tables with a single string.");
+   : state(simple_key_size + 8 * complex_key_slots + payload_size + 8 + sizeof(StringMeta) * complex_key_slots, start_slots),
+     simple_key_size(simple_key_size),
+     complex_key_slots(complex_key_slots),
+     payload_size(payload_size),
+     key_size(simple_key_size + 8 * complex_key_slots),
+     meta_offset(simple_key_size + 8 * complex_key_slots + payload_size) {
+   if (complex_key_slots == 0 || complex_key_slots > max_complex_key_slots) {
+      throw std::runtime_error("Complex hash tables need between 1 and 16 string slots in the key.");
+   }
+}
+
+void HashTableComplexKey::describe(const char* key, StringMeta* meta) const {
+   // The packed key starts with one 8 byte char pointer per string.
+   const auto strings = reinterpret_cast<char* const*>(key);
+   for (uint16_t k = 0; k < complex_key_slots; ++k) {
+      const size_t len = std::strlen(strings[k]);
+      meta[k].length = static_cast<uint32_t>(len);
+      // Zero-pad the prefix of short strings so that it can be compared as a whole.
+      std::memset(meta[k].prefix, 0, sizeof(meta[k].prefix));
+      std::memcpy(meta[k].prefix, strings[k], std::min(len, sizeof(meta[k].prefix)));
+   }
+}
+
+uint64_t HashTableComplexKey::hashDescribed(const char* key, const StringMeta* meta) const {
+   // Chain the hashes of all key parts. A single string hashes the same as plain XXH3.
+   const auto strings = reinterpret_cast<char* const*>(key);
+   uint64_t hash = 0;
+   for (uint16_t k = 0; k < complex_key_slots; ++k) {
+      hash = XXH3_64bits_withSeed(strings[k], meta[k].length, hash);
+   }
+   if (simple_key_size) {
+      hash = XXH3_64bits_withSeed(key + 8 * complex_key_slots, simple_key_size, hash);
    }
+   return hash;
 }
 
 char* HashTableComplexKey::lookup(const char* key) {
-   // The char* of the key represents the packed key. The first slot contains an 8 byte char pointer.
-   const auto indirection = reinterpret_cast<char* const*>(key);
-   const size_t len = std::strlen(*indirection);
-   // First step: hash the string key.
-   const uint64_t hash = XXH3_64bits(*indirection, len);
+   StringMeta meta[max_complex_key_slots];
+   describe(key, meta);
+   const uint64_t hash = hashDescribed(key, meta);
    // Find the slot which we belong to.
-   const auto slot = findSlotOrEmpty(hash, *indirection);
+   const auto slot = findSlotOrEmpty(hash, key, meta);
    // Only if the slot was tagged did we actually find the key.
    return (*slot.tag & tag_fill_mask) ? slot.elem : nullptr;
 }
@@ -284,82 +555,82 @@ char* HashTableComplexKey::lookupOrInsert(const char* key) {
 }
 
 void HashTableComplexKey::lookupOrInsert(char** result, bool* is_new_key, const char* key) {
+   lookupOrInsert(result, is_new_key, key, hash(key));
+}
+
+void HashTableComplexKey::lookupOrInsert(char** result, bool* is_new_key, const char* key, uint64_t hash) {
    // Double the hash table if we don't have enough space.
    // Strictly speaking a bit too passive, as we might not need the
    // slot of the key already exists. But this is a border-case.
    reserveSlot();
 
-   // First step: hash the key.
-   // The char* of the key represents the packed key. The first slot contains an 8 byte char pointer.
-   const auto indirection = reinterpret_cast<char* const*>(key);
-   const size_t len = std::strlen(*indirection);
-   const uint64_t hash = XXH3_64bits(*indirection, len);
-   const auto slot = findSlotOrEmpty(hash, *indirection);
+   StringMeta meta[max_complex_key_slots];
+   describe(key, meta);
+   const auto slot = findSlotOrEmpty(hash, key, meta);
    if (!(*slot.tag)) {
-      // Initialize the slot.
+      // Append a new row for the key.
       auto target_tag = static_cast<uint8_t>(hash >> 56ul);
-      *slot.tag = tag_fill_mask | target_tag;
-      // Copy over the pointer into the first slot.
-      *reinterpret_cast<char**>(slot.elem) = *indirection;
-      state.inserted++;
+      char* row = state.emplace(slot.idx, tag_fill_mask | target_tag);
+      // Copy over the string pointers and the simple key part.
+      std::memcpy(row, key, key_size);
+      // Remember the hash and string metadata for later comparisons and resizes.
+      char* slot_meta = row + meta_offset;
+      std::memcpy(slot_meta, &hash, 8);
+      std::memcpy(slot_meta + 8, meta, sizeof(StringMeta) * complex_key_slots);
       *is_new_key = true;
+      *result = row;
    } else {
       *is_new_key = false;
+      *result = slot.elem;
    }
-   *result = slot.elem;
+}
+
+uint64_t HashTableComplexKey::hash(const char* key) const {
+   StringMeta meta[max_complex_key_slots];
+   describe(key, meta);
+   return hashDescribed(key, meta);
 }
 
 void HashTableComplexKey::iteratorStart(char** it_data, uint64_t* it_idx) {
-   *it_idx = 0;
-   *it_data = &state.data[0];
-   uint8_t* tag_ptr = &state.tags[0];
-   while (((*tag_ptr & tag_fill_mask) == 0) && *it_data != nullptr) {
-      // Advance iterator to the first occupied slot.
-      state.advanceNoWrap(*it_idx, *it_data, tag_ptr);
-   }
+   state.iteratorStart(it_data, it_idx);
 }
 
 void HashTableComplexKey::iteratorAdvance(char** it_data, uint64_t* it_idx) {
-   assert(*it_data != nullptr);
-   uint8_t* tag_ptr = &state.tags[*it_idx];
-   // Advance once to the next slot.
-   state.advanceNoWrap(*it_idx, *it_data, tag_ptr);
-   while (((*tag_ptr & tag_fill_mask) == 0) && *it_data != nullptr) {
-      // Advance until a free slot was found.
-      state.advanceNoWrap(*it_idx, *it_data, tag_ptr);
-   }
+   state.iteratorAdvance(it_data, it_idx);
 }
 
-HashTableComplexKey::LookupResult HashTableComplexKey::findSlotOrEmpty(uint64_t hash, const char* string) {
-   // Access the base table at the right index.
-   uint64_t idx = hash & state.mod_mask;
-   char* elem_ptr = &state.data[idx * state.total_slot_size];
-   uint8_t* tag_ptr = &state.tags[idx];
-   // Get the tag from the hash, take the highest order bits as these
-   // have the lowest risk of collision (lowest order bits are used to compute the slot).
-   auto target_tag = tag_hash_mask & static_cast<uint8_t>(hash >> 56ul);
-   for (;;) {
-      const uint8_t tag_fill = *tag_ptr & tag_fill_mask;
-      const uint8_t tag_hash = *tag_ptr & tag_hash_mask;
-      // Compare the actual strings within the slot.
-      const char* elem_string = *reinterpret_cast<char**>(elem_ptr);
-      if (!tag_fill || (tag_hash == target_tag && elem_string && (std::strcmp(elem_string, string) == 0))) {
-         // We either found the key or an empty slot indicating the key does not exist.
-         return {.elem = elem_ptr, .tag = tag_ptr};
+HashTableComplexKey::LookupResult HashTableComplexKey::findSlotOrEmpty(uint64_t hash, const char* key, const StringMeta* meta) {
+   const auto strings = reinterpret_cast<char* const*>(key);
+   const size_t idx = state.findSlotOrEmpty(hash, [&](const char* elem) {
+      // Reject on the full hash first, then on the string lengths and prefixes.
+      const char* elem_meta = elem + meta_offset;
+      if (std::memcmp(elem_meta, &hash, 8) != 0) {
+         return false;
       }
-      state.advance(idx, elem_ptr, tag_ptr);
-   }
+      if (std::memcmp(elem_meta + 8, meta, sizeof(StringMeta) * complex_key_slots) != 0) {
+         return false;
+      }
+      // Only now compare the actual strings within the slot.
+      const auto elem_strings = reinterpret_cast<char* const*>(elem);
+      for (uint16_t k = 0; k < complex_key_slots; ++k) {
+         if (meta[k].length > sizeof(meta[k].prefix) && std::memcmp(elem_strings[k], strings[k], meta[k].length) != 0) {
+            return false;
+         }
+      }
+      return std::memcmp(elem + 8 * complex_key_slots, key + 8 * complex_key_slots, simple_key_size) == 0;
+   });
+   return {.elem = state.rows[idx], .tag = &state.tags[idx], .idx = idx};
 }
 
-HashTableComplexKey::LookupResult HashTableComplexKey::findFirstEmptySlot(uint64_t hash) {
-   uint64_t idx = hash & state.mod_mask;
-   char* elem_ptr = &state.data[idx * state.total_slot_size];
-   uint8_t* tag_ptr = &state.tags[idx];
-
-   while (*tag_ptr != 0) {
-      state.advance(idx, elem_ptr, tag_ptr);
+void HashTableComplexKey::reserve(size_t num_keys) {
+   if (state.inserted + num_keys <= state.max_fill) {
+      return;
    }
-   return {.elem = elem_ptr, .tag = tag_ptr};
+   size_t slots = state.mod_mask + 1;
+   while (slots - slots / 4 < state.inserted + num_keys) {
+      slots *= 2;
+   }
+   grow(slots);
 }
 
 void HashTableComplexKey::reserveSlot() {
@@ -367,35 +638,18 @@ void HashTableComplexKey::reserveSlot() {
       return;
    }
 
-   // We need to resize. Indicate that this happened to the currently installed execution context.
-   // This will force the driver of the query to rerun the primitive if this used the interpreted path.
-   bool* try_restart_flag = ExecutionContext::tryGetInstalledRestartFlag();
-   if (try_restart_flag) {
-      *try_restart_flag = true;
-   }
-
-   char* curr_slot = &state.data[0];
-   uint8_t* curr_tag = &state.tags[0];
-   size_t old_max_slot = state.mod_mask;
-   // Double the size.
-   SharedHashTableState new_state(state.total_slot_size, 2 * (state.mod_mask + 1));
-   std::swap(new_state, state);
-   for (uint64_t idx = 0; idx <= old_max_slot; ++idx) {
-      if (*curr_tag) {
-         // If it's set, insert hash value into new table. Upper bit does not matter, so don't have to zero it out.
-         const auto indirection = reinterpret_cast<char* const*>(curr_slot);
-         const size_t len = std::strlen(*indirection);
-         const uint64_t hash = XXH3_64bits(*indirection, len);
-         const auto slot = findFirstEmptySlot(hash);
-         // Move over the tag.
-         *slot.tag = *curr_tag;
-         // Move over the full payload. The pointer stays the same, so memcpy is fine.
-         std::memcpy(slot.elem, curr_slot, state.total_slot_size);
-      }
-      curr_slot += state.total_slot_size;
-      curr_tag++;
-   }
-   state.inserted = new_state.inserted;
+   // Double the size. Rows never move, so the pointers handed out so far stay valid
+   // and vectorized primitives don't have to be restarted.
+   grow(2 * (state.mod_mask + 1));
+}
+
+void HashTableComplexKey::grow(size_t slots) {
+   // Only the index gets rebuilt using the hash stored in every row. The rows stay where they are.
+   state.rebuildIndex(slots, [&](const char* row) {
+      uint64_t hash;
+      std::memcpy(&hash, row + meta_offset, 8);
+      return hash;
+   });
 }
 
 size_t HashTableComplexKey::size() const {
@@ -406,57 +660,182 @@ size_t HashTableComplexKey::capacity() const {
    return state.mod_mask + 1;
 }
 
-HashTableDirectLookup::HashTableDirectLookup(uint16_t payload_size_)
-   : slot_size(2 + payload_size_) {
-   // Allocate array for direct lookup.
-   data = std::make_unique<char[]>((1 << 16) * slot_size);
-   tags = std::make_unique<bool[]>(1 << 16);
+HashTableStats HashTableComplexKey::getStats() const {
+   HashTableStats stats = state.stats;
+   stats.table = ID;
+   stats.groups = size();
+   stats.slots = capacity();
+   return stats;
+}
+
+HashTableDirectLookup::HashTableDirectLookup(uint16_t key_size_, uint16_t payload_size_)
+   : key_size(key_size_), payload_size(payload_size_), slot_size(key_size_ + payload_size_) {
+   if (key_size == 0 || key_size > 8) {
+      throw std::runtime_error("Direct lookup tables need keys of one to eight bytes.");
+   }
+   // Narrow keys get a slot for every value, so the window starts at zero.
+   window_placed = key_size <= 2;
+   dense_slots = window_placed ? (size_t{1} << (8 * key_size)) : window_slots;
+   key_mask = key_size == 8 ? ~uint64_t{0} : ((uint64_t{1} << (8 * key_size)) - 1);
+   pages.resize((dense_slots + page_slots - 1) / page_slots);
+}
+
+HashTableDirectLookup::HashTableDirectLookup(uint16_t key_size_, uint16_t payload_size_, uint64_t min_key, uint64_t max_key)
+   : HashTableDirectLookup(key_size_, payload_size_) {
+   // The span is computed modulo the key width, so signed ranges crossing zero work as well.
+   const uint64_t span = (max_key - min_key) & key_mask;
+   if (span < window_slots) {
+      window_start = min_key & key_mask;
+      dense_slots = span + 1;
+      window_placed = true;
+      pages.resize((dense_slots + page_slots - 1) / page_slots);
+   }
+}
+
+uint64_t HashTableDirectLookup::denseIdx(const char* key) {
+   uint64_t value = 0;
+   std::memcpy(&value, key, key_size);
+   return (value - window_start) & key_mask;
+}
+
+char* HashTableDirectLookup::denseSlot(uint64_t idx) {
+   const Page& page = pages[idx / page_slots];
+   const uint64_t page_idx = idx % page_slots;
+   return page.tags && page.tags[page_idx] ? &page.data[slot_size * page_idx] : nullptr;
+}
+
+void HashTableDirectLookup::allocatePage(size_t page_idx) {
+   // The last page only covers the remaining slots of the window.
+   const size_t slots = std::min(page_slots, dense_slots - page_idx * page_slots);
+   pages[page_idx].tags = TableMemory::makeArray<bool>(slots);
+   pages[page_idx].data = TableMemory::makeArray<char>(slots * slot_size);
+   allocated_slots += slots;
 }
 
 char* HashTableDirectLookup::lookup(const char* key) {
-   const uint16_t idx = *reinterpret_cast<const uint16_t*>(key);
-   return tags[idx] ? &data[slot_size * idx] : nullptr;
+   const uint64_t idx = denseIdx(key);
+   if (window_placed && idx < dense_slots) [[likely]] {
+      if constexpr (HashTableStats::collect_probes) {
+         stats.recordProbe(1, 0);
+      }
+      return denseSlot(idx);
+   }
+   return fallback ? fallback->lookup(key) : nullptr;
 }
 
 char* HashTableDirectLookup::lookupOrInsert(const char* key) {
-   const uint16_t idx = *reinterpret_cast<const uint16_t*>(key);
-   tags[idx] = true;
-   char* ptr = &data[slot_size * idx];
-   *reinterpret_cast<uint16_t*>(ptr) = idx;
-   return ptr;
+   char* result;
+   bool is_new_key;
+   lookupOrInsert(&result, &is_new_key, key);
+   return result;
+}
+
+void HashTableDirectLookup::lookupOrInsert(char** result, bool* is_new_key, const char* key) {
+   if (!window_placed) [[unlikely]] {
+      // Center the window on the first key. Keys inserted later can then lie below or above it.
+      uint64_t value = 0;
+      std::memcpy(&value, key, key_size);
+      window_start = (value - dense_slots / 2) & key_mask;
+      window_placed = true;
+   }
+   const uint64_t idx = denseIdx(key);
+   if (idx < dense_slots) [[likely]] {
+      if constexpr (HashTableStats::collect_probes) {
+         stats.recordProbe(1, 0);
+      }
+      Page& page = pages[idx / page_slots];
+      if (!page.tags) [[unlikely]] {
+         allocatePage(idx / page_slots);
+      }
+      const uint64_t page_idx = idx % page_slots;
+      char* ptr = &page.data[slot_size * page_idx];
+      *is_new_key = !page.tags[page_idx];
+      if (*is_new_key) {
+         page.tags[page_idx] = true;
+         std::memcpy(ptr, key, key_size);
+         dense_groups++;
+      }
+      *result = ptr;
+      return;
+   }
+   if (!fallback) {
+      // Creating the table in the middle of a morsel must not lead to growing it within the same morsel.
+      size_t start_slots = 2048;
+      while (start_slots - start_slots / 4 < reserved_keys) {
+         start_slots *= 2;
+      }
+      fallback = std::make_unique<HashTableSimpleKey>(key_size, payload_size, start_slots);
+   }
+   fallback->lookupOrInsert(result, is_new_key, key);
 }
 
 void HashTableDirectLookup::iteratorStart(char** it_data, uint64_t* it_idx) {
-   *it_data = &data[0];
    *it_idx = 0;
-   if (!tags[*it_idx]) {
+   *it_data = denseSlot(0);
+   if (!*it_data) {
       iteratorAdvance(it_data, it_idx);
    }
 }
 
 void HashTableDirectLookup::iteratorAdvance(char** it_data, uint64_t* it_idx) {
-   (*it_idx)++;
-   (*it_data) += slot_size;
-   while (*it_idx < (1 << 16)) {
-      if (tags[*it_idx]) {
+   if (*it_idx < dense_slots) {
+      (*it_idx)++;
+      while (*it_idx < dense_slots) {
+         if (!pages[*it_idx / page_slots].tags) {
+            // Skip pages which never received a key.
+            *it_idx = std::min(dense_slots, (*it_idx / page_slots + 1) * page_slots);
+            continue;
+         }
+         if ((*it_data = denseSlot(*it_idx))) {
+            return;
+         }
+         (*it_idx)++;
+      }
+      // Dense slots are exhausted, continue within the fallback table.
+      if (!fallback) {
+         *it_data = nullptr;
          return;
       }
-      (*it_idx)++;
-      (*it_data) += slot_size;
+      uint64_t fallback_idx;
+      fallback->iteratorStart(it_data, &fallback_idx);
+      *it_idx = dense_slots + fallback_idx;
+      return;
    }
-   *it_data = nullptr;
+   uint64_t fallback_idx = *it_idx - dense_slots;
+   fallback->iteratorAdvance(it_data, &fallback_idx);
+   *it_idx = dense_slots + fallback_idx;
 }
 
 size_t HashTableDirectLookup::size() const {
-   size_t count = 0;
-   for (size_t k = 0; k < 1 << 16; ++k) {
-      count += tags[k];
-   }
-   return count;
+   return dense_groups + fallbackSize();
 }
 
 size_t HashTableDirectLookup::capacity() const {
-   return 1 << 16;
+   return allocated_slots + (fallback ? fallback->capacity() : 0);
+}
+
+size_t HashTableDirectLookup::fallbackSize() const {
+   return fallback ? fallback->size() : 0;
+}
+
+HashTableStats HashTableDirectLookup::getStats() const {
+   HashTableStats result = stats;
+   result.peak_bytes_sum = allocated_slots * (slot_size + sizeof(bool));
+   if (fallback) {
+      result.merge(fallback->getStats());
+   }
+   result.table = ID;
+   result.groups = size();
+   result.slots = capacity();
+   return result;
+}
+
+void HashTableDirectLookup::reserve(size_t num_keys) {
+   if (fallback) {
+      fallback->reserve(num_keys);
+   } else {
+      reserved_keys = std::max(reserved_keys, num_keys);
+   }
 }
 
 }
@@ -1,34 +1,124 @@
 #ifndef INKFUSE_HASHTABLES_H
 #define INKFUSE_HASHTABLES_H
 
+#include "runtime/TableMemory.h"
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 /// This file contains the main hash tables used within InkFuse.
 namespace inkfuse {
 
+/// Statistics about the behaviour of a hash table on the actual data.
+/// Resizes, memory and load are tracked off the hot path and always available. Probe sequence
+/// lengths and fingerprint false positives are only collected in builds with HT_STATS enabled.
+struct HashTableStats {
+#ifdef WITH_HT_STATS
+   static constexpr bool collect_probes = true;
+#else
+   static constexpr bool collect_probes = false;
+#endif
+   /// Number of buckets within the probe length histogram.
+   static constexpr size_t probe_buckets = 8;
+
+   /// ID of the hash table type.
+   std::string table;
+   /// Histogram of probe sequence lengths. Bucket `k` counts the probes which inspected
+   /// [2^k, 2^(k+1)) slots, the last bucket also counts all longer probes.
+   std::array<uint64_t, probe_buckets> probe_lengths{};
+   /// Number of inspected slots whose tag matched the hash, but whose key did not.
+   uint64_t fingerprint_false_positives = 0;
+   /// Number of times the table grew.
+   uint64_t resizes = 0;
+   /// Time spent growing the table.
+   uint64_t resize_nanos = 0;
+   /// Largest amount of memory the table used at once. Merged statistics add up the peaks of all merged
+   /// tables, an upper bound for the peak of the logical table.
+   size_t peak_bytes_sum = 0;
+   /// Number of groups within the table.
+   size_t groups = 0;
+   /// Number of slots of the table.
+   size_t slots = 0;
+
+   /// Fraction of the slots that is filled.
+   double loadFactor() const;
+   /// Total number of recorded probes.
+   uint64_t probes() const;
+   /// Add the statistics of another table, e.g. another partition of the same logical table.
+   void merge(const HashTableStats& other);
+   /// Record a probe which inspected `length` slots. Can be called by multiple threads at once.
+   inline void recordProbe(size_t length, uint64_t false_positives);
+};
+
 /// Shared state between the different hash table implementations.
+///
+/// Rows (key and payload) get appended to a dense heap, the probing index only consists of a tag
+/// and a row pointer per slot. Growing the table only rebuilds the small index, rows never move.
+/// Pointers handed out by a table therefore stay valid until it gets destroyed, and iterating
+/// the table is a sequential scan over the heap.
 struct SharedHashTableState {
    SharedHashTableState(uint16_t total_slot_size_, size_t start_slots_);
 
-   /// Advance an iterator within the hash table.
-   inline void advance(size_t& idx, char*& curr, uint8_t*& tag) const;
-   /// Advance an iterator within the hash table. Sets the pointer to nullptr when the end of the hash table is reached.
-   inline void advanceNoWrap(size_t& idx, char*& curr, uint8_t*& tag) const;
+   /// Find the index of the first slot along the collision chain of `hash` which is either empty,
+   /// or whose tag matches the hash and `matches(row)` returns true.
+   /// Compares a whole group of tags at once if group probing is enabled.
+   /// Internal probes, e.g. while rebuilding the index, don't `record` themselves in the statistics.
+   template <bool record = true, class KeyMatches>
+   inline size_t findSlotOrEmpty(uint64_t hash, const KeyMatches& matches) const;
+   /// Append a new zero-initialized row to the heap and let the empty slot `idx` point to it.
+   inline char* emplace(size_t idx, uint8_t tag);
+   /// Append a new row to the heap while other threads append as well.
+   /// The heap must already have room for the row, it never grows concurrently.
+   inline char* appendConcurrent();
+   /// Rebuild the index with the given number of slots. `hash_of(row)` has to return the hash of a row.
+   template <class HashOf>
+   void rebuildIndex(size_t slots, const HashOf& hash_of);
+
+   /// Number of bytes currently allocated for the index and the heap.
+   size_t memoryBytes() const;
+
+   /// Get an iterator to the first row on the heap.
+   /// Sets it_data to nullptr if the iterator is exhausted.
+   void iteratorStart(char** it_data, uint64_t* it_idx) const;
+   /// Advance an iterator to the next row on the heap.
+   /// Sets it_data to nullptr if the iterator is exhausted.
+   void iteratorAdvance(char** it_data, uint64_t* it_idx) const;
+
+   /// Number of tags compared at once during group probing.
+   static constexpr size_t group_size = 16;
+   /// Name of the tag probing layout this build uses.
+   static const char* probing_layout;
 
    /// Occupied tags containing parts of the key hash.
    /// Similar approach as in folly f14 (just less fast and generic).
-   std::unique_ptr<uint8_t[]> tags;
-   /// Raw hash table state. Zero key is at the end.
-   std::unique_ptr<char[]> data;
+   TableMemory::Array<uint8_t> tags;
+   /// Row every occupied slot points to.
+   TableMemory::Array<char*> rows;
+   /// Heap chunks containing the rows in insertion order. The first chunk holds `chunk_rows` rows,
+   /// every further chunk as many as all chunks before it. This way, the heap doubles with every chunk.
+   std::vector<TableMemory::Array<char>> heap;
+   /// Number of rows in the first heap chunk, power of two.
+   size_t chunk_rows;
+   /// Number of rows the allocated heap chunks can hold.
+   size_t heap_rows;
    /// Index of the last slot, also serves as the modulo mask.
    uint64_t mod_mask;
-   /// Current number of inserted elements.
+   /// Current number of inserted elements. Equal to the number of rows on the heap.
    size_t inserted = 0;
-   /// Allowed maximum number of elements before resize.
+   /// Allowed maximum number of elements before resize. Group probing keeps the collision
+   /// chains cheap to walk, so three quarters of the slots can be filled.
    size_t max_fill;
    /// Total slot size.
    uint16_t total_slot_size;
+   /// Statistics of the table. Probes get recorded from const lookups.
+   mutable HashTableStats stats;
+
+   private:
+   /// Get the heap row at the given position.
+   inline char* heapRow(size_t pos) const;
 };
 
 /// A hash table where key equality checks can be performed as a simple memcmp.
@@ -40,9 +130,14 @@ struct HashTableSimpleKey {
 
    /// Get the pointer to a given key, or nullptr if the group does not exist.
    char* lookup(const char* key);
+   /// Same as above, but with a precomputed hash of the key.
+   char* lookup(const char* key, uint64_t hash);
    /// Get the pointer to a given key, or nullptr if the group does not exist.
    /// If it finds a slot, disables it. Needed for e.g. left semi joins.
+   /// Threads can disable keys concurrently, only one of them gets the row of a key.
    char* lookupDisable(const char* key);
+   /// Same as above, but with a precomputed hash of the key.
+   char* lookupDisable(const char* key, uint64_t hash);
    /// Get the pointer to a given key, creating a new group if it does not exist yet.
    char* lookupOrInsert(const char* key);
    /// Insert a new key - must only be called when we know the group does not exist yet.
@@ -51,6 +146,12 @@ struct HashTableSimpleKey {
    /// Updates the 'result' and 'is_new_key' arguments to give the caller
    /// insight into whether this key was new.
    void lookupOrInsert(char** result, bool* is_new_key, const char* key);
+   /// Same as above, but with a precomputed hash of the key.
+   void lookupOrInsert(char** result, bool* is_new_key, const char* key, uint64_t hash);
+   /// Compute the hash of a key.
+   uint64_t hash(const char* key) const;
+   /// Prefetch the tags and the first slot a lookup for the hash will access.
+   void prefetch(uint64_t hash) const;
    /// Get an iterator to the first non-empty element of the hash table.
    /// Sets it_data to nullptr if the iterator is exhausted.
    void iteratorStart(char** it_data, uint64_t* it_idx);
@@ -61,36 +162,117 @@ struct HashTableSimpleKey {
    size_t size() const;
    /// Get the current capacity. Mainly used for testing.
    size_t capacity() const;
+   /// Get the statistics collected by the table.
+   HashTableStats getStats() const;
+   /// Make sure `num_keys` more keys can be inserted without growing the table. Only a sizing hint:
+   /// growing never moves a row, so it is fine for a table to grow in the middle of a vectorized primitive.
+   /// Reserving up front for a whole chunk just saves rebuilding the index multiple times.
+   void reserve(size_t num_keys);
+
+   /// Variants of the hot lookup paths specialized on a key width known at compile time.
+   /// Keys get hashed and compared through fixed-size loads instead of a variable-length memcmp.
+   /// Must only be called if the key size of the table is `key_width`, see `fixed_key_widths`.
+   template <uint16_t key_width>
+   static uint64_t hashFixed(const char* key);
+   template <uint16_t key_width>
+   char* lookupFixed(const char* key, uint64_t hash);
+   template <uint16_t key_width>
+   void lookupOrInsertFixed(char** result, bool* is_new_key, const char* key, uint64_t hash);
 
    /// Special function if we know this hash table is only ever called with a single key.
    char* lookupOrInsertSingleKey();
 
+   /// Insert all slots of another hash table with the same layout. Other threads may merge into
+   /// this table at the same time: slots are claimed through a compare-and-swap on their tag.
+   /// The table never grows during the merge and must be large enough for all merged slots.
+   /// Keys which already exist are skipped.
+   void mergeConcurrent(const HashTableSimpleKey& other);
+
    private:
    struct LookupResult {
+      /// Row of the slot, nullptr if the slot is empty.
       char* elem;
       uint8_t* tag;
+      /// Index of the slot.
+      size_t idx;
    };
 
    /// Find the correct slot for the key, or the first one which is empty.
    inline LookupResult findSlotOrEmpty(uint64_t hash, const char* string);
+   /// Same as above, comparing keys of a fixed width. A width of 0 uses the key size of the table.
+   template <uint16_t key_width>
+   inline LookupResult findSlotOrEmptyFixed(uint64_t hash, const char* key);
    /// Find the first empty slot for the given hash.
    inline LookupResult findFirstEmptySlot(uint64_t hash);
    /// Make sure one more slot can be added to the hash table.
    /// If not, doubles size.
    void reserveSlot();
+   /// Rehash the index into one with the given number of slots.
+   void grow(size_t slots);
+   /// Insert a full slot while other threads insert as well. Returns false if the key already existed.
+   inline bool insertConcurrent(const char* slot, uint64_t hash);
 
    SharedHashTableState state;
    /// Size of the materialized simple key.
    uint16_t simple_key_size;
 };
 
-/// A hash table with a more complex key. In principle, the key can contain both
-/// a simple part which can just be memcmpared, as well as a set of
-/// successive key slots for more complex data types (such as strings).
-/// Currently we only support using a single string as key.
+/// Key widths for which HashTableSimpleKey has specialized runtime functions.
+constexpr std::array<uint16_t, 4> fixed_key_widths{4, 8, 12, 16};
+
+/// Names the runtime functions of a hash table that are specialized on a fixed key width,
+/// e.g. `ht_sk8_lookup`. They get called on the `HashTable` itself, this type only carries the ID.
+template <class HashTable, uint16_t key_width>
+struct FixedKeyWidth {
+   /// The hash table the runtime functions operate on.
+   using Table = HashTable;
+   /// Unique ID of the specialized runtime functions.
+   static const std::string ID;
+};
+
+/// The hash table whose runtime functions should be used for the key width, falling back to the generic
+/// ones if there is no specialization (width 0).
+template <class HashTable, uint16_t key_width>
+using KeyWidthSpecialized = std::conditional_t<key_width == 0, HashTable, FixedKeyWidth<HashTable, key_width>>;
+
+/// Invoke `fct` with the key size as compile-time constant if there is a specialization for it, or with 0 otherwise.
+template <class Fct>
+auto dispatchKeyWidth(size_t key_size, Fct&& fct) {
+   switch (key_size) {
+      case 4:
+         return fct(std::integral_constant<uint16_t, 4>{});
+      case 8:
+         return fct(std::integral_constant<uint16_t, 8>{});
+      case 12:
+         return fct(std::integral_constant<uint16_t, 12>{});
+      case 16:
+         return fct(std::integral_constant<uint16_t, 16>{});
+      default:
+         return fct(std::integral_constant<uint16_t, 0>{});
+   }
+}
+
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 4>::ID;
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 8>::ID;
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 12>::ID;
+template <>
+const std::string FixedKeyWidth<HashTableSimpleKey, 16>::ID;
+
+/// A hash table with a more complex key. The packed key starts with a set of
+/// successive 8 byte slots for variable-length strings, followed by a simple
+/// fixed-width part which can just be memcmpared.
+///
+/// Behind the payload, every slot stores the key hash as well as the length and a
+/// four byte prefix of every string. Growing the table never has to rehash, and
+/// most non-matching keys are rejected before the strings are compared.
 struct HashTableComplexKey {
    /// Unique Hash Table ID.
    static const std::string ID;
+   /// Maximum number of string slots within a key.
+   static constexpr uint16_t max_complex_key_slots = 16;
 
    HashTableComplexKey(uint16_t simple_key_size, uint16_t complex_key_slots, uint16_t payload_size, size_t start_slots = 64);
 
@@ -102,6 +284,10 @@ struct HashTableComplexKey {
    /// Updates the 'result' and 'is_new_key' arguments to give the caller
    /// insight into whether this key was new.
    void lookupOrInsert(char** result, bool* is_new_key, const char* key);
+   /// Same as above, but with a precomputed hash of the key.
+   void lookupOrInsert(char** result, bool* is_new_key, const char* key, uint64_t hash);
+   /// Compute the hash of a key.
+   uint64_t hash(const char* key) const;
 
    /// Get an iterator to the first non-empty element of the hash table.
    /// Sets it_data to nullptr if the iterator is exhausted.
@@ -114,6 +300,10 @@ struct HashTableComplexKey {
    size_t size() const;
    /// Get the current capacity. Mainly used for testing.
    size_t capacity() const;
+   /// Get the statistics collected by the table.
+   HashTableStats getStats() const;
+   /// Make sure `num_keys` more keys can be inserted without growing the table.
+   void reserve(size_t num_keys);
 
    private:
    SharedHashTableState state;
@@ -123,57 +313,132 @@ struct HashTableComplexKey {
    uint16_t complex_key_slots;
    /// Size of the payload in bytes.
    uint16_t payload_size;
+   /// Size of the packed key, strings first.
+   uint16_t key_size;
+   /// Offset of the slot metadata (hash, string lengths and prefixes) behind the payload.
+   uint16_t meta_offset;
 
    private:
    struct LookupResult {
+      /// Row of the slot, nullptr if the slot is empty.
       char* elem;
       uint8_t* tag;
+      /// Index of the slot.
+      size_t idx;
+   };
+
+   /// Metadata of a single string within the key.
+   struct StringMeta {
+      uint32_t length;
+      char prefix[4];
    };
 
+   /// Compute the metadata of all strings within the key.
+   inline void describe(const char* key, StringMeta* meta) const;
+   /// Hash a key whose string metadata was already computed.
+   inline uint64_t hashDescribed(const char* key, const StringMeta* meta) const;
    /// Find the correct slot for the key, or the first one which is empty.
-   inline LookupResult findSlotOrEmpty(uint64_t hash, const char* key);
-   /// Find the first empty slot for the given hash.
-   inline LookupResult findFirstEmptySlot(uint64_t hash);
+   inline LookupResult findSlotOrEmpty(uint64_t hash, const char* key, const StringMeta* meta);
    /// Make sure one more slot can be added to the hash table.
    /// If not, doubles size.
    void reserveSlot();
+   /// Rebuild the index with the given number of slots.
+   void grow(size_t slots);
 };
 
-/// A hash table using direct lookup on the key index. No hashing, no nothing.
-/// Should be used for 2 byte keys. Okay - this is a bit micro-optimized for TPC-H Q1,
-/// we should also have a one byte variation. But we don't need it a the moment.
-/// This is not an architectural limitation.
+/// A dense-array grouping table for keys of at most 8 bytes. The key bytes are read as a little-endian
+/// integer which directly indexes into an array of slots. No hashing, no nothing.
+/// If the range of the keys is known up front, the window of dense slots covers exactly that range.
+/// Otherwise, keys of one or two bytes get a slot for every possible value, while wider keys get a window of
+/// `window_slots` consecutive values, centered on the first inserted key. Keys outside of the window
+/// fall back to a regular HashTableSimpleKey. This keeps the table correct if the key range turns
+/// out to be larger than expected, while dense keys such as dates skip hashing entirely.
+/// The window is split into pages which only get allocated once the first key falls into them,
+/// so clustered keys only pay for the slots around them. Slots never move.
 struct HashTableDirectLookup {
    /// Unique Hash Table ID.
    static const std::string ID;
+   /// Maximum number of dense slots for keys wider than two bytes.
+   static constexpr size_t window_slots = 1 << 16;
+   /// Number of dense slots within a page.
+   static constexpr size_t page_slots = 1024;
 
-   HashTableDirectLookup(uint16_t payload_size_);
+   /// Create a table on keys with an unknown range.
+   HashTableDirectLookup(uint16_t key_size_, uint16_t payload_size_);
+   /// Create a table on keys within [min_key, max_key]. The bounds are the key bytes read as little-endian integer.
+   /// Ranges wider than `window_slots` are treated as unknown.
+   HashTableDirectLookup(uint16_t key_size_, uint16_t payload_size_, uint64_t min_key, uint64_t max_key);
 
    /// Get the pointer to a given key, or nullptr if the group does not exist.
    char* lookup(const char* key);
    /// Get the pointer to a given key, creating a new group if it does not exist yet.
    char* lookupOrInsert(const char* key);
-
+   /// Get the pointer to a given key, creating a new group if it does not exist yet.
+   /// Updates the 'result' and 'is_new_key' arguments to give the caller
+   /// insight into whether this key was new.
+   void lookupOrInsert(char** result, bool* is_new_key, const char* key);
 
    /// Get an iterator to the first non-empty element of the hash table.
    /// Sets it_data to nullptr if the iterator is exhausted.
    void iteratorStart(char** it_data, uint64_t* it_idx);
    /// Advance an iterator to the next non-empty element in the hash table.
+   /// Iterates the dense slots first, followed by the fallback table.
    /// Sets it_data to nullptr if the iterator is exhausted.
    void iteratorAdvance(char** it_data, uint64_t* it_idx);
    /// Get the current size. Mainly used for testing.
    size_t size() const;
-   /// Get the current capacity. Mainly used for testing.
+   /// Get the current capacity: the slots of all allocated pages and of the fallback. Mainly used for testing.
    size_t capacity() const;
+   /// Number of groups in the fallback hash table. Mainly used for testing.
+   size_t fallbackSize() const;
+   /// Get the statistics collected by the table, including the ones of the fallback table.
+   HashTableStats getStats() const;
+   /// The dense slots never grow, only the fallback table may have to.
+   void reserve(size_t num_keys);
 
-   /// Data managed by the hash table.
-   std::unique_ptr<char[]> data;
-   /// Tags indicating which slot contains data.
-   std::unique_ptr<bool[]> tags;
+   private:
+   /// A page of dense slots.
+   struct Page {
+      /// Tags indicating which slot contains data. Null until the page gets allocated.
+      TableMemory::Array<bool> tags;
+      /// Data of the slots.
+      TableMemory::Array<char> data;
+   };
+
+   /// Get the dense slot index of a key, or `dense_slots` if the key is outside of the window.
+   inline uint64_t denseIdx(const char* key);
+   /// Get the dense slot with the given index, or nullptr if it is empty.
+   inline char* denseSlot(uint64_t idx);
+   /// Allocate the page of a dense slot.
+   void allocatePage(size_t page_idx);
+
+   /// The pages of the dense slots.
+   std::vector<Page> pages;
+   /// Number of slots within the allocated pages.
+   size_t allocated_slots = 0;
+   /// Fallback for keys outside of the dense window. Created on the first such key.
+   std::unique_ptr<HashTableSimpleKey> fallback;
+   /// Number of dense slots.
+   uint64_t dense_slots;
+   /// Key value stored in the first dense slot.
+   uint64_t window_start = 0;
+   /// Mask covering all bits of a key. Keys get subtracted modulo the key width, so that windows
+   /// also work across the sign boundary of signed integers.
+   uint64_t key_mask;
+   /// Has the window been placed yet? Only false for wider keys of unknown range.
+   bool window_placed;
+   /// Number of groups within the dense slots.
+   size_t dense_groups = 0;
+   /// Largest number of keys reserved for at once, the fallback table gets created large enough for it.
+   size_t reserved_keys = 0;
    /// Size of the materialized simple key.
    uint16_t key_size;
+   /// Size of the payload.
+   uint16_t payload_size;
    /// Total slot size.
    uint16_t slot_size;
+   /// Statistics about the dense lookups.
+   HashTableStats stats;
 };
 
 }
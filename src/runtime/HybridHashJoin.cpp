@@ -0,0 +1,376 @@
+#include "runtime/HybridHashJoin.h"
+#include "exec/FuseChunk.h"
+#include "runtime/HashRuntime.h"
+#include "runtime/PartitionedHashTables.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace inkfuse {
+
+namespace {
+/// Size of the write buffer of a spilled partition.
+const size_t spill_buffer_size = 1 << 16;
+
+/// Create an empty hash table that can take the given number of rows without growing.
+std::unique_ptr<HashTableSimpleKey> sizedTable(uint16_t key_size, uint16_t payload_size, size_t rows) {
+   return std::make_unique<HashTableSimpleKey>(key_size, payload_size, std::bit_ceil(std::max(2 * rows, size_t{2})));
+}
+
+/// Insert a packed build row into a hash table that is large enough.
+void insertRow(HashTableSimpleKey& table, const char* row, uint16_t key_size, uint16_t payload_size) {
+   // The build side of a primary key join has no duplicate keys.
+   char* slot = table.insert(row);
+   std::memcpy(slot + key_size, row + key_size, payload_size);
+}
+}
+
+HybridHashJoin::ThreadBuild::ThreadBuild(HybridHashJoin& join_)
+   : join(join_),
+     current(join_.key_size + join_.payload_size, join_.key_size),
+     previous(join_.key_size + join_.payload_size, join_.key_size),
+     spill_buffers(num_partitions) {
+   partitions.reserve(num_partitions);
+   for (size_t k = 0; k < num_partitions; ++k) {
+      // Partitioning copies the full row.
+      partitions.emplace_back(current.rowSize(), current.rowSize());
+   }
+}
+
+char* HybridHashJoin::ThreadBuild::append(const char* key) {
+   if (current.size() == DEFAULT_CHUNK_SIZE) {
+      // A morsel never appends more than DEFAULT_CHUNK_SIZE rows. The rows of `previous` were all
+      // appended by morsels that are done and can be partitioned.
+      partition(previous);
+      previous = std::move(current);
+      current = RowBuffer(previous.rowSize(), join.key_size);
+   }
+   return current.append(key);
+}
+
+void HybridHashJoin::ThreadBuild::partition(RowBuffer& rows) {
+   const uint32_t row_size = rows.rowSize();
+   for (size_t block_idx = 0; block_idx < rows.numBlocks(); ++block_idx) {
+      auto [block, block_rows] = rows.getBlock(block_idx);
+      for (size_t row_idx = 0; row_idx < block_rows; ++row_idx) {
+         const char* row = block + row_idx * row_size;
+         const size_t partition = partitionIdx(HashRuntime::hashKey(row, join.key_size));
+         auto& target = partitions[partition];
+         if (!join.evicted[partition].load(std::memory_order_relaxed)) {
+            if (target.size() % RowBuffer::rows_per_block != 0 || join.reserveBuildBlock(partition)) {
+               target.append(row);
+               continue;
+            }
+         }
+         join.spill(spill_buffers, join.build_files, partition, row, row_size);
+      }
+   }
+   rows = RowBuffer(row_size, join.key_size);
+   spillEvicted();
+}
+
+void HybridHashJoin::ThreadBuild::spillEvicted() {
+   for (size_t partition = 0; partition < num_partitions; ++partition) {
+      auto& rows = partitions[partition];
+      if (rows.size() == 0 || !join.evicted[partition].load(std::memory_order_relaxed)) {
+         continue;
+      }
+      for (size_t block_idx = 0; block_idx < rows.numBlocks(); ++block_idx) {
+         // The rows within a block are contiguous.
+         auto [block, block_rows] = rows.getBlock(block_idx);
+         join.spill(spill_buffers, join.build_files, partition, block, block_rows * rows.rowSize());
+      }
+      rows = RowBuffer(rows.rowSize(), rows.rowSize());
+   }
+}
+
+HybridHashJoin::ThreadProbe::ThreadProbe(HybridHashJoin& join_)
+   : join(join_), matches(join_.matchSize(), join_.match_probe_size), spill_buffers(num_partitions) {
+}
+
+void HybridHashJoin::ThreadProbe::probe(const char* row, uint64_t hash) {
+   const size_t partition = partitionIdx(hash);
+   if (join.evicted[partition].load(std::memory_order_relaxed)) {
+      // The build rows of the partition are on disk, join the probe row later.
+      join.spill(spill_buffers, join.probe_files, partition, row, join.probe_size);
+      return;
+   }
+   char* build_row = join.semi_join ? join.resident.lookupDisable(row, hash) : join.resident.lookup(row, hash);
+   if (!build_row) {
+      return;
+   }
+   if (matches.size() % RowBuffer::rows_per_block == 0) {
+      // We need a new block for the match. If this exceeds the memory budget, write out the matches of this worker.
+      const size_t block_bytes = RowBuffer::rows_per_block * matches.rowSize();
+      const size_t used = join.match_bytes.fetch_add(block_bytes) + block_bytes + join.resident_bytes;
+      if (used > join.memory_budget && matches.size() > 0) {
+         if (!match_file) {
+            match_file = std::make_unique<SpillFile>();
+         }
+         for (size_t block_idx = 0; block_idx < matches.numBlocks(); ++block_idx) {
+            auto [block, block_rows] = matches.getBlock(block_idx);
+            match_file->write(block, block_rows * matches.rowSize());
+         }
+         join.match_bytes -= matches.numBlocks() * block_bytes;
+         matches = RowBuffer(matches.rowSize(), join.match_probe_size);
+      }
+   }
+   char* match = matches.append(row);
+   std::memcpy(match + join.match_probe_size, &build_row, sizeof(char*));
+}
+
+HybridHashJoin::HybridHashJoin(HashTableSimpleKey& resident_, uint16_t key_size_, uint16_t payload_size_, uint16_t probe_size_, size_t memory_budget_, bool semi_join_, size_t max_rows_)
+   : resident(resident_), key_size(key_size_), payload_size(payload_size_), probe_size(probe_size_), match_probe_size(semi_join_ ? 0 : probe_size_), memory_budget(memory_budget_), semi_join(semi_join_), max_rows(max_rows_) {
+   for (size_t k = 0; k < num_partitions; ++k) {
+      evicted[k] = false;
+      partition_bytes[k] = 0;
+   }
+}
+
+size_t HybridHashJoin::partitionIdx(uint64_t hash) {
+   // Partition on the same bits as the parallel aggregation. They are independent of the slot and the tag.
+   return PartitionedHashTable<HashTableSimpleKey>::partitionIdx(hash, num_partitions);
+}
+
+bool HybridHashJoin::reserveBuildBlock(size_t partition) {
+   std::unique_lock guard(evict_lock);
+   if (evicted[partition]) {
+      return false;
+   }
+   const size_t block_bytes = RowBuffer::rows_per_block * (key_size + payload_size);
+   partition_bytes[partition] += block_bytes;
+   resident_bytes += block_bytes;
+   while (resident_bytes > memory_budget) {
+      // Evict the largest partition. The workers write out their rows of the partition once
+      // they partition the next rows.
+      size_t largest = num_partitions;
+      for (size_t k = 0; k < num_partitions; ++k) {
+         if (!evicted[k] && (largest == num_partitions || partition_bytes[k] > partition_bytes[largest])) {
+            largest = k;
+         }
+      }
+      if (largest == num_partitions) {
+         break;
+      }
+      evicted[largest] = true;
+      resident_bytes -= partition_bytes[largest];
+   }
+   return !evicted[partition];
+}
+
+void HybridHashJoin::spill(std::vector<std::vector<char>>& buffers, std::array<std::unique_ptr<SpillFile>, num_partitions>& files, size_t partition, const char* data, size_t size) {
+   auto& buffer = buffers[partition];
+   buffer.insert(buffer.end(), data, data + size);
+   if (buffer.size() >= spill_buffer_size) {
+      flush(buffers, files);
+   }
+}
+
+void HybridHashJoin::flush(std::vector<std::vector<char>>& buffers, std::array<std::unique_ptr<SpillFile>, num_partitions>& files) {
+   for (size_t partition = 0; partition < num_partitions; ++partition) {
+      auto& buffer = buffers[partition];
+      if (buffer.empty()) {
+         continue;
+      }
+      SpillFile* file;
+      {
+         std::unique_lock guard(files_lock);
+         if (!files[partition]) {
+            files[partition] = std::make_unique<SpillFile>();
+         }
+         file = files[partition].get();
+      }
+      file->write(buffer.data(), buffer.size());
+      buffer.clear();
+   }
+}
+
+HybridHashJoin::ThreadBuild& HybridHashJoin::getThreadBuild(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_builds.size() <= thread_id) {
+      thread_builds.push_back(std::make_unique<ThreadBuild>(*this));
+   }
+   return *thread_builds[thread_id];
+}
+
+void HybridHashJoin::finalizeBuild(size_t thread_id) {
+   // The first worker partitions the remaining rows of all workers, the other ones wait until it is done.
+   std::call_once(build_finalized, [&]() {
+      for (auto& build : thread_builds) {
+         build->partition(build->previous);
+         build->partition(build->current);
+      }
+      // Partitioning the rows of later workers can evict partitions of earlier ones.
+      size_t resident_rows = 0;
+      for (auto& build : thread_builds) {
+         build->spillEvicted();
+         flush(build->spill_buffers, build_files);
+         for (const auto& rows : build->partitions) {
+            resident_rows += rows.size();
+         }
+      }
+
+      // All remaining rows fit into memory. The resident table never grows, keeping the probes fast.
+      resident = std::move(*sizedTable(key_size, payload_size, resident_rows));
+      for (const auto& build : thread_builds) {
+         for (const auto& rows : build->partitions) {
+            for (size_t block_idx = 0; block_idx < rows.numBlocks(); ++block_idx) {
+               auto [block, block_rows] = rows.getBlock(block_idx);
+               for (size_t row_idx = 0; row_idx < block_rows; ++row_idx) {
+                  insertRow(resident, block + row_idx * rows.rowSize(), key_size, payload_size);
+               }
+            }
+         }
+      }
+      thread_builds.clear();
+      resident_bytes = resident_rows * (key_size + payload_size);
+   });
+}
+
+HybridHashJoin::ThreadProbe& HybridHashJoin::getThreadProbe(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_probes.size() <= thread_id) {
+      thread_probes.push_back(std::make_unique<ThreadProbe>(*this));
+   }
+   return *thread_probes[thread_id];
+}
+
+void HybridHashJoin::finalizeProbe(size_t thread_id) {
+   auto& probe = getThreadProbe(thread_id);
+   flush(probe.spill_buffers, probe_files);
+}
+
+HybridHashJoin::ThreadOutput& HybridHashJoin::getThreadOutput(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_outputs.size() <= thread_id) {
+      auto& output = thread_outputs.emplace_back(std::make_unique<ThreadOutput>());
+      output->build_rows = std::make_unique<char*[]>(max_rows);
+      output->probe_rows = std::make_unique<char*[]>(max_rows);
+      output->buffer = std::make_unique<char[]>(max_rows * std::max(matchSize(), size_t{probe_size}));
+   }
+   return *thread_outputs[thread_id];
+}
+
+bool HybridHashJoin::claimWork(ThreadOutput& output) {
+   {
+      std::unique_lock guard(lock);
+      if (!work_collected) {
+         // The probe pipeline is done, all matches and spilled rows are known now.
+         for (const auto& probe : thread_probes) {
+            for (size_t block_idx = 0; block_idx < probe->matches.numBlocks(); ++block_idx) {
+               auto [block, block_rows] = probe->matches.getBlock(block_idx);
+               work.push_back(Work{.kind = Work::Kind::MatchBlock, .block = block, .block_size = block_rows});
+            }
+            if (probe->match_file) {
+               work.push_back(Work{.kind = Work::Kind::MatchFile, .file = probe->match_file.get()});
+            }
+         }
+         for (size_t partition = 0; partition < num_partitions; ++partition) {
+            // Partitions without build or probe rows cannot produce a match.
+            if (build_files[partition] && probe_files[partition]) {
+               work.push_back(Work{.kind = Work::Kind::Partition, .file = probe_files[partition].get(), .partition = partition});
+            }
+         }
+         work_collected = true;
+      }
+      if (next_work == work.size()) {
+         return false;
+      }
+      output.work = work[next_work++];
+      output.block_offset = 0;
+   }
+   if (output.work->kind == Work::Kind::Partition) {
+      // Loading the partition is the expensive part, do it outside of the lock.
+      output.table = loadPartition(output.work->partition);
+   }
+   return true;
+}
+
+std::unique_ptr<HashTableSimpleKey> HybridHashJoin::loadPartition(size_t partition) {
+   SpillFile& file = *build_files[partition];
+   const size_t row_size = key_size + payload_size;
+   auto table = sizedTable(key_size, payload_size, file.size() / row_size);
+   auto rows = std::make_unique<char[]>(RowBuffer::rows_per_block * row_size);
+   while (const size_t bytes = file.read(rows.get(), RowBuffer::rows_per_block * row_size)) {
+      for (size_t offset = 0; offset < bytes; offset += row_size) {
+         insertRow(*table, rows.get() + offset, key_size, payload_size);
+      }
+   }
+   // The build rows are only needed once.
+   build_files[partition].reset();
+   return table;
+}
+
+size_t HybridHashJoin::produce(size_t thread_id) {
+   auto& output = getThreadOutput(thread_id);
+   const size_t match_size = matchSize();
+   while (output.work || claimWork(output)) {
+      size_t produced = 0;
+      size_t consumed = 0;
+      switch (output.work->kind) {
+         case Work::Kind::MatchBlock: {
+            consumed = std::min(max_rows, output.work->block_size - output.block_offset);
+            for (size_t k = 0; k < consumed; ++k) {
+               char* match = output.work->block + (output.block_offset + k) * match_size;
+               output.probe_rows[produced] = match;
+               std::memcpy(&output.build_rows[produced], match + match_probe_size, sizeof(char*));
+               produced++;
+            }
+            output.block_offset += consumed;
+            break;
+         }
+         case Work::Kind::MatchFile: {
+            consumed = output.work->file->read(output.buffer.get(), max_rows * match_size) / match_size;
+            for (size_t k = 0; k < consumed; ++k) {
+               char* match = output.buffer.get() + k * match_size;
+               output.probe_rows[produced] = match;
+               std::memcpy(&output.build_rows[produced], match + match_probe_size, sizeof(char*));
+               produced++;
+            }
+            break;
+         }
+         case Work::Kind::Partition: {
+            consumed = output.work->file->read(output.buffer.get(), max_rows * probe_size) / probe_size;
+            for (size_t k = 0; k < consumed; ++k) {
+               char* row = output.buffer.get() + k * probe_size;
+               char* build_row = semi_join ? output.table->lookupDisable(row) : output.table->lookup(row);
+               if (build_row) {
+                  output.probe_rows[produced] = row;
+                  output.build_rows[produced] = build_row;
+                  produced++;
+               }
+            }
+            break;
+         }
+      }
+      if (consumed == 0) {
+         // The work is done, move on to the next one.
+         output.work.reset();
+         output.table.reset();
+         continue;
+      }
+      if (produced > 0) {
+         return produced;
+      }
+   }
+   return 0;
+}
+
+char** HybridHashJoin::getOutput(size_t thread_id, bool build_side) {
+   auto& output = getThreadOutput(thread_id);
+   return build_side ? output.build_rows.get() : output.probe_rows.get();
+}
+
+double HybridHashJoin::progress() const {
+   std::unique_lock guard(lock);
+   if (work.empty()) {
+      return 1.0;
+   }
+   return static_cast<double>(next_work) / work.size();
+}
+
+size_t HybridHashJoin::numEvictedPartitions() const {
+   return std::count_if(evicted.begin(), evicted.end(), [](const std::atomic<bool>& flag) { return flag.load(); });
+}
+
+}
@@ -0,0 +1,214 @@
+#ifndef INKFUSE_HYBRIDHASHJOIN_H
+#define INKFUSE_HYBRIDHASHJOIN_H
+
+#include "runtime/JoinHashTables.h"
+#include "runtime/SpillFile.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/// This file contains the state of primary key joins whose build side can exceed the available memory.
+namespace inkfuse {
+
+/// Hybrid hash join for primary key joins. Build and probe rows are radix-partitioned on the hash of their key.
+/// As long as the build rows fit into the memory budget, all partitions stay in memory. Once they exceed
+/// it, the largest partitions get evicted to local disk until the remaining ones fit again.
+/// This way, as many partitions as possible are joined without ever touching the disk.
+///
+/// - Build: every worker appends its packed build rows (key followed by the payload). Rows get partitioned once the
+///   morsel that produced them is done. When the build pipeline is done, the rows of the resident partitions are
+///   inserted into the `resident` hash table.
+/// - Probe: probe rows of resident partitions are looked up right away and their matches are remembered.
+///   Probe rows of evicted partitions are spilled to disk.
+/// - Output: a followup pipeline first produces the remembered matches. Afterwards, the evicted partitions get
+///   joined pair-wise: the build partition is read back into a hash table and the probe partition is streamed through it.
+struct HybridHashJoin final : public JoinRows {
+   /// Set up the join. `probe_size_` is the size of a packed probe row. Semi joins disable every build row
+   /// that found a match and don't keep the probe rows of their matches.
+   HybridHashJoin(HashTableSimpleKey& resident_, uint16_t key_size_, uint16_t payload_size_, uint16_t probe_size_, size_t memory_budget_, bool semi_join_, size_t max_rows_);
+
+   /// Number of partitions of the build and probe rows.
+   static constexpr size_t num_partitions = 64;
+
+   /// Build side of a worker thread.
+   struct ThreadBuild {
+      ThreadBuild(HybridHashJoin& join_);
+
+      /// Append a new build row and copy the key into it. Returns the row.
+      char* append(const char* key);
+
+      private:
+      friend struct HybridHashJoin;
+
+      /// Partition the given rows, they are not accessed by any running morsel anymore.
+      void partition(RowBuffer& rows);
+      /// Spill the resident rows of all partitions that got evicted.
+      void spillEvicted();
+
+      /// The join.
+      HybridHashJoin& join;
+      /// The rows appended by the current and the previous DEFAULT_CHUNK_SIZE appends.
+      /// The running morsel may still be writing the payload of these rows.
+      RowBuffer current;
+      RowBuffer previous;
+      /// The partitioned rows of the partitions which were not evicted yet.
+      std::vector<RowBuffer> partitions;
+      /// Write buffers of the evicted partitions.
+      std::vector<std::vector<char>> spill_buffers;
+   };
+
+   /// Probe side of a worker thread.
+   struct ThreadProbe {
+      ThreadProbe(HybridHashJoin& join_);
+
+      /// Probe a packed probe row with the given key hash.
+      void probe(const char* row, uint64_t hash);
+
+      private:
+      friend struct HybridHashJoin;
+
+      /// The join.
+      HybridHashJoin& join;
+      /// The matches within the resident partitions: the probe row followed by a pointer to the build row.
+      RowBuffer matches;
+      /// Matches that were spilled because they exceeded the memory budget.
+      std::unique_ptr<SpillFile> match_file;
+      /// Write buffers of the evicted partitions.
+      std::vector<std::vector<char>> spill_buffers;
+   };
+
+   /// Get the build side of a worker thread. Creates it on first access.
+   ThreadBuild& getThreadBuild(size_t thread_id);
+   /// Partition the remaining build rows of all workers and build the resident hash table.
+   /// Must be called by every worker thread once all of them are done building.
+   void finalizeBuild(size_t thread_id);
+
+   /// Get the probe side of a worker thread. Creates it on first access.
+   ThreadProbe& getThreadProbe(size_t thread_id);
+   /// Write out the spilled probe rows of a worker. Must be called by every worker thread once it is done probing.
+   void finalizeProbe(size_t thread_id);
+
+   /// Produce the remembered matches first, then join the evicted partitions.
+   size_t produce(size_t thread_id) override;
+   char** getOutput(size_t thread_id, bool build_side) override;
+   /// Fraction of the match blocks and evicted partitions which were claimed already.
+   double progress() const override;
+
+   /// Get the number of evicted partitions. Mainly used for testing.
+   size_t numEvictedPartitions() const;
+
+   private:
+   /// A unit of work of the output phase.
+   struct Work {
+      enum class Kind {
+         /// A block of matches in memory.
+         MatchBlock,
+         /// A file of spilled matches.
+         MatchFile,
+         /// An evicted pair of partitions.
+         Partition,
+      };
+      Kind kind;
+      /// The block of matches.
+      char* block = nullptr;
+      /// Number of matches within the block.
+      size_t block_size = 0;
+      /// The file of matches, or the probe rows of the partition.
+      SpillFile* file = nullptr;
+      /// The evicted partition.
+      size_t partition = 0;
+   };
+
+   /// Output state of a worker thread.
+   struct ThreadOutput {
+      /// The produced build rows.
+      std::unique_ptr<char*[]> build_rows;
+      /// The produced probe rows.
+      std::unique_ptr<char*[]> probe_rows;
+      /// Rows read back from disk.
+      std::unique_ptr<char[]> buffer;
+      /// The claimed work, if there is one.
+      std::optional<Work> work;
+      /// Number of matches of the claimed block that were produced already.
+      size_t block_offset = 0;
+      /// Hash table on the build rows of the claimed partition.
+      std::unique_ptr<HashTableSimpleKey> table;
+   };
+
+   /// Get the partition of a key hash.
+   static size_t partitionIdx(uint64_t hash);
+   /// Get the size of a remembered match.
+   size_t matchSize() const {
+      return match_probe_size + sizeof(char*);
+   }
+   /// Reserve memory for one more block of build rows in the given partition. Evicts the largest partitions
+   /// while the budget is exceeded. Returns false if the partition is evicted.
+   bool reserveBuildBlock(size_t partition);
+   /// Add data to a write buffer of a partition, writing it to the spill file once the buffer is full.
+   void spill(std::vector<std::vector<char>>& buffers, std::array<std::unique_ptr<SpillFile>, num_partitions>& files, size_t partition, const char* data, size_t size);
+   /// Write out all write buffers.
+   void flush(std::vector<std::vector<char>>& buffers, std::array<std::unique_ptr<SpillFile>, num_partitions>& files);
+   /// Get the output state of a worker thread. Creates it on first access.
+   ThreadOutput& getThreadOutput(size_t thread_id);
+   /// Claim the next unit of work of the output phase. Returns false if no work is left.
+   bool claimWork(ThreadOutput& output);
+   /// Read the build rows of an evicted partition into a hash table.
+   std::unique_ptr<HashTableSimpleKey> loadPartition(size_t partition);
+
+   /// The hash table on the build rows of the resident partitions.
+   HashTableSimpleKey& resident;
+   /// Size of the join key.
+   uint16_t key_size;
+   /// Size of the build payload following the key.
+   uint16_t payload_size;
+   /// Size of a packed probe row.
+   uint16_t probe_size;
+   /// Size of the probe row within a remembered match.
+   uint16_t match_probe_size;
+   /// Memory budget for the build rows and the remembered matches in bytes.
+   size_t memory_budget;
+   /// Is this a semi join?
+   bool semi_join;
+   /// Maximum number of rows produced at a time.
+   size_t max_rows;
+
+   /// Lock protecting the creation of the thread-local state and the work claiming.
+   mutable std::mutex lock;
+   std::vector<std::unique_ptr<ThreadBuild>> thread_builds;
+   std::vector<std::unique_ptr<ThreadProbe>> thread_probes;
+   std::vector<std::unique_ptr<ThreadOutput>> thread_outputs;
+   /// Guard for building the resident hash table.
+   std::once_flag build_finalized;
+
+   /// Lock protecting the memory accounting of the build.
+   std::mutex evict_lock;
+   /// Which partitions were evicted?
+   std::array<std::atomic<bool>, num_partitions> evicted;
+   /// Memory used by the build rows of every partition.
+   std::array<size_t, num_partitions> partition_bytes;
+   /// Memory used by the build rows of the partitions that were not evicted.
+   size_t resident_bytes = 0;
+   /// Memory used by the remembered matches.
+   std::atomic<size_t> match_bytes = 0;
+
+   /// Lock protecting the creation of spill files.
+   std::mutex files_lock;
+   /// The build rows of the evicted partitions.
+   std::array<std::unique_ptr<SpillFile>, num_partitions> build_files;
+   /// The probe rows of the evicted partitions.
+   std::array<std::unique_ptr<SpillFile>, num_partitions> probe_files;
+
+   /// The work of the output phase. Collected when the first work gets claimed.
+   std::vector<Work> work;
+   /// Was the work collected already?
+   bool work_collected = false;
+   /// The next work that was not claimed yet.
+   size_t next_work = 0;
+};
+
+}
+
+#endif //INKFUSE_HYBRIDHASHJOIN_H
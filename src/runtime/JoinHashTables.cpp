@@ -0,0 +1,477 @@
+#include "runtime/JoinHashTables.h"
+#include "runtime/HashRuntime.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <bit>
+#include <cstring>
+
+namespace inkfuse {
+
+namespace {
+/// Number of filter bits per key. With four bits set per key, this gives a false positive
+/// rate of around one percent.
+const size_t bloom_bits_per_key = 16;
+
+/// Add the hashes of all keys within a table to the Bloom filter.
+template <bool concurrent>
+void addToBloomFilter(BloomFilter& filter, HashTableSimpleKey& table) {
+   char* it_data;
+   uint64_t it_idx;
+   table.iteratorStart(&it_data, &it_idx);
+   while (it_data != nullptr) {
+      if constexpr (concurrent) {
+         filter.insertConcurrent(table.hash(it_data));
+      } else {
+         filter.insert(table.hash(it_data));
+      }
+      table.iteratorAdvance(&it_data, &it_idx);
+   }
+}
+
+/// Read a pointer stored at a possibly unaligned position within a row.
+char* loadPointer(const char* src) {
+   char* ptr;
+   std::memcpy(&ptr, src, sizeof(ptr));
+   return ptr;
+}
+
+/// Store a pointer at a possibly unaligned position within a row.
+void storePointer(char* dst, const char* ptr) {
+   std::memcpy(dst, &ptr, sizeof(ptr));
+}
+}
+
+const std::string ArrayJoinIndex::ID = "aj";
+template <>
+const std::string FixedKeyWidth<ArrayJoinIndex, 4>::ID = "aj4";
+template <>
+const std::string FixedKeyWidth<ArrayJoinIndex, 8>::ID = "aj8";
+
+ArrayJoinIndex::ArrayJoinIndex(HashTableSimpleKey& table_, uint16_t key_size_, bool is_signed_)
+   : table(table_), key_size(key_size_), is_signed(is_signed_), key_mask(key_size_ >= 8 ? ~uint64_t{0} : (uint64_t{1} << (8 * key_size_)) - 1) {
+   assert(key_size <= 8);
+}
+
+uint64_t ArrayJoinIndex::orderedKey(const char* key) const {
+   uint64_t value = 0;
+   std::memcpy(&value, key, key_size);
+   if (is_signed) {
+      // Sign-extend and flip the sign bit: negative keys come first.
+      const uint64_t sign_bit = uint64_t{1} << (8 * key_size - 1);
+      value = ((value ^ sign_bit) - sign_bit) ^ (uint64_t{1} << 63);
+   }
+   return value;
+}
+
+void ArrayJoinIndex::reset(const std::vector<std::unique_ptr<HashTableSimpleKey>>& build_tables) {
+   size_t num_rows = 0;
+   uint64_t min = ~uint64_t{0};
+   uint64_t max = 0;
+   for (const auto& build_table : build_tables) {
+      char* it_data;
+      uint64_t it_idx;
+      build_table->iteratorStart(&it_data, &it_idx);
+      while (it_data != nullptr) {
+         const uint64_t key = orderedKey(it_data);
+         min = std::min(min, key);
+         max = std::max(max, key);
+         num_rows++;
+         build_table->iteratorAdvance(&it_data, &it_idx);
+      }
+   }
+   // The array pays off if there are few empty slots in between the keys.
+   dense = num_rows > 0 && max - min < max_slots_per_row * num_rows;
+   if (!dense) {
+      return;
+   }
+   num_slots = max - min + 1;
+   // Find the packed key of the minimum again, offsets are computed on the packed keys.
+   min_key = min;
+   if (is_signed) {
+      min_key ^= uint64_t{1} << 63;
+   }
+   min_key &= key_mask;
+   present = TableMemory::makeArray<uint64_t>((num_slots + 63) / 64);
+   rows = TableMemory::makeArray<char*>(num_slots);
+}
+
+void ArrayJoinIndex::insertConcurrent(HashTableSimpleKey& build_table) {
+   char* it_data;
+   uint64_t it_idx;
+   build_table.iteratorStart(&it_data, &it_idx);
+   while (it_data != nullptr) {
+      // Keys are unique, so the row pointers of different workers never collide. The bitmap words are shared.
+      const uint64_t idx = arrayIdx(it_data);
+      rows[idx] = it_data;
+      std::atomic_ref<uint64_t>(present[idx / 64]).fetch_or(bitMask(idx), std::memory_order_relaxed);
+      build_table.iteratorAdvance(&it_data, &it_idx);
+   }
+}
+
+BloomFilter::BloomFilter(uint16_t key_size_) : words(std::make_unique<uint64_t[]>(1)), key_size(key_size_) {
+   // Contain every key until the filter gets built.
+   words[0] = ~uint64_t{0};
+}
+
+void BloomFilter::reset(size_t num_keys) {
+   const size_t num_words = std::bit_ceil(std::max(num_keys * bloom_bits_per_key / 64, size_t{1}));
+   words = std::make_unique<uint64_t[]>(num_words);
+   word_mask = num_words - 1;
+}
+
+uint64_t BloomFilter::bitMask(uint64_t hash) {
+   // The lower bits pick the word. Every key sets four bits within the word, picked by the upper 24 bits.
+   return (uint64_t{1} << ((hash >> 40) & 63)) | (uint64_t{1} << ((hash >> 46) & 63)) | (uint64_t{1} << ((hash >> 52) & 63)) | (uint64_t{1} << ((hash >> 58) & 63));
+}
+
+void BloomFilter::insert(uint64_t hash) {
+   words[wordIdx(hash)] |= bitMask(hash);
+}
+
+void BloomFilter::insertConcurrent(uint64_t hash) {
+   std::atomic_ref<uint64_t>(words[wordIdx(hash)]).fetch_or(bitMask(hash), std::memory_order_relaxed);
+}
+
+bool BloomFilter::contains(uint64_t hash) const {
+   const uint64_t mask = bitMask(hash);
+   return (words[wordIdx(hash)] & mask) == mask;
+}
+
+bool BloomFilter::containsKey(const char* key) const {
+   return contains(HashRuntime::hashKey(key, key_size));
+}
+
+ParallelBuildHashTable::ParallelBuildHashTable(HashTableSimpleKey& target_, uint16_t key_size_, uint16_t payload_size_)
+   : target(target_), key_size(key_size_), payload_size(payload_size_) {
+}
+
+HashTableSimpleKey& ParallelBuildHashTable::getThreadTable(size_t thread_id) {
+   std::unique_lock lock(thread_tables_lock);
+   while (thread_tables.size() <= thread_id) {
+      thread_tables.push_back(std::make_unique<HashTableSimpleKey>(key_size, payload_size));
+   }
+   return *thread_tables[thread_id];
+}
+
+BloomFilter& ParallelBuildHashTable::enableBloomFilter() {
+   if (!bloom_filter) {
+      bloom_filter = std::make_unique<BloomFilter>(key_size);
+   }
+   return *bloom_filter;
+}
+
+ArrayJoinIndex& ParallelBuildHashTable::enableArrayIndex(bool is_signed) {
+   if (!array_index) {
+      array_index = std::make_unique<ArrayJoinIndex>(target, key_size, is_signed);
+   }
+   return *array_index;
+}
+
+void ParallelBuildHashTable::finalize(size_t thread_id) {
+   const auto is_dense = [&]() { return array_index && array_index->isDense(); };
+   std::call_once(target_sized, [&]() {
+      if (array_index) {
+         // The range of the build keys decides whether the array pays off.
+         array_index->reset(thread_tables);
+      }
+      if (is_dense()) {
+         // The probes never touch the target, the rows stay within the thread tables.
+         if (bloom_filter) {
+            size_t total = 0;
+            for (const auto& table : thread_tables) {
+               total += table->size();
+            }
+            bloom_filter->reset(total);
+         }
+         return;
+      }
+      if (thread_tables.size() == 1) {
+         // Single-threaded build, the build table becomes the target as-is.
+         target = std::move(*thread_tables[0]);
+         thread_tables.clear();
+         if (bloom_filter) {
+            bloom_filter->reset(target.size());
+            addToBloomFilter<false>(*bloom_filter, target);
+         }
+         return;
+      }
+      size_t total = 0;
+      for (const auto& table : thread_tables) {
+         total += table->size();
+      }
+      // Size the target so that it stays at most half full. It never grows, so we can keep the
+      // collision chains of the probes extra short.
+      target = HashTableSimpleKey(key_size, payload_size, std::bit_ceil(std::max(2 * total, size_t{2})));
+      if (bloom_filter) {
+         bloom_filter->reset(total);
+      }
+   });
+   if (thread_id < thread_tables.size()) {
+      if (bloom_filter) {
+         addToBloomFilter<true>(*bloom_filter, *thread_tables[thread_id]);
+      }
+      if (is_dense()) {
+         // The array points into the build table, it has to stay around.
+         array_index->insertConcurrent(*thread_tables[thread_id]);
+         return;
+      }
+      target.mergeConcurrent(*thread_tables[thread_id]);
+      // Free the build table of this worker right away.
+      thread_tables[thread_id].reset();
+   }
+}
+
+RowBuffer::RowBuffer(uint32_t row_size_, uint32_t prefix_size_)
+   : row_size(row_size_), prefix_size(prefix_size_) {
+}
+
+char* RowBuffer::append(const char* prefix) {
+   if (last_block_rows == rows_per_block) {
+      blocks.push_back(std::make_unique_for_overwrite<char[]>(rows_per_block * row_size));
+      last_block_rows = 0;
+   }
+   char* row = blocks.back().get() + last_block_rows * row_size;
+   last_block_rows++;
+   if (prefix_size) {
+      std::memcpy(row, prefix, prefix_size);
+   }
+   return row;
+}
+
+size_t RowBuffer::size() const {
+   if (blocks.empty()) {
+      return 0;
+   }
+   return (blocks.size() - 1) * rows_per_block + last_block_rows;
+}
+
+size_t RowBuffer::numBlocks() const {
+   return blocks.size();
+}
+
+std::pair<char*, size_t> RowBuffer::getBlock(size_t idx) const {
+   const size_t rows = (idx + 1 == blocks.size()) ? last_block_rows : rows_per_block;
+   return {blocks[idx].get(), rows};
+}
+
+NMJoinHashTable::NMJoinHashTable(HashTableSimpleKey& index_, uint16_t key_size_, uint16_t payload_size_)
+   : index(index_), key_size(key_size_), payload_size(payload_size_) {
+}
+
+NMJoinHashTable::ThreadRows::ThreadRows(uint32_t row_size_, uint16_t key_size_)
+   : key_size(key_size_) {
+   partitions.reserve(num_partitions);
+   for (size_t partition = 0; partition < num_partitions; ++partition) {
+      partitions.emplace_back(row_size_, key_size_);
+   }
+}
+
+char* NMJoinHashTable::ThreadRows::append(const char* key) {
+   return partitions[partitionIdx(HashRuntime::hashKey(key, key_size))].append(key);
+}
+
+NMJoinHashTable::ThreadRows& NMJoinHashTable::getThreadRows(size_t thread_id) {
+   std::unique_lock lock(thread_rows_lock);
+   while (thread_rows.size() <= thread_id) {
+      thread_rows.push_back(std::make_unique<ThreadRows>(rowSize(), key_size));
+   }
+   return *thread_rows[thread_id];
+}
+
+BloomFilter& NMJoinHashTable::enableBloomFilter() {
+   if (!bloom_filter) {
+      bloom_filter = std::make_unique<BloomFilter>(key_size);
+   }
+   return *bloom_filter;
+}
+
+char* NMJoinHashTable::rowsBegin(const char* slot) const {
+   return loadPointer(slot + key_size);
+}
+
+uint64_t NMJoinHashTable::rowsCount(const char* slot) const {
+   return *reinterpret_cast<const uint64_t*>(slot + key_size + 8);
+}
+
+void NMJoinHashTable::finalize(size_t thread_id) {
+   std::call_once(index_sized, [&]() {
+      size_t total = 0;
+      for (const auto& thread : thread_rows) {
+         for (const auto& partition : thread->partitions) {
+            total += partition.size();
+         }
+      }
+      // Size the index for the worst case of only distinct keys. It never grows while the partitions get merged into it.
+      index = HashTableSimpleKey(key_size, index_payload_size, std::bit_ceil(std::max(2 * total, size_t{2})));
+      rows.resize(num_partitions);
+      if (bloom_filter) {
+         bloom_filter->reset(total);
+      }
+   });
+   // Partitions never share a key, so every worker can group whole partitions on its own.
+   for (size_t partition = next_partition.fetch_add(1); partition < num_partitions; partition = next_partition.fetch_add(1)) {
+      groupPartition(partition);
+   }
+}
+
+void NMJoinHashTable::groupPartition(size_t partition) {
+   const uint32_t row_size = rowSize();
+   auto for_each_row = [&](auto&& fct) {
+      for (const auto& thread : thread_rows) {
+         const RowBuffer& buffer = thread->partitions[partition];
+         for (size_t block_idx = 0; block_idx < buffer.numBlocks(); ++block_idx) {
+            auto [block, block_rows] = buffer.getBlock(block_idx);
+            for (size_t row_idx = 0; row_idx < block_rows; ++row_idx) {
+               fct(block + row_idx * row_size);
+            }
+         }
+      }
+   };
+   size_t total = 0;
+   for (const auto& thread : thread_rows) {
+      total += thread->partitions[partition].size();
+   }
+   if (total == 0) {
+      return;
+   }
+   // The keys of the partition get grouped within a small table of their own, which stays within the cache.
+   HashTableSimpleKey grouped(key_size, index_payload_size, std::bit_ceil(2 * total));
+
+   // 1. Count the rows of every key.
+   for_each_row([&](const char* row) {
+      char* slot;
+      bool is_new_key;
+      grouped.lookupOrInsert(&slot, &is_new_key, row);
+      auto* count = reinterpret_cast<uint64_t*>(slot + key_size + 8);
+      if (is_new_key) {
+         *count = 0;
+      }
+      (*count)++;
+   });
+
+   // 2. Give every key its contiguous range of rows. The count gets rebuilt while scattering.
+   rows[partition] = std::make_unique_for_overwrite<char[]>(total * row_size);
+   char* begin = rows[partition].get();
+   char* it_data;
+   uint64_t it_idx;
+   grouped.iteratorStart(&it_data, &it_idx);
+   while (it_data != nullptr) {
+      auto* count = reinterpret_cast<uint64_t*>(it_data + key_size + 8);
+      storePointer(it_data + key_size, begin);
+      begin += *count * row_size;
+      *count = 0;
+      grouped.iteratorAdvance(&it_data, &it_idx);
+   }
+
+   // 3. Scatter the rows into their ranges.
+   for_each_row([&](const char* row) {
+      char* slot = grouped.lookup(row);
+      auto* count = reinterpret_cast<uint64_t*>(slot + key_size + 8);
+      std::memcpy(loadPointer(slot + key_size) + *count * row_size, row, row_size);
+      (*count)++;
+   });
+   // The appended rows of the partition are no longer needed.
+   for (const auto& thread : thread_rows) {
+      thread->partitions[partition] = RowBuffer(row_size, key_size);
+   }
+
+   index.mergeConcurrent(grouped);
+   if (bloom_filter) {
+      addToBloomFilter<true>(*bloom_filter, grouped);
+   }
+}
+
+NMJoinMatches::NMJoinMatches(const NMJoinHashTable& table_, uint16_t probe_size_, size_t max_rows_)
+   : table(table_), probe_size(probe_size_), max_rows(max_rows_) {
+}
+
+RowBuffer& NMJoinMatches::getThreadMatches(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_matches.size() <= thread_id) {
+      // Every match consists of the probe row followed by the pointer to the index slot.
+      thread_matches.push_back(std::make_unique<RowBuffer>(probe_size + sizeof(char*), probe_size));
+   }
+   return *thread_matches[thread_id];
+}
+
+void NMJoinMatches::addMatch(RowBuffer& matches, const char* probe_row, const char* slot) {
+   char* match = matches.append(probe_row);
+   storePointer(match + matches.rowSize() - sizeof(char*), slot);
+}
+
+NMJoinMatches::Expansion& NMJoinMatches::getExpansion(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (expansions.size() <= thread_id) {
+      auto& expansion = expansions.emplace_back(std::make_unique<Expansion>());
+      expansion->probe_rows = std::make_unique<char*[]>(max_rows);
+      expansion->build_rows = std::make_unique<char*[]>(max_rows);
+   }
+   return *expansions[thread_id];
+}
+
+bool NMJoinMatches::claimBlock(Expansion& expansion) {
+   std::unique_lock guard(lock);
+   if (!blocks_collected) {
+      // The probe pipeline is done, all matches are known now.
+      for (const auto& matches : thread_matches) {
+         for (size_t block_idx = 0; block_idx < matches->numBlocks(); ++block_idx) {
+            blocks.push_back(matches->getBlock(block_idx));
+         }
+      }
+      blocks_collected = true;
+   }
+   if (next_block == blocks.size()) {
+      return false;
+   }
+   std::tie(expansion.block, expansion.block_size) = blocks[next_block++];
+   expansion.match_idx = 0;
+   expansion.row_idx = 0;
+   return true;
+}
+
+size_t NMJoinMatches::produce(size_t thread_id) {
+   auto& expansion = getExpansion(thread_id);
+   const size_t match_size = probe_size + sizeof(char*);
+   const uint32_t row_size = table.rowSize();
+   size_t produced = 0;
+   while (produced < max_rows) {
+      if (expansion.match_idx == expansion.block_size && !claimBlock(expansion)) {
+         // All matches were expanded.
+         break;
+      }
+      char* match = expansion.block + expansion.match_idx * match_size;
+      const char* slot = loadPointer(match + probe_size);
+      // The build rows of the match are contiguous - we only have to pick up where we left off.
+      char* build_rows = table.rowsBegin(slot);
+      const uint64_t count = table.rowsCount(slot);
+      const uint64_t num_rows = std::min(count - expansion.row_idx, static_cast<uint64_t>(max_rows - produced));
+      for (uint64_t k = 0; k < num_rows; ++k) {
+         expansion.probe_rows[produced] = match;
+         expansion.build_rows[produced] = build_rows + (expansion.row_idx + k) * row_size;
+         produced++;
+      }
+      expansion.row_idx += num_rows;
+      if (expansion.row_idx == count) {
+         // Move on to the next match.
+         expansion.match_idx++;
+         expansion.row_idx = 0;
+      }
+   }
+   return produced;
+}
+
+char** NMJoinMatches::getOutput(size_t thread_id, bool build_side) {
+   auto& expansion = getExpansion(thread_id);
+   return build_side ? expansion.build_rows.get() : expansion.probe_rows.get();
+}
+
+double NMJoinMatches::progress() const {
+   std::unique_lock guard(lock);
+   if (blocks.empty()) {
+      return 1.0;
+   }
+   return static_cast<double>(next_block) / blocks.size();
+}
+
+}
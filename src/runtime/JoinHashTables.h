@@ -0,0 +1,421 @@
+#ifndef INKFUSE_JOINHASHTABLES_H
+#define INKFUSE_JOINHASHTABLES_H
+
+#include "runtime/HashTables.h"
+#include "runtime/TableMemory.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// This file contains the hash tables used for parallel join builds.
+namespace inkfuse {
+
+/// Register-blocked Bloom filter on the keys of a join build. All bits of a key fall into
+/// a single 64 bit word, so checking a key costs one hash and at most one cache miss.
+/// Used as runtime filter to drop probe rows before they are packed and looked up.
+struct BloomFilter {
+   /// Create a filter on keys of the given size. Until it gets reset, the filter contains every key.
+   BloomFilter(uint16_t key_size_);
+
+   /// Size the filter for the given number of keys and clear all bits.
+   void reset(size_t num_keys);
+   /// Add the hash of a key.
+   void insert(uint64_t hash);
+   /// Add the hash of a key while other threads insert at the same time.
+   void insertConcurrent(uint64_t hash);
+   /// Might a key with the given hash be in the filter?
+   bool contains(uint64_t hash) const;
+   /// Might the key be in the filter? The key is hashed the same way as in the HashTableSimpleKey.
+   bool containsKey(const char* key) const;
+
+   private:
+   /// Get the word of a hash.
+   size_t wordIdx(uint64_t hash) const {
+      return hash & word_mask;
+   }
+   /// Get the bits set within the word of a hash.
+   static uint64_t bitMask(uint64_t hash);
+
+   /// The filter words.
+   std::unique_ptr<uint64_t[]> words;
+   /// Number of words - 1, used as modulo mask.
+   uint64_t word_mask = 0;
+   /// Size of the key.
+   uint16_t key_size;
+};
+
+/// Array index on the build side of a PK join on a single integer key. Once the build pipeline is done,
+/// the index looks at the range of the build keys. If the range is small relative to the number of build rows,
+/// every key maps straight to the array offset `key - min`: a presence bitmap tells whether the key exists and
+/// an array of row pointers leads to its build row. Probes then neither hash nor compare keys.
+/// Otherwise, every lookup is forwarded to the hash table. As this is only known at runtime, the probe
+/// keeps splitting hashing from the lookup: for dense keys the hash step only prefetches the array slot.
+struct ArrayJoinIndex {
+   /// Unique ID of the index within the runtime functions.
+   static const std::string ID;
+   /// The array may have at most this many slots per build row. Sparser keys keep using the hash table.
+   static constexpr size_t max_slots_per_row = 4;
+
+   /// Set up an index on integer keys of the given size. `table_` is used if the keys are too sparse.
+   ArrayJoinIndex(HashTableSimpleKey& table_, uint16_t key_size_, bool is_signed_);
+
+   /// Look at the key range of the build tables and set up the array if it pays off.
+   void reset(const std::vector<std::unique_ptr<HashTableSimpleKey>>& build_tables);
+   /// Add the rows of a build table to the array. Workers can add disjoint keys at the same time.
+   void insertConcurrent(HashTableSimpleKey& build_table);
+   /// Are lookups resolved through the array?
+   bool isDense() const {
+      return dense;
+   }
+
+   /// Get the build row of a key, nullptr if there is none.
+   char* lookup(const char* key) {
+      return dense ? lookupDense(key) : table.lookup(key);
+   }
+   /// Get the build row of a key and remove it from the index. Every build row is found at most once, as needed by semi joins.
+   /// Multiple threads can disable keys at the same time.
+   char* lookupDisable(const char* key) {
+      return dense ? lookupDisableDense(key) : table.lookupDisable(key);
+   }
+
+   /// Prefetch the array slot of a key if the keys are dense. Otherwise, hash the key and prefetch
+   /// its hash table slot. Specialized on the key width of the hash table if `key_width` is not 0.
+   /// @return the hash of the key, 0 if the keys are dense.
+   template <uint16_t key_width = 0>
+   uint64_t hashPrefetch(const char* key) const {
+      if (dense) {
+         const uint64_t idx = arrayIdx(key);
+         if (idx < num_slots) {
+            __builtin_prefetch(&present[idx / 64]);
+            __builtin_prefetch(&rows[idx]);
+         }
+         return 0;
+      }
+      uint64_t hash;
+      if constexpr (key_width != 0) {
+         hash = HashTableSimpleKey::hashFixed<key_width>(key);
+      } else {
+         hash = table.hash(key);
+      }
+      table.prefetch(hash);
+      return hash;
+   }
+   /// Same as `lookup`, on a key whose hash was computed by `hashPrefetch`.
+   template <uint16_t key_width = 0>
+   char* lookup(const char* key, uint64_t hash) {
+      if (dense) {
+         return lookupDense(key);
+      }
+      if constexpr (key_width != 0) {
+         return table.lookupFixed<key_width>(key, hash);
+      } else {
+         return table.lookup(key, hash);
+      }
+   }
+   /// Same as `lookupDisable`, on a key whose hash was computed by `hashPrefetch`.
+   char* lookupDisable(const char* key, uint64_t hash) {
+      return dense ? lookupDisableDense(key) : table.lookupDisable(key, hash);
+   }
+
+   private:
+   /// Get the build row of a key from the array.
+   char* lookupDense(const char* key) const {
+      const uint64_t idx = arrayIdx(key);
+      if (idx >= num_slots || !(present[idx / 64] & bitMask(idx))) {
+         return nullptr;
+      }
+      return rows[idx];
+   }
+   /// Get the build row of a key from the array and clear its presence bit.
+   char* lookupDisableDense(const char* key) {
+      const uint64_t idx = arrayIdx(key);
+      if (idx >= num_slots) {
+         return nullptr;
+      }
+      std::atomic_ref<uint64_t> word(present[idx / 64]);
+      // Only pay for the atomic update if the key is still present.
+      if (!(word.load(std::memory_order_relaxed) & bitMask(idx)) || !(word.fetch_and(~bitMask(idx), std::memory_order_relaxed) & bitMask(idx))) {
+         return nullptr;
+      }
+      return rows[idx];
+   }
+
+   /// Get the array offset of a key. Keys below the minimum wrap around to large offsets.
+   uint64_t arrayIdx(const char* key) const {
+      uint64_t value = 0;
+      // The keys are packed as little-endian integers.
+      std::memcpy(&value, key, key_size);
+      return (value - min_key) & key_mask;
+   }
+   /// Get the bit of an array offset within its bitmap word.
+   static uint64_t bitMask(uint64_t idx) {
+      return uint64_t{1} << (idx % 64);
+   }
+   /// Get a key as integer whose unsigned order is the order of the keys.
+   uint64_t orderedKey(const char* key) const;
+
+   /// The hash table used for sparse keys.
+   HashTableSimpleKey& table;
+   /// Size of the key.
+   uint16_t key_size;
+   /// Are the keys signed integers?
+   bool is_signed;
+   /// Mask covering all bits of a key. Offsets are computed modulo the key width, so that
+   /// the array also works across the sign boundary of signed integers.
+   uint64_t key_mask;
+   /// Are lookups resolved through the array?
+   bool dense = false;
+   /// The smallest build key.
+   uint64_t min_key = 0;
+   /// Number of array slots.
+   uint64_t num_slots = 0;
+   /// Presence bitmap of the array slots.
+   TableMemory::Array<uint64_t> present;
+   /// Build row of every present array slot.
+   TableMemory::Array<char*> rows;
+};
+
+/// Array index keys are single integers, only 4 and 8 byte keys use the specialized lookups of the hash table.
+template <>
+const std::string FixedKeyWidth<ArrayJoinIndex, 4>::ID;
+template <>
+const std::string FixedKeyWidth<ArrayJoinIndex, 8>::ID;
+
+/// Hash table of a join build running on multiple worker threads. Every worker first
+/// inserts into its own thread-local HashTableSimpleKey, which keeps the regular
+/// single-threaded insert path (including morsel restarts on resize).
+/// Once the build pipeline is done, the target table is sized for all build rows and
+/// every worker moves the rows of its thread-local table over through lock-free inserts.
+/// Probes then run wait-free on the target table.
+struct ParallelBuildHashTable {
+   ParallelBuildHashTable(HashTableSimpleKey& target_, uint16_t key_size_, uint16_t payload_size_);
+
+   /// Get the build table of a worker thread. Creates the table on first access.
+   HashTableSimpleKey& getThreadTable(size_t thread_id);
+
+   /// Move the thread-local tables into the target. Must be called by every worker thread
+   /// once all of them are done building. The target gets sized once, the inserts run in parallel.
+   void finalize(size_t thread_id);
+
+   /// Also build a Bloom filter on the build keys during `finalize`.
+   BloomFilter& enableBloomFilter();
+   /// Also build an array index on the build keys during `finalize`. Keys have to be integers.
+   /// If the index turns out to be dense, the rows stay within the build tables of the workers
+   /// and the target is never filled.
+   ArrayJoinIndex& enableArrayIndex(bool is_signed);
+
+   private:
+   /// The hash table that gets probed.
+   HashTableSimpleKey& target;
+   /// Size of the join key within a slot.
+   uint16_t key_size;
+   /// Size of the payload following the key.
+   uint16_t payload_size;
+   /// Lock protecting the creation of thread tables.
+   std::mutex thread_tables_lock;
+   /// The build tables of the workers.
+   std::vector<std::unique_ptr<HashTableSimpleKey>> thread_tables;
+   /// Guard for sizing the target.
+   std::once_flag target_sized;
+   /// Optional Bloom filter on the build keys.
+   std::unique_ptr<BloomFilter> bloom_filter;
+   /// Optional array index on the build keys.
+   std::unique_ptr<ArrayJoinIndex> array_index;
+};
+
+/// Append-only buffer of fixed-size rows. Rows are stored in blocks and never move once
+/// they were appended, so appending never invalidates previously returned rows.
+struct RowBuffer {
+   /// Every appended row starts with a prefix of `prefix_size_` bytes copied from the caller.
+   RowBuffer(uint32_t row_size_, uint32_t prefix_size_);
+
+   /// Append a new row and copy the prefix into it. Returns the row.
+   char* append(const char* prefix);
+
+   /// Get the number of rows.
+   size_t size() const;
+   /// Get the number of blocks.
+   size_t numBlocks() const;
+   /// Get the start of a block and the number of rows within it.
+   std::pair<char*, size_t> getBlock(size_t idx) const;
+   /// Get the size of a single row.
+   uint32_t rowSize() const {
+      return row_size;
+   }
+
+   /// Number of rows within a single block.
+   static constexpr size_t rows_per_block = 1024;
+
+   private:
+   /// The blocks storing the rows.
+   std::vector<std::unique_ptr<char[]>> blocks;
+   /// Number of rows within the last block.
+   size_t last_block_rows = rows_per_block;
+   /// Size of a row.
+   uint32_t row_size;
+   /// Size of the prefix copied into a new row.
+   uint32_t prefix_size;
+};
+
+/// Build side of a join where the build keys are not unique (n:m join). Every worker first appends
+/// its build rows (key followed by the payload) to thread-local RowBuffers, one per hash partition of the key.
+/// Once the build pipeline is done, the rows get grouped by their key: all rows of a key are stored next to
+/// each other within one contiguous array. The `index` hash table maps every key to its range of rows.
+/// Finding all partners of a probe row therefore needs a single lookup and a sequential scan,
+/// rather than following a chain of pointers through the heap.
+struct NMJoinHashTable {
+   NMJoinHashTable(HashTableSimpleKey& index_, uint16_t key_size_, uint16_t payload_size_);
+
+   /// Slot layout within the index: the key, followed by the pointer to the first row and the number of rows.
+   static constexpr uint16_t index_payload_size = 16;
+   /// Number of hash partitions of the build rows. The workers group whole partitions in parallel.
+   static constexpr size_t num_partitions = 64;
+
+   /// Build rows of a worker thread, split into the hash partitions of their keys.
+   struct ThreadRows {
+      ThreadRows(uint32_t row_size_, uint16_t key_size_);
+
+      /// Append a new build row to the partition of its key and copy the key into it. Returns the row.
+      char* append(const char* key);
+
+      private:
+      friend struct NMJoinHashTable;
+
+      /// Size of the join key.
+      uint16_t key_size;
+      /// The rows of every partition.
+      std::vector<RowBuffer> partitions;
+   };
+
+   /// Get the build rows of a worker thread. Creates the buffer on first access.
+   ThreadRows& getThreadRows(size_t thread_id);
+
+   /// Group the build rows of all workers by key and set up the index. Must be called by every worker
+   /// thread once all of them are done building. The index gets sized once, then every worker claims
+   /// partitions and groups their rows until no partition is left.
+   void finalize(size_t thread_id);
+
+   /// Also build a Bloom filter on the build keys during `finalize`.
+   BloomFilter& enableBloomFilter();
+
+   /// Get the first row for an index slot.
+   char* rowsBegin(const char* slot) const;
+   /// Get the number of rows for an index slot.
+   uint64_t rowsCount(const char* slot) const;
+   /// Get the size of a single build row.
+   uint32_t rowSize() const {
+      return key_size + payload_size;
+   }
+
+   private:
+   /// Get the partition of a key hash. Uses bits that are independent of the slot and the tag within the index.
+   static size_t partitionIdx(uint64_t hash) {
+      return (hash >> 48) & (num_partitions - 1);
+   }
+   /// Group the rows of a single partition and merge its keys into the index.
+   void groupPartition(size_t partition);
+
+   /// Index from the key to its rows.
+   HashTableSimpleKey& index;
+   /// Size of the join key.
+   uint16_t key_size;
+   /// Size of the payload following the key.
+   uint16_t payload_size;
+   /// Lock protecting the creation of thread-local rows.
+   std::mutex thread_rows_lock;
+   /// The build rows of the workers.
+   std::vector<std::unique_ptr<ThreadRows>> thread_rows;
+   /// Guard for sizing the index.
+   std::once_flag index_sized;
+   /// The next partition which was not claimed for grouping yet.
+   std::atomic<size_t> next_partition = 0;
+   /// The rows of every partition grouped by key.
+   std::vector<std::unique_ptr<char[]>> rows;
+   /// Optional Bloom filter on the build keys.
+   std::unique_ptr<BloomFilter> bloom_filter;
+};
+
+/// Joined rows which are produced outside of the probe pipeline. A followup pipeline reads them
+/// through the JoinRowsDriver: every call of `produce` fills the output arrays of a worker with
+/// pointers to the packed build and probe rows of a bounded number of joined rows.
+struct JoinRows {
+   virtual ~JoinRows() = default;
+
+   /// Produce the next set of joined rows of a worker thread. Multiple threads can produce concurrently.
+   /// Returns the number of produced rows, 0 once all rows were produced.
+   virtual size_t produce(size_t thread_id) = 0;
+   /// Get the output array of a worker thread: either the build or the probe rows. The array never moves.
+   virtual char** getOutput(size_t thread_id, bool build_side) = 0;
+   /// Fraction of the work that was claimed already.
+   virtual double progress() const = 0;
+};
+
+/// The matches of the probe rows of an n:m join. The probe pipeline appends every probe row
+/// together with its index slot to a thread-local RowBuffer. A followup pipeline then expands the
+/// matches into the joined rows, producing at most `max_rows` of them at a time.
+/// A match with more partners than `max_rows` gets split across several expansions.
+struct NMJoinMatches final : public JoinRows {
+   NMJoinMatches(const NMJoinHashTable& table_, uint16_t probe_size_, size_t max_rows_);
+
+   /// Get the matches of a worker thread. Creates the buffer on first access.
+   RowBuffer& getThreadMatches(size_t thread_id);
+
+   /// Add a match: copies the probe row and stores the index slot behind it. The probe row
+   /// is null if the matches don't keep probe rows.
+   static void addMatch(RowBuffer& matches, const char* probe_row, const char* slot);
+
+   /// Expansion state of a worker thread.
+   struct Expansion {
+      /// The probe rows of the produced rows.
+      std::unique_ptr<char*[]> probe_rows;
+      /// The build rows of the produced rows.
+      std::unique_ptr<char*[]> build_rows;
+      /// The claimed block of matches.
+      char* block = nullptr;
+      /// Number of matches within the claimed block.
+      size_t block_size = 0;
+      /// The current match within the block.
+      size_t match_idx = 0;
+      /// Number of build rows of the current match that were produced already.
+      uint64_t row_idx = 0;
+   };
+
+   /// Get the expansion state of a worker thread. The output arrays never move.
+   Expansion& getExpansion(size_t thread_id);
+
+   /// Expand the next set of matches into the output of the worker thread. Multiple threads can expand
+   /// concurrently, they claim whole blocks of matches.
+   size_t produce(size_t thread_id) override;
+   char** getOutput(size_t thread_id, bool build_side) override;
+   /// Fraction of match blocks which were claimed already.
+   double progress() const override;
+
+   private:
+   /// Claim the next block of matches. Returns false if no block is left.
+   bool claimBlock(Expansion& expansion);
+
+   /// The build side of the join.
+   const NMJoinHashTable& table;
+   /// Size of the probe row stored with every match.
+   uint16_t probe_size;
+   /// Maximum number of rows produced by a single expansion.
+   size_t max_rows;
+   /// Lock protecting the thread-local state and the block claiming.
+   mutable std::mutex lock;
+   /// The matches of the workers.
+   std::vector<std::unique_ptr<RowBuffer>> thread_matches;
+   /// The expansion state of the workers.
+   std::vector<std::unique_ptr<Expansion>> expansions;
+   /// All blocks of matches over all threads. Collected when the first block gets claimed.
+   std::vector<std::pair<char*, size_t>> blocks;
+   /// Were the blocks collected already?
+   bool blocks_collected = false;
+   /// The next block which was not claimed yet.
+   size_t next_block = 0;
+};
+
+}
+
+#endif //INKFUSE_JOINHASHTABLES_H
@@ -0,0 +1,235 @@
+#include "runtime/PartitionedHashTables.h"
+#include "exec/ExecutionContext.h"
+#include "exec/FuseChunk.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <type_traits>
+
+namespace inkfuse {
+
+template <>
+const std::string PartitionedHashTable<HashTableSimpleKey>::ID = "psk";
+template <>
+const std::string PartitionedHashTable<HashTableComplexKey>::ID = "pck";
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 4>::ID = "psk4";
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 8>::ID = "psk8";
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 12>::ID = "psk12";
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 16>::ID = "psk16";
+
+namespace {
+/// Size of the buffers used for writing and reading spilled groups.
+const size_t SPILL_BUFFER_SIZE = 1 << 16;
+}
+
+template <class HashTable>
+AggregationHashTables<HashTable>::AggregationHashTables(Factory factory_, MergeFunction merge_, size_t num_partitions_, uint16_t key_size_, uint16_t payload_size_, std::optional<size_t> memory_budget_)
+   : factory(std::move(factory_)), merge(std::move(merge_)), num_partitions(num_partitions_), key_size(key_size_), payload_size(payload_size_), memory_budget(memory_budget_) {
+   merged_flags = std::make_unique<std::once_flag[]>(num_partitions);
+   merged.resize(num_partitions);
+   spill_files.resize(num_partitions);
+}
+
+template <class HashTable>
+PartitionedHashTable<HashTable>& AggregationHashTables<HashTable>::getThreadTable(size_t thread_id) {
+   std::unique_lock lock(thread_tables_lock);
+   while (thread_tables.size() <= thread_id) {
+      auto& table = thread_tables.emplace_back(std::make_unique<PartitionedHashTable<HashTable>>(num_partitions, factory));
+      if (memory_budget) {
+         // Every table accounts for its own memory, the accounted bytes live within the check.
+         table->setMemoryCheck([this, accounted = size_t{0}](PartitionedHashTable<HashTable>& table) mutable {
+            checkMemory(table, accounted);
+         });
+      }
+   }
+   return *thread_tables[thread_id];
+}
+
+template <class HashTable>
+HashTable& AggregationHashTables<HashTable>::mergePartition(size_t idx) {
+   assert(idx < num_partitions);
+   std::call_once(merged_flags[idx], [&]() {
+      if (thread_tables.empty()) {
+         // No worker ever pre-aggregated.
+         merged[idx] = factory();
+         return;
+      }
+      // The partition of the first worker becomes the merge target.
+      merged[idx] = thread_tables[0]->releasePartition(idx);
+      for (size_t thread_id = 1; thread_id < thread_tables.size(); ++thread_id) {
+         // Free the pre-aggregated partition once it was merged.
+         auto source = thread_tables[thread_id]->releasePartition(idx);
+         mergeInto(*merged[idx], *source);
+         retireStats(source->getStats());
+      }
+      if (spill_files[idx]) {
+         // Stream the spilled groups back in. The file only contains whole slots and
+         // the buffer is a multiple of the slot size, so every read returns whole slots.
+         const size_t slot_size = key_size + payload_size;
+         std::vector<char> buffer(std::max(SPILL_BUFFER_SIZE / slot_size, size_t{1}) * slot_size);
+         while (const size_t bytes = spill_files[idx]->read(buffer.data(), buffer.size())) {
+            for (size_t offset = 0; offset < bytes; offset += slot_size) {
+               mergeSlot(*merged[idx], &buffer[offset]);
+            }
+         }
+         spill_files[idx].reset();
+      }
+   });
+   return *merged[idx];
+}
+
+template <class HashTable>
+void AggregationHashTables<HashTable>::dropPartition(size_t idx) {
+   assert(idx < num_partitions);
+   if (merged[idx]) {
+      retireStats(merged[idx]->getStats());
+   }
+   merged[idx].reset();
+}
+
+template <class HashTable>
+size_t AggregationHashTables<HashTable>::getSpilledBytes() const {
+   size_t bytes = 0;
+   for (const auto& file : spill_files) {
+      bytes += file ? file->size() : 0;
+   }
+   return bytes;
+}
+
+template <class HashTable>
+void AggregationHashTables<HashTable>::mergeInto(HashTable& target, HashTable& source) {
+   char* it_data;
+   uint64_t it_idx;
+   source.iteratorStart(&it_data, &it_idx);
+   while (it_data != nullptr) {
+      mergeSlot(target, it_data);
+      source.iteratorAdvance(&it_data, &it_idx);
+   }
+}
+
+template <class HashTable>
+void AggregationHashTables<HashTable>::mergeSlot(HashTable& target, const char* slot) {
+   char* dst;
+   bool is_new_key;
+   if constexpr (std::is_same_v<HashTable, HashTableSimpleKey>) {
+      if (key_size == 0) {
+         // Aggregation without key, there is only a single group.
+         is_new_key = target.size() == 0;
+         dst = target.lookupOrInsertSingleKey();
+      } else {
+         target.lookupOrInsert(&dst, &is_new_key, slot);
+      }
+   } else {
+      target.lookupOrInsert(&dst, &is_new_key, slot);
+   }
+   if (is_new_key) {
+      // New groups take over the aggregate state as-is.
+      std::memcpy(dst + key_size, slot + key_size, payload_size);
+   } else {
+      merge(dst, slot);
+   }
+}
+
+template <class HashTable>
+void AggregationHashTables<HashTable>::checkMemory(PartitionedHashTable<HashTable>& table, size_t& accounted) {
+   // Every slot also has a one byte tag.
+   size_t bytes = 0;
+   for (size_t idx = 0; idx < num_partitions; ++idx) {
+      bytes += table.getPartition(idx).capacity() * (key_size + payload_size + 1);
+   }
+   used_bytes += bytes;
+   used_bytes -= accounted;
+   accounted = bytes;
+   // Only spill tables with more groups than a chunk. Otherwise an interpreted primitive
+   // that gets rerun on the cleared table could trigger the next spill right away.
+   if (used_bytes.load() > *memory_budget && table.getNumGroups() > DEFAULT_CHUNK_SIZE) {
+      spill(table);
+      used_bytes -= accounted;
+      accounted = 0;
+   }
+}
+
+template <class HashTable>
+void AggregationHashTables<HashTable>::spill(PartitionedHashTable<HashTable>& table) {
+   const size_t slot_size = key_size + payload_size;
+   std::vector<char> buffer;
+   buffer.reserve(SPILL_BUFFER_SIZE + slot_size);
+   for (size_t idx = 0; idx < num_partitions; ++idx) {
+      auto& partition = table.getPartition(idx);
+      if (partition.size() == 0) {
+         continue;
+      }
+      SpillFile* file;
+      {
+         std::unique_lock lock(thread_tables_lock);
+         if (!spill_files[idx]) {
+            spill_files[idx] = std::make_unique<SpillFile>();
+         }
+         file = spill_files[idx].get();
+      }
+      char* it_data;
+      uint64_t it_idx;
+      partition.iteratorStart(&it_data, &it_idx);
+      while (it_data != nullptr) {
+         buffer.insert(buffer.end(), it_data, it_data + slot_size);
+         if (buffer.size() >= SPILL_BUFFER_SIZE) {
+            file->write(buffer.data(), buffer.size());
+            buffer.clear();
+         }
+         partition.iteratorAdvance(&it_data, &it_idx);
+      }
+      if (!buffer.empty()) {
+         file->write(buffer.data(), buffer.size());
+         buffer.clear();
+      }
+   }
+   // The cleared table starts out small again, just like the first table of the worker.
+   retireStats(table.getStats());
+   table.clear(factory);
+   // The groups returned by earlier lookups of the running morsel are gone. This forces interpreted
+   // primitives to rerun and look up their groups in the cleared table.
+   // Their groups were spilled with zero-initialized aggregate state, merging them later is a no-op.
+   bool* try_restart_flag = ExecutionContext::tryGetInstalledRestartFlag();
+   if (try_restart_flag) {
+      *try_restart_flag = true;
+   }
+}
+
+template <class HashTable>
+void AggregationHashTables<HashTable>::retireStats(const HashTableStats& stats) {
+   std::unique_lock lock(stats_lock);
+   retired_stats.merge(stats);
+}
+
+template <class HashTable>
+HashTableStats AggregationHashTables<HashTable>::getStats() {
+   HashTableStats stats;
+   {
+      std::unique_lock lock(stats_lock);
+      stats = retired_stats;
+   }
+   {
+      std::unique_lock lock(thread_tables_lock);
+      for (const auto& table : thread_tables) {
+         stats.merge(table->getStats());
+      }
+   }
+   for (const auto& table : merged) {
+      if (table) {
+         stats.merge(table->getStats());
+      }
+   }
+   stats.table = "agg_" + HashTable::ID;
+   return stats;
+}
+
+// Explicitly instantiate templates.
+template struct AggregationHashTables<HashTableSimpleKey>;
+template struct AggregationHashTables<HashTableComplexKey>;
+template struct AggregationHashTables<HashTableDirectLookup>;
+
+}
@@ -0,0 +1,253 @@
+#ifndef INKFUSE_PARTITIONEDHASHTABLES_H
+#define INKFUSE_PARTITIONEDHASHTABLES_H
+
+#include "runtime/HashTables.h"
+#include "runtime/SpillFile.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// This file contains the hash tables used for parallel two-phase aggregations.
+namespace inkfuse {
+
+/// A hash table which radix-partitions its groups into a set of independent hash tables.
+/// Every worker thread of a parallel aggregation pre-aggregates into its own PartitionedHashTable.
+/// Partition `k` of the different workers then gets merged independently.
+/// Keeping the partitions small also keeps them cache resident during the merge.
+template <class HashTable>
+struct PartitionedHashTable {
+   /// Unique Hash Table ID.
+   static const std::string ID;
+
+   /// Create a new partitioned hash table. The number of partitions has to be a power of two.
+   PartitionedHashTable(size_t num_partitions, const std::function<std::unique_ptr<HashTable>()>& factory) {
+      if (num_partitions == 0 || num_partitions > max_partitions || (num_partitions & (num_partitions - 1)) != 0) {
+         throw std::runtime_error("Number of hash table partitions has to be a power of 2 of at most 256.");
+      }
+      partitions.reserve(num_partitions);
+      for (size_t k = 0; k < num_partitions; ++k) {
+         partitions.push_back(factory());
+      }
+   }
+
+   /// Checks the memory used by the table, may spill its groups. Gets called every `memory_check_interval` new groups.
+   using MemoryCheck = std::function<void(PartitionedHashTable& table)>;
+
+   /// Get the pointer to a given key, creating a new group in the right partition if it does not exist yet.
+   char* lookupOrInsert(const char* key) {
+      checkMemoryBeforeInsert();
+      const uint64_t hash = partitions[0]->hash(key);
+      char* result;
+      bool is_new_key;
+      partitions[partitionIdx(hash, partitions.size())]->lookupOrInsert(&result, &is_new_key, key, hash);
+      num_groups += is_new_key;
+      return result;
+   }
+
+   /// Same as above, specialized on a fixed key width. See HashTableSimpleKey::lookupOrInsertFixed.
+   template <uint16_t key_width>
+   char* lookupOrInsertFixed(const char* key) {
+      checkMemoryBeforeInsert();
+      const uint64_t hash = HashTable::template hashFixed<key_width>(key);
+      char* result;
+      bool is_new_key;
+      partitions[partitionIdx(hash, partitions.size())]->template lookupOrInsertFixed<key_width>(&result, &is_new_key, key, hash);
+      num_groups += is_new_key;
+      return result;
+   }
+
+   /// Make room for `num_keys` more keys. The hash spreads the keys uniformly across the partitions, so every
+   /// partition reserves its expected share. This is only a sizing hint: a partition receiving more keys grows in place.
+   void reserve(size_t num_keys) {
+      const size_t per_partition = (num_keys + partitions.size() - 1) / partitions.size();
+      for (auto& partition : partitions) {
+         partition->reserve(per_partition);
+      }
+   }
+
+   /// Install a memory check that is run regularly while new groups get inserted.
+   void setMemoryCheck(MemoryCheck check) {
+      memory_check = std::move(check);
+      next_memory_check = num_groups + memory_check_interval;
+   }
+
+   /// Replace all partitions with empty ones. Used once the groups were spilled.
+   void clear(const std::function<std::unique_ptr<HashTable>()>& factory) {
+      for (auto& partition : partitions) {
+         partition = factory();
+      }
+      num_groups = 0;
+      if (memory_check) {
+         next_memory_check = memory_check_interval;
+      }
+   }
+
+   /// Get the number of groups inserted since the table was last cleared.
+   size_t getNumGroups() const {
+      return num_groups;
+   }
+   /// Same as above, lets the partitioned table stand in for a single hash table.
+   size_t size() const {
+      return num_groups;
+   }
+
+   /// Get a single partition.
+   HashTable& getPartition(size_t idx) {
+      return *partitions[idx];
+   }
+
+   /// Release a single partition. Used to hand the partition over to the merged result.
+   std::unique_ptr<HashTable> releasePartition(size_t idx) {
+      return std::move(partitions[idx]);
+   }
+
+   size_t getNumPartitions() const {
+      return partitions.size();
+   }
+
+   /// Get the combined statistics of all partitions which were not released yet.
+   HashTableStats getStats() const {
+      HashTableStats stats;
+      for (const auto& partition : partitions) {
+         if (partition) {
+            stats.merge(partition->getStats());
+         }
+      }
+      return stats;
+   }
+
+   /// Get the partition for the given hash. The lower bits of the hash pick the slot within the
+   /// partition and the upper byte is used for the tags. We partition on the bits in between.
+   static size_t partitionIdx(uint64_t hash, size_t num_partitions) {
+      return (hash >> 48ul) & (num_partitions - 1);
+   }
+
+   /// Maximum number of partitions.
+   static constexpr size_t max_partitions = 256;
+   /// Number of new groups between two memory checks.
+   static constexpr size_t memory_check_interval = 1024;
+
+   private:
+   /// Run the memory check if enough new groups were inserted. Has to happen before inserting:
+   /// if the groups get spilled, the returned pointer still has to be valid.
+   void checkMemoryBeforeInsert() {
+      if (num_groups >= next_memory_check) [[unlikely]] {
+         next_memory_check = num_groups + memory_check_interval;
+         memory_check(*this);
+      }
+   }
+
+   /// The backing partitions.
+   std::vector<std::unique_ptr<HashTable>> partitions;
+   /// Number of groups inserted since the table was last cleared.
+   size_t num_groups = 0;
+   /// Number of groups at which the next memory check runs.
+   size_t next_memory_check = std::numeric_limits<size_t>::max();
+   /// The memory check, if one is installed.
+   MemoryCheck memory_check;
+};
+
+/// Hash tables of a parallel two-phase aggregation. Phase one pre-aggregates into one
+/// PartitionedHashTable per worker thread. Phase two merges the per-worker partitions
+/// into a single hash table per partition. Different partitions can be merged concurrently.
+///
+/// Slots of all tables have the same layout: the aggregation key followed by the aggregate state.
+///
+/// With a memory budget, the aggregation runs out of core. Once the pre-aggregation tables of all workers exceed
+/// the budget, a worker writes the groups of its table to one spill file per partition and starts over with
+/// an empty table. Merging a partition then streams the spilled groups back in. This requires that the
+/// aggregate state can be merged from zero-initialized slots.
+template <class HashTable>
+struct AggregationHashTables {
+   /// Creates an empty hash table for a single partition.
+   using Factory = std::function<std::unique_ptr<HashTable>()>;
+   /// Merges the aggregate state of the `src` slot into the `dst` slot.
+   using MergeFunction = std::function<void(char* dst, const char* src)>;
+
+   AggregationHashTables(Factory factory_, MergeFunction merge_, size_t num_partitions_, uint16_t key_size_, uint16_t payload_size_, std::optional<size_t> memory_budget_ = std::nullopt);
+
+   /// Get the pre-aggregation table of a worker thread. Creates the table on first access.
+   PartitionedHashTable<HashTable>& getThreadTable(size_t thread_id);
+
+   /// Merge a partition across all worker threads and return the merged hash table.
+   /// Must only be called once all pre-aggregation is done. Every partition gets merged once,
+   /// different partitions can be merged by different threads at the same time.
+   HashTable& mergePartition(size_t idx);
+   /// Free a merged partition once it was read completely.
+   void dropPartition(size_t idx);
+
+   /// Get the number of bytes that were spilled to disk. Mainly used for testing.
+   size_t getSpilledBytes() const;
+   /// Get the combined statistics of all pre-aggregation and merged tables, including the ones that were freed already.
+   HashTableStats getStats();
+
+   size_t getNumPartitions() const {
+      return num_partitions;
+   }
+
+   private:
+   /// Merge a single pre-aggregation partition into the target.
+   void mergeInto(HashTable& target, HashTable& source);
+   /// Merge a single slot into the target.
+   void mergeSlot(HashTable& target, const char* slot);
+   /// Update the memory used by a worker table. `accounted` are the bytes of the table that were accounted for so far.
+   /// Spills the table if the budget is exceeded.
+   void checkMemory(PartitionedHashTable<HashTable>& table, size_t& accounted);
+   /// Write all groups of a worker table to the spill files and clear it.
+   void spill(PartitionedHashTable<HashTable>& table);
+   /// Keep the statistics of a table that is about to be freed.
+   void retireStats(const HashTableStats& stats);
+
+   /// Factory for new partitions.
+   Factory factory;
+   /// Aggregate state merge function.
+   MergeFunction merge;
+   /// Number of partitions per worker.
+   size_t num_partitions;
+   /// Size of the aggregation key within a slot.
+   uint16_t key_size;
+   /// Size of the aggregate state following the key.
+   uint16_t payload_size;
+   /// Memory budget for the pre-aggregation tables of all workers in bytes.
+   std::optional<size_t> memory_budget;
+   /// Memory currently used by the pre-aggregation tables of all workers.
+   std::atomic<size_t> used_bytes = 0;
+   /// Lock protecting the creation of thread tables and spill files.
+   std::mutex thread_tables_lock;
+   /// The pre-aggregation tables of the workers.
+   std::vector<std::unique_ptr<PartitionedHashTable<HashTable>>> thread_tables;
+   /// Merge guards, one per partition.
+   std::unique_ptr<std::once_flag[]> merged_flags;
+   /// The merged partitions.
+   std::vector<std::unique_ptr<HashTable>> merged;
+   /// The spilled groups of every partition.
+   std::vector<std::unique_ptr<SpillFile>> spill_files;
+   /// Lock protecting the statistics of freed tables.
+   std::mutex stats_lock;
+   /// Combined statistics of all freed tables.
+   HashTableStats retired_stats;
+};
+
+template <>
+const std::string PartitionedHashTable<HashTableSimpleKey>::ID;
+template <>
+const std::string PartitionedHashTable<HashTableComplexKey>::ID;
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 4>::ID;
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 8>::ID;
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 12>::ID;
+template <>
+const std::string FixedKeyWidth<PartitionedHashTable<HashTableSimpleKey>, 16>::ID;
+
+}
+
+#endif //INKFUSE_PARTITIONEDHASHTABLES_H
@@ -0,0 +1,287 @@
+#include "runtime/RadixHashJoin.h"
+#include "exec/FuseChunk.h"
+#include "runtime/HashRuntime.h"
+#include <algorithm>
+#include <bit>
+
+namespace inkfuse {
+
+namespace {
+/// Size of a cache line.
+const size_t cache_line_size = 64;
+/// Approximate size of the blocks storing the rows of a partition.
+const size_t block_size = 1 << 15;
+/// Additional memory of every row within a hash table that has twice as many slots as rows: a tag and an index entry per slot.
+const size_t row_overhead = 2 * (sizeof(uint8_t) + sizeof(char*));
+
+/// Create an empty hash table that can take the given number of rows without growing.
+std::unique_ptr<HashTableSimpleKey> sizedTable(uint16_t key_size, uint16_t payload_size, size_t rows) {
+   return std::make_unique<HashTableSimpleKey>(key_size, payload_size, std::bit_ceil(std::max(2 * rows, size_t{2})));
+}
+}
+
+RadixHashJoin::PartitionRows::PartitionRows(uint32_t row_size_, size_t block_rows_)
+   : row_size(row_size_), block_rows(block_rows_) {
+}
+
+void RadixHashJoin::PartitionRows::append(const char* data, size_t rows) {
+   while (rows > 0) {
+      const size_t block_offset = num_rows % block_rows;
+      if (block_offset == 0 && num_rows / block_rows == blocks.size()) {
+         // The rows get overwritten right away, no need to zero the block.
+         blocks.emplace_back(new char[block_rows * row_size]);
+      }
+      const size_t copied = std::min(rows, block_rows - block_offset);
+      std::memcpy(blocks.back().get() + block_offset * row_size, data, copied * row_size);
+      data += copied * row_size;
+      num_rows += copied;
+      rows -= copied;
+   }
+}
+
+RadixHashJoin::Partitioner::Partitioner(uint32_t row_size_, size_t num_partitions)
+   : row_size(row_size_), buffer_rows(std::max(write_buffer_size / row_size_, size_t{1})), fill(num_partitions) {
+   buffer_stride = (buffer_rows * row_size + cache_line_size - 1) & ~(cache_line_size - 1);
+   buffer_memory = std::make_unique<char[]>(num_partitions * buffer_stride + cache_line_size);
+   // Align the buffers on cache lines, a full buffer then covers as few lines as possible.
+   const auto address = reinterpret_cast<uintptr_t>(buffer_memory.get());
+   buffers = buffer_memory.get() + ((cache_line_size - address % cache_line_size) % cache_line_size);
+   // Blocks hold a multiple of the write-combining buffer. Flushing a full buffer then never crosses blocks.
+   const size_t block_rows = buffer_rows * std::max(block_size / (buffer_rows * row_size), size_t{1});
+   partitions.reserve(num_partitions);
+   for (size_t k = 0; k < num_partitions; ++k) {
+      partitions.emplace_back(row_size, block_rows);
+   }
+}
+
+void RadixHashJoin::Partitioner::flush() {
+   for (size_t partition = 0; partition < partitions.size(); ++partition) {
+      partitions[partition].append(buffers + partition * buffer_stride, fill[partition]);
+      fill[partition] = 0;
+   }
+}
+
+RadixHashJoin::ThreadBuild::ThreadBuild(RadixHashJoin& join_)
+   : join(join_), rows(join_.key_size + join_.payload_size, join_.key_size) {
+}
+
+RadixHashJoin::ThreadProbe::ThreadProbe(RadixHashJoin& join_)
+   : join(join_), partitioned(join_.probe_size, join_.numPartitions(0)) {
+}
+
+RadixHashJoin::RadixHashJoin(uint16_t key_size_, uint16_t payload_size_, uint16_t probe_size_, bool semi_join_, size_t max_rows_, size_t partition_bytes_)
+   : key_size(key_size_), payload_size(payload_size_), probe_size(probe_size_), semi_join(semi_join_), max_rows(max_rows_), partition_bytes(partition_bytes_) {
+}
+
+void RadixHashJoin::choosePartitions() {
+   size_t build_rows = 0;
+   for (const auto& build : thread_builds) {
+      build_rows += build->rows.size();
+   }
+   // Enough partitions that the hash table of every partition fits into the target size.
+   const size_t table_bytes = build_rows * (key_size + payload_size + row_overhead);
+   const size_t min_partitions = table_bytes / partition_bytes + (table_bytes % partition_bytes != 0);
+   const size_t partitions = std::bit_ceil(std::max(min_partitions, size_t{1}));
+   const size_t bits = std::countr_zero(partitions);
+   pass_bits[0] = std::min(bits, max_pass_bits);
+   pass_bits[1] = std::min(bits - pass_bits[0], max_pass_bits);
+}
+
+RadixHashJoin::ThreadBuild& RadixHashJoin::getThreadBuild(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_builds.size() <= thread_id) {
+      thread_builds.push_back(std::make_unique<ThreadBuild>(*this));
+   }
+   return *thread_builds[thread_id];
+}
+
+void RadixHashJoin::finalizeBuild(size_t thread_id) {
+   // All workers are done appending, the number of build rows is known now.
+   std::call_once(partitions_chosen, [&]() { choosePartitions(); });
+   if (thread_id >= thread_builds.size()) {
+      return;
+   }
+   // Every worker runs the first partitioning pass on its own rows.
+   auto& build = *thread_builds[thread_id];
+   auto& partitioned = build.partitioned.emplace(build.rows.rowSize(), numPartitions(0));
+   for (size_t block_idx = 0; block_idx < build.rows.numBlocks(); ++block_idx) {
+      auto [block, block_rows] = build.rows.getBlock(block_idx);
+      for (size_t row_idx = 0; row_idx < block_rows; ++row_idx) {
+         const char* row = block + row_idx * build.rows.rowSize();
+         partitioned.add(row, partitionIdx(HashRuntime::hashKey(row, key_size), 0));
+      }
+   }
+   partitioned.flush();
+   build.rows = RowBuffer(build.rows.rowSize(), key_size);
+}
+
+RadixHashJoin::ThreadProbe& RadixHashJoin::getThreadProbe(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_probes.size() <= thread_id) {
+      thread_probes.push_back(std::make_unique<ThreadProbe>(*this));
+   }
+   return *thread_probes[thread_id];
+}
+
+void RadixHashJoin::finalizeProbe(size_t thread_id) {
+   getThreadProbe(thread_id).partitioned.flush();
+}
+
+RadixHashJoin::ThreadOutput& RadixHashJoin::getThreadOutput(size_t thread_id) {
+   std::unique_lock guard(lock);
+   while (thread_outputs.size() <= thread_id) {
+      auto& output = thread_outputs.emplace_back(std::make_unique<ThreadOutput>());
+      output->build_rows = std::make_unique<char*[]>(max_rows);
+      output->probe_rows = std::make_unique<char*[]>(max_rows);
+   }
+   return *thread_outputs[thread_id];
+}
+
+bool RadixHashJoin::claimPartition(ThreadOutput& output) {
+   size_t partition;
+   {
+      std::unique_lock guard(lock);
+      if (!work_collected) {
+         // The probe pipeline is done, all partitions are complete now.
+         for (size_t candidate = 0; candidate < numPartitions(0); ++candidate) {
+            // Partitions without build or probe rows cannot produce a match.
+            const bool has_build = std::any_of(thread_builds.begin(), thread_builds.end(), [&](const auto& build) {
+               return build->partitioned && build->partitioned->partitions[candidate].size() > 0;
+            });
+            const bool has_probe = std::any_of(thread_probes.begin(), thread_probes.end(), [&](const auto& probe) {
+               return probe->partitioned.partitions[candidate].size() > 0;
+            });
+            if (has_build && has_probe) {
+               work.push_back(candidate);
+            }
+         }
+         work_collected = true;
+      }
+      if (next_work == work.size()) {
+         return false;
+      }
+      partition = work[next_work++];
+   }
+
+   // The rows of the claimed partition are spread across all workers.
+   PartitionPair pair;
+   for (const auto& build : thread_builds) {
+      if (build->partitioned) {
+         pair.build.push_back(&build->partitioned->partitions[partition]);
+      }
+   }
+   for (const auto& probe : thread_probes) {
+      pair.probe.push_back(&probe->partitioned.partitions[partition]);
+   }
+   output.pairs.clear();
+   output.next_pair = 0;
+   if (numPartitions(1) == 1) {
+      output.pairs.push_back(std::move(pair));
+      return true;
+   }
+
+   // Second partitioning pass. The partition is small enough that this runs within the cache of the worker.
+   auto& sub_build = output.sub_build.emplace(key_size + payload_size, numPartitions(1));
+   for (const PartitionRows* rows : pair.build) {
+      for (size_t idx = 0; idx < rows->size(); ++idx) {
+         const char* row = rows->row(idx);
+         sub_build.add(row, partitionIdx(HashRuntime::hashKey(row, key_size), 1));
+      }
+   }
+   sub_build.flush();
+   auto& sub_probe = output.sub_probe.emplace(probe_size, numPartitions(1));
+   for (const PartitionRows* rows : pair.probe) {
+      for (size_t idx = 0; idx < rows->size(); ++idx) {
+         const char* row = rows->row(idx);
+         sub_probe.add(row, partitionIdx(HashRuntime::hashKey(row, key_size), 1));
+      }
+   }
+   sub_probe.flush();
+   for (size_t sub_partition = 0; sub_partition < numPartitions(1); ++sub_partition) {
+      output.pairs.push_back(PartitionPair{
+         .build = {&sub_build.partitions[sub_partition]},
+         .probe = {&sub_probe.partitions[sub_partition]},
+      });
+   }
+   return true;
+}
+
+bool RadixHashJoin::nextPair(ThreadOutput& output) {
+   const auto num_rows = [](const std::vector<const PartitionRows*>& parts) {
+      size_t rows = 0;
+      for (const PartitionRows* part : parts) {
+         rows += part->size();
+      }
+      return rows;
+   };
+   while (true) {
+      while (output.next_pair < output.pairs.size()) {
+         const auto& pair = output.pairs[output.next_pair++];
+         const size_t build_rows = num_rows(pair.build);
+         if (build_rows == 0 || num_rows(pair.probe) == 0) {
+            continue;
+         }
+         // The table never grows and fits into the cache.
+         output.table = sizedTable(key_size, payload_size, build_rows);
+         for (const PartitionRows* rows : pair.build) {
+            for (size_t idx = 0; idx < rows->size(); ++idx) {
+               // The build side of a primary key join has no duplicate keys.
+               const char* row = rows->row(idx);
+               char* slot = output.table->insert(row);
+               std::memcpy(slot + key_size, row + key_size, payload_size);
+            }
+         }
+         output.probe_part = 0;
+         output.probe_row = 0;
+         return true;
+      }
+      if (!claimPartition(output)) {
+         return false;
+      }
+   }
+}
+
+size_t RadixHashJoin::produce(size_t thread_id) {
+   auto& output = getThreadOutput(thread_id);
+   while (output.table || nextPair(output)) {
+      const auto& probe = output.pairs[output.next_pair - 1].probe;
+      size_t produced = 0;
+      while (produced < max_rows && output.probe_part < probe.size()) {
+         const PartitionRows& rows = *probe[output.probe_part];
+         if (output.probe_row == rows.size()) {
+            output.probe_part++;
+            output.probe_row = 0;
+            continue;
+         }
+         char* row = rows.row(output.probe_row++);
+         char* build_row = semi_join ? output.table->lookupDisable(row) : output.table->lookup(row);
+         if (build_row) {
+            output.probe_rows[produced] = row;
+            output.build_rows[produced] = build_row;
+            produced++;
+         }
+      }
+      if (produced > 0) {
+         return produced;
+      }
+      // All probe rows of the pair were streamed through the table. The rows produced by the
+      // last call are consumed, the table can go.
+      output.table.reset();
+   }
+   return 0;
+}
+
+char** RadixHashJoin::getOutput(size_t thread_id, bool build_side) {
+   auto& output = getThreadOutput(thread_id);
+   return build_side ? output.build_rows.get() : output.probe_rows.get();
+}
+
+double RadixHashJoin::progress() const {
+   std::unique_lock guard(lock);
+   if (work.empty()) {
+      return 1.0;
+   }
+   return static_cast<double>(next_work) / work.size();
+}
+
+}
@@ -0,0 +1,237 @@
+#ifndef INKFUSE_RADIXHASHJOIN_H
+#define INKFUSE_RADIXHASHJOIN_H
+
+#include "runtime/JoinHashTables.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/// This file contains the state of primary key joins whose build side is much larger than the CPU caches.
+namespace inkfuse {
+
+/// Radix-partitioned hash join for primary key joins. A single hash table on a large build side turns every
+/// probe into a random DRAM access. Instead, build and probe rows are radix-partitioned on the hash of their
+/// key until the hash table of a single partition fits into the cache. Every pair of partitions is then
+/// joined with a small, cache-resident hash table.
+///
+/// - Build: every worker appends its packed build rows (key followed by the payload). Once the build pipeline is done,
+///   the number of partitions is chosen based on the number of build rows and every worker partitions its own rows.
+/// - Probe: probe rows are not looked up, they are only scattered into the partitions.
+/// - Output: a followup pipeline claims one partition at a time. If the partition is still too large for the cache,
+///   it is split up once more in a second pass. Afterwards, the build rows of every (sub-)partition are inserted into a
+///   hash table and the probe rows of the partition are streamed through it.
+///
+/// All scatters go through software write-combining buffers: a row is first copied into a small buffer of its partition,
+/// full buffers are flushed to the partition with one sequential copy. This way, the scatter only touches a few cache
+/// lines and TLB entries at a time, even with hundreds of partitions.
+struct RadixHashJoin final : public JoinRows {
+   /// Set up the join. `probe_size_` is the size of a packed probe row. Semi joins disable every build row
+   /// that found a match. The hash table of a single partition should not exceed `partition_bytes_`.
+   RadixHashJoin(uint16_t key_size_, uint16_t payload_size_, uint16_t probe_size_, bool semi_join_, size_t max_rows_, size_t partition_bytes_ = default_partition_bytes);
+
+   /// Default target size of the hash table of a single partition. Small enough to stay within the L2 cache.
+   static constexpr size_t default_partition_bytes = 256 * 1024;
+   /// Maximum number of radix bits of a single partitioning pass. Keeps the write-combining buffers of all
+   /// partitions within the L1/L2 cache and the number of written pages within the TLB.
+   static constexpr size_t max_pass_bits = 8;
+   /// Size of the write-combining buffer of a partition.
+   static constexpr size_t write_buffer_size = 256;
+
+   /// Rows of a single partition, stored within fixed-size blocks which never move.
+   struct PartitionRows {
+      PartitionRows(uint32_t row_size_, size_t block_rows_);
+
+      /// Append `rows` contiguous rows.
+      void append(const char* data, size_t rows);
+      /// Get a row.
+      char* row(size_t idx) const {
+         return blocks[idx / block_rows].get() + (idx % block_rows) * row_size;
+      }
+      /// Get the number of rows.
+      size_t size() const {
+         return num_rows;
+      }
+
+      private:
+      /// The blocks storing the rows.
+      std::vector<std::unique_ptr<char[]>> blocks;
+      /// Size of a row.
+      uint32_t row_size;
+      /// Number of rows within a block.
+      size_t block_rows;
+      /// Number of rows.
+      size_t num_rows = 0;
+   };
+
+   /// Scatters rows into partitions through software write-combining buffers.
+   struct Partitioner {
+      Partitioner(uint32_t row_size_, size_t num_partitions);
+
+      /// Add a row to a partition.
+      void add(const char* row, size_t partition) {
+         char* buffer = buffers + partition * buffer_stride;
+         std::memcpy(buffer + fill[partition] * row_size, row, row_size);
+         if (++fill[partition] == buffer_rows) {
+            partitions[partition].append(buffer, buffer_rows);
+            fill[partition] = 0;
+         }
+      }
+      /// Write out the rows within the write-combining buffers. Must be called once all rows were added.
+      void flush();
+
+      /// The partitioned rows.
+      std::vector<PartitionRows> partitions;
+
+      private:
+      /// Size of a row.
+      uint32_t row_size;
+      /// Number of rows within a write-combining buffer.
+      uint32_t buffer_rows;
+      /// Distance between the write-combining buffers of two partitions. A multiple of the cache line size.
+      size_t buffer_stride;
+      /// The memory backing the write-combining buffers.
+      std::unique_ptr<char[]> buffer_memory;
+      /// The cache-line aligned write-combining buffers.
+      char* buffers;
+      /// Number of rows within every write-combining buffer.
+      std::vector<uint32_t> fill;
+   };
+
+   /// Build side of a worker thread.
+   struct ThreadBuild {
+      ThreadBuild(RadixHashJoin& join_);
+
+      /// Append a new build row and copy the key into it. Returns the row.
+      char* append(const char* key) {
+         return rows.append(key);
+      }
+
+      private:
+      friend struct RadixHashJoin;
+
+      /// The join.
+      RadixHashJoin& join;
+      /// The appended rows. They never move while the morsel writing their payload runs.
+      RowBuffer rows;
+      /// The rows after the first partitioning pass.
+      std::optional<Partitioner> partitioned;
+   };
+
+   /// Probe side of a worker thread.
+   struct ThreadProbe {
+      ThreadProbe(RadixHashJoin& join_);
+
+      /// Add a packed probe row with the given key hash to its partition.
+      void probe(const char* row, uint64_t hash) {
+         partitioned.add(row, join.partitionIdx(hash, 0));
+      }
+
+      private:
+      friend struct RadixHashJoin;
+
+      /// The join.
+      RadixHashJoin& join;
+      /// The rows after the first partitioning pass.
+      Partitioner partitioned;
+   };
+
+   /// Get the build side of a worker thread. Creates it on first access.
+   ThreadBuild& getThreadBuild(size_t thread_id);
+   /// Choose the number of partitions and partition the build rows of the worker.
+   /// Must be called by every worker thread once all of them are done building.
+   void finalizeBuild(size_t thread_id);
+
+   /// Get the probe side of a worker thread. Creates it on first access. Only valid once the build is finalized.
+   ThreadProbe& getThreadProbe(size_t thread_id);
+   /// Flush the write-combining buffers of a worker. Must be called by every worker thread once it is done probing.
+   void finalizeProbe(size_t thread_id);
+
+   /// Join the partitions pair-wise.
+   size_t produce(size_t thread_id) override;
+   char** getOutput(size_t thread_id, bool build_side) override;
+   /// Fraction of the partitions which were claimed already.
+   double progress() const override;
+
+   /// Get the number of partitions of the first (0) or second (1) partitioning pass. Mainly used for testing.
+   size_t numPartitions(size_t pass) const {
+      return size_t{1} << pass_bits[pass];
+   }
+
+   private:
+   /// The rows of a (sub-)partition pair that get joined with each other.
+   struct PartitionPair {
+      std::vector<const PartitionRows*> build;
+      std::vector<const PartitionRows*> probe;
+   };
+
+   /// Output state of a worker thread.
+   struct ThreadOutput {
+      /// The produced build rows.
+      std::unique_ptr<char*[]> build_rows;
+      /// The produced probe rows.
+      std::unique_ptr<char*[]> probe_rows;
+      /// The build and probe rows of the claimed partition after the second partitioning pass.
+      std::optional<Partitioner> sub_build;
+      std::optional<Partitioner> sub_probe;
+      /// The partition pairs of the claimed partition.
+      std::vector<PartitionPair> pairs;
+      /// The next pair which was not joined yet.
+      size_t next_pair = 0;
+      /// Hash table on the build rows of the current pair.
+      std::unique_ptr<HashTableSimpleKey> table;
+      /// Position of the next probe row of the current pair.
+      size_t probe_part = 0;
+      size_t probe_row = 0;
+   };
+
+   /// Get the partition of a key hash within the given partitioning pass.
+   size_t partitionIdx(uint64_t hash, size_t pass) const {
+      // The partitions use bits of the hash that are independent of the slot and the tag within the partition's hash table.
+      const size_t shift = pass == 0 ? 48 : 40;
+      return (hash >> shift) & ((size_t{1} << pass_bits[pass]) - 1);
+   }
+   /// Choose the number of partitions based on the number of build rows.
+   void choosePartitions();
+   /// Get the output state of a worker thread. Creates it on first access.
+   ThreadOutput& getThreadOutput(size_t thread_id);
+   /// Claim the next partition and set up its pairs. Returns false if no partition is left.
+   bool claimPartition(ThreadOutput& output);
+   /// Set up the hash table of the next non-empty pair of the claimed partitions. Returns false if all partitions are joined.
+   bool nextPair(ThreadOutput& output);
+
+   /// Size of the join key.
+   uint16_t key_size;
+   /// Size of the build payload following the key.
+   uint16_t payload_size;
+   /// Size of a packed probe row.
+   uint16_t probe_size;
+   /// Is this a semi join?
+   bool semi_join;
+   /// Maximum number of rows produced at a time.
+   size_t max_rows;
+   /// Target size of the hash table of a single partition.
+   size_t partition_bytes;
+   /// Number of radix bits of the first and the second partitioning pass.
+   size_t pass_bits[2] = {0, 0};
+
+   /// Lock protecting the creation of the thread-local state and the partition claiming.
+   mutable std::mutex lock;
+   std::vector<std::unique_ptr<ThreadBuild>> thread_builds;
+   std::vector<std::unique_ptr<ThreadProbe>> thread_probes;
+   std::vector<std::unique_ptr<ThreadOutput>> thread_outputs;
+   /// Guard for choosing the number of partitions.
+   std::once_flag partitions_chosen;
+
+   /// The partitions which have build and probe rows. Collected when the first partition gets claimed.
+   std::vector<size_t> work;
+   /// Was the work collected already?
+   bool work_collected = false;
+   /// The next partition that was not claimed yet.
+   size_t next_work = 0;
+};
+
+}
+
+#endif //INKFUSE_RADIXHASHJOIN_H
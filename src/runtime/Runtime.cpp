@@ -7,6 +7,7 @@
 #include "algebra/suboperators/sinks/CountingSink.h"
 #include "algebra/suboperators/sinks/FuseChunkSink.h"
 #include "algebra/suboperators/sources/HashTableSource.h"
+#include "algebra/suboperators/sources/TableScanSource.h"
 #include "runtime/HashRuntime.h"
 #include "runtime/HashTableRuntime.h"
 #include "runtime/MemoryRuntime.h"
@@ -20,6 +21,7 @@ GlobalRuntime::GlobalRuntime() : program(std::make_unique<IR::Program>("global_r
    // Register the different runtime structs of the suboperators.
    LoopDriverRuntime::registerRuntime();
    IndexedIUProviderRuntime::registerRuntime();
+   TScanDecodeIUProvider::registerRuntime();
    KeyPackingRuntime::registerRuntime();
    FuseChunkSink::registerRuntime();
    CountingSink::registerRuntime();
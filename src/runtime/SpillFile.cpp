@@ -0,0 +1,37 @@
+#include "runtime/SpillFile.h"
+#include <stdexcept>
+
+namespace inkfuse {
+
+SpillFile::SpillFile() : file(std::tmpfile()) {
+   if (!file) {
+      throw std::runtime_error("Could not create spill file.");
+   }
+}
+
+SpillFile::~SpillFile() {
+   std::fclose(file);
+}
+
+void SpillFile::write(const char* data, size_t size) {
+   std::unique_lock lock(write_lock);
+   if (std::fwrite(data, 1, size, file) != size) {
+      throw std::runtime_error("Could not write to spill file.");
+   }
+   bytes_written += size;
+}
+
+size_t SpillFile::read(char* data, size_t size) {
+   if (bytes_read == 0 && std::fseek(file, 0, SEEK_SET) != 0) {
+      // Switch from writing to reading. Seeking flushes the buffered writes.
+      throw std::runtime_error("Could not read from spill file.");
+   }
+   const size_t read = std::fread(data, 1, size, file);
+   if (read < size && std::ferror(file)) {
+      throw std::runtime_error("Could not read from spill file.");
+   }
+   bytes_read += read;
+   return read;
+}
+
+}
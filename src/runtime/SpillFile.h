@@ -0,0 +1,44 @@
+#ifndef INKFUSE_SPILLFILE_H
+#define INKFUSE_SPILLFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+namespace inkfuse {
+
+/// Temporary file on local disk for intermediate state that does not fit into memory.
+/// Writers append to the file, once writing is done it gets read back sequentially from the start.
+/// The file lives in the temporary directory of the system and is removed once it gets closed.
+struct SpillFile {
+   SpillFile();
+   ~SpillFile();
+
+   SpillFile(const SpillFile&) = delete;
+   SpillFile& operator=(const SpillFile&) = delete;
+
+   /// Append data to the file. Multiple threads can write at the same time.
+   void write(const char* data, size_t size);
+   /// Read the next bytes of the file into `data`. Returns the number of bytes read, 0 at the end of the file.
+   /// Must only be called once all writes are done.
+   size_t read(char* data, size_t size);
+
+   /// Get the number of bytes written.
+   size_t size() const {
+      return bytes_written;
+   }
+
+   private:
+   /// The backing file.
+   std::FILE* file;
+   /// Lock protecting the writes.
+   std::mutex write_lock;
+   /// Number of bytes written.
+   size_t bytes_written = 0;
+   /// Number of bytes read.
+   size_t bytes_read = 0;
+};
+
+}
+
+#endif //INKFUSE_SPILLFILE_H
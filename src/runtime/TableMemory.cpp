@@ -0,0 +1,117 @@
+#include "runtime/TableMemory.h"
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#include <unordered_map>
+#include <vector>
+
+namespace inkfuse::TableMemory {
+
+namespace {
+/// Round an allocation size up to the size of its mapping.
+size_t mappingSize(size_t bytes) {
+   return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+/// Process-wide pool of released mappings, keyed by their size.
+struct RecyclingPool {
+   std::mutex lock;
+   std::unordered_map<size_t, std::vector<void*>> mappings;
+   size_t pooled = 0;
+
+   /// Take a pooled mapping of the given size, nullptr if there is none.
+   void* take(size_t size) {
+      std::unique_lock guard(lock);
+      auto it = mappings.find(size);
+      if (it == mappings.end() || it->second.empty()) {
+         return nullptr;
+      }
+      void* ptr = it->second.back();
+      it->second.pop_back();
+      pooled -= size;
+      return ptr;
+   }
+
+   /// Keep a mapping for later reuse. Returns false if the pool is full.
+   bool put(void* ptr, size_t size) {
+      std::unique_lock guard(lock);
+      if (pooled + size > pool_limit) {
+         return false;
+      }
+      mappings[size].push_back(ptr);
+      pooled += size;
+      return true;
+   }
+
+   void clear() {
+      std::unique_lock guard(lock);
+      for (auto& [size, ptrs] : mappings) {
+         for (void* ptr : ptrs) {
+            munmap(ptr, size);
+         }
+      }
+      mappings.clear();
+      pooled = 0;
+   }
+};
+
+RecyclingPool& getPool() {
+   // Never destroyed, tables within static objects may still release memory during shutdown.
+   static RecyclingPool* pool = new RecyclingPool;
+   return *pool;
+}
+}
+
+void* allocate(size_t bytes) {
+   if (bytes < mmap_threshold) {
+      // Small arrays are not worth a mapping of their own.
+      void* ptr = std::calloc(bytes ? bytes : 1, 1);
+      if (!ptr) {
+         throw std::bad_alloc();
+      }
+      return ptr;
+   }
+   const size_t size = mappingSize(bytes);
+   if (void* recycled = getPool().take(size)) {
+      // The pages are already faulted in, but still contain the state of the last table.
+      std::memset(recycled, 0, bytes);
+      return recycled;
+   }
+   void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED) {
+      throw std::bad_alloc();
+   }
+#ifdef MADV_HUGEPAGE
+   // Only a hint, the kernel falls back to regular pages if there are no huge pages.
+   madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+   return ptr;
+}
+
+void release(void* ptr, size_t bytes) {
+   if (!ptr) {
+      return;
+   }
+   if (bytes < mmap_threshold) {
+      std::free(ptr);
+      return;
+   }
+   const size_t size = mappingSize(bytes);
+   if (!getPool().put(ptr, size)) {
+      munmap(ptr, size);
+   }
+}
+
+size_t pooledBytes() {
+   auto& pool = getPool();
+   std::unique_lock guard(pool.lock);
+   return pool.pooled;
+}
+
+void clearPool() {
+   getPool().clear();
+}
+
+} // namespace inkfuse::TableMemory
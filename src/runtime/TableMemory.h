@@ -0,0 +1,55 @@
+#ifndef INKFUSE_TABLEMEMORY_H
+#define INKFUSE_TABLEMEMORY_H
+
+#include <cstddef>
+#include <memory>
+
+/// Memory backend for the arrays of the hash tables.
+///
+/// Large arrays get their own anonymous mapping which is advised to use transparent huge pages.
+/// Fresh mappings come zeroed from the kernel, so there is no need for a memset. Released
+/// mappings are kept in a process-wide pool: repeated queries reuse memory which is already
+/// faulted in instead of paying for the first touch of every page again.
+namespace inkfuse::TableMemory {
+
+/// Allocations of at least this size get backed by their own mapping, smaller ones use calloc.
+constexpr size_t mmap_threshold = size_t{1} << 20;
+/// Mappings are rounded up to a multiple of the huge page size.
+constexpr size_t huge_page_size = size_t{2} << 20;
+/// Maximum number of bytes kept in the recycling pool. Anything beyond is returned to the kernel.
+constexpr size_t pool_limit = size_t{1} << 30;
+
+/// Allocate `bytes` of zero-initialized memory.
+void* allocate(size_t bytes);
+/// Release memory that was allocated with `allocate(bytes)`.
+void release(void* ptr, size_t bytes);
+
+/// Number of bytes currently kept in the recycling pool.
+size_t pooledBytes();
+/// Return all pooled memory to the kernel.
+void clearPool();
+
+/// Deleter for arrays allocated through the table memory.
+struct Deleter {
+   /// Size of the allocation in bytes.
+   size_t bytes = 0;
+
+   void operator()(void* ptr) const {
+      release(ptr, bytes);
+   }
+};
+
+/// Owning pointer to an array within the table memory.
+template <class T>
+using Array = std::unique_ptr<T[], Deleter>;
+
+/// Allocate a zero-initialized array of `count` elements.
+template <class T>
+Array<T> makeArray(size_t count) {
+   const size_t bytes = count * sizeof(T);
+   return Array<T>(static_cast<T*>(allocate(bytes)), Deleter{bytes});
+}
+
+} // namespace inkfuse::TableMemory
+
+#endif //INKFUSE_TABLEMEMORY_H
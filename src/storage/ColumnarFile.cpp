@@ -0,0 +1,235 @@
+#include "storage/ColumnarFile.h"
+#include "storage/MappedFile.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace inkfuse::ColumnarFile {
+
+namespace {
+
+/// Identifies the schema file of the columnar format.
+const std::string schema_magic = "inkfuse-columnar";
+/// Version of the format, bumped on every incompatible change.
+const uint64_t format_version = 4;
+
+/// Header at the start of every column file. The column data starts right behind it,
+/// which keeps it aligned for all value types.
+struct ColumnHeader {
+   /// Identifies a column file.
+   char magic[8];
+   /// Number of rows.
+   uint64_t rows;
+   /// Number of bytes of string data, zero for PODColumns.
+   uint64_t string_bytes;
+   /// Number of dictionary entries, zero if the StringColumn is not dictionary-encoded.
+   uint64_t dictionary_entries;
+   /// Number of bytes of the zero-terminated dictionary entries.
+   uint64_t dictionary_bytes;
+   /// Width of the frame-of-reference deltas, zero if the PODColumn is not compressed.
+   uint64_t delta_width;
+   /// Does the PODColumn have a zone map?
+   uint64_t has_zone_map;
+   /// Pad the header to 64 bytes.
+   uint64_t reserved[1];
+};
+static_assert(sizeof(ColumnHeader) == 64);
+
+/// Sections behind the values of a PODColumn start at multiples of 8 bytes.
+size_t alignSection(size_t offset) {
+   return (offset + 7) & ~size_t{7};
+}
+
+const char column_magic[8] = {'I', 'N', 'K', 'F', 'C', 'O', 'L', '1'};
+
+std::string schemaPath(const std::string& dir) {
+   return dir + "/schema";
+}
+
+std::string columnPath(const std::string& dir, std::string_view name) {
+   return dir + "/" + std::string(name) + ".col";
+}
+
+/// Open a file for writing that throws on every failure.
+std::ofstream openOutput(const std::string& path) {
+   std::ofstream out;
+   out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+   out.open(path, std::ios::binary | std::ios::trunc);
+   return out;
+}
+
+/// Pad the file to the start of the next section.
+void padSection(std::ofstream& out) {
+   const size_t offset = out.tellp();
+   const char zeros[8]{};
+   out.write(zeros, alignSection(offset) - offset);
+}
+
+void writeColumn(const std::string& path, BaseColumn& col) {
+   auto out = openOutput(path);
+   ColumnHeader header{};
+   std::memcpy(header.magic, column_magic, sizeof(column_magic));
+   header.rows = col.length();
+   if (auto string_col = dynamic_cast<StringColumn*>(&col)) {
+      // Offsets of the strings relative to the start of the string data.
+      char** strings = reinterpret_cast<char**>(string_col->getRawData());
+      std::vector<uint64_t> offsets(header.rows);
+      for (size_t row = 0; row < header.rows; ++row) {
+         offsets[row] = header.string_bytes;
+         header.string_bytes += std::strlen(strings[row]) + 1;
+      }
+      const auto* code_type = dynamic_cast<const IR::DictionaryCode*>(string_col->getCodeType().get());
+      if (code_type) {
+         header.dictionary_entries = code_type->dictionary->size();
+         for (const auto& entry : *code_type->dictionary) {
+            header.dictionary_bytes += entry.size() + 1;
+         }
+      }
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+      for (size_t row = 0; row < header.rows; ++row) {
+         out.write(strings[row], std::strlen(strings[row]) + 1);
+      }
+      if (code_type) {
+         for (const auto& entry : *code_type->dictionary) {
+            out.write(entry.c_str(), entry.size() + 1);
+         }
+         out.write(string_col->getCodes(), header.rows);
+      }
+   } else {
+      auto& pod_col = dynamic_cast<PODColumn&>(col);
+      const size_t value_bytes = col.getType()->numBytes();
+      const size_t block_bytes = (header.rows + PODColumn::block_rows - 1) / PODColumn::block_rows * value_bytes;
+      header.delta_width = pod_col.getDeltaType() ? pod_col.getDeltaType()->numBytes() : 0;
+      header.has_zone_map = pod_col.getZoneMap() != nullptr;
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      if (header.delta_width) {
+         // Compressed columns only keep their references and deltas.
+         out.write(pod_col.getReferences(), block_bytes);
+         out.write(pod_col.getDeltas(), header.rows * header.delta_width);
+      } else {
+         out.write(col.getRawData(), header.rows * value_bytes);
+      }
+      if (header.has_zone_map) {
+         padSection(out);
+         out.write(pod_col.getZoneMap(), 2 * block_bytes);
+      }
+   }
+}
+
+void readColumn(const std::string& path, BaseColumn& col, uint64_t rows) {
+   auto [mapping, bytes] = mapFile(path);
+   if (bytes < sizeof(ColumnHeader)) {
+      throw std::runtime_error("Column file " + path + " is truncated");
+   }
+   ColumnHeader header;
+   std::memcpy(&header, mapping.get(), sizeof(header));
+   if (std::memcmp(header.magic, column_magic, sizeof(column_magic)) != 0) {
+      throw std::runtime_error(path + " is not a column file");
+   }
+   if (header.rows != rows) {
+      throw std::runtime_error("Column file " + path + " does not match the row count of the schema");
+   }
+   // Point into the mapping while sharing its ownership.
+   const char* data = mapping.get();
+   size_t offset = sizeof(ColumnHeader);
+   if (auto string_col = dynamic_cast<StringColumn*>(&col)) {
+      const size_t offset_bytes = rows * sizeof(uint64_t);
+      const size_t strings_end = offset + offset_bytes + header.string_bytes;
+      const size_t codes_begin = strings_end + header.dictionary_bytes;
+      if (bytes != (header.dictionary_entries ? codes_begin + rows : strings_end)) {
+         throw std::runtime_error("Column file " + path + " is truncated");
+      }
+      const auto* offsets = reinterpret_cast<const uint64_t*>(data + offset);
+      string_col->mapStorage(std::shared_ptr<const char>(mapping, data + offset + offset_bytes), offsets, rows);
+      if (header.dictionary_entries) {
+         // The dictionary is tiny, so it gets copied into the code type.
+         auto dictionary = std::make_shared<std::vector<std::string>>();
+         const char* entry = data + strings_end;
+         while (dictionary->size() < header.dictionary_entries && entry < data + codes_begin) {
+            entry += dictionary->emplace_back(entry).size() + 1;
+         }
+         if (dictionary->size() != header.dictionary_entries || entry != data + codes_begin) {
+            throw std::runtime_error("Column file " + path + " has a corrupt dictionary");
+         }
+         string_col->mapDictionary(std::move(dictionary), std::shared_ptr<const char>(mapping, data + codes_begin));
+      }
+   } else {
+      auto& pod_col = dynamic_cast<PODColumn&>(col);
+      const size_t value_bytes = col.getType()->numBytes();
+      const size_t block_bytes = (rows + PODColumn::block_rows - 1) / PODColumn::block_rows * value_bytes;
+      const size_t section_begin = offset;
+      offset += header.delta_width ? block_bytes + rows * header.delta_width : rows * value_bytes;
+      const size_t zone_map_begin = alignSection(offset);
+      if (header.has_zone_map) {
+         offset = zone_map_begin + 2 * block_bytes;
+      }
+      if (bytes != offset) {
+         throw std::runtime_error("Column file " + path + " is truncated");
+      }
+      if (header.delta_width) {
+         pod_col.mapCompression(rows, header.delta_width, std::shared_ptr<const char>(mapping, data + section_begin), std::shared_ptr<const char>(mapping, data + section_begin + block_bytes));
+      } else {
+         pod_col.mapStorage(std::shared_ptr<const char>(mapping, data + section_begin), rows * value_bytes);
+      }
+      if (header.has_zone_map) {
+         pod_col.mapZoneMap(std::shared_ptr<const char>(mapping, data + zone_map_begin));
+      }
+   }
+}
+
+}
+
+bool exists(const std::string& dir) {
+   return std::filesystem::exists(schemaPath(dir));
+}
+
+void write(const StoredRelation& rel, const std::string& dir) {
+   std::filesystem::create_directories(dir);
+   const size_t rows = rel.columnCount() ? rel.getColumn(0).second.length() : 0;
+   // The schema is written last: a relation only exists once all of its columns are complete.
+   std::stringstream schema;
+   schema << schema_magic << " " << format_version << "\n";
+   schema << rows << " " << rel.columnCount() << "\n";
+   for (size_t col_idx = 0; col_idx < rel.columnCount(); ++col_idx) {
+      auto [name, col] = rel.getColumn(col_idx);
+      if (col.length() != rows) {
+         throw std::runtime_error("All columns of a relation need the same number of rows");
+      }
+      writeColumn(columnPath(dir, name), col);
+      schema << name << " " << col.getType()->id() << " " << col.isNullable() << "\n";
+   }
+   auto out = openOutput(schemaPath(dir));
+   out << schema.str();
+}
+
+void read(StoredRelation& rel, const std::string& dir) {
+   std::ifstream schema;
+   schema.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+   schema.open(schemaPath(dir));
+   std::string magic;
+   uint64_t version;
+   uint64_t rows;
+   size_t num_columns;
+   schema >> magic >> version >> rows >> num_columns;
+   if (magic != schema_magic || version != format_version) {
+      throw std::runtime_error("Unsupported columnar format in " + dir);
+   }
+   if (num_columns != rel.columnCount()) {
+      throw std::runtime_error("Stored relation in " + dir + " has a different number of columns");
+   }
+   for (size_t col_idx = 0; col_idx < num_columns; ++col_idx) {
+      std::string name;
+      std::string type_id;
+      bool nullable;
+      schema >> name >> type_id >> nullable;
+      auto [expected_name, col] = rel.getColumn(col_idx);
+      if (name != expected_name || type_id != col.getType()->id() || nullable != col.isNullable()) {
+         throw std::runtime_error("Column " + name + " in " + dir + " does not match the relation");
+      }
+      readColumn(columnPath(dir, name), col, rows);
+   }
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef INKFUSE_COLUMNARFILE_H
+#define INKFUSE_COLUMNARFILE_H
+
+#include "storage/Relation.h"
+#include <string>
+
+/// Native on-disk format of a StoredRelation.
+///
+/// A relation is stored within its own directory: a `schema` file lists the number of rows and
+/// the name, type and nullability of every column. Every column lives in a separate `<name>.col` file
+/// with a fixed 64 byte header followed by the raw column data.
+/// - PODColumn: the values in exactly the layout of `PODColumn::getRawData`. Compressed PODColumns
+///   no longer have them, they only store their references and deltas.
+/// - StringColumn: one 8 byte offset per row into the string data, followed by the zero-terminated strings.
+///
+/// The data derived from the values is stored behind them, so that it does not have to be rebuilt on every read:
+/// the zone maps of PODColumns, as well as the dictionary entries and codes of dictionary-encoded StringColumns.
+///
+/// Reading maps the column files into memory instead of parsing them. PODColumns then point straight
+/// at the mapped pages, StringColumns only have to turn the offsets into pointers. The pages come from the
+/// page cache, so they are shared across processes and only read from disk when they are accessed.
+namespace inkfuse::ColumnarFile {
+
+/// Does the directory contain a relation in the columnar format?
+bool exists(const std::string& dir);
+
+/// Write a relation into the directory. The directory gets created if it does not exist yet.
+void write(const StoredRelation& rel, const std::string& dir);
+
+/// Map the relation stored within the directory into `rel`, including its derived data. The columns of `rel` have to be attached
+/// already and must match the stored schema. They must not contain any rows yet.
+void read(StoredRelation& rel, const std::string& dir);
+
+} // namespace inkfuse::ColumnarFile
+
+#endif //INKFUSE_COLUMNARFILE_H
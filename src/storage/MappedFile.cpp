@@ -0,0 +1,39 @@
+#include "storage/MappedFile.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace inkfuse {
+
+std::pair<std::shared_ptr<const char>, size_t> mapFile(const std::string& path) {
+   const int fd = ::open(path.c_str(), O_RDONLY);
+   if (fd < 0) {
+      throw std::runtime_error("Could not open file " + path);
+   }
+   struct stat file_stat {};
+   if (::fstat(fd, &file_stat) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Could not stat file " + path);
+   }
+   const auto bytes = static_cast<size_t>(file_stat.st_size);
+   if (bytes == 0) {
+      ::close(fd);
+      return {nullptr, 0};
+   }
+   void* data = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+   // The mapping stays valid after closing the file.
+   ::close(fd);
+   if (data == MAP_FAILED) {
+      throw std::runtime_error("Could not map file " + path);
+   }
+   // Files are read front to back.
+   ::madvise(data, bytes, MADV_SEQUENTIAL);
+   std::shared_ptr<const char> mapping(static_cast<const char*>(data), [bytes](const char* ptr) {
+      ::munmap(const_cast<char*>(ptr), bytes);
+   });
+   return {std::move(mapping), bytes};
+}
+
+}
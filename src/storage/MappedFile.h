@@ -0,0 +1,17 @@
+#ifndef INKFUSE_MAPPEDFILE_H
+#define INKFUSE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace inkfuse {
+
+/// Map a whole file read-only into memory. Returns the mapping and its size in bytes.
+/// The mapping is released once the last reference is gone. Empty files result in an empty mapping.
+std::pair<std::shared_ptr<const char>, size_t> mapFile(const std::string& path);
+
+} // namespace inkfuse
+
+#endif //INKFUSE_MAPPEDFILE_H
@@ -1,40 +1,242 @@
 #include "storage/Relation.h"
 #include "common/Helpers.h"
+#include "storage/MappedFile.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
 #include <cstring>
+#include <exception>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace inkfuse {
 
 namespace {
 
-void loadDate(char* dest, const char* str) {
-   auto val = helpers::dateStrToInt(str);
+/// Values are parsed through std::from_chars, which neither allocates nor depends on the locale.
+template <class T>
+void parseNumber(T& val, const char* str, uint32_t len) {
+   const auto [ptr, ec] = std::from_chars(str, str + len, val);
+   if (ec != std::errc{}) {
+      throw std::runtime_error("Cannot parse value " + std::string(str, len));
+   }
+}
+
+void loadDate(char* dest, const char* str, uint32_t len) {
+   auto val = helpers::dateStrToInt(str, len);
    *reinterpret_cast<int32_t*>(dest) = val;
 }
 
-template <std::signed_integral T>
-void loadInt(char* dest, const char* str) {
-   T val = std::stoll(str);
-   *reinterpret_cast<T*>(dest) = val;
+template <class T>
+void loadNumber(char* dest, const char* str, uint32_t len) {
+   T val;
+   parseNumber(val, str, len);
+   std::memcpy(dest, &val, sizeof(T));
 }
 
-template <std::unsigned_integral T>
-void loadUint(char* dest, const char* str) {
-   T val = std::stoull(str);
-   *reinterpret_cast<T*>(dest) = val;
+void loadChar(char* dest, const char* str, uint32_t len) {
+   *dest = *str;
 }
 
-void loadFloat(char* dest, const char* str) {
-   auto val = std::stof(str);
-   *reinterpret_cast<float*>(dest) = val;
+/// Finds the delimiters ('|' and newlines) of .tbl rows. Scans blocks of 16 characters at once
+/// and keeps the bitmask of their delimiters around, so that the short values within a row
+/// mostly come from the same block.
+struct DelimiterScanner {
+   DelimiterScanner(const char* begin, const char* end_) : block(begin), end(end_) {
+      mask = scan(block);
+   }
+
+   /// Get the next delimiter, `end` if there is none.
+   const char* next() {
+      while (mask == 0) {
+         block += block_size;
+         if (block >= end) {
+            return end;
+         }
+         mask = scan(block);
+      }
+      const char* delimiter = block + std::countr_zero(mask);
+      mask &= mask - 1;
+      return delimiter;
+   }
+
+   private:
+   static constexpr size_t block_size = 16;
+
+   /// Get the bitmask of the delimiters within the block starting at `pos`.
+   uint32_t scan(const char* pos) const {
+#ifdef __SSE2__
+      if (end - pos >= static_cast<ptrdiff_t>(block_size)) {
+         const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+         const __m128i delimiters = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('|')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+         return _mm_movemask_epi8(delimiters);
+      }
+#endif
+      uint32_t result = 0;
+      const size_t chars = std::min(block_size, static_cast<size_t>(end - pos));
+      for (size_t k = 0; k < chars; ++k) {
+         result |= static_cast<uint32_t>(pos[k] == '|' || pos[k] == '\n') << k;
+      }
+      return result;
+   }
+
+   /// Start of the current block.
+   const char* block;
+   /// End of the scanned characters.
+   const char* end;
+   /// Delimiters within the current block which were not returned yet.
+   uint32_t mask;
+};
+
+/// Minimum size of the chunks a .tbl file is split into. Small files are not worth extra threads.
+const size_t min_chunk_size = 1 << 20;
+
+/// Hand owned bytes over to a shared pointer, so that they are used just like mapped ones.
+std::shared_ptr<const char> shareBytes(std::vector<char> bytes) {
+   auto owner = std::make_shared<const std::vector<char>>(std::move(bytes));
+   return std::shared_ptr<const char>(owner, owner->data());
 }
 
-void loadDouble(char* dest, const char* str) {
-   auto val = std::stod(str);
-   *reinterpret_cast<double*>(dest) = val;
+template <class Delta, class T>
+void writeDeltas(const T* values, size_t rows, const T* references, size_t block_rows, std::vector<char>& deltas) {
+   using Unsigned = std::make_unsigned_t<T>;
+   deltas.resize(rows * sizeof(Delta));
+   auto* out = reinterpret_cast<Delta*>(deltas.data());
+   for (size_t row = 0; row < rows; ++row) {
+      out[row] = static_cast<Delta>(static_cast<Unsigned>(values[row]) - static_cast<Unsigned>(references[row / block_rows]));
+   }
 }
 
-void loadChar(char* dest, const char* str) {
-   *dest = *str;
+/// Does the zone map entry [min, max] overlap with [lower, upper]?
+template <class T>
+bool overlapsRange(const char* entry, const char* lower, const char* upper) {
+   T min, max;
+   std::memcpy(&min, entry, sizeof(T));
+   std::memcpy(&max, entry + sizeof(T), sizeof(T));
+   if (lower) {
+      T lower_val;
+      std::memcpy(&lower_val, lower, sizeof(T));
+      if (max < lower_val) {
+         return false;
+      }
+   }
+   if (upper) {
+      T upper_val;
+      std::memcpy(&upper_val, upper, sizeof(T));
+      if (min > upper_val) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/// Compute the minimum and maximum of every block of `rows` values.
+template <class T>
+void computeZoneMap(const char* data, size_t rows, size_t block_rows, std::vector<char>& zone_map) {
+   const auto* values = reinterpret_cast<const T*>(data);
+   const size_t num_blocks = (rows + block_rows - 1) / block_rows;
+   zone_map.resize(2 * num_blocks * sizeof(T));
+   auto* entries = reinterpret_cast<T*>(zone_map.data());
+   for (size_t block = 0; block < num_blocks; ++block) {
+      const auto [min, max] = std::minmax_element(values + block * block_rows, values + std::min((block + 1) * block_rows, rows));
+      entries[2 * block] = *min;
+      entries[2 * block + 1] = *max;
+   }
+}
+
+/// Call `fct.template operator()<T>()` with the C++ type T behind the values of `type`.
+/// Returns false if there is no zone map for the type.
+template <class Fct>
+bool visitZoneMapType(const IR::Type& type, Fct&& fct) {
+   if (dynamic_cast<const IR::Date*>(&type)) {
+      fct.template operator()<int32_t>();
+   } else if (dynamic_cast<const IR::SignedInt*>(&type)) {
+      switch (type.numBytes()) {
+         case 1:
+            fct.template operator()<int8_t>();
+            break;
+         case 2:
+            fct.template operator()<int16_t>();
+            break;
+         case 4:
+            fct.template operator()<int32_t>();
+            break;
+         case 8:
+            fct.template operator()<int64_t>();
+            break;
+         default:
+            return false;
+      }
+   } else if (dynamic_cast<const IR::UnsignedInt*>(&type)) {
+      switch (type.numBytes()) {
+         case 1:
+            fct.template operator()<uint8_t>();
+            break;
+         case 2:
+            fct.template operator()<uint16_t>();
+            break;
+         case 4:
+            fct.template operator()<uint32_t>();
+            break;
+         case 8:
+            fct.template operator()<uint64_t>();
+            break;
+         default:
+            return false;
+      }
+   } else if (dynamic_cast<const IR::Float*>(&type)) {
+      if (type.numBytes() == 4) {
+         fct.template operator()<float>();
+      } else {
+         fct.template operator()<double>();
+      }
+   } else if (dynamic_cast<const IR::Char*>(&type)) {
+      fct.template operator()<char>();
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/// Frame-of-reference encode `rows` values into `references` and `deltas`.
+/// Returns the width of the deltas in bytes, zero if they would not be narrower than the values.
+template <class T>
+size_t encodeFrameOfReference(const T* values, size_t rows, size_t block_rows, std::vector<char>& references, std::vector<char>& deltas) {
+   using Unsigned = std::make_unsigned_t<T>;
+   const size_t num_blocks = (rows + block_rows - 1) / block_rows;
+   std::vector<T> block_min(num_blocks);
+   // The differences are computed on the unsigned representation. They are exact as long as min <= value.
+   Unsigned max_delta = 0;
+   for (size_t block = 0; block < num_blocks; ++block) {
+      const auto [min, max] = std::minmax_element(values + block * block_rows, values + std::min((block + 1) * block_rows, rows));
+      block_min[block] = *min;
+      max_delta = std::max<Unsigned>(max_delta, static_cast<Unsigned>(*max) - static_cast<Unsigned>(*min));
+   }
+   size_t width = 1;
+   while (width < sizeof(T) && static_cast<uint64_t>(max_delta) >> (8 * width) != 0) {
+      width *= 2;
+   }
+   if (width >= sizeof(T)) {
+      return 0;
+   }
+   references.resize(num_blocks * sizeof(T));
+   std::memcpy(references.data(), block_min.data(), references.size());
+   switch (width) {
+      case 1:
+         writeDeltas<uint8_t>(values, rows, block_min.data(), block_rows, deltas);
+         break;
+      case 2:
+         writeDeltas<uint16_t>(values, rows, block_min.data(), block_rows, deltas);
+         break;
+      default:
+         writeDeltas<uint32_t>(values, rows, block_min.data(), block_rows, deltas);
+   }
+   return width;
 }
 
 }
@@ -48,24 +250,22 @@ bool BaseColumn::isNullable() {
 
 PODColumn::PODColumn(IR::TypeArc type_, bool nullable_)
    : BaseColumn(nullable_), type(std::move(type_)) {
-   // Reserve 5 MB of data.
-   storage.reserve(5'000'000);
    // Resolve the loading function.
    if (dynamic_cast<IR::Date*>(type.get())) {
       load_val = loadDate;
    } else if (dynamic_cast<IR::SignedInt*>(type.get())) {
       switch (type->numBytes()) {
          case 1:
-            load_val = loadInt<int8_t>;
+            load_val = loadNumber<int8_t>;
             break;
          case 2:
-            load_val = loadInt<int16_t>;
+            load_val = loadNumber<int16_t>;
             break;
          case 4:
-            load_val = loadInt<int32_t>;
+            load_val = loadNumber<int32_t>;
             break;
          case 8:
-            load_val = loadInt<int64_t>;
+            load_val = loadNumber<int64_t>;
             break;
          default:
             throw std::runtime_error("Unsupported width for loading signed integers");
@@ -73,16 +273,16 @@ PODColumn::PODColumn(IR::TypeArc type_, bool nullable_)
    } else if (dynamic_cast<IR::UnsignedInt*>(type.get())) {
       switch (type->numBytes()) {
          case 1:
-            load_val = loadUint<uint8_t>;
+            load_val = loadNumber<uint8_t>;
             break;
          case 2:
-            load_val = loadUint<uint16_t>;
+            load_val = loadNumber<uint16_t>;
             break;
          case 4:
-            load_val = loadUint<uint32_t>;
+            load_val = loadNumber<uint32_t>;
             break;
          case 8:
-            load_val = loadUint<uint64_t>;
+            load_val = loadNumber<uint64_t>;
             break;
          default:
             throw std::runtime_error("Unsupported width for loading unsigned integers");
@@ -90,10 +290,10 @@ PODColumn::PODColumn(IR::TypeArc type_, bool nullable_)
    } else if (dynamic_cast<IR::Float*>(type.get())) {
       switch (type->numBytes()) {
          case 4:
-            load_val = loadFloat;
+            load_val = loadNumber<float>;
             break;
          case 8:
-            load_val = loadDouble;
+            load_val = loadNumber<double>;
             break;
          default:
             throw std::runtime_error("Unsupported width for loading floating points");
@@ -107,20 +307,185 @@ PODColumn::PODColumn(IR::TypeArc type_, bool nullable_)
 
 size_t PODColumn::length() const
 {
-   return storage.size() / type->numBytes();
+   if (delta_type) {
+      return compressed_rows;
+   }
+   return (mapping ? mapped_bytes : storage.size()) / type->numBytes();
 }
 
 void PODColumn::loadValue(const char* str, uint32_t strlen)
 {
+   if (mapping) {
+      throw std::runtime_error("Cannot load values into a mapped PODColumn");
+   }
+   if (delta_type || zone_overlaps) [[unlikely]] {
+      throw std::runtime_error("Cannot load values into a compressed PODColumn or one with a zone map");
+   }
    // Make sure we have enough space in the backing storage.
    storage.resize(storage_offset + type->numBytes());
    // Load the value - the loading function was resolved in the constructor.
-   load_val(&getRawData()[storage_offset], str);
+   load_val(&getRawData()[storage_offset], str, strlen);
    // Increment the offset to make sure the next value gets written behind this one.
    storage_offset += type->numBytes();
 }
 
+void PODColumn::reserve(size_t rows) {
+   storage.reserve(storage_offset + rows * type->numBytes());
+}
+
+void PODColumn::append(BaseColumn& other) {
+   if (mapping) {
+      throw std::runtime_error("Cannot append to a mapped PODColumn");
+   }
+   if (delta_type || zone_overlaps) {
+      throw std::runtime_error("Cannot append to a compressed PODColumn or one with a zone map");
+   }
+   auto& other_pod = dynamic_cast<PODColumn&>(other);
+   if (other_pod.delta_type) {
+      throw std::runtime_error("Cannot append a compressed PODColumn, it no longer has its values");
+   }
+   const char* data = other_pod.getRawData();
+   const size_t bytes = other_pod.length() * type->numBytes();
+   storage.insert(storage.end(), data, data + bytes);
+   storage_offset += bytes;
+}
+
+bool PODColumn::compress() {
+   if (delta_type) {
+      return true;
+   }
+   const size_t rows = length();
+   if (rows == 0) {
+      return false;
+   }
+   const char* data = getRawData();
+   std::vector<char> references;
+   std::vector<char> deltas;
+   size_t width = 0;
+   if (dynamic_cast<IR::Date*>(type.get())) {
+      width = encodeFrameOfReference(reinterpret_cast<const int32_t*>(data), rows, block_rows, references, deltas);
+   } else if (dynamic_cast<IR::SignedInt*>(type.get())) {
+      switch (type->numBytes()) {
+         case 2:
+            width = encodeFrameOfReference(reinterpret_cast<const int16_t*>(data), rows, block_rows, references, deltas);
+            break;
+         case 4:
+            width = encodeFrameOfReference(reinterpret_cast<const int32_t*>(data), rows, block_rows, references, deltas);
+            break;
+         case 8:
+            width = encodeFrameOfReference(reinterpret_cast<const int64_t*>(data), rows, block_rows, references, deltas);
+            break;
+      }
+   } else if (dynamic_cast<IR::UnsignedInt*>(type.get())) {
+      switch (type->numBytes()) {
+         case 2:
+            width = encodeFrameOfReference(reinterpret_cast<const uint16_t*>(data), rows, block_rows, references, deltas);
+            break;
+         case 4:
+            width = encodeFrameOfReference(reinterpret_cast<const uint32_t*>(data), rows, block_rows, references, deltas);
+            break;
+         case 8:
+            width = encodeFrameOfReference(reinterpret_cast<const uint64_t*>(data), rows, block_rows, references, deltas);
+            break;
+      }
+   }
+   if (width == 0) {
+      return false;
+   }
+   mapCompression(rows, width, shareBytes(std::move(references)), shareBytes(std::move(deltas)));
+   return true;
+}
+
+void PODColumn::mapCompression(size_t rows, size_t delta_width, std::shared_ptr<const char> references_, std::shared_ptr<const char> deltas_) {
+   delta_type = IR::UnsignedInt::build(delta_width);
+   references = std::move(references_);
+   deltas = std::move(deltas_);
+   compressed_rows = rows;
+   // Scans decode the deltas, the values are no longer needed.
+   std::vector<char>().swap(storage);
+   storage_offset = 0;
+   mapping.reset();
+   mapped_bytes = 0;
+}
+
+void PODColumn::buildZoneMap() {
+   if (delta_type) {
+      throw std::runtime_error("Zone maps have to be built before the column gets compressed");
+   }
+   const size_t rows = length();
+   const char* data = getRawData();
+   std::vector<char> entries;
+   if (!visitZoneMapType(*type, [&]<class T>() { computeZoneMap<T>(data, rows, block_rows, entries); })) {
+      return;
+   }
+   mapZoneMap(shareBytes(std::move(entries)));
+}
+
+void PODColumn::mapZoneMap(std::shared_ptr<const char> zone_map_) {
+   if (!visitZoneMapType(*type, [&]<class T>() { zone_overlaps = overlapsRange<T>; })) {
+      throw std::runtime_error("There are no zone maps for " + type->id() + " columns");
+   }
+   zone_map = std::move(zone_map_);
+}
+
+std::optional<std::pair<uint64_t, uint64_t>> PODColumn::getValueRange() const {
+   std::optional<std::pair<uint64_t, uint64_t>> result;
+   const size_t rows = length();
+   if (!zone_map || rows == 0) {
+      return result;
+   }
+   const size_t num_blocks = (rows + block_rows - 1) / block_rows;
+   visitZoneMapType(*type, [&]<class T>() {
+      if constexpr (std::is_integral_v<T>) {
+         const auto* entries = reinterpret_cast<const T*>(zone_map.get());
+         T min = entries[0];
+         T max = entries[1];
+         for (size_t block = 1; block < num_blocks; ++block) {
+            min = std::min(min, entries[2 * block]);
+            max = std::max(max, entries[2 * block + 1]);
+         }
+         uint64_t raw_min = 0;
+         uint64_t raw_max = 0;
+         std::memcpy(&raw_min, &min, sizeof(T));
+         std::memcpy(&raw_max, &max, sizeof(T));
+         result.emplace(raw_min, raw_max);
+      }
+   });
+   return result;
+}
+
+bool PODColumn::mayContain(size_t begin, size_t end, const char* lower, const char* upper) const {
+   if (!zone_overlaps) {
+      return true;
+   }
+   const size_t entry_size = 2 * type->numBytes();
+   for (size_t block = begin / block_rows; block * block_rows < end; ++block) {
+      if (zone_overlaps(zone_map.get() + block * entry_size, lower, upper)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+std::vector<char> PODColumn::parseValue(std::string_view str) const {
+   std::vector<char> result(type->numBytes());
+   load_val(result.data(), str.data(), str.size());
+   return result;
+}
+
+void PODColumn::mapStorage(std::shared_ptr<const char> mapping_, size_t bytes) {
+   if (length() != 0) {
+      throw std::runtime_error("Only empty PODColumns can be mapped");
+   }
+   std::vector<char>().swap(storage);
+   mapping = std::move(mapping_);
+   mapped_bytes = bytes;
+}
+
 void StringColumn::loadValue(const char* str, uint32_t strLen) {
+   if (code_type) [[unlikely]] {
+      throw std::runtime_error("Cannot load values into a dictionary-encoded StringColumn");
+   }
    // Need the zero byte at the end of the string - this is not part of the input file.
    auto elem = reinterpret_cast<char*>(storage.alloc(strLen + 1));
    // Copy over the string.
@@ -130,6 +495,78 @@ void StringColumn::loadValue(const char* str, uint32_t strLen) {
    offsets.push_back(elem);
 }
 
+void StringColumn::reserve(size_t rows) {
+   offsets.reserve(offsets.size() + rows);
+}
+
+void StringColumn::append(BaseColumn& other) {
+   auto& other_strings = dynamic_cast<StringColumn&>(other);
+   if (code_type || other_strings.code_type) {
+      throw std::runtime_error("Cannot append dictionary-encoded StringColumns");
+   }
+   offsets.insert(offsets.end(), other_strings.offsets.begin(), other_strings.offsets.end());
+   // Take over the memory backing the strings. The regions go in front, new strings are still allocated from the current region at the back.
+   auto& other_regions = other_strings.storage.regions;
+   storage.regions.insert(storage.regions.begin(), std::make_move_iterator(other_regions.begin()), std::make_move_iterator(other_regions.end()));
+   other_regions.clear();
+   if (other_strings.mapping) {
+      if (mapping) {
+         throw std::runtime_error("Cannot append two mapped StringColumns");
+      }
+      mapping = std::move(other_strings.mapping);
+   }
+}
+
+bool StringColumn::buildDictionary() {
+   if (code_type) {
+      return true;
+   }
+   // Collect the distinct strings, giving up as soon as there are too many of them.
+   const size_t max_entries = std::min(IR::DictionaryCode::max_entries, offsets.size() / min_rows_per_entry);
+   std::unordered_map<std::string_view, uint8_t> distinct;
+   for (const char* str : offsets) {
+      if (distinct.emplace(str, 0).second && distinct.size() > max_entries) {
+         return false;
+      }
+   }
+   if (distinct.empty()) {
+      return false;
+   }
+   // Sorted dictionaries keep the order of the strings within the codes.
+   auto dictionary = std::make_shared<std::vector<std::string>>();
+   for (const auto& [str, _] : distinct) {
+      dictionary->emplace_back(str);
+   }
+   std::sort(dictionary->begin(), dictionary->end());
+   for (size_t code = 0; code < dictionary->size(); ++code) {
+      distinct[(*dictionary)[code]] = code;
+   }
+   std::vector<char> row_codes(offsets.size());
+   for (size_t row = 0; row < offsets.size(); ++row) {
+      row_codes[row] = distinct[offsets[row]];
+   }
+   mapDictionary(std::move(dictionary), shareBytes(std::move(row_codes)));
+   return true;
+}
+
+void StringColumn::mapDictionary(std::shared_ptr<const std::vector<std::string>> dictionary, std::shared_ptr<const char> codes_) {
+   code_type = IR::DictionaryCode::build(std::move(dictionary));
+   codes = std::move(codes_);
+}
+
+void StringColumn::mapStorage(std::shared_ptr<const char> mapping_, const uint64_t* string_offsets, size_t rows) {
+   if (length() != 0) {
+      throw std::runtime_error("Only empty StringColumns can be mapped");
+   }
+   mapping = std::move(mapping_);
+   // The runtime passes char* around, so the offsets have to be turned into pointers once.
+   offsets.resize(rows);
+   char* base = const_cast<char*>(mapping.get());
+   for (size_t row = 0; row < rows; ++row) {
+      offsets[row] = base + string_offsets[row];
+   }
+}
+
 BaseColumn& StoredRelation::getColumn(std::string_view name) const {
    for (const auto& [n, c] : columns) {
       if (n == name) {
@@ -182,34 +619,128 @@ StringColumn& StoredRelation::attachStringColumn(std::string_view name, bool nul
 }
 
 void StoredRelation::loadRows(std::istream& stream) {
-   std::string line;
-   while (stream.peek() != EOF && std::getline(stream, line)) {
-      loadRow(line);
-   }
+   const std::string data(std::istreambuf_iterator<char>(stream), {});
+   parseRows(data.data(), data.data() + data.size());
 }
 
 void StoredRelation::loadRow(const std::string& str) {
-   size_t currPos = 0;
-   for (auto& [c_name, c] : columns) {
-      if (currPos == str.length()) {
-         throw std::runtime_error("Not enough columns in TSV");
+   parseRows(str.data(), str.data() + str.size());
+}
+
+void StoredRelation::loadFile(const std::string& path, size_t num_threads) {
+   auto [mapping, bytes] = mapFile(path);
+   const char* data = mapping.get();
+   // Split the file into chunks that start at the beginning of a row.
+   const size_t num_chunks = std::max(std::min(num_threads, bytes / min_chunk_size), size_t{1});
+   std::vector<const char*> bounds{data};
+   for (size_t chunk = 1; chunk < num_chunks; ++chunk) {
+      const char* split = std::max(data + chunk * bytes / num_chunks, bounds.back());
+      const char* newline = static_cast<const char*>(std::memchr(split, '\n', data + bytes - split));
+      bounds.push_back(newline ? newline + 1 : data + bytes);
+   }
+   bounds.push_back(data + bytes);
+
+   // Every chunk but the first one is parsed into its own partial relation.
+   std::vector<StoredRelation> partials(num_chunks - 1);
+   for (auto& partial : partials) {
+      for (const auto& [name, col] : columns) {
+         if (dynamic_cast<StringColumn*>(col.get())) {
+            partial.attachStringColumn(name, col->isNullable());
+         } else {
+            partial.attachPODColumn(name, col->getType(), col->isNullable());
+         }
       }
-      size_t end = str.find('|', currPos);
-      if (end == std::string::npos) {
-         end = str.length();
+   }
+   std::vector<std::exception_ptr> errors(num_chunks);
+   const auto parse_chunk = [&](size_t chunk) {
+      try {
+         StoredRelation& target = chunk == 0 ? *this : partials[chunk - 1];
+         // Presize the columns for the rows of the chunk.
+         const size_t rows = std::count(bounds[chunk], bounds[chunk + 1], '\n') + 1;
+         for (auto& [_, col] : target.columns) {
+            col->reserve(rows);
+         }
+         target.parseRows(bounds[chunk], bounds[chunk + 1]);
+      } catch (...) {
+         errors[chunk] = std::current_exception();
       }
-      c->loadValue(str.data() + currPos, end - currPos);
-      currPos = end + 1;
+   };
+   std::vector<std::thread> workers;
+   for (size_t chunk = 1; chunk < num_chunks; ++chunk) {
+      workers.emplace_back(parse_chunk, chunk);
    }
-   // Row is active.
-   appendRow();
-   if (currPos != str.length()) {
-      // There should be a final closing | in the files.
-      throw std::runtime_error("Too many columns in TSV");
+   parse_chunk(0);
+   for (auto& worker : workers) {
+      worker.join();
+   }
+   for (const auto& error : errors) {
+      if (error) {
+         std::rethrow_exception(error);
+      }
+   }
+
+   // Concatenate the partial columns.
+   for (size_t col_idx = 0; col_idx < columns.size(); ++col_idx) {
+      auto& col = *columns[col_idx].second;
+      size_t rows = 0;
+      for (const auto& partial : partials) {
+         rows += partial.columns[col_idx].second->length();
+      }
+      col.reserve(rows);
+      for (auto& partial : partials) {
+         col.append(*partial.columns[col_idx].second);
+      }
+   }
+}
+
+void StoredRelation::parseRows(const char* begin, const char* end) {
+   DelimiterScanner scanner(begin, end);
+   const char* pos = begin;
+   while (pos < end) {
+      for (auto& [c_name, c] : columns) {
+         const char* delimiter = scanner.next();
+         if (delimiter == end || *delimiter != '|') {
+            throw std::runtime_error("Not enough columns in TSV");
+         }
+         c->loadValue(pos, delimiter - pos);
+         pos = delimiter + 1;
+      }
+      // Row is active.
+      appendRow();
+      // There should be a final closing | in the files, followed by the end of the row.
+      const char* row_end = scanner.next();
+      if (row_end != pos || (row_end != end && *row_end != '\n')) {
+         throw std::runtime_error("Too many columns in TSV");
+      }
+      pos = row_end + 1;
    }
 }
 
 void StoredRelation::appendRow() {
 }
 
+void StoredRelation::buildDictionaries() {
+   for (auto& [_, col] : columns) {
+      if (auto strings = dynamic_cast<StringColumn*>(col.get())) {
+         strings->buildDictionary();
+      }
+   }
+}
+
+void StoredRelation::compressColumns() {
+   for (auto& [_, col] : columns) {
+      if (auto pod = dynamic_cast<PODColumn*>(col.get())) {
+         pod->compress();
+      }
+   }
+}
+
+void StoredRelation::buildZoneMaps() {
+   for (auto& [_, col] : columns) {
+      if (auto pod = dynamic_cast<PODColumn*>(col.get())) {
+         pod->buildZoneMap();
+      }
+   }
+}
+
 } // namespace inkfuse
@@ -6,7 +6,10 @@
 #include <cstddef>
 #include <istream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -30,6 +33,13 @@ class BaseColumn {
    /// Load a value based on a string representation into the column.
    virtual void loadValue(const char* str, uint32_t strLen) = 0;
 
+   /// Reserve space for `rows` additional rows.
+   virtual void reserve(size_t rows) = 0;
+
+   /// Append all rows of `other`, which has to be a column of the same type.
+   /// `other` must not be used afterwards.
+   virtual void append(BaseColumn& other) = 0;
+
    /// Get a pointer to the backing raw data.
    virtual char* getRawData() = 0;
 
@@ -43,7 +53,6 @@ class BaseColumn {
 class StringColumn final : public BaseColumn {
    public:
    explicit StringColumn(bool nullable_) : BaseColumn(nullable_) {
-      offsets.reserve(1'000'000);
    }
 
    /// Get number of rows within the column.
@@ -61,11 +70,48 @@ class StringColumn final : public BaseColumn {
 
    void loadValue(const char* str, uint32_t strLen) override;
 
+   void reserve(size_t rows) override;
+
+   void append(BaseColumn& other) override;
+
+   /// Dictionary-encode the column if it has few distinct strings: at most `IR::DictionaryCode::max_entries`,
+   /// and on average every string has to occur at least `min_rows_per_entry` times. The strings stay available.
+   /// Returns whether the column is dictionary-encoded now.
+   bool buildDictionary();
+
+   /// Get the type of the dictionary codes, nullptr if the column is not dictionary-encoded.
+   const IR::TypeArc& getCodeType() const {
+      return code_type;
+   }
+
+   /// Get a pointer to the one byte dictionary codes of the rows. Only valid if the column is dictionary-encoded.
+   char* getCodes() {
+      // Mapped codes are never written, the const_cast only serves the scans.
+      return const_cast<char*>(codes.get());
+   }
+
+   /// Dictionary-encode the column through `dictionary` and the one byte `codes_` of its rows,
+   /// e.g. ones mapped from a columnar file. The codes are kept alive by the column.
+   void mapDictionary(std::shared_ptr<const std::vector<std::string>> dictionary, std::shared_ptr<const char> codes_);
+
+   /// Strings need to occur this often on average to be worth a dictionary.
+   static constexpr size_t min_rows_per_entry = 4;
+
+   /// Back the column by mapped string data. `string_offsets` contains the offset of every
+   /// zero-terminated string relative to the start of `mapping_`. The mapping is kept alive by the column.
+   void mapStorage(std::shared_ptr<const char> mapping_, const uint64_t* string_offsets, size_t rows);
+
    private:
    /// Actual vector of data that stores the char* that are passed through the runtime.
    std::vector<char*> offsets;
    /// Backing storage for the strings. `offsets` points into this allocator.
    MemoryRuntime::MemoryRegion storage;
+   /// Mapped string data if the column was read from a columnar file.
+   std::shared_ptr<const char> mapping;
+   /// Type of the dictionary codes if the column is dictionary-encoded.
+   IR::TypeArc code_type;
+   /// Dictionary code of every row, either owned or mapped.
+   std::shared_ptr<const char> codes;
 };
 
 /// Column over a fixed-size InkFuse type that can be represented
@@ -78,27 +124,114 @@ class PODColumn final : public BaseColumn {
 
    void loadValue(const char* str, uint32_t strlen) override;
 
+   void reserve(size_t rows) override;
+
+   void append(BaseColumn& other) override;
+
+   /// Get the values. Compressed columns no longer have them, they return nullptr.
    char* getRawData() override {
-      return storage.data();
+      if (delta_type) {
+         return nullptr;
+      }
+      // Mapped data is never written, the const_cast only serves the common column interface.
+      return mapping ? const_cast<char*>(mapping.get()) : storage.data();
    }
 
+   /// Get the backing storage. Only valid if the column is not mapped.
    std::vector<char>& getStorage() {
       return storage;
    }
 
+   /// Back the column by `bytes` of mapped values instead of the owned storage.
+   /// The mapping is kept alive by the column.
+   void mapStorage(std::shared_ptr<const char> mapping_, size_t bytes);
+
    IR::TypeArc getType() const override {
       return type;
    };
 
+   /// Compress integer and date columns through frame-of-reference encoding: every block of
+   /// `block_rows` rows stores its minimum as reference, every row its unsigned delta to
+   /// the reference. All deltas share the narrowest integer type that fits the widest block.
+   /// Columns where this does not save space stay uncompressed. The values of a compressed column
+   /// get released, scans decode the deltas. Returns whether the column is compressed now.
+   bool compress();
+
+   /// Get the type of the deltas, nullptr if the column is not compressed.
+   const IR::TypeArc& getDeltaType() const {
+      return delta_type;
+   }
+
+   /// Get a pointer to the references of the blocks. Only valid if the column is compressed.
+   char* getReferences() {
+      // Mapped references and deltas are never written, the const_cast only serves the scans.
+      return const_cast<char*>(references.get());
+   }
+
+   /// Get a pointer to the deltas of the rows. Only valid if the column is compressed.
+   char* getDeltas() {
+      return const_cast<char*>(deltas.get());
+   }
+
+   /// Compress the column of `rows` rows through the `delta_width` byte deltas and the block references of an
+   /// earlier `compress`, e.g. ones mapped from a columnar file. Both are kept alive by the column,
+   /// the values get released.
+   void mapCompression(size_t rows, size_t delta_width, std::shared_ptr<const char> references_, std::shared_ptr<const char> deltas_);
+
+   /// Keep the minimum and maximum of every block of `block_rows` rows. Scans can then skip
+   /// the blocks that cannot contain any value of a range. Needs the values, so it has to happen before `compress`.
+   void buildZoneMap();
+
+   /// Could any row within [begin, end) lie within [lower, upper]? The bounds are values in the
+   /// representation of the column type, nullptr if the range is unbounded on that side.
+   /// Without a zone map, every row could.
+   bool mayContain(size_t begin, size_t end, const char* lower, const char* upper) const;
+
+   /// Get the zone map, nullptr if the column does not have one. Every block has its minimum
+   /// followed by its maximum, both in the type of the column.
+   const char* getZoneMap() const {
+      return zone_map.get();
+   }
+
+   /// Get the smallest and the largest value of an integer column from its zone map, both as the raw bytes
+   /// of the value read as little-endian integer. Empty if the column has no zone map or no rows.
+   std::optional<std::pair<uint64_t, uint64_t>> getValueRange() const;
+
+   /// Use the zone map of an earlier `buildZoneMap`, e.g. one mapped from a columnar file.
+   /// The zone map is kept alive by the column.
+   void mapZoneMap(std::shared_ptr<const char> zone_map_);
+
+   /// Parse a value from its .tbl representation into the representation of the column type.
+   std::vector<char> parseValue(std::string_view str) const;
+
+   /// Number of rows per block of compressed columns and zone maps.
+   static constexpr size_t block_rows = 1024;
+
    private:
    /// Function to load a value. Depends on the nested type.
-   std::function<void(char* data ,const char* str)> load_val;
+   void (*load_val)(char* data, const char* str, uint32_t len);
    /// Backing storage.
    std::vector<char> storage;
    /// Offset within the backing storage.
    size_t storage_offset = 0;
+   /// Mapped values if the column was read from a columnar file.
+   std::shared_ptr<const char> mapping;
+   /// Size of the mapped values.
+   size_t mapped_bytes = 0;
    /// InkFuse type of this table.
    IR::TypeArc type;
+   /// Type of the deltas if the column is compressed.
+   IR::TypeArc delta_type;
+   /// Reference value of every block, in the type of the column. Either owned or mapped.
+   std::shared_ptr<const char> references;
+   /// Delta of every row to the reference of its block. Either owned or mapped.
+   std::shared_ptr<const char> deltas;
+   /// Number of rows if the column is compressed.
+   size_t compressed_rows = 0;
+   /// Minimum and maximum of every block, in the type of the column. Either owned or mapped.
+   std::shared_ptr<const char> zone_map;
+   /// Does a zone map entry overlap with a range? Depends on the nested type.
+   bool (*zone_overlaps)(const char* entry, const char* lower, const char* upper) = nullptr;
 };
 
 using BaseColumnPtr = std::unique_ptr<BaseColumn>;
@@ -133,10 +266,27 @@ class StoredRelation {
    /// Load a single .tbl row into the table, advancing the ifstream past the next newline.
    void loadRow(const std::string& str);
 
+   /// Load a whole .tbl file into the table. The file is split into chunks at row boundaries,
+   /// which get parsed by up to `num_threads` threads into separate columns. These are then
+   /// concatenated in file order.
+   void loadFile(const std::string& path, size_t num_threads = std::thread::hardware_concurrency());
+
    /// Add a row to the back of the active bitvector.
    void appendRow();
 
+   /// Dictionary-encode all string columns with few distinct values. Called once all rows are loaded.
+   void buildDictionaries();
+
+   /// Compress all integer and date columns where this saves space. Called once all rows are loaded.
+   void compressColumns();
+
+   /// Build the zone maps of all PODColumns. Called once all rows are loaded.
+   void buildZoneMaps();
+
    private:
+   /// Parse the .tbl rows within [begin, end) into the table. Every row ends with a '|' followed by a newline.
+   void parseRows(const char* begin, const char* end);
+
    /// Backing columns.
    /// We use a vector to exploit ordering during the scan.
    std::vector<std::pair<std::string, std::unique_ptr<BaseColumn>>> columns;
@@ -0,0 +1,97 @@
+#include "exec/TaskScheduler.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace inkfuse {
+
+namespace {
+
+// Parametrized over the number of workers.
+struct TaskSchedulerTestT : public ::testing::TestWithParam<size_t> {};
+
+// Diamond: 0 -> {1, 2} -> 3. Every task must run after its dependencies.
+TEST_P(TaskSchedulerTestT, diamond) {
+   TaskScheduler scheduler(GetParam());
+   std::mutex order_lock;
+   std::vector<size_t> order;
+   auto record = [&](size_t task_id) {
+      return [&, task_id]() {
+         std::unique_lock lock(order_lock);
+         order.push_back(task_id);
+      };
+   };
+   scheduler.addTask(record(0));
+   scheduler.addTask(record(1), {0});
+   scheduler.addTask(record(2), {0});
+   scheduler.addTask(record(3), {1, 2});
+   scheduler.run();
+
+   ASSERT_EQ(order.size(), 4);
+   EXPECT_EQ(order[0], 0);
+   EXPECT_EQ(order[3], 3);
+}
+
+// Many independent tasks with a single final task depending on all of them.
+TEST_P(TaskSchedulerTestT, fan_in) {
+   TaskScheduler scheduler(GetParam());
+   std::atomic<size_t> done = 0;
+   std::vector<size_t> dependencies;
+   for (size_t k = 0; k < 100; ++k) {
+      dependencies.push_back(scheduler.addTask([&]() { done++; }));
+   }
+   size_t seen_at_end = 0;
+   scheduler.addTask([&]() { seen_at_end = done; }, dependencies);
+   scheduler.run();
+   EXPECT_EQ(seen_at_end, 100);
+}
+
+// Exceptions within a task are propagated and stop dependent tasks.
+TEST_P(TaskSchedulerTestT, exception) {
+   TaskScheduler scheduler(GetParam());
+   bool dependent_ran = false;
+   auto failing = scheduler.addTask([]() { throw std::runtime_error("task failed"); });
+   scheduler.addTask([&]() { dependent_ran = true; }, {failing});
+   EXPECT_THROW(scheduler.run(), std::runtime_error);
+   EXPECT_FALSE(dependent_ran);
+}
+
+// Tasks borrowing extra workers never run more threads than the shared budget allows.
+TEST_P(TaskSchedulerTestT, worker_budget) {
+   const size_t workers = GetParam();
+   WorkerBudget budget(workers);
+   TaskScheduler scheduler(workers);
+   std::atomic<size_t> running = 0;
+   std::atomic<size_t> max_running = 0;
+   for (size_t k = 0; k < 20; ++k) {
+      scheduler.addTask([&]() {
+         WorkerBudget::Guard own(budget, budget.acquire(1, 1));
+         WorkerBudget::Guard extra(budget, budget.acquire(0, workers - 1));
+         const size_t now = (running += 1 + extra.count);
+         size_t seen = max_running;
+         while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+         }
+         running -= 1 + extra.count;
+      });
+   }
+   scheduler.run();
+   EXPECT_LE(max_running, workers);
+   EXPECT_GE(max_running, 1);
+   // All workers were returned.
+   EXPECT_EQ(budget.acquire(0, workers), workers);
+}
+
+TEST(test_task_scheduler, invalid_dependency) {
+   TaskScheduler scheduler(1);
+   EXPECT_THROW(scheduler.addTask([]() {}, {0}), std::runtime_error);
+}
+
+INSTANTIATE_TEST_CASE_P(
+   test_task_scheduler,
+   TaskSchedulerTestT,
+   ::testing::Values(size_t{1}, size_t{4}));
+
+}
+
+}
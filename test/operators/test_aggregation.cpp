@@ -119,6 +119,87 @@ INSTANTIATE_TEST_CASE_P(
       PipelineExecutor::ExecutionMode::Interpreted,
       PipelineExecutor::ExecutionMode::Hybrid));
 
+struct ParallelAggTestT : public AggregationTestT, public ::testing::TestWithParam<PipelineExecutor::ExecutionMode> {
+   /// Run SELECT keys, sum(col_2), count(col_2) FROM t GROUP BY keys on four threads.
+   /// Every query needs its own name: the compilation of a hybrid run can outlive the test.
+   void runParallel(std::string name, std::vector<const IU*> keys, size_t expected_groups, std::optional<size_t> memory_budget = std::nullopt) {
+      std::vector<AggregateFunctions::Description> agg_fct;
+      agg_fct.push_back({
+         .agg_iu = *iu_col_2,
+         .code = Opcode::Sum,
+      });
+      agg_fct.push_back({
+         .agg_iu = *iu_col_2,
+         .code = Opcode::Count,
+      });
+      std::vector<RelAlgOpPtr> children;
+      children.push_back(std::move(*scan));
+      auto agg = Aggregation::build(std::move(children), "aggregator", std::move(keys), std::move(agg_fct), memory_budget);
+      auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(agg));
+      // Every group must be produced exactly once, even though it was pre-aggregated by multiple threads.
+      for (const IU* out : control_block->root->getOutput()) {
+         control_block->dag.getPipelines()[1]->attachSuboperator(CountingSink::build(*out, [expected_groups](size_t count) {
+            EXPECT_EQ(count, expected_groups);
+         }));
+      }
+      ASSERT_EQ(control_block->dag.getPipelines().size(), 2);
+      // The read pipeline depends on the aggregation pipeline.
+      EXPECT_EQ(control_block->dag.getPipelineDependencies()[1], std::vector<size_t>{0});
+      const auto stats = QueryExecutor::runQuery(control_block, GetParam(), "parallel_agg_" + name, 4);
+      if (!memory_budget) {
+         // The pre-aggregation tables grow in place, only spilling restarts interpreted lookups.
+         EXPECT_EQ(stats.restarts, 0);
+      }
+      // Both pipelines access the aggregation tables, the query reports them once.
+      ASSERT_EQ(stats.hash_tables.size(), 1);
+      EXPECT_EQ(stats.hash_tables[0].table.rfind("agg_", 0), 0);
+      EXPECT_GE(stats.hash_tables[0].groups, expected_groups);
+      EXPECT_GT(stats.hash_tables[0].peak_bytes_sum, 0);
+   }
+};
+
+TEST_P(ParallelAggTestT, one_key) {
+   runParallel("one_key", {iu_col_1}, 10000);
+}
+
+TEST_P(ParallelAggTestT, group_by_text) {
+   runParallel("group_by_text", {iu_col_4}, 4);
+}
+
+TEST_P(ParallelAggTestT, group_by_text_and_number) {
+   // The string key gets packed in front of the numeric keys.
+   runParallel("group_by_text_and_number", {iu_col_1, iu_col_4}, 10000);
+}
+
+TEST_P(ParallelAggTestT, group_by_text_and_float) {
+   runParallel("group_by_text_and_float", {iu_col_3, iu_col_4}, 20);
+}
+
+TEST_P(ParallelAggTestT, out_of_core) {
+   // Spilled groups must still be produced exactly once.
+   runParallel("out_of_core", {iu_col_1}, 10000, 0);
+}
+
+TEST_P(ParallelAggTestT, out_of_core_unsupported) {
+   std::vector<AggregateFunctions::Description> agg_fct;
+   agg_fct.push_back({
+      .agg_iu = *iu_col_2,
+      .code = Opcode::Count,
+   });
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan));
+   // String keys live outside of the hash table and cannot be spilled.
+   EXPECT_THROW(Aggregation::build(std::move(children), "aggregator", std::vector<const IU*>{iu_col_4}, std::move(agg_fct), 0), std::runtime_error);
+}
+
+INSTANTIATE_TEST_CASE_P(
+   ParallelAggregationTest,
+   ParallelAggTestT,
+   ::testing::Values(
+      PipelineExecutor::ExecutionMode::Fused,
+      PipelineExecutor::ExecutionMode::Interpreted,
+      PipelineExecutor::ExecutionMode::Hybrid));
+
 using ParamT = std::tuple<OpcodeVec, PipelineExecutor::ExecutionMode>;
 struct SimpleAggTestT : public AggregationTestT, public ::testing::TestWithParam<ParamT> {};
 
@@ -5,6 +5,7 @@
 #include "codegen/Value.h"
 #include "codegen/backend_c/BackendC.h"
 #include "exec/PipelineExecutor.h"
+#include "runtime/HashRuntime.h"
 #include <gtest/gtest.h>
 
 namespace inkfuse {
@@ -182,6 +183,9 @@ TEST_P(ExpressionTParametrized, hash) {
    auto& hash_col = ctx.getColumn(hash_iu);
    for (uint16_t k = 0; k < 1000; ++k) {
       auto elem = reinterpret_cast<uint64_t*>(hash_col.raw_data)[k];
+      // The inlined hash of the generated code has to agree with the runtime.
+      uint64_t key = k;
+      EXPECT_EQ(elem, HashRuntime::hashKey(&key, 8));
       EXPECT_EQ(seen.count(elem), 0);
       seen.insert(elem);
    }
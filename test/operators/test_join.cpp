@@ -104,10 +104,92 @@ TEST_P(PkJoinTestT, one_key) {
       }));
    }
    ASSERT_EQ(control_block->dag.getPipelines().size(), 2);
+   // The probe pipeline has to wait for the build pipeline.
+   const auto dependencies = control_block->dag.getPipelineDependencies();
+   EXPECT_TRUE(dependencies[0].empty());
+   EXPECT_EQ(dependencies[1], std::vector<size_t>{0});
    // Run the query.
    QueryExecutor::runQuery(control_block, GetParam(), "join_one_key");
 }
 
+/// PK join with a single int4 key, building and probing on multiple threads.
+TEST_P(PkJoinTestT, one_key_parallel) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   std::vector<const IU*> payload_right{iu_rel_2_col_2, iu_rel_2_col_3};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), std::move(payload_right), JoinType::Inner, true);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // Every build row has to make it into the probed hash table exactly once, even though
+   // the workers built separate tables.
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[1]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE);
+      }));
+   }
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 2);
+   // Run the query.
+   const auto stats = QueryExecutor::runQuery(control_block, GetParam(), "join_one_key_parallel", 4);
+   // The thread-local build tables grow in place, so interpreted inserts never restart.
+   EXPECT_EQ(stats.restarts, 0);
+}
+
+/// PK join with a single int4 key, filtering the probe side through a Bloom filter built on multiple threads.
+TEST_P(PkJoinTestT, one_key_bloom_filter) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   std::vector<const IU*> payload_right{iu_rel_2_col_2, iu_rel_2_col_3};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), std::move(payload_right), JoinType::Inner, true, /* bloom_filter_= */ true);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // The Bloom filter must never drop a probe row with a join partner.
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[1]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE);
+      }));
+   }
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 2);
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_one_key_bloom_filter", 4);
+}
+
+/// PK left semi join on the dense int4 key, resolved through the array index on multiple threads.
+/// Every build row has to be produced exactly once, even though it gets probed ten times.
+TEST_P(PkJoinTestT, one_key_semi) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), {}, JoinType::LeftSemi, true);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 2);
+   // Disabling lookups are atomic, nothing keeps the probe pipeline on a single thread.
+   for (const auto& op : control_block->dag.getPipelines()[1]->getSubops()) {
+      EXPECT_TRUE(op->isParallelizable());
+   }
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[1]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, BUILD_SIZE);
+      }));
+   }
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_one_key_semi", 4);
+}
+
 /// PK join with a compound (int4, uint1) key.
 TEST_P(PkJoinTestT, two_keys) {
    // Set up the join.
@@ -134,6 +216,220 @@ TEST_P(PkJoinTestT, two_keys) {
    QueryExecutor::runQuery(control_block, GetParam(), "join_two_keys");
 }
 
+/// Hybrid hash join whose build side exceeds the memory budget on multiple threads.
+/// Most partitions of the build side get spilled to disk.
+TEST_P(PkJoinTestT, hybrid_one_key_parallel) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   std::vector<const IU*> payload_right{iu_rel_2_col_2, iu_rel_2_col_3};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), std::move(payload_right), JoinType::Inner, true, false, 1 << 18);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // The joined rows are produced by a separate pipeline.
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE);
+      }));
+   }
+   const auto dependencies = control_block->dag.getPipelineDependencies();
+   EXPECT_EQ(dependencies[1], std::vector<size_t>{0});
+   EXPECT_EQ(dependencies[2], std::vector<size_t>{1});
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_hybrid_one_key_parallel", 4);
+}
+
+/// Hybrid left semi join without any memory. All partitions get spilled to disk.
+TEST_P(PkJoinTestT, hybrid_semi) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), {}, JoinType::LeftSemi, true, false, 0);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // Every build row has a match and has to be produced exactly once.
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, BUILD_SIZE);
+      }));
+   }
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_hybrid_semi");
+}
+
+/// Hybrid left semi join whose build side stays resident. Multiple threads probe the same keys.
+TEST_P(PkJoinTestT, hybrid_semi_parallel) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), {}, JoinType::LeftSemi, true, false, 1ull << 30);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // Every build key is probed ten times, but has to be produced exactly once.
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, BUILD_SIZE);
+      }));
+   }
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_hybrid_semi_parallel", 4);
+}
+
+/// Radix-partitioned join, chosen because the build side is expected to be far larger than the caches.
+TEST_P(PkJoinTestT, radix_two_keys_parallel) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1, iu_rel_1_col_2};
+   std::vector<const IU*> payload_left{iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1, iu_rel_2_col_2};
+   std::vector<const IU*> payload_right{iu_rel_2_col_3};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), std::move(payload_right), JoinType::Inner, true, false, std::nullopt, Join::radix_join_threshold);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // The joined rows are produced by a separate pipeline. Only the build rows with col_2 = 3 find a partner.
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE / 10);
+      }));
+   }
+   const auto dependencies = control_block->dag.getPipelineDependencies();
+   EXPECT_EQ(dependencies[1], std::vector<size_t>{0});
+   EXPECT_EQ(dependencies[2], std::vector<size_t>{1});
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_radix_two_keys_parallel", 4);
+}
+
+/// Radix-partitioned left semi join. Every build row has to be produced exactly once.
+TEST_P(PkJoinTestT, radix_semi) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_1));
+   children.push_back(std::move(*scan_2));
+   std::vector<const IU*> keys_left{iu_rel_1_col_1};
+   std::vector<const IU*> payload_left{iu_rel_1_col_2, iu_rel_1_col_3};
+   std::vector<const IU*> keys_right{iu_rel_2_col_1};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), {}, JoinType::LeftSemi, true, false, std::nullopt, Join::radix_join_threshold);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, BUILD_SIZE);
+      }));
+   }
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_radix_semi");
+}
+
+/// n:m join building on the relation with duplicate int4 keys. Every probe row has ten join partners.
+TEST_P(PkJoinTestT, nm_one_key) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_2));
+   children.push_back(std::move(*scan_1));
+   std::vector<const IU*> keys_left{iu_rel_2_col_1};
+   std::vector<const IU*> payload_left{iu_rel_2_col_2, iu_rel_2_col_3};
+   std::vector<const IU*> keys_right{iu_rel_1_col_1};
+   std::vector<const IU*> payload_right{iu_rel_1_col_2, iu_rel_1_col_3};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), std::move(payload_right), JoinType::Inner, false);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   // The matches get expanded in a separate pipeline.
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE);
+      }));
+   }
+   // Every pipeline has to wait for the one before.
+   const auto dependencies = control_block->dag.getPipelineDependencies();
+   EXPECT_EQ(dependencies[1], std::vector<size_t>{0});
+   EXPECT_EQ(dependencies[2], std::vector<size_t>{1});
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_nm_one_key");
+}
+
+/// n:m join with a compound (int4, uint1) key on multiple threads. Every tenth probe row has ten join partners.
+TEST_P(PkJoinTestT, nm_two_keys_parallel) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_2));
+   children.push_back(std::move(*scan_1));
+   std::vector<const IU*> keys_left{iu_rel_2_col_1, iu_rel_2_col_2};
+   std::vector<const IU*> payload_left{iu_rel_2_col_3};
+   std::vector<const IU*> keys_right{iu_rel_1_col_1, iu_rel_1_col_2};
+   std::vector<const IU*> payload_right{iu_rel_1_col_3};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), std::move(payload_right), JoinType::Inner, false);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE / 10);
+      }));
+   }
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_nm_two_keys_parallel", 4);
+}
+
+/// n:m left semi join. Every build row has a join partner and has to be produced exactly once.
+TEST_P(PkJoinTestT, nm_semi) {
+   // Set up the join.
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(*scan_2));
+   children.push_back(std::move(*scan_1));
+   std::vector<const IU*> keys_left{iu_rel_2_col_1};
+   std::vector<const IU*> payload_left{iu_rel_2_col_3};
+   std::vector<const IU*> keys_right{iu_rel_1_col_1};
+   auto join = Join::build(std::move(children), "join", std::move(keys_left), std::move(payload_left), std::move(keys_right), {}, JoinType::LeftSemi, false);
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(join));
+
+   ASSERT_EQ(control_block->dag.getPipelines().size(), 3);
+   for (const IU* out : control_block->root->getOutput()) {
+      control_block->dag.getPipelines()[2]->attachSuboperator(CountingSink::build(*out, [](size_t count) {
+         EXPECT_EQ(count, PROBE_SIZE);
+      }));
+   }
+   // Run the query.
+   QueryExecutor::runQuery(control_block, GetParam(), "join_nm_semi");
+}
+
+/// Join on (string, int4) keys. The join hash tables would only compare the string pointers, so the join is rejected.
+TEST(join, string_keys_unsupported) {
+   StoredRelation rel_1;
+   rel_1.attachStringColumn("name");
+   rel_1.attachPODColumn("id", IR::SignedInt::build(4));
+   StoredRelation rel_2;
+   rel_2.attachStringColumn("name");
+   rel_2.attachPODColumn("id", IR::SignedInt::build(4));
+   auto scan_1 = std::make_unique<TableScan>(rel_1, std::vector<std::string>{"name", "id"}, "scan_1");
+   auto scan_2 = std::make_unique<TableScan>(rel_2, std::vector<std::string>{"name", "id"}, "scan_2");
+   std::vector<const IU*> keys_left{scan_1->getOutput()[0], scan_1->getOutput()[1]};
+   std::vector<const IU*> keys_right{scan_2->getOutput()[0], scan_2->getOutput()[1]};
+   std::vector<RelAlgOpPtr> children;
+   children.push_back(std::move(scan_1));
+   children.push_back(std::move(scan_2));
+   EXPECT_THROW(Join::build(std::move(children), "join", std::move(keys_left), {}, std::move(keys_right), {}, JoinType::Inner, false), std::runtime_error);
+}
+
 INSTANTIATE_TEST_CASE_P(PkJoinTest, PkJoinTestT, ::testing::Values(PipelineExecutor::ExecutionMode::Fused,
                                                                    PipelineExecutor::ExecutionMode::Interpreted,
                                                                    PipelineExecutor::ExecutionMode::Hybrid));
@@ -1,10 +1,17 @@
+#include "algebra/Aggregation.h"
 #include "algebra/CompilationContext.h"
+#include "algebra/ExpressionOp.h"
+#include "algebra/Filter.h"
 #include "algebra/Pipeline.h"
 #include "algebra/RelAlgOp.h"
 #include "algebra/TableScan.h"
+#include "algebra/suboperators/sinks/CountingSink.h"
 #include "algebra/suboperators/sinks/FuseChunkSink.h"
 #include "codegen/backend_c/BackendC.h"
+#include "common/Helpers.h"
+#include "algebra/Print.h"
 #include "exec/PipelineExecutor.h"
+#include "exec/QueryExecutor.h"
 #include <gtest/gtest.h>
 
 namespace inkfuse {
@@ -46,6 +53,165 @@ TEST(test_table_scan, scan_1) {
    }
 }
 
+/// Scan a relation spanning many morsels with multiple worker threads.
+struct TableScanParallelTestT : public ::testing::TestWithParam<PipelineExecutor::ExecutionMode> {};
+
+TEST_P(TableScanParallelTestT, scan_parallel) {
+   constexpr uint64_t num_rows = 100'000;
+   StoredRelation rel;
+   auto& col_1 = rel.attachPODColumn("col_1", IR::UnsignedInt::build(8));
+   auto& storage = col_1.getStorage();
+   storage.resize(8 * num_rows);
+   for (uint64_t k = 0; k < num_rows; ++k) {
+      reinterpret_cast<uint64_t*>(storage.data())[k] = k;
+   }
+
+   TableScan scan(rel, {"col_1"}, "scan_1");
+   const auto& tscan_iu = *scan.getOutput()[0];
+
+   PipelineDAG dag;
+   scan.decay(dag);
+   auto& pipe = dag.getCurrentPipeline();
+   auto& sink = reinterpret_cast<CountingSink&>(pipe.attachSuboperator(CountingSink::build(tscan_iu)));
+
+   PipelineExecutor exec(pipe, GetParam(), "test_table_scan_parallel", nullptr, 4);
+   EXPECT_EQ(exec.getNumThreads(), 4);
+   EXPECT_NO_THROW(exec.runPipeline());
+   // Every row must be counted exactly once across all worker threads.
+   EXPECT_EQ(sink.getCount(), num_rows);
+}
+
+/// Range predicates on a clustered column skip all morsels that cannot contain matching rows.
+TEST_P(TableScanParallelTestT, zone_maps) {
+   constexpr uint64_t num_rows = 100'000;
+   StoredRelation rel;
+   auto& col_1 = rel.attachPODColumn("col_1", IR::SignedInt::build(4));
+   auto& col_2 = rel.attachStringColumn("col_2");
+   for (uint64_t k = 0; k < num_rows; ++k) {
+      const auto value = std::to_string(k / 1000);
+      col_1.loadValue(value.data(), value.size());
+      col_2.loadValue("a", 1);
+   }
+   rel.buildZoneMaps();
+
+   // Rows [20'000, 30'000) lie within the first two morsels behind 16'384.
+   auto scan = TableScan::build(rel, {"col_1"}, "scan_1", {{"col_1", "20", "29"}});
+   const auto& tscan_iu = *scan->getOutput()[0];
+   // The zone map also gives the value range of the column.
+   ASSERT_TRUE(tscan_iu.range);
+   EXPECT_EQ(tscan_iu.range->min, 0);
+   EXPECT_EQ(tscan_iu.range->max, 99);
+   PipelineDAG dag;
+   scan->decay(dag);
+   auto& pipe = dag.getCurrentPipeline();
+   auto& sink = reinterpret_cast<CountingSink&>(pipe.attachSuboperator(CountingSink::build(tscan_iu)));
+
+   PipelineExecutor exec(pipe, GetParam(), "test_table_scan_zone_maps", nullptr, 4);
+   EXPECT_NO_THROW(exec.runPipeline());
+   EXPECT_EQ(sink.getCount(), 2 * DEFAULT_CHUNK_SIZE);
+
+   // String columns have no zone maps.
+   EXPECT_ANY_THROW(TableScan::build(rel, {"col_1"}, "scan_2", {{"col_2", "a", std::nullopt}}));
+}
+
+/// Filter and group on a dictionary-encoded string column. Both work on the codes, the printed result is decoded again.
+TEST_P(TableScanParallelTestT, dictionary_codes) {
+   constexpr uint64_t num_rows = 100'000;
+   const std::vector<std::string> modes{"TRUCK", "AIR", "MAIL", "SHIP"};
+   StoredRelation rel;
+   auto& col_1 = rel.attachStringColumn("col_1");
+   for (uint64_t k = 0; k < num_rows; ++k) {
+      const auto& mode = modes[k % modes.size()];
+      col_1.loadValue(mode.data(), mode.size());
+   }
+   rel.buildDictionaries();
+   ASSERT_TRUE(col_1.getCodeType());
+
+   auto scan = TableScan::build(rel, {"col_1"}, "scan_1");
+   const IU& mode_iu = *scan->getOutput()[0];
+   EXPECT_TRUE(dynamic_cast<IR::DictionaryCode*>(mode_iu.type.get()));
+
+   // Filter on col_1 = 'MAIL'.
+   std::vector<ExpressionOp::NodePtr> nodes;
+   nodes.emplace_back(std::make_unique<ExpressionOp::IURefNode>(&mode_iu));
+   nodes.emplace_back(std::make_unique<ExpressionOp::ComputeNode>(ExpressionOp::ComputeNode::Type::StrEquals, IR::StringVal::build("MAIL"), nodes[0].get()));
+   auto root = nodes[1].get();
+   std::vector<RelAlgOpPtr> expr_children;
+   expr_children.push_back(std::move(scan));
+   auto expr = ExpressionOp::build(std::move(expr_children), "expr", {root}, std::move(nodes));
+   const IU& filter_iu = *expr->getOutput()[0];
+   std::vector<RelAlgOpPtr> filter_children;
+   filter_children.push_back(std::move(expr));
+   auto filter = Filter::build(std::move(filter_children), "filter", {&mode_iu}, filter_iu);
+   const IU& filtered_iu = *filter->getOutput()[0];
+
+   // Group by col_1 and count.
+   std::vector<RelAlgOpPtr> agg_children;
+   agg_children.push_back(std::move(filter));
+   std::vector<AggregateFunctions::Description> aggregates{{filtered_iu, AggregateFunctions::Opcode::Count}};
+   auto agg = Aggregation::build(std::move(agg_children), "agg", {&filtered_iu}, std::move(aggregates));
+   std::vector<const IU*> out_ius{agg->getOutput()[0], agg->getOutput()[1]};
+   std::vector<RelAlgOpPtr> print_children;
+   print_children.push_back(std::move(agg));
+   auto print = Print::build(std::move(print_children), std::move(out_ius), {"mode", "count"});
+   auto& printer = print->printer;
+   auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(print));
+   std::stringstream stream;
+   printer->setOstream(stream);
+   QueryExecutor::runQuery(control_block, GetParam(), "test_table_scan_dictionary_codes", 4);
+   EXPECT_EQ(printer->num_rows, 1);
+   EXPECT_EQ(stream.str(), "mode, count\nMAIL,25000\n");
+}
+
+/// Scan compressed columns, the values are decoded within the scan.
+TEST_P(TableScanParallelTestT, compressed) {
+   // A single morsel which spans multiple compression blocks.
+   constexpr uint64_t num_rows = 5'000;
+   StoredRelation rel;
+   auto& col_1 = rel.attachPODColumn("col_1", IR::SignedInt::build(8));
+   auto& col_2 = rel.attachPODColumn("col_2", IR::Date::build());
+   for (uint64_t k = 0; k < num_rows; ++k) {
+      const auto value = std::to_string(-50'000 + 3 * static_cast<int64_t>(k) + static_cast<int64_t>(k % 7));
+      col_1.loadValue(value.data(), value.size());
+      const auto date = helpers::dateIntToStr(10'000 + k % 200);
+      col_2.loadValue(date.data(), date.size());
+   }
+   rel.compressColumns();
+   ASSERT_EQ(col_1.getDeltaType()->numBytes(), 2);
+   ASSERT_EQ(col_2.getDeltaType()->numBytes(), 1);
+
+   TableScan scan(rel, {"col_1", "col_2"}, "scan_1");
+   const auto& iu_1 = *scan.getOutput()[0];
+   const auto& iu_2 = *scan.getOutput()[1];
+   // The scan still provides the original types.
+   EXPECT_EQ(iu_1.type->id(), col_1.getType()->id());
+   EXPECT_EQ(iu_2.type->id(), col_2.getType()->id());
+
+   PipelineDAG dag;
+   scan.decay(dag);
+   auto& pipe = dag.getCurrentPipeline();
+   pipe.attachSuboperator(FuseChunkSink::build(nullptr, iu_1));
+   pipe.attachSuboperator(FuseChunkSink::build(nullptr, iu_2));
+
+   PipelineExecutor exec(pipe, GetParam(), "test_table_scan_compressed_" + std::to_string(static_cast<int>(GetParam())));
+   EXPECT_NO_THROW(exec.runPipeline());
+   const auto* values_1 = reinterpret_cast<const int64_t*>(exec.getExecutionContext().getColumn(iu_1).raw_data);
+   const auto* values_2 = reinterpret_cast<const int32_t*>(exec.getExecutionContext().getColumn(iu_2).raw_data);
+   // Compressed columns no longer have their values, compare against the loaded ones.
+   for (uint64_t k = 0; k < num_rows; ++k) {
+      ASSERT_EQ(values_1[k], -50'000 + 3 * static_cast<int64_t>(k) + static_cast<int64_t>(k % 7));
+      ASSERT_EQ(values_2[k], 10'000 + static_cast<int32_t>(k % 200));
+   }
+}
+
+INSTANTIATE_TEST_CASE_P(
+   test_table_scan,
+   TableScanParallelTestT,
+   ::testing::Values(
+      PipelineExecutor::ExecutionMode::Fused,
+      PipelineExecutor::ExecutionMode::Interpreted,
+      PipelineExecutor::ExecutionMode::Hybrid));
+
 }
 
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 #include "xxhash.h"
 #include <cstring>
 #include <random>
+#include <set>
 
 namespace inkfuse {
 
@@ -56,8 +57,8 @@ struct HashTableTestT : public ::testing::TestWithParam<ParamT> {
       // Serialize the payload.
       std::memcpy(slot + std::get<0>(GetParam()), payload_ptr, 16);
       EXPECT_EQ(ht.size(), ++insert_counter);
-      // Check for HT growing behaviour.
-      if (insert_counter <= 1024) {
+      // Check for HT growing behaviour. Three quarters of the slots can be filled.
+      if (insert_counter <= 1536) {
          EXPECT_EQ(ht.capacity(), 2048);
       } else {
          EXPECT_GT(ht.capacity(), 2048);
@@ -96,6 +97,216 @@ TEST(hash_table, bad_size) {
    EXPECT_ANY_THROW(HashTableSimpleKey(16, 3, 3));
 }
 
+// Fill a small table up to its maximum load. Collision chains then wrap around the end of
+// the table, mixing group and single-tag probing.
+TEST(hash_table, max_load) {
+   for (size_t slots : {8, 16, 32, 256}) {
+      HashTableSimpleKey ht(8, 8, slots);
+      const uint64_t max_fill = slots - slots / 4;
+      for (uint64_t key = 0; key < max_fill; ++key) {
+         ht.insert(reinterpret_cast<const char*>(&key));
+      }
+      EXPECT_EQ(ht.capacity(), slots);
+      for (uint64_t key = 0; key < max_fill; ++key) {
+         char* slot = ht.lookup(reinterpret_cast<const char*>(&key));
+         ASSERT_NE(slot, nullptr);
+         EXPECT_EQ(*reinterpret_cast<uint64_t*>(slot), key);
+      }
+      for (uint64_t key = max_fill; key < 2 * slots; ++key) {
+         EXPECT_EQ(ht.lookup(reinterpret_cast<const char*>(&key)), nullptr);
+      }
+      // Disabled slots keep the collision chains intact.
+      for (uint64_t key = 0; key < max_fill; key += 2) {
+         EXPECT_NE(ht.lookupDisable(reinterpret_cast<const char*>(&key)), nullptr);
+      }
+      for (uint64_t key = 0; key < max_fill; ++key) {
+         const bool disabled = key % 2 == 0;
+         EXPECT_EQ(ht.lookup(reinterpret_cast<const char*>(&key)) == nullptr, disabled);
+      }
+   }
+}
+
+// Reserving room for keys up front means the inserts never have to grow the table.
+TEST(hash_table, reserve) {
+   HashTableSimpleKey ht(8, 8, 8);
+   for (uint64_t key = 0; key < 100; ++key) {
+      ht.insert(reinterpret_cast<const char*>(&key));
+   }
+   ht.reserve(1000);
+   const size_t capacity = ht.capacity();
+   EXPECT_GE(capacity - capacity / 4, 1100);
+   for (uint64_t key = 100; key < 1100; ++key) {
+      ht.insert(reinterpret_cast<const char*>(&key));
+   }
+   EXPECT_EQ(ht.capacity(), capacity);
+   // The keys inserted before reserving survived the growth.
+   for (uint64_t key = 0; key < 1100; ++key) {
+      char* slot = ht.lookup(reinterpret_cast<const char*>(&key));
+      ASSERT_NE(slot, nullptr);
+      EXPECT_EQ(*reinterpret_cast<uint64_t*>(slot), key);
+   }
+   // Reserving less than the free slots is a no-op.
+   ht.reserve(10);
+   EXPECT_EQ(ht.capacity(), capacity);
+}
+
+// Rows live on a heap outside of the index. They never move when the table grows,
+// and iterating the table visits them in insertion order.
+TEST(hash_table, stable_rows) {
+   HashTableSimpleKey ht(8, 8, 8);
+   std::vector<char*> rows;
+   for (uint64_t key = 0; key < 10000; ++key) {
+      char* row = ht.insert(reinterpret_cast<const char*>(&key));
+      *reinterpret_cast<uint64_t*>(row + 8) = 3 * key;
+      rows.push_back(row);
+   }
+   EXPECT_GT(ht.capacity(), 8);
+   for (uint64_t key = 0; key < 10000; ++key) {
+      EXPECT_EQ(ht.lookup(reinterpret_cast<const char*>(&key)), rows[key]);
+   }
+   char* it_data;
+   uint64_t it_idx;
+   uint64_t expected = 0;
+   for (ht.iteratorStart(&it_data, &it_idx); it_data; ht.iteratorAdvance(&it_data, &it_idx)) {
+      EXPECT_EQ(it_data, rows[expected]);
+      EXPECT_EQ(*reinterpret_cast<uint64_t*>(it_data + 8), 3 * expected);
+      expected++;
+   }
+   EXPECT_EQ(expected, 10000);
+}
+
+// Tables keep track of their resizes and load. Probes are only recorded in builds with HT_STATS.
+TEST(hash_table, stats) {
+   HashTableSimpleKey ht(8, 8, 8);
+   for (uint64_t key = 0; key < 1000; ++key) {
+      ht.insert(reinterpret_cast<const char*>(&key));
+   }
+   for (uint64_t key = 0; key < 2000; ++key) {
+      ht.lookup(reinterpret_cast<const char*>(&key));
+   }
+   const auto stats = ht.getStats();
+   EXPECT_EQ(stats.table, HashTableSimpleKey::ID);
+   EXPECT_EQ(stats.groups, 1000);
+   EXPECT_EQ(stats.slots, ht.capacity());
+   EXPECT_DOUBLE_EQ(stats.loadFactor(), 1000.0 / ht.capacity());
+   // 8 slots grow to 2048 slots.
+   EXPECT_EQ(stats.resizes, 8);
+   EXPECT_GE(stats.peak_bytes_sum, ht.capacity() * 9 + 1000 * 16);
+   if constexpr (HashTableStats::collect_probes) {
+      // One probe per insert and lookup, rebuilding the index during resizes is not a probe.
+      EXPECT_EQ(stats.probes(), 3000);
+   } else {
+      EXPECT_EQ(stats.probes(), 0);
+      EXPECT_EQ(stats.fingerprint_false_positives, 0);
+   }
+}
+
+// The lookups specialized on the key width agree with the generic ones.
+TEST(hash_table, fixed_key_width) {
+   dispatchKeyWidth(12, [](auto key_width) {
+      HashTableSimpleKey ht(key_width, 8, 8);
+      std::array<uint32_t, 3> key{};
+      const char* raw_key = reinterpret_cast<const char*>(key.data());
+      for (uint32_t k = 0; k < 1000; ++k) {
+         key = {k, k % 7, 42};
+         const uint64_t hash = HashTableSimpleKey::hashFixed<key_width>(raw_key);
+         EXPECT_EQ(hash, ht.hash(raw_key));
+         char* slot;
+         bool is_new_key;
+         ht.template lookupOrInsertFixed<key_width>(&slot, &is_new_key, raw_key, hash);
+         ASSERT_TRUE(is_new_key);
+         *reinterpret_cast<uint64_t*>(slot + key_width) = k;
+      }
+      for (uint32_t k = 0; k < 1100; ++k) {
+         key = {k, k % 7, 42};
+         char* generic = ht.lookup(raw_key);
+         EXPECT_EQ(ht.template lookupFixed<key_width>(raw_key, ht.hash(raw_key)), generic);
+         if (k < 1000) {
+            ASSERT_NE(generic, nullptr);
+            EXPECT_EQ(*reinterpret_cast<uint64_t*>(generic + key_width), k);
+         } else {
+            EXPECT_EQ(generic, nullptr);
+         }
+      }
+   });
+}
+
+// Four byte keys are aggregated in a window around the first key, other keys get hashed.
+TEST(hash_table, direct_lookup_window) {
+   EXPECT_ANY_THROW(HashTableDirectLookup(0, 8));
+   EXPECT_ANY_THROW(HashTableDirectLookup(9, 8));
+   HashTableDirectLookup ht(4, 8);
+   // Pages of the window only get allocated once a key falls into them.
+   EXPECT_EQ(ht.capacity(), 0);
+   // Keys around zero cross the sign boundary and have to stay within the window.
+   std::vector<int32_t> keys;
+   for (int32_t k = -1000; k < 1000; ++k) {
+      keys.push_back(k);
+   }
+   // Keys far away from the first one go to the fallback.
+   keys.push_back(1 << 20);
+   keys.push_back(-(1 << 20));
+   for (int32_t key : keys) {
+      const char* raw_key = reinterpret_cast<const char*>(&key);
+      EXPECT_EQ(ht.lookup(raw_key), nullptr);
+      char* slot;
+      bool is_new_key;
+      ht.lookupOrInsert(&slot, &is_new_key, raw_key);
+      ASSERT_TRUE(is_new_key);
+      EXPECT_EQ(std::memcmp(slot, raw_key, 4), 0);
+      *reinterpret_cast<int64_t*>(slot + 4) = 2 * key;
+   }
+   EXPECT_EQ(ht.size(), keys.size());
+   EXPECT_EQ(ht.fallbackSize(), 2);
+   EXPECT_LT(ht.capacity(), HashTableDirectLookup::window_slots);
+   for (int32_t key : keys) {
+      const char* raw_key = reinterpret_cast<const char*>(&key);
+      char* slot = ht.lookup(raw_key);
+      ASSERT_NE(slot, nullptr);
+      EXPECT_EQ(ht.lookupOrInsert(raw_key), slot);
+      EXPECT_EQ(*reinterpret_cast<int64_t*>(slot + 4), 2 * key);
+   }
+   // The iterator visits the dense groups and the fallback groups exactly once.
+   std::set<int32_t> seen;
+   char* it_data;
+   uint64_t it_idx;
+   for (ht.iteratorStart(&it_data, &it_idx); it_data; ht.iteratorAdvance(&it_data, &it_idx)) {
+      EXPECT_TRUE(seen.insert(*reinterpret_cast<int32_t*>(it_data)).second);
+   }
+   EXPECT_EQ(seen.size(), keys.size());
+}
+
+// If the key range is known, the window covers exactly that range.
+TEST(hash_table, direct_lookup_known_range) {
+   const int32_t min = -100;
+   const int32_t max = 2000;
+   HashTableDirectLookup ht(4, 8, static_cast<uint32_t>(min), static_cast<uint32_t>(max));
+   for (int32_t key = max; key >= min; --key) {
+      char* slot = ht.lookupOrInsert(reinterpret_cast<const char*>(&key));
+      *reinterpret_cast<int64_t*>(slot + 4) = key;
+   }
+   EXPECT_EQ(ht.size(), max - min + 1);
+   EXPECT_EQ(ht.fallbackSize(), 0);
+   EXPECT_EQ(ht.capacity(), max - min + 1);
+   // The groups are visited in key order.
+   int32_t expected = min;
+   char* it_data;
+   uint64_t it_idx;
+   for (ht.iteratorStart(&it_data, &it_idx); it_data; ht.iteratorAdvance(&it_data, &it_idx)) {
+      EXPECT_EQ(*reinterpret_cast<int32_t*>(it_data), expected);
+      EXPECT_EQ(*reinterpret_cast<int64_t*>(it_data + 4), expected);
+      expected++;
+   }
+   EXPECT_EQ(expected, max + 1);
+
+   // Ranges wider than the window are treated as unknown.
+   HashTableDirectLookup wide(4, 8, 0, 1 << 20);
+   const int32_t key = 1 << 19;
+   wide.lookupOrInsert(reinterpret_cast<const char*>(&key));
+   EXPECT_EQ(wide.fallbackSize(), 0);
+   EXPECT_EQ(wide.capacity(), HashTableDirectLookup::page_slots);
+}
+
 TEST_P(HashTableTestT, inserts_lookups) {
    auto num_vals = std::get<1>(GetParam());
    auto data = buildRandomData(num_vals);
@@ -53,8 +53,8 @@ struct ComplexHashTableTestT : public ::testing::TestWithParam<size_t> {
       EXPECT_TRUE(inserted);
       EXPECT_EQ(std::strcmp(*reinterpret_cast<char**>(slot), *reinterpret_cast<char * const *>(key_ptr)), 0);
       EXPECT_EQ(ht.size(), ++insert_counter);
-      // Check for HT growing behaviour.
-      if (insert_counter <= 1024) {
+      // Check for HT growing behaviour. Three quarters of the slots can be filled.
+      if (insert_counter <= 1536) {
          EXPECT_EQ(ht.capacity(), 2048);
       } else {
          EXPECT_GT(ht.capacity(), 2048);
@@ -87,9 +87,66 @@ struct ComplexHashTableTestT : public ::testing::TestWithParam<size_t> {
 
 // Simple test for failing hash table construction.
 TEST(complex_hash_table, bad_args) {
-   EXPECT_ANY_THROW(HashTableComplexKey(1, 1, 16, 4));
-   EXPECT_ANY_THROW(HashTableComplexKey(0, 2, 16, 4));
+   EXPECT_ANY_THROW(HashTableComplexKey(8, 0, 16, 4));
+   EXPECT_ANY_THROW(HashTableComplexKey(0, 17, 16, 4));
    EXPECT_ANY_THROW(HashTableComplexKey(0, 1, 16, 5));
+   EXPECT_NO_THROW(HashTableComplexKey(4, 2, 16, 4));
+}
+
+// Keys made up of two strings and a four byte integer. Strings with a shared
+// prefix and the same length must only be told apart by the full comparison.
+TEST(complex_hash_table, multi_part_key) {
+   HashTableComplexKey ht(4, 2, 8, 4);
+   const std::vector<std::string> strings = {"", "a", "ab", "abcd", "abce", "abcdefgh", "abcdefgi", "prefix_one", "prefix_two"};
+   struct Key {
+      const char* first;
+      const char* second;
+      uint32_t number;
+   } __attribute__((packed));
+   auto buildKey = [&](size_t first, size_t second, uint32_t number) {
+      return Key{strings[first].data(), strings[second].data(), number};
+   };
+
+   // Insert every combination, the table has to grow several times along the way.
+   for (size_t first = 0; first < strings.size(); ++first) {
+      for (size_t second = 0; second < strings.size(); ++second) {
+         for (uint32_t number = 0; number < 3; ++number) {
+            const Key key = buildKey(first, second, number);
+            char* slot;
+            bool is_new_key;
+            ht.lookupOrInsert(&slot, &is_new_key, reinterpret_cast<const char*>(&key));
+            ASSERT_TRUE(is_new_key);
+            *reinterpret_cast<uint64_t*>(slot + sizeof(Key)) = 9 * 3 * first + 3 * second + number;
+         }
+      }
+   }
+   EXPECT_EQ(ht.size(), strings.size() * strings.size() * 3);
+
+   // Keys are found through copies of the strings, their payload survived all resizes.
+   const std::vector<std::string> copies = strings;
+   for (size_t first = 0; first < strings.size(); ++first) {
+      for (size_t second = 0; second < strings.size(); ++second) {
+         for (uint32_t number = 0; number < 4; ++number) {
+            const Key key{copies[first].data(), copies[second].data(), number};
+            const char* slot = ht.lookup(reinterpret_cast<const char*>(&key));
+            if (number == 3) {
+               EXPECT_EQ(slot, nullptr);
+               continue;
+            }
+            ASSERT_NE(slot, nullptr);
+            EXPECT_EQ(ht.hash(reinterpret_cast<const char*>(&key)), ht.hash(slot));
+            EXPECT_EQ(*reinterpret_cast<const uint64_t*>(slot + sizeof(Key)), 9 * 3 * first + 3 * second + number);
+         }
+      }
+   }
+}
+
+// A single string key hashes the same way as before the table supported multiple strings.
+TEST(complex_hash_table, single_string_hash) {
+   HashTableComplexKey ht(0, 1, 8);
+   const std::string str = "inkfuse";
+   const char* raw_string = str.data();
+   EXPECT_EQ(ht.hash(reinterpret_cast<const char*>(&raw_string)), XXH3_64bits(str.data(), str.size()));
 }
 
 TEST_P(ComplexHashTableTestT, inserts_lookups) {
@@ -0,0 +1,185 @@
+#include "gtest/gtest.h"
+#include "runtime/HybridHashJoin.h"
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace inkfuse {
+
+namespace {
+
+/// Build rows consist of an 8 byte key and an 8 byte payload. Probe rows also have an 8 byte payload.
+const uint16_t KEY_SIZE = 8;
+const uint16_t PAYLOAD_SIZE = 8;
+const uint16_t PROBE_SIZE = 16;
+/// Number of build rows.
+const uint64_t BUILD_SIZE = 100'000;
+
+/// Run a function on two threads in parallel.
+template <class Fct>
+void onTwoThreads(Fct fct) {
+   std::thread worker([&]() { fct(1); });
+   fct(0);
+   worker.join();
+}
+
+struct HybridHashJoinTestT : public ::testing::TestWithParam<size_t> {
+   HybridHashJoinTestT() : resident(KEY_SIZE, PAYLOAD_SIZE) {
+   }
+
+   /// Build on the keys [0, BUILD_SIZE) with payload `key + 1`.
+   void build(HybridHashJoin& join) {
+      onTwoThreads([&](size_t thread_id) {
+         auto& build = join.getThreadBuild(thread_id);
+         for (uint64_t key = thread_id; key < BUILD_SIZE; key += 2) {
+            char* row = build.append(reinterpret_cast<const char*>(&key));
+            *reinterpret_cast<uint64_t*>(row + KEY_SIZE) = key + 1;
+         }
+      });
+      onTwoThreads([&](size_t thread_id) { join.finalizeBuild(thread_id); });
+   }
+
+   /// Probe with the keys [0, num_keys) and payload `2 * key`.
+   void probe(HybridHashJoin& join, uint64_t num_keys) {
+      onTwoThreads([&](size_t thread_id) {
+         auto& probe = join.getThreadProbe(thread_id);
+         for (uint64_t key = thread_id; key < num_keys; key += 2) {
+            uint64_t row[2] = {key, 2 * key};
+            const char* packed = reinterpret_cast<const char*>(row);
+            probe.probe(packed, resident.hash(packed));
+         }
+      });
+      onTwoThreads([&](size_t thread_id) { join.finalizeProbe(thread_id); });
+   }
+
+   /// Produce all joined rows and return how often every build key was produced.
+   std::vector<size_t> produce(HybridHashJoin& join, bool semi_join) {
+      std::vector<size_t> produced(BUILD_SIZE);
+      std::mutex produced_lock;
+      onTwoThreads([&](size_t thread_id) {
+         while (const size_t rows = join.produce(thread_id)) {
+            EXPECT_LE(rows, 1024);
+            char** build_rows = join.getOutput(thread_id, true);
+            char** probe_rows = join.getOutput(thread_id, false);
+            std::unique_lock guard(produced_lock);
+            for (size_t k = 0; k < rows; ++k) {
+               const auto* build_row = reinterpret_cast<const uint64_t*>(build_rows[k]);
+               EXPECT_EQ(build_row[1], build_row[0] + 1);
+               if (!semi_join) {
+                  const auto* probe_row = reinterpret_cast<const uint64_t*>(probe_rows[k]);
+                  EXPECT_EQ(probe_row[0], build_row[0]);
+                  EXPECT_EQ(probe_row[1], 2 * build_row[0]);
+               }
+               produced[build_row[0]]++;
+            }
+         }
+      });
+      return produced;
+   }
+
+   HashTableSimpleKey resident;
+};
+
+TEST(test_hybrid_hash_join, spill_file) {
+   SpillFile file;
+   // Two threads write 1000 rows of 8 bytes each.
+   onTwoThreads([&](size_t thread_id) {
+      for (uint64_t k = 0; k < 1000; ++k) {
+         const uint64_t value = 2 * k + thread_id;
+         file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+   });
+   EXPECT_EQ(file.size(), 2000 * sizeof(uint64_t));
+
+   // Read back in chunks which don't line up with the writes.
+   std::vector<bool> seen(2000);
+   std::vector<uint64_t> chunk(300);
+   size_t total = 0;
+   while (const size_t bytes = file.read(reinterpret_cast<char*>(chunk.data()), chunk.size() * sizeof(uint64_t))) {
+      for (size_t k = 0; k < bytes / sizeof(uint64_t); ++k) {
+         ASSERT_LT(chunk[k], 2000);
+         EXPECT_FALSE(seen[chunk[k]]);
+         seen[chunk[k]] = true;
+      }
+      total += bytes;
+   }
+   EXPECT_EQ(total, file.size());
+}
+
+TEST_P(HybridHashJoinTestT, inner) {
+   HybridHashJoin join(resident, KEY_SIZE, PAYLOAD_SIZE, PROBE_SIZE, GetParam(), false, 1024);
+   build(join);
+   // Every build key has exactly one partner, the upper half of the probe keys has none.
+   probe(join, 2 * BUILD_SIZE);
+   const auto produced = produce(join, false);
+   for (uint64_t key = 0; key < BUILD_SIZE; ++key) {
+      ASSERT_EQ(produced[key], 1);
+   }
+
+   // The build side needs around 1.6 MB.
+   const size_t evicted = join.numEvictedPartitions();
+   if (GetParam() == 0) {
+      EXPECT_EQ(evicted, HybridHashJoin::num_partitions);
+   } else if (GetParam() == std::numeric_limits<size_t>::max()) {
+      EXPECT_EQ(evicted, 0);
+      EXPECT_EQ(resident.size(), BUILD_SIZE);
+   } else {
+      EXPECT_GT(evicted, 0);
+      EXPECT_LT(evicted, HybridHashJoin::num_partitions);
+   }
+}
+
+TEST_P(HybridHashJoinTestT, semi) {
+   HybridHashJoin join(resident, KEY_SIZE, PAYLOAD_SIZE, KEY_SIZE, GetParam(), true, 1024);
+   build(join);
+   // Every build row has to be produced once, even though every key is probed twice.
+   // Probe rows of semi joins only consist of the key.
+   onTwoThreads([&](size_t thread_id) {
+      auto& probe = join.getThreadProbe(thread_id);
+      for (size_t k = 0; k < 2; ++k) {
+         for (uint64_t key = thread_id; key < BUILD_SIZE; key += 2) {
+            const char* packed = reinterpret_cast<const char*>(&key);
+            probe.probe(packed, resident.hash(packed));
+         }
+      }
+   });
+   onTwoThreads([&](size_t thread_id) { join.finalizeProbe(thread_id); });
+   const auto produced = produce(join, true);
+   for (uint64_t key = 0; key < BUILD_SIZE; ++key) {
+      ASSERT_EQ(produced[key], 1);
+   }
+}
+
+// Four threads probe every key of a resident semi join. Every build row is produced exactly once.
+TEST_F(HybridHashJoinTestT, semi_concurrent_probes) {
+   HybridHashJoin join(resident, KEY_SIZE, PAYLOAD_SIZE, KEY_SIZE, std::numeric_limits<size_t>::max(), true, 1024);
+   build(join);
+   ASSERT_EQ(join.numEvictedPartitions(), 0);
+   std::vector<std::thread> workers;
+   for (size_t thread_id = 0; thread_id < 4; ++thread_id) {
+      workers.emplace_back([&, thread_id]() {
+         auto& probe = join.getThreadProbe(thread_id);
+         for (uint64_t key = 0; key < BUILD_SIZE; ++key) {
+            const char* packed = reinterpret_cast<const char*>(&key);
+            probe.probe(packed, resident.hash(packed));
+         }
+         join.finalizeProbe(thread_id);
+      });
+   }
+   for (auto& worker : workers) {
+      worker.join();
+   }
+   const auto produced = produce(join, true);
+   for (uint64_t key = 0; key < BUILD_SIZE; ++key) {
+      ASSERT_EQ(produced[key], 1);
+   }
+}
+
+INSTANTIATE_TEST_CASE_P(
+   test_hybrid_hash_join,
+   HybridHashJoinTestT,
+   ::testing::Values(0, 1 << 20, std::numeric_limits<size_t>::max()));
+
+}
+
+}
@@ -0,0 +1,244 @@
+#include "gtest/gtest.h"
+#include "runtime/JoinHashTables.h"
+#include <limits>
+#include <thread>
+
+namespace inkfuse {
+
+namespace {
+
+/// Slots consist of an 8 byte key and an 8 byte payload.
+const uint16_t KEY_SIZE = 8;
+const uint16_t PAYLOAD_SIZE = 8;
+
+/// Insert a key with payload `key + 1` into a build table.
+void insert(HashTableSimpleKey& table, uint64_t key) {
+   char* slot = table.lookupOrInsert(reinterpret_cast<const char*>(&key));
+   *reinterpret_cast<uint64_t*>(slot + KEY_SIZE) = key + 1;
+}
+
+/// Run the build on the given number of threads. Thread `k` inserts the keys [k * 5000, (k + 2) * 5000).
+void build(HashTableSimpleKey& target, size_t num_threads) {
+   ParallelBuildHashTable build_tables(target, KEY_SIZE, PAYLOAD_SIZE);
+   for (size_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+      auto& table = build_tables.getThreadTable(thread_id);
+      for (uint64_t key = thread_id * 5'000; key < (thread_id + 2) * 5'000; ++key) {
+         insert(table, key);
+      }
+   }
+   std::vector<std::thread> workers;
+   for (size_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+      workers.emplace_back([&, thread_id]() { build_tables.finalize(thread_id); });
+   }
+   for (auto& worker : workers) {
+      worker.join();
+   }
+}
+
+void checkTarget(HashTableSimpleKey& target, uint64_t num_keys) {
+   EXPECT_EQ(target.size(), num_keys);
+   for (uint64_t key = 0; key < num_keys; ++key) {
+      const char* slot = target.lookup(reinterpret_cast<const char*>(&key));
+      ASSERT_NE(slot, nullptr);
+      EXPECT_EQ(*reinterpret_cast<const uint64_t*>(slot), key);
+      EXPECT_EQ(*reinterpret_cast<const uint64_t*>(slot + KEY_SIZE), key + 1);
+   }
+   const uint64_t missing = num_keys;
+   EXPECT_EQ(target.lookup(reinterpret_cast<const char*>(&missing)), nullptr);
+}
+
+TEST(test_join_hash_tables, single_thread) {
+   HashTableSimpleKey target(KEY_SIZE, PAYLOAD_SIZE, 8);
+   build(target, 1);
+   checkTarget(target, 10'000);
+}
+
+TEST(test_join_hash_tables, concurrent_inserts) {
+   // Neighbouring threads share half of their keys, so the concurrent inserts race on the same slots.
+   HashTableSimpleKey target(KEY_SIZE, PAYLOAD_SIZE, 8);
+   build(target, 8);
+   checkTarget(target, 45'000);
+   // The target was sized for all build rows up front.
+   EXPECT_GE(target.capacity(), 2 * 45'000);
+}
+
+TEST(test_join_hash_tables, bloom_filter) {
+   HashTableSimpleKey target(KEY_SIZE, PAYLOAD_SIZE, 8);
+   ParallelBuildHashTable build_tables(target, KEY_SIZE, PAYLOAD_SIZE);
+   auto& filter = build_tables.enableBloomFilter();
+   for (size_t thread_id = 0; thread_id < 4; ++thread_id) {
+      auto& table = build_tables.getThreadTable(thread_id);
+      for (uint64_t key = thread_id; key < 40'000; key += 4) {
+         insert(table, key);
+      }
+   }
+   std::vector<std::thread> workers;
+   for (size_t thread_id = 0; thread_id < 4; ++thread_id) {
+      workers.emplace_back([&, thread_id]() { build_tables.finalize(thread_id); });
+   }
+   for (auto& worker : workers) {
+      worker.join();
+   }
+   checkTarget(target, 40'000);
+   // No false negatives.
+   for (uint64_t key = 0; key < 40'000; ++key) {
+      EXPECT_TRUE(filter.containsKey(reinterpret_cast<const char*>(&key)));
+   }
+   // And only few false positives.
+   size_t false_positives = 0;
+   for (uint64_t key = 40'000; key < 140'000; ++key) {
+      false_positives += filter.containsKey(reinterpret_cast<const char*>(&key));
+   }
+   EXPECT_LT(false_positives, 5'000);
+}
+
+TEST(test_join_hash_tables, nm_join) {
+   // Four threads build 10'000 rows on 100 distinct keys.
+   HashTableSimpleKey index(KEY_SIZE, NMJoinHashTable::index_payload_size, 8);
+   NMJoinHashTable table(index, KEY_SIZE, PAYLOAD_SIZE);
+   for (size_t thread_id = 0; thread_id < 4; ++thread_id) {
+      auto& rows = table.getThreadRows(thread_id);
+      for (uint64_t k = thread_id; k < 10'000; k += 4) {
+         const uint64_t key = k % 100;
+         char* row = rows.append(reinterpret_cast<const char*>(&key));
+         *reinterpret_cast<uint64_t*>(row + KEY_SIZE) = k;
+      }
+   }
+   // The workers group the partitions in parallel.
+   std::vector<std::thread> workers;
+   for (size_t thread_id = 0; thread_id < 4; ++thread_id) {
+      workers.emplace_back([&, thread_id]() { table.finalize(thread_id); });
+   }
+   for (auto& worker : workers) {
+      worker.join();
+   }
+
+   // All rows of a key are stored contiguously.
+   EXPECT_EQ(index.size(), 100);
+   for (uint64_t key = 0; key < 100; ++key) {
+      const char* slot = index.lookup(reinterpret_cast<const char*>(&key));
+      ASSERT_NE(slot, nullptr);
+      ASSERT_EQ(table.rowsCount(slot), 100);
+      const char* rows = table.rowsBegin(slot);
+      for (size_t k = 0; k < 100; ++k) {
+         const char* row = rows + k * table.rowSize();
+         EXPECT_EQ(*reinterpret_cast<const uint64_t*>(row), key);
+         EXPECT_EQ(*reinterpret_cast<const uint64_t*>(row + KEY_SIZE) % 100, key);
+      }
+   }
+
+   // Every key gets probed twice. The 100 join partners of a probe row don't fit into a single expansion.
+   NMJoinMatches matches(table, KEY_SIZE, 64);
+   auto& buffer = matches.getThreadMatches(0);
+   for (uint64_t key = 0; key < 200; ++key) {
+      const uint64_t probe_key = key % 100;
+      NMJoinMatches::addMatch(buffer, reinterpret_cast<const char*>(&probe_key), index.lookup(reinterpret_cast<const char*>(&probe_key)));
+   }
+   size_t total = 0;
+   while (const size_t rows = matches.produce(0)) {
+      EXPECT_LE(rows, 64);
+      const auto& expansion = matches.getExpansion(0);
+      for (size_t k = 0; k < rows; ++k) {
+         EXPECT_EQ(*reinterpret_cast<const uint64_t*>(expansion.probe_rows[k]), *reinterpret_cast<const uint64_t*>(expansion.build_rows[k]));
+      }
+      total += rows;
+   }
+   EXPECT_EQ(total, 200 * 100);
+   EXPECT_EQ(matches.progress(), 1.0);
+}
+
+/// Build an array index on 4 byte signed keys on two threads. Thread `k` inserts every second key of [from, to).
+void buildArrayIndex(ParallelBuildHashTable& build_tables, int32_t from, int32_t to) {
+   for (size_t thread_id = 0; thread_id < 2; ++thread_id) {
+      auto& table = build_tables.getThreadTable(thread_id);
+      for (int32_t key = from + thread_id; key < to; key += 2) {
+         char* slot = table.lookupOrInsert(reinterpret_cast<const char*>(&key));
+         *reinterpret_cast<int32_t*>(slot + 4) = key + 1;
+      }
+   }
+   std::vector<std::thread> workers;
+   for (size_t thread_id = 0; thread_id < 2; ++thread_id) {
+      workers.emplace_back([&, thread_id]() { build_tables.finalize(thread_id); });
+   }
+   for (auto& worker : workers) {
+      worker.join();
+   }
+}
+
+TEST(test_join_hash_tables, array_index_dense) {
+   // The keys cross the sign boundary.
+   HashTableSimpleKey target(4, 4, 8);
+   ParallelBuildHashTable build_tables(target, 4, 4);
+   auto& index = build_tables.enableArrayIndex(true);
+   buildArrayIndex(build_tables, -5'000, 5'000);
+   ASSERT_TRUE(index.isDense());
+   // The rows stay within the thread tables.
+   EXPECT_EQ(target.size(), 0);
+   for (int32_t key = -6'000; key < 6'000; ++key) {
+      const char* row = index.lookup(reinterpret_cast<const char*>(&key));
+      if (key < -5'000 || key >= 5'000) {
+         EXPECT_EQ(row, nullptr);
+      } else {
+         ASSERT_NE(row, nullptr);
+         EXPECT_EQ(*reinterpret_cast<const int32_t*>(row), key);
+         EXPECT_EQ(*reinterpret_cast<const int32_t*>(row + 4), key + 1);
+      }
+   }
+   // Far away keys must not wrap around into the array.
+   for (int32_t key : {std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max()}) {
+      EXPECT_EQ(index.lookup(reinterpret_cast<const char*>(&key)), nullptr);
+   }
+   // Dense keys don't need a hash, the lookups on a hash ignore it.
+   for (int32_t key = -6'000; key < 6'000; ++key) {
+      const char* packed = reinterpret_cast<const char*>(&key);
+      EXPECT_EQ(index.hashPrefetch<4>(packed), 0);
+      EXPECT_EQ(index.lookup<4>(packed, 0), index.lookup(packed));
+   }
+   // A disabling lookup finds every key exactly once.
+   for (int32_t key = -5'000; key < 5'000; ++key) {
+      ASSERT_NE(index.lookupDisable(reinterpret_cast<const char*>(&key)), nullptr);
+      EXPECT_EQ(index.lookupDisable(reinterpret_cast<const char*>(&key), 0), nullptr);
+   }
+}
+
+TEST(test_join_hash_tables, array_index_sparse) {
+   // A single far away key makes the keys too sparse for an array, lookups go to the target.
+   HashTableSimpleKey target(4, 4, 8);
+   ParallelBuildHashTable build_tables(target, 4, 4);
+   auto& index = build_tables.enableArrayIndex(false);
+   const int32_t far_key = 1'000'000;
+   build_tables.getThreadTable(0).lookupOrInsert(reinterpret_cast<const char*>(&far_key));
+   buildArrayIndex(build_tables, 0, 100);
+   EXPECT_FALSE(index.isDense());
+   EXPECT_EQ(target.size(), 101);
+   for (int32_t key = 0; key < 100; ++key) {
+      const char* packed = reinterpret_cast<const char*>(&key);
+      const char* row = index.lookup(packed);
+      ASSERT_NE(row, nullptr);
+      EXPECT_EQ(*reinterpret_cast<const int32_t*>(row + 4), key + 1);
+      // Sparse keys are hashed like in the target, also by the lookups specialized on the key width.
+      const uint64_t hash = index.hashPrefetch(packed);
+      EXPECT_EQ(hash, target.hash(packed));
+      EXPECT_EQ(index.hashPrefetch<4>(packed), hash);
+      EXPECT_EQ(index.lookup(packed, hash), row);
+      EXPECT_EQ(index.lookup<4>(packed, hash), row);
+   }
+   EXPECT_NE(index.lookupDisable(reinterpret_cast<const char*>(&far_key)), nullptr);
+   EXPECT_EQ(index.lookupDisable(reinterpret_cast<const char*>(&far_key)), nullptr);
+}
+
+TEST(test_join_hash_tables, empty_build) {
+   HashTableSimpleKey target(KEY_SIZE, PAYLOAD_SIZE, 8);
+   ParallelBuildHashTable build_tables(target, KEY_SIZE, PAYLOAD_SIZE);
+   build_tables.getThreadTable(3);
+   for (size_t thread_id = 0; thread_id < 4; ++thread_id) {
+      build_tables.finalize(thread_id);
+   }
+   EXPECT_EQ(target.size(), 0);
+   const uint64_t key = 0;
+   EXPECT_EQ(target.lookup(reinterpret_cast<const char*>(&key)), nullptr);
+}
+
+}
+
+}
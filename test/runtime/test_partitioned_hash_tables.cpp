@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+#include "runtime/PartitionedHashTables.h"
+#include <unordered_set>
+
+namespace inkfuse {
+
+namespace {
+
+/// Slots consist of an 8 byte key and an 8 byte counter.
+const uint16_t KEY_SIZE = 8;
+const uint16_t PAYLOAD_SIZE = 8;
+
+std::unique_ptr<HashTableSimpleKey> buildPartition() {
+   return std::make_unique<HashTableSimpleKey>(KEY_SIZE, PAYLOAD_SIZE, 8);
+}
+
+void addCounts(char* dst, const char* src) {
+   *reinterpret_cast<uint64_t*>(dst + KEY_SIZE) += *reinterpret_cast<const uint64_t*>(src + KEY_SIZE);
+}
+
+/// Count a key within the pre-aggregation table.
+void count(PartitionedHashTable<HashTableSimpleKey>& table, uint64_t key) {
+   char* slot = table.lookupOrInsert(reinterpret_cast<const char*>(&key));
+   EXPECT_EQ(*reinterpret_cast<uint64_t*>(slot), key);
+   (*reinterpret_cast<uint64_t*>(slot + KEY_SIZE))++;
+}
+
+TEST(test_partitioned_hash_tables, partitions_disjoint) {
+   PartitionedHashTable<HashTableSimpleKey> table(16, &buildPartition);
+   for (uint64_t key = 0; key < 10'000; ++key) {
+      count(table, key);
+      count(table, key);
+   }
+   // Every key lives in exactly one partition.
+   size_t total = 0;
+   for (size_t idx = 0; idx < table.getNumPartitions(); ++idx) {
+      auto& partition = table.getPartition(idx);
+      total += partition.size();
+      for (uint64_t key = 0; key < 10'000; ++key) {
+         const char* slot = partition.lookup(reinterpret_cast<const char*>(&key));
+         const bool expected = PartitionedHashTable<HashTableSimpleKey>::partitionIdx(partition.hash(reinterpret_cast<const char*>(&key)), 16) == idx;
+         EXPECT_EQ(slot != nullptr, expected);
+         if (slot) {
+            EXPECT_EQ(*reinterpret_cast<const uint64_t*>(slot + KEY_SIZE), 2);
+         }
+      }
+   }
+   EXPECT_EQ(total, 10'000);
+}
+
+TEST(test_partitioned_hash_tables, invalid_partitions) {
+   EXPECT_THROW(PartitionedHashTable<HashTableSimpleKey>(3, &buildPartition), std::runtime_error);
+   EXPECT_THROW(PartitionedHashTable<HashTableSimpleKey>(512, &buildPartition), std::runtime_error);
+}
+
+/// Three workers pre-aggregate overlapping key ranges, the merged partitions have to contain the combined counts.
+TEST(test_partitioned_hash_tables, merge) {
+   AggregationHashTables<HashTableSimpleKey> tables(&buildPartition, &addCounts, 8, KEY_SIZE, PAYLOAD_SIZE);
+   for (size_t thread_id = 0; thread_id < 3; ++thread_id) {
+      auto& table = tables.getThreadTable(thread_id);
+      // Worker k counts the keys [1000 * k, 1000 * k + 2000).
+      for (uint64_t key = 1000 * thread_id; key < 1000 * thread_id + 2000; ++key) {
+         count(table, key);
+      }
+   }
+
+   std::unordered_set<uint64_t> seen;
+   for (size_t idx = 0; idx < tables.getNumPartitions(); ++idx) {
+      auto& merged = tables.mergePartition(idx);
+      // Merging is idempotent.
+      EXPECT_EQ(&merged, &tables.mergePartition(idx));
+      char* it_data;
+      uint64_t it_idx;
+      merged.iteratorStart(&it_data, &it_idx);
+      while (it_data != nullptr) {
+         const uint64_t key = *reinterpret_cast<uint64_t*>(it_data);
+         const uint64_t counted = *reinterpret_cast<uint64_t*>(it_data + KEY_SIZE);
+         // The first and last 1000 keys are only seen by a single worker.
+         const uint64_t expected = (key < 1000 || key >= 3000) ? 1 : 2;
+         EXPECT_EQ(counted, expected);
+         EXPECT_TRUE(seen.insert(key).second);
+         merged.iteratorAdvance(&it_data, &it_idx);
+      }
+   }
+   EXPECT_EQ(seen.size(), 4000);
+}
+
+/// With a memory budget of zero, the workers spill their groups regularly. Merging has to combine the spilled groups.
+TEST(test_partitioned_hash_tables, spill) {
+   AggregationHashTables<HashTableSimpleKey> tables(&buildPartition, &addCounts, 8, KEY_SIZE, PAYLOAD_SIZE, 0);
+   for (size_t thread_id = 0; thread_id < 2; ++thread_id) {
+      auto& table = tables.getThreadTable(thread_id);
+      // Every worker counts the keys [0, 20'000) three times.
+      for (size_t round = 0; round < 3; ++round) {
+         for (uint64_t key = 0; key < 20'000; ++key) {
+            count(table, key);
+         }
+      }
+      // The table got cleared when spilling.
+      EXPECT_LT(table.getNumGroups(), 20'000);
+   }
+   EXPECT_GT(tables.getSpilledBytes(), 0);
+
+   size_t groups = 0;
+   for (size_t idx = 0; idx < tables.getNumPartitions(); ++idx) {
+      auto& merged = tables.mergePartition(idx);
+      char* it_data;
+      uint64_t it_idx;
+      merged.iteratorStart(&it_data, &it_idx);
+      while (it_data != nullptr) {
+         EXPECT_EQ(*reinterpret_cast<uint64_t*>(it_data + KEY_SIZE), 6);
+         groups++;
+         merged.iteratorAdvance(&it_data, &it_idx);
+      }
+      tables.dropPartition(idx);
+   }
+   EXPECT_EQ(groups, 20'000);
+}
+
+/// Without a memory budget, nothing gets spilled.
+TEST(test_partitioned_hash_tables, no_spill_without_budget) {
+   AggregationHashTables<HashTableSimpleKey> tables(&buildPartition, &addCounts, 8, KEY_SIZE, PAYLOAD_SIZE);
+   auto& table = tables.getThreadTable(0);
+   for (uint64_t key = 0; key < 20'000; ++key) {
+      count(table, key);
+   }
+   EXPECT_EQ(table.getNumGroups(), 20'000);
+   EXPECT_EQ(tables.getSpilledBytes(), 0);
+}
+
+}
+
+}
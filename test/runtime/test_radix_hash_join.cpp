@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+#include "runtime/RadixHashJoin.h"
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace inkfuse {
+
+namespace {
+
+/// Build rows consist of an 8 byte key and an 8 byte payload. Probe rows also have an 8 byte payload.
+const uint16_t KEY_SIZE = 8;
+const uint16_t PAYLOAD_SIZE = 8;
+const uint16_t PROBE_SIZE = 16;
+/// Number of build rows.
+const uint64_t BUILD_SIZE = 100'000;
+
+/// Run a function on two threads in parallel.
+template <class Fct>
+void onTwoThreads(Fct fct) {
+   std::thread worker([&]() { fct(1); });
+   fct(0);
+   worker.join();
+}
+
+/// The parameter is the target size of the hash table of a partition.
+struct RadixHashJoinTestT : public ::testing::TestWithParam<size_t> {
+   RadixHashJoinTestT() : hasher(KEY_SIZE, 0) {
+   }
+
+   /// Build on the keys [0, BUILD_SIZE) with payload `key + 1`.
+   void build(RadixHashJoin& join) {
+      onTwoThreads([&](size_t thread_id) {
+         auto& build = join.getThreadBuild(thread_id);
+         for (uint64_t key = thread_id; key < BUILD_SIZE; key += 2) {
+            char* row = build.append(reinterpret_cast<const char*>(&key));
+            *reinterpret_cast<uint64_t*>(row + KEY_SIZE) = key + 1;
+         }
+      });
+      onTwoThreads([&](size_t thread_id) { join.finalizeBuild(thread_id); });
+   }
+
+   /// Produce all joined rows and return how often every build key was produced.
+   std::vector<size_t> produce(RadixHashJoin& join, bool semi_join) {
+      std::vector<size_t> produced(BUILD_SIZE);
+      std::mutex produced_lock;
+      onTwoThreads([&](size_t thread_id) {
+         while (const size_t rows = join.produce(thread_id)) {
+            EXPECT_LE(rows, 1024);
+            char** build_rows = join.getOutput(thread_id, true);
+            char** probe_rows = join.getOutput(thread_id, false);
+            std::unique_lock guard(produced_lock);
+            for (size_t k = 0; k < rows; ++k) {
+               const auto* build_row = reinterpret_cast<const uint64_t*>(build_rows[k]);
+               EXPECT_EQ(build_row[1], build_row[0] + 1);
+               if (!semi_join) {
+                  const auto* probe_row = reinterpret_cast<const uint64_t*>(probe_rows[k]);
+                  EXPECT_EQ(probe_row[0], build_row[0]);
+                  EXPECT_EQ(probe_row[1], 2 * build_row[0]);
+               }
+               produced[build_row[0]]++;
+            }
+         }
+      });
+      EXPECT_EQ(join.progress(), 1.0);
+      return produced;
+   }
+
+   /// Only used for hashing the probe keys the same way the probe pipeline does.
+   HashTableSimpleKey hasher;
+};
+
+TEST_P(RadixHashJoinTestT, inner) {
+   RadixHashJoin join(KEY_SIZE, PAYLOAD_SIZE, PROBE_SIZE, false, 1024, GetParam());
+   build(join);
+   // Every build key has exactly one partner, the upper half of the probe keys has none.
+   onTwoThreads([&](size_t thread_id) {
+      auto& probe = join.getThreadProbe(thread_id);
+      for (uint64_t key = thread_id; key < 2 * BUILD_SIZE; key += 2) {
+         uint64_t row[2] = {key, 2 * key};
+         const char* packed = reinterpret_cast<const char*>(row);
+         probe.probe(packed, hasher.hash(packed));
+      }
+   });
+   onTwoThreads([&](size_t thread_id) { join.finalizeProbe(thread_id); });
+   const auto produced = produce(join, false);
+   for (uint64_t key = 0; key < BUILD_SIZE; ++key) {
+      ASSERT_EQ(produced[key], 1);
+   }
+
+   // The hash tables on the build side need around 3.4 MB.
+   if (GetParam() == std::numeric_limits<size_t>::max()) {
+      EXPECT_EQ(join.numPartitions(0), 1);
+      EXPECT_EQ(join.numPartitions(1), 1);
+   } else if (GetParam() == RadixHashJoin::default_partition_bytes) {
+      EXPECT_EQ(join.numPartitions(0), 16);
+      EXPECT_EQ(join.numPartitions(1), 1);
+   } else {
+      // Tiny partitions need a second partitioning pass.
+      EXPECT_EQ(join.numPartitions(0), size_t{1} << RadixHashJoin::max_pass_bits);
+      EXPECT_GT(join.numPartitions(1), 1);
+   }
+}
+
+TEST_P(RadixHashJoinTestT, semi) {
+   RadixHashJoin join(KEY_SIZE, PAYLOAD_SIZE, KEY_SIZE, true, 1024, GetParam());
+   build(join);
+   // Every build row has to be produced once, even though every key is probed twice.
+   // Probe rows of semi joins only consist of the key.
+   onTwoThreads([&](size_t thread_id) {
+      auto& probe = join.getThreadProbe(thread_id);
+      for (size_t k = 0; k < 2; ++k) {
+         for (uint64_t key = thread_id; key < BUILD_SIZE; key += 2) {
+            const char* packed = reinterpret_cast<const char*>(&key);
+            probe.probe(packed, hasher.hash(packed));
+         }
+      }
+   });
+   onTwoThreads([&](size_t thread_id) { join.finalizeProbe(thread_id); });
+   const auto produced = produce(join, true);
+   for (uint64_t key = 0; key < BUILD_SIZE; ++key) {
+      ASSERT_EQ(produced[key], 1);
+   }
+}
+
+INSTANTIATE_TEST_CASE_P(
+   test_radix_hash_join,
+   RadixHashJoinTestT,
+   ::testing::Values(512, RadixHashJoin::default_partition_bytes, std::numeric_limits<size_t>::max()));
+
+}
+
+}
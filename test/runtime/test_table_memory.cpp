@@ -0,0 +1,43 @@
+#include "gtest/gtest.h"
+#include "runtime/TableMemory.h"
+#include <algorithm>
+
+namespace inkfuse {
+
+namespace {
+
+bool allZero(const char* data, size_t bytes) {
+   return std::all_of(data, data + bytes, [](char c) { return c == 0; });
+}
+
+TEST(test_table_memory, small_arrays) {
+   TableMemory::clearPool();
+   auto array = TableMemory::makeArray<uint64_t>(100);
+   EXPECT_TRUE(allZero(reinterpret_cast<const char*>(array.get()), 800));
+   array.reset();
+   // Small arrays are not pooled.
+   EXPECT_EQ(TableMemory::pooledBytes(), 0);
+}
+
+TEST(test_table_memory, recycled_mappings_are_zeroed) {
+   TableMemory::clearPool();
+   const size_t bytes = 3 * TableMemory::mmap_threshold;
+   auto array = TableMemory::makeArray<char>(bytes);
+   EXPECT_TRUE(allZero(array.get(), bytes));
+   std::fill(array.get(), array.get() + bytes, 42);
+   const char* first = array.get();
+   array.reset();
+   // The mapping is kept for the next table of the same size.
+   EXPECT_GE(TableMemory::pooledBytes(), bytes);
+   auto recycled = TableMemory::makeArray<char>(bytes);
+   EXPECT_EQ(recycled.get(), first);
+   EXPECT_EQ(TableMemory::pooledBytes(), 0);
+   EXPECT_TRUE(allZero(recycled.get(), bytes));
+   recycled.reset();
+   TableMemory::clearPool();
+   EXPECT_EQ(TableMemory::pooledBytes(), 0);
+}
+
+}
+
+}
@@ -11,10 +11,8 @@ namespace {
 
 /// Test hash table inserts during a resize. This is a subtle flow which needs to make
 /// sure that hash table resizes during vectorized interpretation are handled correctly.
-/// For this we are using the fact that each primitive is idempotent - the hash tables
-/// inserts during vectorized interpretation should set the restart flag for the interpreter
-/// when a hash table resize occurs.
-/// Otherwise we run risk of retaining old pointers of the hash table before the resize.
+/// The pointers returned by the vectorized lookups are only consumed by the next primitive,
+/// so they have to stay valid when the hash table grows in the middle of the chunk.
 struct HtInsertTest : public ::testing::TestWithParam<PipelineExecutor::ExecutionMode> {
    HtInsertTest() : ht(4, 4, 16), pointers(IR::Pointer::build(IR::Char::build())), keys(IR::UnsignedInt::build(4)), to_pack(IR::UnsignedInt::build(4)) {
       auto& pipe = dag.buildNewPipeline();
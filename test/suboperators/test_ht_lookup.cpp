@@ -9,21 +9,27 @@ namespace inkfuse {
 
 namespace {
 
-struct HtLookupSubopTest : public ::testing::TestWithParam<PipelineExecutor::ExecutionMode> {
-   HtLookupSubopTest() : key_iu(IR::ByteArray::build(8)), ptr_iu(IR::Pointer::build(IR::Char::build())), table(8, 12) {
-      // Set up the hash table operator. No pseudo-ius as we directly provide the source and don't pack manually.
-      auto op = RuntimeFunctionSubop::htLookup<HashTableSimpleKey>(nullptr, ptr_iu, key_iu, {}, &table);
+/// Parametrized over the execution mode and whether the lookup runs on keys hashed by a separate prefetching primitive.
+using ParamT = std::tuple<PipelineExecutor::ExecutionMode, bool>;
+
+struct HtLookupSubopTest : public ::testing::TestWithParam<ParamT> {
+   HtLookupSubopTest() : key_iu(IR::ByteArray::build(8)), hash_iu(IR::UnsignedInt::build(8)), ptr_iu(IR::Pointer::build(IR::Char::build())), table(8, 12) {
       // And insert keys into the backing table.
       addValuesToHashTable();
 
       // Get ready for execution on the parametrized execution mode.
       PipelineDAG dag;
       dag.buildNewPipeline();
-      dag.getCurrentPipeline().attachSuboperator(std::move(op));
+      // Set up the hash table operator. No pseudo-ius as we directly provide the source and don't pack manually.
+      if (std::get<1>(GetParam())) {
+         dag.getCurrentPipeline().attachSuboperator(RuntimeFunctionSubop::htHashPrefetch<HashTableSimpleKey>(nullptr, hash_iu, key_iu, {}, &table));
+         dag.getCurrentPipeline().attachSuboperator(RuntimeFunctionSubop::htLookupWithHash<HashTableSimpleKey>(nullptr, ptr_iu, key_iu, hash_iu, {}, &table));
+      } else {
+         dag.getCurrentPipeline().attachSuboperator(RuntimeFunctionSubop::htLookup<HashTableSimpleKey>(nullptr, ptr_iu, key_iu, {}, &table));
+      }
       auto& pipe_simple = dag.getCurrentPipeline();
-      auto& ops = pipe_simple.getSubops();
       pipe = pipe_simple.repipeAll(0, pipe_simple.getSubops().size());
-      PipelineExecutor::ExecutionMode mode = GetParam();
+      PipelineExecutor::ExecutionMode mode = std::get<0>(GetParam());
       exec.emplace(*pipe, mode, "HtLookupSubop_exec");
    };
 
@@ -37,6 +43,7 @@ struct HtLookupSubopTest : public ::testing::TestWithParam<PipelineExecutor::Exe
    }
 
    IU key_iu;
+   IU hash_iu;
    IU ptr_iu;
    HashTableSimpleKey table;
    std::unique_ptr<Pipeline> pipe;
@@ -88,8 +95,10 @@ TEST_P(HtLookupSubopTest, lookup_nonexisting) {
 INSTANTIATE_TEST_CASE_P(
    HtLookupSubop,
    HtLookupSubopTest,
-   ::testing::Values(PipelineExecutor::ExecutionMode::Fused,
-                     PipelineExecutor::ExecutionMode::Interpreted));
+   ::testing::Combine(
+      ::testing::Values(PipelineExecutor::ExecutionMode::Fused,
+                        PipelineExecutor::ExecutionMode::Interpreted),
+      ::testing::Bool()));
 
 }
 
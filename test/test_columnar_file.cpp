@@ -0,0 +1,136 @@
+#include "common/Helpers.h"
+#include "common/TPCH.h"
+#include "storage/ColumnarFile.h"
+#include <cstring>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+namespace inkfuse {
+
+namespace {
+
+const size_t COL_SIZE = 1000;
+
+/// Fresh temporary directory which gets removed again at the end of the test.
+struct TempDir {
+   TempDir() : path(std::filesystem::temp_directory_path() / ("inkfuse_columnar_" + std::to_string(::getpid()))) {
+      std::filesystem::remove_all(path);
+   }
+   ~TempDir() {
+      std::filesystem::remove_all(path);
+   }
+
+   std::filesystem::path path;
+};
+
+/// Attach an int8 and a string column.
+void attachColumns(StoredRelation& rel) {
+   rel.attachPODColumn("ints", IR::SignedInt::build(8));
+   rel.attachStringColumn("strings");
+}
+
+TEST(test_columnar_file, roundtrip) {
+   TempDir dir;
+   {
+      StoredRelation rel;
+      attachColumns(rel);
+      for (size_t k = 0; k < COL_SIZE; ++k) {
+         rel.loadRow(std::to_string(k) + "|string_" + std::to_string(k) + "|");
+      }
+      ColumnarFile::write(rel, dir.path);
+   }
+   ASSERT_TRUE(ColumnarFile::exists(dir.path));
+
+   StoredRelation mapped;
+   attachColumns(mapped);
+   ColumnarFile::read(mapped, dir.path);
+   auto& ints = mapped.getColumn("ints");
+   auto& strings = mapped.getColumn("strings");
+   ASSERT_EQ(ints.length(), COL_SIZE);
+   ASSERT_EQ(strings.length(), COL_SIZE);
+   const auto* int_data = reinterpret_cast<const int64_t*>(ints.getRawData());
+   char** string_data = reinterpret_cast<char**>(strings.getRawData());
+   for (size_t k = 0; k < COL_SIZE; ++k) {
+      EXPECT_EQ(int_data[k], k);
+      EXPECT_STREQ(string_data[k], ("string_" + std::to_string(k)).c_str());
+   }
+   // Mapped columns are read-only.
+   EXPECT_ANY_THROW(ints.loadValue("1", 1));
+}
+
+TEST(test_columnar_file, schema_mismatch) {
+   TempDir dir;
+   {
+      StoredRelation rel;
+      attachColumns(rel);
+      rel.loadRow("1|a|");
+      ColumnarFile::write(rel, dir.path);
+   }
+   StoredRelation other_type;
+   other_type.attachPODColumn("ints", IR::SignedInt::build(4));
+   other_type.attachStringColumn("strings");
+   EXPECT_ANY_THROW(ColumnarFile::read(other_type, dir.path));
+   StoredRelation missing_column;
+   missing_column.attachPODColumn("ints", IR::SignedInt::build(8));
+   EXPECT_ANY_THROW(ColumnarFile::read(missing_column, dir.path));
+}
+
+TEST(test_columnar_file, tpch) {
+   TempDir dir;
+   {
+      auto schema = tpch::getTPCHSchema();
+      helpers::loadDataInto(schema, "test/tpch/testdata", true);
+      helpers::storeDataInto(schema, dir.path);
+   }
+   // There are no .tbl files, the tables have to come from the columnar files.
+   auto schema = tpch::getTPCHSchema();
+   auto expected = tpch::getTPCHSchema();
+   helpers::loadDataInto(schema, dir.path, true);
+   helpers::loadDataInto(expected, "test/tpch/testdata", true);
+   for (const auto& [tbl_name, tbl] : expected) {
+      const auto& mapped = schema[tbl_name];
+      for (size_t col_idx = 0; col_idx < tbl->columnCount(); ++col_idx) {
+         auto [name, col] = tbl->getColumn(col_idx);
+         auto& mapped_col = mapped->getColumn(name);
+         ASSERT_EQ(mapped_col.length(), col.length());
+         if (auto strings = dynamic_cast<StringColumn*>(&col)) {
+            char** data = reinterpret_cast<char**>(col.getRawData());
+            char** mapped_data = reinterpret_cast<char**>(mapped_col.getRawData());
+            for (size_t row = 0; row < col.length(); ++row) {
+               ASSERT_STREQ(mapped_data[row], data[row]);
+            }
+            // The dictionaries are mapped instead of being rebuilt.
+            auto& mapped_strings = dynamic_cast<StringColumn&>(mapped_col);
+            ASSERT_EQ(!!mapped_strings.getCodeType(), !!strings->getCodeType());
+            if (strings->getCodeType()) {
+               EXPECT_EQ(*dynamic_cast<const IR::DictionaryCode&>(*mapped_strings.getCodeType()).dictionary,
+                         *dynamic_cast<const IR::DictionaryCode&>(*strings->getCodeType()).dictionary);
+               EXPECT_EQ(std::memcmp(mapped_strings.getCodes(), strings->getCodes(), col.length()), 0);
+            }
+         } else {
+            const size_t value_bytes = col.getType()->numBytes();
+            // So are the deltas and zone maps. Compressed columns only store their deltas.
+            auto& pod = dynamic_cast<PODColumn&>(col);
+            auto& mapped_pod = dynamic_cast<PODColumn&>(mapped_col);
+            const size_t num_blocks = (col.length() + PODColumn::block_rows - 1) / PODColumn::block_rows;
+            ASSERT_EQ(!!mapped_pod.getDeltaType(), !!pod.getDeltaType());
+            if (pod.getDeltaType()) {
+               const size_t delta_width = pod.getDeltaType()->numBytes();
+               ASSERT_EQ(mapped_pod.getDeltaType()->numBytes(), delta_width);
+               EXPECT_EQ(mapped_pod.getRawData(), nullptr);
+               EXPECT_EQ(std::memcmp(mapped_pod.getReferences(), pod.getReferences(), num_blocks * value_bytes), 0);
+               EXPECT_EQ(std::memcmp(mapped_pod.getDeltas(), pod.getDeltas(), col.length() * delta_width), 0);
+            } else {
+               EXPECT_EQ(std::memcmp(mapped_col.getRawData(), col.getRawData(), col.length() * value_bytes), 0);
+            }
+            ASSERT_TRUE(mapped_pod.getZoneMap());
+            EXPECT_EQ(std::memcmp(mapped_pod.getZoneMap(), pod.getZoneMap(), 2 * num_blocks * value_bytes), 0);
+         }
+      }
+   }
+}
+
+}
+
+}
@@ -1,7 +1,11 @@
+#include "common/Helpers.h"
 #include "storage/Relation.h"
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <random>
 #include <gtest/gtest.h>
+#include <unistd.h>
 
 namespace inkfuse {
 
@@ -132,6 +136,171 @@ TEST(test_storage, load_strings) {
       EXPECT_EQ(0, std::strcmp(data[k], strings[k].data()));
    }
 }
+
+/// Test that only string columns with few distinct values get dictionary-encoded.
+TEST(test_storage, string_dictionary) {
+   StoredRelation rel;
+   auto& low = rel.attachStringColumn("low");
+   auto& high = rel.attachStringColumn("high");
+   const std::vector<std::string> values{"RAIL", "AIR", "TRUCK"};
+   for (size_t k = 0; k < COL_SIZE; ++k) {
+      low.loadValue(values[k % 3].data(), values[k % 3].size());
+      const auto unique = std::to_string(k);
+      high.loadValue(unique.data(), unique.size());
+   }
+   rel.buildDictionaries();
+   EXPECT_FALSE(high.getCodeType());
+   ASSERT_TRUE(low.getCodeType());
+   const auto& code_type = dynamic_cast<const IR::DictionaryCode&>(*low.getCodeType());
+   // Codes follow the order of the strings.
+   EXPECT_EQ(*code_type.dictionary, (std::vector<std::string>{"AIR", "RAIL", "TRUCK"}));
+   EXPECT_EQ(code_type.encode("SHIP"), IR::DictionaryCode::max_entries);
+   const auto* codes = reinterpret_cast<const uint8_t*>(low.getCodes());
+   char** strings = reinterpret_cast<char**>(low.getRawData());
+   for (size_t k = 0; k < COL_SIZE; ++k) {
+      EXPECT_EQ(code_type.decode(codes[k]), values[k % 3]);
+      EXPECT_STREQ(strings[k], values[k % 3].c_str());
+   }
+}
+
+TEST(test_storage, compress_columns) {
+   StoredRelation rel;
+   auto& sorted = rel.attachPODColumn("sorted", IR::UnsignedInt::build(8));
+   auto& negative = rel.attachPODColumn("negative", IR::SignedInt::build(4));
+   auto& wide = rel.attachPODColumn("wide", IR::SignedInt::build(4));
+   auto& narrow = rel.attachPODColumn("narrow", IR::UnsignedInt::build(1));
+   const size_t rows = 10 * PODColumn::block_rows + 7;
+   for (size_t k = 0; k < rows; ++k) {
+      const auto sorted_val = std::to_string(1'000'000'000'000 + 100 * k);
+      sorted.loadValue(sorted_val.data(), sorted_val.size());
+      const auto negative_val = std::to_string(-static_cast<int64_t>(k % 300));
+      negative.loadValue(negative_val.data(), negative_val.size());
+      const auto wide_val = std::to_string(k % 2 ? 2'000'000'000 : -2'000'000'000);
+      wide.loadValue(wide_val.data(), wide_val.size());
+      narrow.loadValue("1", 1);
+   }
+   rel.compressColumns();
+   // Deltas that are not narrower than the values are not worth it.
+   EXPECT_FALSE(wide.getDeltaType());
+   EXPECT_FALSE(narrow.getDeltaType());
+   // A block of the sorted column spans 102'300, the negative column 299.
+   ASSERT_TRUE(sorted.getDeltaType());
+   ASSERT_TRUE(negative.getDeltaType());
+   EXPECT_EQ(sorted.getDeltaType()->numBytes(), 4);
+   EXPECT_EQ(negative.getDeltaType()->numBytes(), 2);
+
+   // Decode the same way the table scan does.
+   const auto* sorted_refs = reinterpret_cast<const uint64_t*>(sorted.getReferences());
+   const auto* sorted_deltas = reinterpret_cast<const uint32_t*>(sorted.getDeltas());
+   const auto* negative_refs = reinterpret_cast<const int32_t*>(negative.getReferences());
+   const auto* negative_deltas = reinterpret_cast<const uint16_t*>(negative.getDeltas());
+   for (size_t k = 0; k < rows; ++k) {
+      const size_t block = k / PODColumn::block_rows;
+      EXPECT_EQ(sorted_refs[block] + sorted_deltas[k], 1'000'000'000'000 + 100 * k);
+      EXPECT_EQ(negative_refs[block] + negative_deltas[k], -static_cast<int64_t>(k % 300));
+   }
+   // The uncompressed values are released and the column cannot change anymore.
+   EXPECT_EQ(sorted.getRawData(), nullptr);
+   EXPECT_EQ(sorted.length(), rows);
+   EXPECT_ANY_THROW(sorted.loadValue("1", 1));
+   EXPECT_ANY_THROW(sorted.buildZoneMap());
+   // Uncompressed columns keep their values.
+   EXPECT_EQ(reinterpret_cast<const int32_t*>(wide.getRawData())[1], 2'000'000'000);
+}
+
+TEST(test_storage, zone_map) {
+   StoredRelation rel;
+   auto& dates = rel.attachPODColumn("dates", IR::Date::build());
+   auto& prices = rel.attachPODColumn("prices", IR::Float::build(8));
+   const size_t rows = 3 * PODColumn::block_rows;
+   for (size_t k = 0; k < rows; ++k) {
+      // Every block covers ten consecutive days.
+      const auto date = helpers::dateIntToStr(10'000 + 10 * (k / PODColumn::block_rows) + k % 10);
+      dates.loadValue(date.data(), date.size());
+      const auto price = std::to_string(k % 2 ? 1.5 : -1.5);
+      prices.loadValue(price.data(), price.size());
+   }
+   // Without a zone map every row could match.
+   const auto day = dates.parseValue(helpers::dateIntToStr(10'015));
+   EXPECT_TRUE(dates.mayContain(0, PODColumn::block_rows, day.data(), day.data()));
+   rel.buildZoneMaps();
+
+   // Only the second block contains the day.
+   EXPECT_FALSE(dates.mayContain(0, PODColumn::block_rows, day.data(), day.data()));
+   EXPECT_TRUE(dates.mayContain(PODColumn::block_rows, 2 * PODColumn::block_rows, day.data(), day.data()));
+   EXPECT_TRUE(dates.mayContain(0, rows, day.data(), day.data()));
+   EXPECT_FALSE(dates.mayContain(2 * PODColumn::block_rows, rows, nullptr, day.data()));
+   EXPECT_TRUE(dates.mayContain(2 * PODColumn::block_rows, rows, day.data(), nullptr));
+
+   const auto low = prices.parseValue("-2");
+   const auto high = prices.parseValue("2");
+   const auto above = prices.parseValue("1.6");
+   EXPECT_TRUE(prices.mayContain(0, rows, low.data(), high.data()));
+   EXPECT_FALSE(prices.mayContain(0, rows, above.data(), nullptr));
+   EXPECT_FALSE(prices.mayContain(0, rows, nullptr, low.data()));
+   // The zone map has to stay valid.
+   EXPECT_ANY_THROW(prices.loadValue("1", 1));
+}
+
+/// Test the hand-written date parser against leap years and dates before the epoch.
+TEST(test_storage, parse_dates) {
+   EXPECT_EQ(helpers::dateStrToInt("1970-01-01"), 0);
+   EXPECT_EQ(helpers::dateStrToInt("2000-02-29"), 11'016);
+   EXPECT_EQ(helpers::dateStrToInt("2000-03-01"), 11'017);
+   EXPECT_EQ(helpers::dateStrToInt("1900-03-01"), -25'508);
+   EXPECT_EQ(helpers::dateStrToInt("1998-12-01"), 10'561);
+   // Only the given number of characters is parsed.
+   EXPECT_EQ(helpers::dateStrToInt("1995-03-15|next", 10), helpers::dateStrToInt("1995-03-15"));
+   EXPECT_EQ(helpers::dateIntToStr(helpers::dateStrToInt("1992-1-2")), "1992-01-02");
+   EXPECT_ANY_THROW(helpers::dateStrToInt("1995-13-01"));
+   EXPECT_ANY_THROW(helpers::dateStrToInt("1995/03/01"));
+}
+
+/// Test that malformed rows get rejected.
+TEST(test_storage, malformed_rows) {
+   StoredRelation rel;
+   rel.attachPODColumn("col_1", IR::SignedInt::build(4));
+   rel.attachPODColumn("col_2", IR::Float::build(8));
+   rel.loadRow("1|2.5|");
+   EXPECT_ANY_THROW(rel.loadRow("1|"));
+   EXPECT_ANY_THROW(rel.loadRow("1|2.5"));
+   EXPECT_ANY_THROW(rel.loadRow("1|2.5|3|"));
+   EXPECT_ANY_THROW(rel.loadRow("one|2.5|"));
+}
+
+/// Test that a .tbl file split into multiple chunks ends up in file order.
+TEST(test_storage, load_file_parallel) {
+   const auto path = std::filesystem::temp_directory_path() / ("inkfuse_ingest_" + std::to_string(::getpid()) + ".tbl");
+   // Around 4 MB of rows, enough for four chunks.
+   const size_t rows = 100'000;
+   {
+      std::ofstream out(path);
+      for (size_t k = 0; k < rows; ++k) {
+         out << k << "|" << helpers::dateIntToStr(k % 10'000) << "|string_with_some_padding_" << k << "|" << (k % 1000) / 4.0 << "|\n";
+      }
+   }
+   StoredRelation rel;
+   rel.attachPODColumn("key", IR::UnsignedInt::build(8));
+   rel.attachPODColumn("date", IR::Date::build());
+   rel.attachStringColumn("string");
+   rel.attachPODColumn("value", IR::Float::build(8));
+   rel.loadFile(path, 4);
+   std::filesystem::remove(path);
+
+   for (size_t col_idx = 0; col_idx < rel.columnCount(); ++col_idx) {
+      ASSERT_EQ(rel.getColumn(col_idx).second.length(), rows);
+   }
+   const auto* keys = reinterpret_cast<const uint64_t*>(rel.getColumn("key").getRawData());
+   const auto* dates = reinterpret_cast<const int32_t*>(rel.getColumn("date").getRawData());
+   char** strings = reinterpret_cast<char**>(rel.getColumn("string").getRawData());
+   const auto* values = reinterpret_cast<const double*>(rel.getColumn("value").getRawData());
+   for (size_t k = 0; k < rows; ++k) {
+      ASSERT_EQ(keys[k], k);
+      ASSERT_EQ(dates[k], k % 10'000);
+      ASSERT_STREQ(strings[k], ("string_with_some_padding_" + std::to_string(k)).c_str());
+      ASSERT_EQ(values[k], (k % 1000) / 4.0);
+   }
+}
 }
 
 }
\ No newline at end of file
@@ -7,6 +7,24 @@ namespace inkfuse {
 
 namespace {
 
+/// Get the values of a 4 byte column. Compressed columns no longer have them, so they get decoded.
+std::vector<int32_t> int32Values(BaseColumn& col) {
+   auto& pod = dynamic_cast<PODColumn&>(col);
+   std::vector<int32_t> values(pod.length());
+   if (!pod.getDeltaType()) {
+      std::memcpy(values.data(), pod.getRawData(), values.size() * sizeof(int32_t));
+      return values;
+   }
+   const auto* references = reinterpret_cast<const int32_t*>(pod.getReferences());
+   const size_t delta_width = pod.getDeltaType()->numBytes();
+   for (size_t row = 0; row < values.size(); ++row) {
+      uint32_t delta = 0;
+      std::memcpy(&delta, pod.getDeltas() + row * delta_width, delta_width);
+      values[row] = references[row / PODColumn::block_rows] + static_cast<int32_t>(delta);
+   }
+   return values;
+}
+
 void testLineitem(Schema& schema) {
    auto& table = schema["lineitem"];
    // Every column should have 6005 rows ingested.
@@ -26,7 +44,7 @@ void testLineitem(Schema& schema) {
    {
       // l_orderkey increasing from 1 to 5988
       auto& l_orderkey = table->getColumn("l_orderkey");
-      auto l_orderkey_data = reinterpret_cast<int32_t*>(l_orderkey.getRawData());
+      auto l_orderkey_data = int32Values(l_orderkey);
       for (size_t row = 0; row < 6005; ++row) {
          EXPECT_GE(l_orderkey_data[row], 1);
          EXPECT_LE(l_orderkey_data[row], 5988);
@@ -38,7 +56,7 @@ void testLineitem(Schema& schema) {
    {
       // l_shipdate in the 90s
       auto& l_shipdate = table->getColumn("l_shipdate");
-      auto l_shipdate_data = reinterpret_cast<int32_t*>(l_shipdate.getRawData());
+      auto l_shipdate_data = int32Values(l_shipdate);
       auto min = helpers::dateStrToInt("1990-1-1");
       auto max = helpers::dateStrToInt("1999-12-31");
       EXPECT_GE(min, 365 * 20);
@@ -8,8 +8,8 @@ namespace inkfuse {
 
 namespace {
 
-// Parametrized over query-id and execution mode.
-class TPCHQueriesTestT : public ::testing::TestWithParam<std::tuple<std::string, PipelineExecutor::ExecutionMode>> {
+// Parametrized over query-id, execution mode and number of worker threads.
+class TPCHQueriesTestT : public ::testing::TestWithParam<std::tuple<std::string, PipelineExecutor::ExecutionMode, size_t>> {
    public:
    static void SetUpTestCase() {
       // Only ingest data once and share it across tests.
@@ -61,7 +61,7 @@ TEST_P(TPCHQueriesTestT, run) {
    auto control_block = std::make_shared<PipelineExecutor::QueryControlBlock>(std::move(root));
    std::stringstream stream;
    printer->setOstream(stream);
-   QueryExecutor::runQuery(control_block, std::get<1>(GetParam()), test_name);
+   QueryExecutor::runQuery(control_block, std::get<1>(GetParam()), test_name, std::get<2>(GetParam()));
    EXPECT_EQ(printer->num_rows, expected_rows.at(test_name));
 }
 
@@ -73,9 +73,10 @@ INSTANTIATE_TEST_CASE_P(
       ::testing::Values(
          PipelineExecutor::ExecutionMode::Fused,
          PipelineExecutor::ExecutionMode::Interpreted,
-         PipelineExecutor::ExecutionMode::Hybrid)),
-   [](const ::testing::TestParamInfo<std::tuple<std::string, PipelineExecutor::ExecutionMode>>& info) -> std::string {
-      return std::get<0>(info.param) + "_mode_" + std::to_string(static_cast<uint8_t>(std::get<1>(info.param)));
+         PipelineExecutor::ExecutionMode::Hybrid),
+      ::testing::Values(size_t{1}, size_t{4})),
+   [](const ::testing::TestParamInfo<std::tuple<std::string, PipelineExecutor::ExecutionMode, size_t>>& info) -> std::string {
+      return std::get<0>(info.param) + "_mode_" + std::to_string(static_cast<uint8_t>(std::get<1>(info.param))) + "_threads_" + std::to_string(std::get<2>(info.param));
    }
 );
 
@@ -4,6 +4,7 @@
 #include "exec/QueryExecutor.h"
 #include "gflags/gflags.h"
 #include "interpreter/FragmentCache.h"
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iostream>
@@ -14,6 +15,9 @@
 DEFINE_string(scale_factor, "1", "scale factor in the data directory");
 DEFINE_int32(repetitions, 10, "how often each query should be run");
 DEFINE_bool(perf_events, false, "should we collect perf events for each query?");
+DEFINE_int32(threads, 1, "how many worker threads should execute each pipeline?");
+DEFINE_bool(ht_stats, false, "should we dump the hash table statistics of the last repetition of each query?");
+DEFINE_bool(store_columnar, false, "should we store the loaded data in the columnar format, so that later runs can map it?");
 
 namespace {
 
@@ -61,6 +65,8 @@ int main(int argc, char* argv[]) {
    const auto sf = FLAGS_scale_factor;
    const auto reps = FLAGS_repetitions;
    const auto perf_events = FLAGS_perf_events;
+   const auto threads = static_cast<size_t>(std::max(FLAGS_threads, 1));
+   const auto ht_stats = FLAGS_ht_stats;
 
    // Populate the fragment cache.
    std::cout << "Generating & Loading Fragments ..." << std::endl;
@@ -75,6 +81,10 @@ int main(int argc, char* argv[]) {
       auto end = std::chrono::steady_clock::now();
       std::cout << "Loaded after " << std::chrono::duration_cast<std::chrono::seconds>(end - start).count() << " seconds" << std::endl;
    }
+   if (FLAGS_store_columnar) {
+      std::cout << "Storing Columnar Data ..." << std::endl;
+      helpers::storeDataInto(schema, "data");
+   }
 
    // If we are collecting perf events, set up the collector.
    BenchmarkParameters params;
@@ -88,6 +98,7 @@ int main(int argc, char* argv[]) {
    }
    params.setParam("name", "inkfuse_microbenchmark");
    params.setParam("sf", sf);
+   params.setParam("threads", std::to_string(threads));
    bool write_header = true;
 
    // Benchmark each backend.
@@ -96,6 +107,8 @@ int main(int argc, char* argv[]) {
       std::cout << "Benchmarking backend " << backend_name << "\n";
       // Measurements. Pairs of (total_time <milliseconds>, compilation_stalled <microseconds>).
       std::vector<std::vector<std::pair<size_t, size_t>>> measurements(reps);
+      // Hash table statistics of the last repetition of every query.
+      std::vector<std::vector<HashTableStats>> table_stats(queries.size());
 
       // Run the queries.
       for (size_t k = 0; k < queries.size(); ++k) {
@@ -112,21 +125,47 @@ int main(int argc, char* argv[]) {
             if (perf_events) {
                // Split into compilation and execution as we don't want compilation to populate
                // perf metrics.
-               QueryExecutor::StepwiseExecutor exec(control_block, backend_mode, q_name + "_" + std::to_string(rep));
+               QueryExecutor::StepwiseExecutor exec(control_block, backend_mode, q_name + "_" + std::to_string(rep), threads);
                exec.prepareQuery();
                // Wait until compilation is definitely done.
                std::this_thread::sleep_for(std::chrono::milliseconds(200));
                // And now perfom the actual execution, measuring the CPU metrics.
                PerfEventBlock block(perf_outfile, 1, params, write_header);
-               exec.runQuery();
+               query_stats = exec.runQuery();
                write_header = false;
             } else {
-               query_stats = QueryExecutor::runQuery(control_block, backend_mode, q_name + "_" + std::to_string(rep));
+               query_stats = QueryExecutor::runQuery(control_block, backend_mode, q_name + "_" + std::to_string(rep), threads);
             }
             const auto stop = std::chrono::steady_clock::now();
             const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
             observations.emplace_back(millis, query_stats.codegen_microseconds);
+            table_stats[k] = std::move(query_stats.hash_tables);
+         }
+      }
+
+      if (ht_stats) {
+         // One line per hash table accessed by the query.
+         const std::string f_name = "ht_stats_inkfuse_" + backend_name + "_" + sf + ".csv";
+         std::ofstream outfile;
+         outfile.open(f_name);
+         if (!outfile.is_open()) {
+            throw std::runtime_error("Could not open result file " + f_name);
+         }
+         outfile << "query,table,groups,slots,load_factor,peak_bytes_sum,resizes,resize_micros,probes,fingerprint_false_positives";
+         for (size_t bucket = 0; bucket < HashTableStats::probe_buckets; ++bucket) {
+            outfile << ",probe_len_" << (size_t{1} << bucket);
+         }
+         outfile << "\n";
+         for (size_t k = 0; k < queries.size(); ++k) {
+            for (const auto& table : table_stats[k]) {
+               outfile << queries[k].first << "," << table.table << "," << table.groups << "," << table.slots << "," << table.loadFactor() << ","
+                       << table.peak_bytes_sum << "," << table.resizes << "," << table.resize_nanos / 1000 << "," << table.probes() << "," << table.fingerprint_false_positives;
+               for (uint64_t count : table.probe_lengths) {
+                  outfile << "," << count;
+               }
+               outfile << "\n";
+            }
          }
       }
 